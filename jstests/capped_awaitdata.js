@@ -0,0 +1,24 @@
+// an awaitData getMore on a capped collection returns soon after an insert, not after its timeout
+
+t = db.capped_awaitdata;
+t.drop();
+db.createCollection( t.getName() , { capped : true , size : 100000 } );
+t.insert( { x : 0 } );
+db.getLastError();
+
+c = t.find().addOption( DBQuery.Option.tailable ).addOption( DBQuery.Option.awaitData );
+assert.eq( 0 , c.next().x );
+
+// with nothing new, the getMore waits out its timeout of about 4 seconds
+start = new Date();
+assert( !c.hasNext() );
+assert.gt( new Date() - start , 2000 , "returned without waiting" );
+
+s = startParallelShell( "sleep( 500 ); db.capped_awaitdata.insert( { x : 1 } ); db.getLastError();" );
+start = new Date();
+assert( c.hasNext() , "insert not seen" );
+assert.eq( 1 , c.next().x );
+assert.lt( new Date() - start , 3000 , "insert not noticed until the timeout" );
+s();
+
+t.drop();
@@ -0,0 +1,33 @@
+// engineStats sections, and the byte counters collStats keeps per index
+
+res = db.adminCommand( { engineStats : 1 } );
+assert.commandWorked( res );
+[ "cachetable" , "checkpoint" ].forEach( function( section ) {
+    assert.eq( "object" , typeof( res[section] ) , section + " " + tojson( res ) );
+    for ( var k in res[section] ) {
+        assert.eq( "number" , typeof( res[section][k] ) , section + "." + k );
+    }
+} );
+
+t = db.engine_stats;
+t.drop();
+t.ensureIndex( { x : 1 } );
+for ( var i = 0; i < 1000; i++ ) {
+    t.insert( { _id : i , x : i , s : "some bytes to write" } );
+}
+db.getLastError();
+
+s = t.stats();
+assert.lt( 0 , s.bytesWritten , tojson( s ) );
+assert.eq( 2 , s.indexDetails.length );
+s.indexDetails.forEach( function( idx ) {
+    assert.lt( 0 , idx.bytesWritten , tojson( idx ) );
+    assert.lte( 0 , idx.compressionRatio , tojson( idx ) );
+} );
+before = s.bytesRead;
+
+assert.eq( 1000 , t.find().hint( { _id : 1 } ).itcount() );
+assert.eq( 100 , t.find( { x : { $lt : 100 } } ).hint( { x : 1 } ).itcount() );
+assert.lt( before , t.stats().bytesRead );
+
+t.drop();
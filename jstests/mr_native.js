@@ -0,0 +1,64 @@
+// map/reduce with aggregation expressions instead of javascript
+
+t = db.mr_native;
+t.drop();
+
+for ( var i = 0; i < 20000; i++ ) {
+    t.insert( { g : i % 3000 , x : i , y : i * 2 , s : "s" + ( i % 7 ) } );
+}
+db.getLastError();
+
+function sorted( res ) {
+    assert.commandWorked( res );
+    var a = res.results || db[res.result].find().toArray();
+    a.sort( function( l , r ) { return l._id < r._id ? -1 : l._id > r._id ? 1 : 0; } );
+    return a;
+}
+
+jsMap = function() { emit( this.g , { x : this.x , y : this.y } ); };
+jsReduce = function( k , vals ) {
+    var res = { x : 0 , y : vals[0].y };
+    vals.forEach( function( v ) { res.x += v.x; res.y = Math.max( res.y , v.y ); } );
+    return res;
+};
+nativeMap = { key : "$g" , value : { x : "$x" , y : "$y" } };
+nativeReduce = { x : { $sum : "$value.x" } , y : { $max : "$value.y" } };
+
+// inline, and to a collection, with the mapper threads and without
+[ 1 , 4 ].forEach( function( threads ) {
+    assert.commandWorked( db.adminCommand( { setParameter : 1 , mrNativeMapThreads : threads } ) );
+
+    js = sorted( t.runCommand( "mapReduce" , { map : jsMap , reduce : jsReduce , out : { inline : 1 } } ) );
+    native = sorted( t.runCommand( "mapReduce" , { map : nativeMap , reduce : nativeReduce , out : { inline : 1 } } ) );
+    assert.eq( 3000 , native.length , "inline " + threads );
+    assert.eq( js , native , "inline " + threads );
+
+    native = sorted( t.runCommand( "mapReduce" , { map : nativeMap , reduce : nativeReduce , out : "mr_native_out" } ) );
+    assert.eq( js , native , "replace " + threads );
+} );
+
+// scalar values, a query and a finalize
+js = sorted( t.runCommand( "mapReduce" , {
+    map : function() { emit( this.s , this.x ); } ,
+    reduce : function( k , vals ) { return Array.sum( vals ); } ,
+    finalize : function( k , v ) { return v + 1; } ,
+    query : { x : { $lt : 1000 } } ,
+    out : { inline : 1 } } ) );
+native = sorted( t.runCommand( "mapReduce" , {
+    map : { key : "$s" , value : "$x" } ,
+    reduce : { $sum : "$value" } ,
+    finalize : { $add : [ "$value" , 1 ] } ,
+    query : { x : { $lt : 1000 } } ,
+    out : { inline : 1 } } ) );
+assert.eq( 7 , native.length , "scalar" );
+assert.eq( js , native , "scalar" );
+
+// reduces have to work on their own output
+res = t.runCommand( "mapReduce" , { map : nativeMap , reduce : { x : { $avg : "$value.x" } } , out : { inline : 1 } } );
+assert.commandFailed( res , "avg" );
+res = t.runCommand( "mapReduce" , { map : nativeMap , reduce : jsReduce , out : { inline : 1 } } );
+assert.commandFailed( res , "mixed" );
+
+assert.commandWorked( db.adminCommand( { setParameter : 1 , mrNativeMapThreads : 4 } ) );
+db.mr_native_out.drop();
+t.drop();
@@ -0,0 +1,91 @@
+// partitioned collections: documents live in primary key ranges that can be dropped whole
+
+t = db.partitioned_collection;
+t.drop();
+
+assert.commandWorked( db.runCommand( { create : t.getName() , partitioned : true } ) );
+assert.commandFailed( db.runCommand( { create : "partitioned_capped" , partitioned : true , capped : true , size : 1000 } ) );
+
+function info() {
+    var res = db.runCommand( { getPartitionInfo : t.getName() } );
+    assert.commandWorked( res );
+    return res;
+}
+assert.eq( 1 , info().numPartitions );
+
+for ( var i = 0; i < 100; i++ ) {
+    t.insert( { _id : i , x : i % 10 } );
+}
+assert( !db.getLastError() );
+
+// close off the first partition at its largest _id, and the second at a given one
+res = db.runCommand( { addPartition : t.getName() } );
+assert.commandWorked( res );
+assert.eq( 99 , res.max );
+for ( var i = 100; i < 200; i++ ) {
+    t.insert( { _id : i , x : i % 10 } );
+}
+assert.commandWorked( db.runCommand( { addPartition : t.getName() , newMax : 250 } ) );
+assert.commandFailed( db.runCommand( { addPartition : t.getName() , newMax : 150 } ) );
+for ( var i = 200; i < 300; i++ ) {
+    t.insert( { _id : i , x : i % 10 } );
+}
+assert( !db.getLastError() );
+
+p = info();
+assert.eq( 3 , p.numPartitions );
+assert.eq( 99 , p.partitions[0].max );
+assert.eq( 250 , p.partitions[1].max );
+
+// reads and writes find the right partition
+assert.eq( 300 , t.count() );
+assert.eq( 300 , t.find().itcount() );
+assert.eq( 30 , t.find( { x : 3 } ).itcount() );
+assert.eq( 299 , t.find().sort( { $natural : -1 } ).next()._id );
+assert.eq( { _id : 240 , x : 0 } , t.findOne( { _id : 240 } ) );
+assert.eq( 11 , t.find( { _id : { $gte : 95 , $lte : 105 } } ).itcount() );
+assert.eq( [ 105 , 104 , 103 , 102 , 101 , 100 , 99 , 98 , 97 , 96 , 95 ] ,
+           t.find( { _id : { $gte : 95 , $lte : 105 } } ).sort( { _id : -1 } ).toArray().map( function( o ) { return o._id; } ) );
+t.update( { _id : 251 } , { $set : { x : 100 } } );
+t.remove( { _id : 50 } );
+assert( !db.getLastError() );
+assert.eq( 100 , t.findOne( { _id : 251 } ).x );
+assert.eq( null , t.findOne( { _id : 50 } ) );
+assert.eq( 2 , t.find( { _id : { $gte : 49 , $lte : 51 } } ).explain().n );
+
+// no secondary indexes
+t.ensureIndex( { x : 1 } );
+assert( db.getLastError() );
+
+// a copy gets the same partitions, ids included, so the source's drops replay on it
+copydb = db.getSisterDB( "partitioned_collection_copy" );
+copydb.dropDatabase();
+assert.commandWorked( db.copyDatabase( db.getName() , copydb.getName() ) );
+assert.eq( p.partitions , copydb.runCommand( { getPartitionInfo : t.getName() } ).partitions );
+assert.eq( p.nextPartitionId , copydb.runCommand( { getPartitionInfo : t.getName() } ).nextPartitionId );
+assert.eq( 299 , copydb[t.getName()].count() );
+copydb.dropDatabase();
+
+// dropping the first partition drops its documents, and only those
+assert.commandWorked( db.runCommand( { dropPartition : t.getName() , id : p.partitions[0]._id } ) );
+assert.eq( 200 , t.count() );
+assert.eq( null , t.findOne( { _id : 10 } ) );
+assert.eq( 2 , info().numPartitions );
+
+// dropping the last gives its range to the one before it (a max is inclusive)
+assert.commandWorked( db.runCommand( { dropPartition : t.getName() , id : info().partitions[1]._id } ) );
+assert.eq( 1 , info().numPartitions );
+assert.eq( 151 , t.count() );
+t.insert( { _id : 1000 } );
+assert( !db.getLastError() );
+assert.eq( 152 , t.count() );
+assert.commandFailed( db.runCommand( { dropPartition : t.getName() , id : info().partitions[0]._id } ) );
+
+// not for regular collections
+db.partitioned_collection_plain.drop();
+db.partitioned_collection_plain.insert( { _id : 1 } );
+assert.commandFailed( db.runCommand( { addPartition : "partitioned_collection_plain" } ) );
+assert.commandFailed( db.runCommand( { getPartitionInfo : "partitioned_collection_plain" } ) );
+db.partitioned_collection_plain.drop();
+
+t.drop();
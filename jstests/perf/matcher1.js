@@ -0,0 +1,37 @@
+/**
+ *  Matcher throughput for some common predicate shapes, over an unindexed wide collection
+ */
+
+var size = 100000;
+var scans = 5;
+var t = db.perf.matcher1;
+
+function testSetup() {
+    t.drop();
+    var doc = { a : 5, s : "hello world", sub : { x : 1, y : { z : 2.5 } } };
+    for ( var i = 0; i < 50; i++ ) {
+        doc[ "" + i ] = i;
+    }
+    for ( var i = 0; i < size; i++ ) {
+        doc._id = i;
+        t.insert( doc );
+    }
+    assert.eq( null , db.getLastError() );
+}
+
+function report( shape, query ) {
+    assert.eq( size , t.find( query ).itcount() , shape );
+    var ms = Date.timeFunc( function() {
+        assert.eq( size , t.find( query ).itcount() , shape );
+    } , scans );
+    print( "matcher " + shape + ": " + Math.round( size * scans * 1000 / Math.max( ms , 1 ) ) + " docs/sec" );
+}
+
+testSetup();
+report( "equality" , { a : 5 } );
+report( "string equality" , { s : "hello world" } );
+report( "range" , { a : { $gt : 1 , $lt : 10 } } );
+report( "two fields" , { a : 5 , "49" : { $gte : 40 } } );
+report( "dotted" , { "sub.y.z" : { $lte : 3 } , "sub.x" : 1 } );
+report( "$in" , { a : { $in : [ 3 , 4 , 5 ] } } );
+t.drop();
@@ -0,0 +1,51 @@
+// sampled profiling, written to system.profile by the background profile writer
+
+// special db so that it can be run in parallel tests
+var stddb = db;
+var db = db.getSisterDB( "profile_sampled" );
+
+function setParams( async , rate ) {
+    assert.commandWorked( db.adminCommand( { setParameter : 1 , profileAsync : async , profileSampleRate : rate } ) );
+}
+
+try {
+    db.dropDatabase();
+    t = db.profile_sampled;
+    for ( var i = 0; i < 100; i++ ) {
+        t.insert( { _id : i } );
+    }
+    db.getLastError();
+
+    db.setProfilingLevel( 0 );
+    db.system.profile.drop();
+    setParams( true , 10 );
+    // nothing here is slow, only the sample gets profiled
+    db.setProfilingLevel( 1 , 100000 );
+
+    for ( var i = 0; i < 1000; i++ ) {
+        t.findOne( { _id : i % 100 } );
+    }
+
+    // the writer drains every 100ms, and op numbers are shared with other connections, so only
+    // the rough size of the sample can be checked
+    assert.soon( function() { return db.system.profile.find( { ns : t.getFullName() } ).count() >= 20; } ,
+                 "sampled ops never reached system.profile" );
+    sleep( 500 );
+    assert.gt( 500 , db.system.profile.find( { ns : t.getFullName() } ).count() , "sampled too much" );
+
+    o = db.system.profile.findOne( { ns : t.getFullName() , op : "query" } );
+    assert( o , "no sampled query" );
+    assert( o.timingMicros , tojson( o ) );
+    assert.lte( 0 , o.timingMicros.lockWait );
+    assert.lte( 0 , o.timingMicros.commit );
+
+    stats = db.serverStatus().profileWriter;
+    assert( stats.async );
+    assert.lt( 0 , stats.written );
+}
+finally {
+    db.setProfilingLevel( 0 , 100 );
+    setParams( false , 0 );
+    db.dropDatabase();
+    db = stddb;
+}
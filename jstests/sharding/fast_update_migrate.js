@@ -0,0 +1,45 @@
+// Fast updates only log their mods, which a migration never sees.  They run on shards
+// whenever no migration is logging ops, so a migration that starts afterwards must still
+// copy their effect with the rows it clones.
+
+var st = new ShardingTest({ shards : 2, mongos : 1 });
+
+// stop balancer since we want manual control for this
+st.stopBalancer();
+
+var dbname = "testDB";
+var coll = "fast_update_migrate";
+var ns = dbname + "." + coll;
+var s = st.s0;
+var t = s.getDB( dbname ).getCollection( coll );
+
+t.drop();
+s.adminCommand( { enablesharding : dbname } );
+s.adminCommand( { shardcollection : ns , key : { _id : 1 } } );
+for ( var i = 0; i < 1000; i++ ) {
+    t.insert( { _id : i , n : 0 } );
+}
+assert.eq( null , s.getDB( dbname ).getLastError() );
+
+var from = st.getServer( dbname );
+var to = st.getOther( from );
+[ from , to ].forEach( function( shard ) {
+    assert.commandWorked( shard.adminCommand( { setParameter : 1 , fastUpdates : true } ) );
+} );
+
+from.getDB( dbname ).setProfilingLevel( 2 );
+for ( var i = 0; i < 1000; i++ ) {
+    t.update( { _id : i } , { $inc : { n : 1 } } );
+}
+assert.eq( null , s.getDB( dbname ).getLastError() );
+from.getDB( dbname ).setProfilingLevel( 0 );
+assert.lt( 0 , from.getDB( dbname ).system.profile.find( { ns : ns , fastmod : true } ).itcount(),
+           "updates weren't fast" );
+
+var moveResult = s.adminCommand( { moveChunk : ns , find : { _id : 0 } , to : to.name } );
+assert( moveResult.ok , "migration didn't work after fast updates: " + tojson( moveResult ) );
+
+assert.eq( 1000 , to.getDB( dbname ).getCollection( coll ).count( { n : 1 } ) );
+assert.eq( 1000 , t.count( { n : 1 } ) );
+
+st.stop();
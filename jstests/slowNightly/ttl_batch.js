@@ -0,0 +1,38 @@
+/**
+ * The TTL monitor deletes a big expiry wave in batches, one transaction each, and reports them in
+ * serverStatus.
+ */
+
+var t = db.ttl_batch;
+t.drop();
+
+assert.commandWorked( db.adminCommand( { setParameter : 1 , ttlDeleteBatchSize : 100 } ) );
+
+var past = new Date( (new Date()).getTime() - 3600 * 1000 );
+for ( var i = 0; i < 5000; i++ ) {
+    t.insert( { x : past } );
+}
+t.insert( { x : new Date() } );
+db.getLastError();
+
+var before = db.serverStatus().ttl;
+t.ensureIndex( { x : 1 } , { expireAfterSeconds : 60 } );
+
+assert.soon(
+    function() {
+        return t.count() == 1;
+    }, "TTL index on x didn't delete everything expired" , 70 * 1000
+);
+
+// the counters are bumped just after each batch commits
+var after;
+assert.soon(
+    function() {
+        after = db.serverStatus().ttl;
+        return after.deletedDocuments - before.deletedDocuments == 5000 && after.expiredBacklog == 0;
+    }, "TTL stats don't show the deletes" , 10 * 1000
+);
+assert.gte( after.batches - before.batches , 50 , "not deleted in batches" );
+
+assert.commandWorked( db.adminCommand( { setParameter : 1 , ttlDeleteBatchSize : 1000 } ) );
+t.drop();
@@ -932,10 +932,18 @@ dodouble:
     }
 
     // used by jsonString()
-    inline std::string escape( const std::string& s , bool escape_slash=false) {
-        StringBuilder ret;
-        for ( std::string::const_iterator i = s.begin(); i != s.end(); ++i ) {
-            switch ( *i ) {
+    inline void escape( StringBuilder& ret, const StringData& s, bool escape_slash=false ) {
+        const char* const end = s.rawData() + s.size();
+        const char* run = s.rawData();
+        for ( const char* i = run; i != end; ++i ) {
+            const char c = *i;
+            // copy runs of characters that need no escaping in one go
+            if ( c != '"' && c != '\\' && c != '/' && !( c >= 0 && c <= 0x1f ) ) {
+                continue;
+            }
+            ret.write( run, i - run );
+            run = i + 1;
+            switch ( c ) {
             case '"':
                 ret << "\\\"";
                 break;
@@ -961,16 +969,16 @@ dodouble:
                 ret << "\\t";
                 break;
             default:
-                if ( *i >= 0 && *i <= 0x1f ) {
-                    //TODO: these should be utf16 code-units not bytes
-                    char c = *i;
-                    ret << "\\u00" << toHexLower(&c, 1);
-                }
-                else {
-                    ret << *i;
-                }
+                //TODO: these should be utf16 code-units not bytes
+                ret << "\\u00" << toHexLower(&c, 1);
             }
         }
+        ret.write( run, end - run );
+    }
+
+    inline std::string escape( const std::string& s , bool escape_slash=false) {
+        StringBuilder ret;
+        escape( ret, s, escape_slash );
         return ret.str();
     }
 
@@ -0,0 +1,156 @@
+/**
+ * Copyright (C) 2013 Tokutek Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Measures documents/sec for validating, iterating and looking up fields in small, wide and
+ * deeply nested documents.  Not run as part of the unit tests; build it with the bson_bench
+ * target and run it by hand, optionally passing the number of seconds to spend on each case.
+ */
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mongo/base/initializer.h"
+#include "mongo/bson/bson_element_index.h"
+#include "mongo/bson/bson_validate.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/util/timer.h"
+
+namespace mongo {
+namespace {
+
+    // keeps the compiler from optimizing the work away
+    volatile long long sink;
+
+    BSONObj smallDoc() {
+        return BSON( "_id" << OID::gen() << "name" << "some name" << "n" << 17 << "x" << 1.5 );
+    }
+
+    BSONObj wideDoc() {
+        BSONObjBuilder b;
+        for ( int i = 0; i < 200; i++ ) {
+            const std::string name = "field" + BSONObjBuilder::numStr( i );
+            if ( i % 3 == 0 )
+                b.append( name, "a string value" );
+            else if ( i % 3 == 1 )
+                b.append( name, i );
+            else
+                b.append( name, i * 1.5 );
+        }
+        return b.obj();
+    }
+
+    BSONObj nestedDoc() {
+        BSONObj x = BSON( "leaf" << "value" );
+        for ( int i = 0; i < 50; i++ ) {
+            x = BSON( "n" << i << "s" << "level" << "sub" << x );
+        }
+        return x;
+    }
+
+    struct Case {
+        const char *name;
+        void (*run)( const BSONObj &obj );
+    };
+
+    void validate( const BSONObj &obj ) {
+        sink += validateBSON( obj.objdata(), obj.objsize() ).isOK();
+    }
+
+    void validateUTF8( const BSONObj &obj ) {
+        sink += validateBSON( obj.objdata(), obj.objsize(), true ).isOK();
+    }
+
+    void iterate( const BSONObj &obj ) {
+        long long total = 0;
+        for ( BSONObjIterator it( obj ); it.more(); ) {
+            total += it.next().size();
+        }
+        sink += total;
+    }
+
+    // looks up the last, middle and first fields, as a matcher with three predicates would
+    void getFields( const BSONObj &obj ) {
+        const int n = obj.nFields();
+        BSONObjIterator it( obj );
+        std::vector<BSONElement> elts;
+        while ( it.more() ) {
+            elts.push_back( it.next() );
+        }
+        sink += obj.getField( elts[n - 1].fieldName() ).size();
+        sink += obj.getField( elts[n / 2].fieldName() ).size();
+        sink += obj.getField( elts[0].fieldName() ).size();
+    }
+
+    void indexFields( const BSONObj &obj ) {
+        BSONElementIndex index( obj );
+        const size_t n = index.size();
+        sink += index.getField( index[n - 1].fieldName() ).size();
+        sink += index.getField( index[n / 2].fieldName() ).size();
+        sink += index.getField( index[0].fieldName() ).size();
+    }
+
+    void runCase( const char *docName, const BSONObj &obj, const Case &c, double seconds ) {
+        const unsigned long long budget = static_cast<unsigned long long>( seconds * 1000 * 1000 );
+        long long docs = 0;
+        Timer t;
+        while ( t.micros() < budget ) {
+            for ( int i = 0; i < 1000; i++ ) {
+                c.run( obj );
+            }
+            docs += 1000;
+        }
+        const double rate = docs * 1000000.0 / t.micros();
+        std::cout << std::left << std::setw( 10 ) << docName
+                  << std::setw( 16 ) << c.name
+                  << std::right << std::setw( 14 ) << static_cast<long long>( rate )
+                  << " docs/sec" << std::endl;
+    }
+
+}  // namespace
+}  // namespace mongo
+
+int main( int argc, char **argv, char **envp ) {
+    using namespace mongo;
+    runGlobalInitializersOrDie( argc, argv, envp );
+
+    const double seconds = argc > 1 ? atof( argv[1] ) : 1.0;
+
+    const Case cases[] = {
+        { "validate", validate },
+        { "validateUTF8", validateUTF8 },
+        { "iterate", iterate },
+        { "getField", getFields },
+        { "elementIndex", indexFields },
+    };
+    const std::pair<const char *, BSONObj> docs[] = {
+        std::make_pair( "small", smallDoc() ),
+        std::make_pair( "wide", wideDoc() ),
+        std::make_pair( "nested", nestedDoc() ),
+    };
+
+    for ( size_t d = 0; d < sizeof( docs ) / sizeof( docs[0] ); d++ ) {
+        std::cout << docs[d].first << ": " << docs[d].second.objsize() << " bytes, "
+                  << docs[d].second.nFields() << " top level fields" << std::endl;
+        for ( size_t c = 0; c < sizeof( cases ) / sizeof( cases[0] ); c++ ) {
+            runCase( docs[d].first, docs[d].second, cases[c], seconds );
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * Copyright (C) 2013 Tokutek Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongo/bson/bson_element_index.h"
+
+#include <cstring>
+
+#include "mongo/bson/bsonobjiterator.h"
+
+namespace mongo {
+
+    BSONElementIndex::BSONElementIndex( const BSONObj &obj ) : _data( obj.objdata() ) {
+        for ( BSONObjIterator it( obj ); it.more(); ) {
+            const BSONElement e = it.next();
+            Entry entry;
+            entry.offset = static_cast<uint32_t>( e.rawdata() - _data );
+            entry.fieldNameSize = e.fieldNameSize();
+            entry.totalSize = e.size();
+            _entries.push_back( entry );
+        }
+    }
+
+    uint32_t BSONElementIndex::hashName( const char *name, size_t len ) {
+        // FNV-1a
+        uint32_t h = 2166136261U;
+        for ( size_t i = 0; i < len; ++i ) {
+            h ^= static_cast<unsigned char>( name[i] );
+            h *= 16777619U;
+        }
+        return h;
+    }
+
+    bool BSONElementIndex::nameEquals( const Entry &entry, const StringData &name ) const {
+        // the field name starts right after the type byte
+        return entry.fieldNameSize == static_cast<int>( name.size() ) + 1 &&
+               memcmp( _data + entry.offset + 1, name.rawData(), name.size() ) == 0;
+    }
+
+    void BSONElementIndex::buildHash() const {
+        size_t nSlots = 1;
+        while ( nSlots < _entries.size() * 2 ) {
+            nSlots <<= 1;
+        }
+        _slots.assign( nSlots, 0 );
+        const size_t mask = nSlots - 1;
+        for ( size_t i = 0; i < _entries.size(); ++i ) {
+            const Entry &entry = _entries[i];
+            const char *name = _data + entry.offset + 1;
+            const StringData nameData( name, entry.fieldNameSize - 1 );
+            size_t pos = hashName( name, entry.fieldNameSize - 1 ) & mask;
+            bool duplicate = false;
+            while ( _slots[pos] != 0 ) {
+                // as with BSONObj::getField(), the first of several equal names wins
+                if ( nameEquals( _entries[_slots[pos] - 1], nameData ) ) {
+                    duplicate = true;
+                    break;
+                }
+                pos = ( pos + 1 ) & mask;
+            }
+            if ( !duplicate ) {
+                _slots[pos] = static_cast<uint32_t>( i + 1 );
+            }
+        }
+    }
+
+    BSONElement BSONElementIndex::getField( const StringData &name ) const {
+        if ( _entries.size() < HashThreshold ) {
+            for ( std::vector<Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it ) {
+                if ( nameEquals( *it, name ) ) {
+                    return BSONElement( _data + it->offset, it->fieldNameSize, it->totalSize );
+                }
+            }
+            return BSONElement();
+        }
+
+        if ( _slots.empty() ) {
+            buildHash();
+        }
+        const size_t mask = _slots.size() - 1;
+        for ( size_t pos = hashName( name.rawData(), name.size() ) & mask;
+              _slots[pos] != 0;
+              pos = ( pos + 1 ) & mask ) {
+            const Entry &entry = _entries[_slots[pos] - 1];
+            if ( nameEquals( entry, name ) ) {
+                return BSONElement( _data + entry.offset, entry.fieldNameSize, entry.totalSize );
+            }
+        }
+        return BSONElement();
+    }
+
+}
@@ -0,0 +1,74 @@
+/**
+ * Copyright (C) 2013 Tokutek Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "mongo/base/string_data.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/platform/cstdint.h"
+
+namespace mongo {
+
+    /**
+     * The offsets and sizes of the top level elements of an object, found in a single pass.
+     *
+     * BSONObj::getField() walks the object and computes the size of every element before the
+     * one it is looking for, on every call.  Code that looks up several fields in the same
+     * object can build one of these instead, after which a lookup only compares field names of
+     * the right length and elements come back with their sizes already known.  Objects with many
+     * fields also get a hash table of the field names, built by the first getField().
+     *
+     * The object must stay in scope for as long as the index is used.
+     */
+    class BSONElementIndex {
+    public:
+        explicit BSONElementIndex( const BSONObj &obj );
+
+        /** @return the number of top level elements, not counting the EOO */
+        size_t size() const { return _entries.size(); }
+
+        /** @return the i'th element of the object */
+        BSONElement operator[]( size_t i ) const {
+            const Entry &e = _entries[i];
+            return BSONElement( _data + e.offset, e.fieldNameSize, e.totalSize );
+        }
+
+        /** @return the first element named name, or EOO if there is none */
+        BSONElement getField( const StringData &name ) const;
+
+    private:
+        struct Entry {
+            uint32_t offset;
+            int fieldNameSize; // includes the NUL
+            int totalSize;
+        };
+
+        // below this many fields, comparing lengths is about as fast as hashing
+        static const size_t HashThreshold = 16;
+
+        static uint32_t hashName( const char *name, size_t len );
+        bool nameEquals( const Entry &entry, const StringData &name ) const;
+        void buildHash() const;
+
+        const char *_data;
+        std::vector<Entry> _entries;
+        // open addressing, power of two slots holding an index into _entries plus one, 0 if empty
+        mutable std::vector<uint32_t> _slots;
+    };
+
+}
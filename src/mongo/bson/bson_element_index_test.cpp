@@ -0,0 +1,79 @@
+/**
+ * Copyright (C) 2013 Tokutek Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongo/bson/bson_element_index.h"
+
+#include "mongo/db/jsobj.h"
+#include "mongo/unittest/unittest.h"
+
+namespace {
+
+    using namespace mongo;
+
+    TEST(BSONElementIndex, Empty) {
+        BSONObj x;
+        BSONElementIndex index( x );
+        ASSERT_EQUALS( 0U, index.size() );
+        ASSERT( index.getField( "a" ).eoo() );
+    }
+
+    TEST(BSONElementIndex, MatchesIterator) {
+        BSONObj x = BSON( "a" << 1 << "bb" << "str" << "c" << BSON( "d" << 2 ) <<
+                          "e" << BSON_ARRAY( 1 << 2 ) << "f" << 1.5 );
+        BSONElementIndex index( x );
+        ASSERT_EQUALS( 5U, index.size() );
+        size_t i = 0;
+        for ( BSONObjIterator it( x ); it.more(); ++i ) {
+            BSONElement e = it.next();
+            ASSERT_EQUALS( e.rawdata(), index[i].rawdata() );
+            ASSERT_EQUALS( e.size(), index[i].size() );
+            ASSERT_EQUALS( string( e.fieldName() ), string( index[i].fieldName() ) );
+        }
+    }
+
+    TEST(BSONElementIndex, GetField) {
+        BSONObj x = BSON( "a" << 1 << "ab" << 2 << "b" << 3 << "a" << 4 );
+        BSONElementIndex index( x );
+        ASSERT_EQUALS( 1, index.getField( "a" ).numberInt() );
+        ASSERT_EQUALS( 2, index.getField( "ab" ).numberInt() );
+        ASSERT_EQUALS( 3, index.getField( "b" ).numberInt() );
+        ASSERT( index.getField( "" ).eoo() );
+        ASSERT( index.getField( "abc" ).eoo() );
+        ASSERT( index.getField( "c" ).eoo() );
+        ASSERT_EQUALS( x.getField( "ab" ).rawdata(), index.getField( "ab" ).rawdata() );
+    }
+
+    TEST(BSONElementIndex, GetFieldWide) {
+        // enough fields to use the hash table, with one duplicate name
+        BSONObjBuilder b;
+        for ( int i = 0; i < 100; i++ ) {
+            b.append( "f" + BSONObjBuilder::numStr( i ), i );
+        }
+        b.append( "f7", -1 );
+        BSONObj x = b.obj();
+        BSONElementIndex index( x );
+        ASSERT_EQUALS( 101U, index.size() );
+        for ( int i = 0; i < 100; i++ ) {
+            const string name = "f" + BSONObjBuilder::numStr( i );
+            ASSERT_EQUALS( x.getField( name ).rawdata(), index.getField( name ).rawdata() );
+            ASSERT_EQUALS( i, index.getField( name ).numberInt() );
+        }
+        ASSERT( index.getField( "f100" ).eoo() );
+        ASSERT( index.getField( "f" ).eoo() );
+        ASSERT( index.getField( "" ).eoo() );
+    }
+
+}
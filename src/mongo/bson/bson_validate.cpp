@@ -15,7 +15,8 @@
  *    limitations under the License.
  */
 
-#include <deque>
+#include <cstring>
+#include <vector>
 
 #include "mongo/bson/bson_validate.h"
 #include "mongo/bson/oid.h"
@@ -35,8 +36,7 @@ namespace mongo {
                 if ( ( _position + sizeof(N) ) > _maxLength )
                     return false;
                 if ( out ) {
-                    const N* temp = reinterpret_cast<const N*>(_buffer + _position);
-                    *out = *temp;
+                    memcpy( out, _buffer + _position, sizeof(N) );
                 }
                 _position += sizeof(N);
                 return true;
@@ -62,6 +62,10 @@ namespace mongo {
                 if ( !readNumber<int>( &sz ) )
                     return Status( ErrorCodes::InvalidBSON, "invalid bson" );
 
+                // the size counts the terminating NUL
+                if ( sz <= 0 )
+                    return Status( ErrorCodes::InvalidBSON, "invalid bson string length" );
+
                 if ( out ) {
                     *out = StringData( _buffer + _position, sz );
                 }
@@ -94,6 +98,77 @@ namespace mongo {
             uint64_t _maxLength;
         };
 
+        /**
+         * Checks UTF-8 well-formedness the same way isValidUTF8() in util/text.h does.  Runs of
+         * ASCII, the common case, are skipped a machine word at a time.
+         */
+        bool isValidUTF8Data( const char* data, size_t len ) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>( data );
+            const unsigned char* const end = p + len;
+            while ( p < end ) {
+                if ( end - p >= 8 ) {
+                    uint64_t word;
+                    memcpy( &word, p, sizeof(word) );
+                    if ( ( word & 0x8080808080808080ULL ) == 0 ) {
+                        p += 8;
+                        continue;
+                    }
+                }
+                const unsigned char c = *p++;
+                if ( c < 0x80 )
+                    continue;
+                int left; // continuation bytes expected
+                if ( c < 0xC2 || c > 0xF4 )
+                    return false; // unexpected continuation byte, overlong, or too large
+                else if ( c < 0xE0 )
+                    left = 1;
+                else if ( c < 0xF0 )
+                    left = 2;
+                else
+                    left = 3;
+                if ( end - p < left )
+                    return false;
+                for ( ; left; --left ) {
+                    if ( ( *p++ & 0xC0 ) != 0x80 )
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Size of the value of each element type that has a fixed size, -1 for types with
+         * variable size and for invalid types.
+         */
+        class FixedValueSizes {
+        public:
+            FixedValueSizes() {
+                for ( int i = 0; i < 256; ++i )
+                    _sizes[i] = -1;
+                set( MinKey, 0 );
+                set( MaxKey, 0 );
+                set( jstNULL, 0 );
+                set( Undefined, 0 );
+                set( Bool, sizeof(int8_t) );
+                set( NumberInt, sizeof(int32_t) );
+                set( NumberDouble, sizeof(int64_t) );
+                set( NumberLong, sizeof(int64_t) );
+                set( Timestamp, sizeof(int64_t) );
+                set( Date, sizeof(int64_t) );
+                set( jstOID, sizeof(OID) );
+            }
+            int operator[]( char type ) const {
+                return _sizes[static_cast<unsigned char>( type )];
+            }
+        private:
+            void set( BSONType type, int size ) {
+                _sizes[static_cast<unsigned char>( type )] = size;
+            }
+            int _sizes[256];
+        };
+
+        const FixedValueSizes fixedValueSizes;
+
         struct ValidationState {
             enum State {
                 BeginObj = 1,
@@ -127,7 +202,42 @@ namespace mongo {
             int _startPosition;
         };
 
-        Status validateElementInfo(Buffer* buffer, ValidationState::State* nextState) {
+        /**
+         * Stack of the objects being validated.  Documents are rarely nested deeply, so the first
+         * levels live inline and validating them allocates nothing.
+         */
+        class ValidationFrameStack {
+        public:
+            ValidationFrameStack() : _size( 0 ) {}
+
+            ValidationObjectFrame* push() {
+                if ( _size < kInlineFrames ) {
+                    return &_inline[_size++];
+                }
+                _overflow.push_back( ValidationObjectFrame() );
+                _size++;
+                return &_overflow.back();
+            }
+
+            /** @return the new top frame, or NULL if the stack is now empty */
+            ValidationObjectFrame* pop() {
+                if ( _size > kInlineFrames )
+                    _overflow.pop_back();
+                _size--;
+                if ( _size == 0 )
+                    return NULL;
+                return _size > kInlineFrames ? &_overflow.back() : &_inline[_size - 1];
+            }
+
+        private:
+            static const size_t kInlineFrames = 32;
+            ValidationObjectFrame _inline[kInlineFrames];
+            std::vector<ValidationObjectFrame> _overflow;
+            size_t _size;
+        };
+
+        Status validateElementInfo(Buffer* buffer, bool checkUTF8,
+                                   ValidationState::State* nextState) {
             Status status = Status::OK();
 
             char type;
@@ -143,38 +253,18 @@ namespace mongo {
             status = buffer->readCString( &name );
             if ( !status.isOK() )
                 return status;
+            if ( checkUTF8 && !isValidUTF8Data( name.rawData(), name.size() ) )
+                return Status( ErrorCodes::InvalidBSON, "field name is not valid UTF-8" );
 
-            switch ( type ) {
-            case MinKey:
-            case MaxKey:
-            case jstNULL:
-            case Undefined:
-                return Status::OK();
-
-            case jstOID:
-                if ( !buffer->skip( sizeof(OID) ) )
-                    return Status( ErrorCodes::InvalidBSON, "invalid bson" );
-                return Status::OK();
-
-            case NumberInt:
-                if ( !buffer->skip( sizeof(int32_t) ) )
-                    return Status( ErrorCodes::InvalidBSON, "invalid bson" );
-                return Status::OK();
-
-            case Bool:
-                if ( !buffer->skip( sizeof(int8_t) ) )
-                    return Status( ErrorCodes::InvalidBSON, "invalid bson" );
-                return Status::OK();
-
-
-            case NumberDouble:
-            case NumberLong:
-            case Timestamp:
-            case Date:
-                if ( !buffer->skip( sizeof(int64_t) ) )
+            // most elements have a fixed size, skip those without going through the switch
+            const int fixedSize = fixedValueSizes[type];
+            if ( fixedSize >= 0 ) {
+                if ( fixedSize > 0 && !buffer->skip( fixedSize ) )
                     return Status( ErrorCodes::InvalidBSON, "invalid bson" );
                 return Status::OK();
+            }
 
+            switch ( type ) {
             case DBRef:
                 status = buffer->readUTF8String( NULL );
                 if ( !status.isOK() )
@@ -194,11 +284,16 @@ namespace mongo {
 
             case Code:
             case Symbol:
-            case String:
-                status = buffer->readUTF8String( NULL );
+            case String: {
+                StringData value;
+                status = buffer->readUTF8String( &value );
                 if ( !status.isOK() )
                     return status;
+                // value includes the terminating NUL
+                if ( checkUTF8 && !isValidUTF8Data( value.rawData(), value.size() - 1 ) )
+                    return Status( ErrorCodes::InvalidBSON, "string is not valid UTF-8" );
                 return Status::OK();
+            }
 
             case BinData: {
                 int sz;
@@ -221,16 +316,15 @@ namespace mongo {
             }
         }
 
-        Status validateBSONIterative(Buffer* buffer) {
-            std::deque<ValidationObjectFrame> frames;
+        Status validateBSONIterative(Buffer* buffer, bool checkUTF8) {
+            ValidationFrameStack frames;
             ValidationObjectFrame* curr = NULL;
             ValidationState::State state = ValidationState::BeginObj;
 
             while (state != ValidationState::Done) {
                 switch (state) {
                 case ValidationState::BeginObj:
-                    frames.push_back(ValidationObjectFrame());
-                    curr = &frames.back();
+                    curr = frames.push();
                     curr->setStartPosition(buffer->position());
                     curr->setIsCodeWithScope(false);
                     if (!buffer->readNumber<int>(&curr->expectedSize)) {
@@ -240,7 +334,7 @@ namespace mongo {
                     state = ValidationState::WithinObj;
                     // fall through
                 case ValidationState::WithinObj: {
-                    Status status = validateElementInfo(buffer, &state);
+                    Status status = validateElementInfo(buffer, checkUTF8, &state);
                     if (!status.isOK())
                         return status;
                     break;
@@ -251,12 +345,11 @@ namespace mongo {
                         return Status( ErrorCodes::InvalidBSON,
                                        "bson length doesn't match what we found" );
                     }
-                    frames.pop_back();
-                    if (frames.empty()) {
+                    curr = frames.pop();
+                    if (!curr) {
                         state = ValidationState::Done;
                     }
                     else {
-                        curr = &frames.back();
                         if (curr->isCodeWithScope())
                             state = ValidationState::EndCodeWScope;
                         else
@@ -265,8 +358,7 @@ namespace mongo {
                     break;
                 }
                 case ValidationState::BeginCodeWScope: {
-                    frames.push_back(ValidationObjectFrame());
-                    curr = &frames.back();
+                    curr = frames.push();
                     curr->setStartPosition(buffer->position());
                     curr->setIsCodeWithScope(true);
                     if ( !buffer->readNumber<int>( &curr->expectedSize ) )
@@ -283,10 +375,9 @@ namespace mongo {
                         return Status( ErrorCodes::InvalidBSON,
                                        "bson length for CodeWScope doesn't match what we found" );
                     }
-                    frames.pop_back();
-                    if (frames.empty())
+                    curr = frames.pop();
+                    if (!curr)
                         return Status(ErrorCodes::InvalidBSON, "unnested CodeWScope");
-                    curr = &frames.back();
                     state = ValidationState::WithinObj;
                     break;
                 }
@@ -300,13 +391,13 @@ namespace mongo {
 
     }  // namespace
 
-    Status validateBSON( const char* originalBuffer, uint64_t maxLength ) {
+    Status validateBSON( const char* originalBuffer, uint64_t maxLength, bool checkUTF8 ) {
         if ( maxLength < 5 ) {
             return Status( ErrorCodes::InvalidBSON, "bson data has to be at least 5 bytes" );
         }
 
         Buffer buf( originalBuffer, maxLength );
-        return validateBSONIterative( &buf );
+        return validateBSONIterative( &buf, checkUTF8 );
     }
 
 }  // namespace mongo
@@ -213,4 +213,40 @@ namespace {
         ASSERT_NOT_OK(validateBSON(x.objdata(), x.objsize() / 2));
     }
 
+    TEST(BSONValidateFast, DeeplyNested) {
+        // deeper than the frames kept inline by the validator
+        BSONObj x = BSON( "x" << 1 );
+        for ( int i = 0; i < 100; i++ ) {
+            x = BSON( "a" << x << "b" << i );
+        }
+        ASSERT_OK(validateBSON(x.objdata(), x.objsize()));
+        ASSERT_NOT_OK(validateBSON(x.objdata(), x.objsize() - 1));
+    }
+
+    TEST(BSONValidateFast, ZeroLengthString) {
+        BSONObj x = BSON( "s" << "abc" );
+        // overwrite the string length
+        char* data = const_cast<char*>( x.getField( "s" ).value() );
+        memset( data, 0, 4 );
+        ASSERT_NOT_OK(validateBSON(x.objdata(), x.objsize()));
+    }
+
+    TEST(BSONValidateFast, UTF8) {
+        BSONObj ascii = BSON( "name" << "plain ascii that spans several words" );
+        ASSERT_OK(validateBSON(ascii.objdata(), ascii.objsize(), true));
+
+        BSONObj multibyte = BSON( "caf\xc3\xa9" << "\xe2\x82\xac 10, \xf0\x9f\x98\x80" );
+        ASSERT_OK(validateBSON(multibyte.objdata(), multibyte.objsize(), true));
+
+        BSONObj badValue = BSON( "a" << "0123456789\xc3" );
+        ASSERT_OK(validateBSON(badValue.objdata(), badValue.objsize()));
+        ASSERT_NOT_OK(validateBSON(badValue.objdata(), badValue.objsize(), true));
+
+        BSONObj badName = BSON( "\x80" << 1 );
+        ASSERT_NOT_OK(validateBSON(badName.objdata(), badName.objsize(), true));
+
+        BSONObj overlong = BSON( "a" << BSON( "b" << "\xc0\xaf" ) );
+        ASSERT_NOT_OK(validateBSON(overlong.objdata(), overlong.objsize(), true));
+    }
+
 }
@@ -108,6 +108,8 @@ namespace mongo {
         std::string toString( bool includeFieldName = true, bool full=false) const;
         void toString(StringBuilder& s, bool includeFieldName = true, bool full=false, int depth=0) const;
         std::string jsonString( JsonStringFormat format, bool includeFieldNames = true, int pretty = 0 ) const;
+        /** Appends the JSON to s without building intermediate strings. */
+        void jsonString( StringBuilder& s, JsonStringFormat format, bool includeFieldNames = true, int pretty = 0 ) const;
         operator std::string() const { return toString(); }
 
         /** Returns the type of the element */
@@ -462,11 +464,17 @@ namespace mongo {
         template<typename T> bool coerce( T* out ) const;
 
     private:
+        // for an element whose sizes are already known
+        BSONElement(const char *d, int fieldNameSize, int size) :
+            data(d), fieldNameSize_(fieldNameSize), totalSize(size) {
+        }
+
         const char *data;
         mutable int fieldNameSize_; // cached value
 
         mutable int totalSize; /* caches the computed size */
 
+        friend class BSONElementIndex;
         friend class BSONObjIterator;
         friend class BSONObj;
         const BSONElement& chk(int t) const {
@@ -152,6 +152,8 @@ namespace mongo {
             @param pretty if true we try to add some lf's and indentation
         */
         std::string jsonString( JsonStringFormat format = Strict, int pretty = 0 ) const;
+        /** Appends the JSON to s without building intermediate strings. */
+        void jsonString( StringBuilder& s, JsonStringFormat format = Strict, int pretty = 0 ) const;
 
         /** note: addFields always adds _id even if not specified */
         int addFields(BSONObj& from, std::set<std::string>& fields); /* returns n added */
@@ -467,21 +469,30 @@ namespace mongo {
         public:
             char data[4]; // start of object
 
+            // set in the ref-count of a holder allocated from an OpArena rather than malloc
+            enum { InOpArena = 0x80000000 };
+
             void zero() { refCount.zero(); }
+            void zeroInOpArena() { refCount.set(InOpArena); }
 
             // these are called automatically by boost::intrusive_ptr
             friend void intrusive_ptr_add_ref(Holder* h) { h->refCount++; }
             friend void intrusive_ptr_release(Holder* h) {
 #if defined(_DEBUG) // cant use dassert or DEV here
-                verify((int)h->refCount > 0); // make sure we haven't already freed the buffer
+                // make sure we haven't already freed the buffer
+                verify((h->refCount & ~InOpArena) > 0);
 #endif
-                if(--(h->refCount) == 0){
+                const unsigned left = --(h->refCount);
+                if((left & ~InOpArena) == 0){
 #if defined(_DEBUG)
                     unsigned sz = (unsigned&) *h->data;
                     verify(sz < BSONObjMaxInternalSize * 3);
                     memset(h->data, 0xdd, sz);
 #endif
-                    free(h);
+                    if (left == InOpArena)
+                        OpArena::release(h);
+                    else
+                        free(h);
                 }
             }
         };
@@ -55,6 +55,14 @@ namespace mongo {
             _b.skip(4); /*leave room for size field and ref-count*/
         }
 
+        /** @param arena if not NULL, OpArena::current() to build the object in, for a temporary
+            that is built and dropped within the operation.  obj() still works.
+        */
+        BSONObjBuilder(int initsize, OpArena* arena) : _b(_buf), _buf(initsize + sizeof(unsigned), arena), _offset( sizeof(unsigned) ), _s( this ) , _tracker(0) , _doneCalled(false) {
+            _b.appendNum((unsigned)0); // ref-count
+            _b.skip(4); /*leave room for size field and ref-count*/
+        }
+
         /** @param baseBuilder construct a BSONObjBuilder using an existing BufBuilder
          *  This is for more efficient adding of subobjects/arrays. See docs for subobjStart for example.
          */
@@ -559,7 +567,9 @@ namespace mongo {
             massert( 10335 , "builder does not own memory", own );
             doneFast();
             BSONObj::Holder* h = (BSONObj::Holder*)_b.buf();
-            decouple(); // sets _b.buf() to NULL
+            if ( _b.inOpArena() )
+                h->zeroInOpArena(); // so the object gives the buffer back to the arena
+            _b.decoupleHolder(); // sets _b.buf() to NULL
             return BSONObj(h);
         }
 
@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "mongo/bson/inline_decls.h"
+#include "mongo/bson/util/op_arena.h"
 #include "mongo/base/string_data.h"
 #include "mongo/util/assert_util.h"
 
@@ -65,14 +66,43 @@ namespace mongo {
 
     class TrivialAllocator { 
     public:
-        void* Malloc(size_t sz) { return malloc(sz); }
-        void* Realloc(void *p, size_t sz) { return realloc(p, sz); }
-        void Free(void *p) { free(p); }
+        TrivialAllocator() : _arena(NULL) { }
+
+        /** Allocate from arena, if not NULL, which must be OpArena::current(). */
+        void useOpArena(OpArena* arena) { _arena = arena; }
+        /** @return true if the current allocation came from an OpArena */
+        bool inOpArena() const { return _arena != NULL; }
+
+        void* Malloc(size_t sz) {
+            if ( _arena ) {
+                void *p = _arena == OpArena::current() ? _arena->allocate(sz) : NULL;
+                if ( p )
+                    return p;
+                _arena = NULL;
+            }
+            return malloc(sz);
+        }
+        void* Realloc(void *p, size_t sz) {
+            if ( _arena )
+                return arenaRealloc(p, sz);
+            return realloc(p, sz);
+        }
+        void Free(void *p) {
+            if ( _arena )
+                OpArena::release(p);
+            else
+                free(p);
+        }
+    private:
+        void* arenaRealloc(void *p, size_t sz);
+
+        OpArena *_arena;
     };
 
     class StackAllocator {
     public:
         enum { SZ = 512 };
+        bool inOpArena() const { return false; }
         void* Malloc(size_t sz) {
             if( sz <= SZ ) return buf;
             return malloc(sz); 
@@ -104,15 +134,14 @@ namespace mongo {
         Allocator al;
     public:
         _BufBuilder(int initsize = 512) : size(initsize) {
-            if ( size > 0 ) {
-                data = (char *) al.Malloc(size);
-                if( data == 0 )
-                    msgasserted(10000, "out of memory BufBuilder");
-            }
-            else {
-                data = 0;
-            }
-            l = 0;
+            init();
+        }
+        /** Draw the buffer from arena, if not NULL, which must be OpArena::current().  A buffer
+            from an arena can't be decouple()d, but a BSONObjBuilder's can still become a BSONObj.
+        */
+        _BufBuilder(int initsize, OpArena *arena) : size(initsize) {
+            al.useOpArena(arena);
+            init();
         }
         ~_BufBuilder() { kill(); }
 
@@ -147,7 +176,18 @@ namespace mongo {
         const char* buf() const { return data; }
 
         /* assume ownership of the buffer - you must then free() it */
-        void decouple() { data = 0; }
+        void decouple() {
+            if ( al.inOpArena() )
+                msgasserted( 17024 , "can't decouple a BufBuilder buffer from an OpArena" );
+            data = 0;
+        }
+
+        /* assume ownership of a buffer that starts with a BSONObj::Holder, which frees itself
+           correctly whether or not it came from an OpArena */
+        void decoupleHolder() { data = 0; }
+
+        /** @return true if the buffer came from an OpArena */
+        bool inOpArena() const { return al.inOpArena(); }
 
         void appendUChar(unsigned char j) {
             *((unsigned char*)grow(sizeof(unsigned char))) = j;
@@ -211,6 +251,18 @@ namespace mongo {
         }
 
     private:
+        void init() {
+            if ( size > 0 ) {
+                data = (char *) al.Malloc(size);
+                if( data == 0 )
+                    msgasserted(10000, "out of memory BufBuilder");
+            }
+            else {
+                data = 0;
+            }
+            l = 0;
+        }
+
         /* "slow" portion of 'grow()'  */
         void NOINLINE_DECL grow_reallocate() {
             int a = 64;
@@ -321,6 +373,9 @@ namespace mongo {
         void reset( int maxSize = 0 ) { _buf.reset( maxSize ); }
 
         std::string str() const { return std::string(_buf.data, _buf.l); }
+
+        /** @return the contents, valid until the builder is next modified */
+        StringData stringData() const { return StringData(_buf.data, _buf.l); }
         
         int len() const { return _buf.l; }
 
@@ -0,0 +1,258 @@
+/**
+ * Copyright (C) 2013 Tokutek Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongo/pch.h"
+
+#include "mongo/bson/util/op_arena.h"
+
+#include <algorithm>
+#include <new>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/bson/util/builder.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/concurrency/threadlocal.h"
+
+namespace mongo {
+
+    struct OpArena::Block {
+        /** Precedes each allocation. */
+        struct Header {
+            Block* block;
+            size_t size;
+        };
+
+        explicit Block(size_t sz) : refs(1), size(sz), used(0) { }
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+
+        /** @return the space an allocation of size bytes takes in its block */
+        static size_t footprint(size_t size) {
+            return (sizeof(Header) + size + 7) & ~static_cast<size_t>(7);
+        }
+
+        static Header* header(const void* p) {
+            return const_cast<Header*>(static_cast<const Header*>(p)) - 1;
+        }
+
+        // one per live allocation, plus one while it is its arena's current block
+        AtomicUInt32 refs;
+        const size_t size;
+        size_t used;
+    };
+
+    namespace {
+
+        AtomicInt64 totalOperations;
+        AtomicInt64 totalAllocations;
+        AtomicInt64 totalBytes;
+        AtomicInt64 totalBlocks;
+        AtomicInt64 totalOversize;
+        AtomicInt64 highWater;
+
+    } // namespace
+
+    TSP_DECLARE(OpArena, opArenas);
+    TSP_DEFINE(OpArena, opArenas);
+
+    OpArena::OpArena() :
+        _block(NULL), _nextBlockSize(BlockSize), _active(false),
+        _allocations(0), _bytes(0), _inUse(0), _peak(0), _blocks(0), _oversize(0) {
+    }
+
+    OpArena::~OpArena() {
+        retire();
+    }
+
+    OpArena* OpArena::current() {
+        OpArena* arena = opArenas.get();
+        return arena != NULL && arena->_active ? arena : NULL;
+    }
+
+    void* OpArena::allocate(size_t size) {
+        if (size > MaxAllocation) {
+            _oversize++;
+            return NULL;
+        }
+        const size_t needed = Block::footprint(size);
+        if (_block == NULL || _block->size - _block->used < needed) {
+            if (!newBlock(needed)) {
+                return NULL;
+            }
+        }
+        Block::Header* h = reinterpret_cast<Block::Header*>(_block->data() + _block->used);
+        h->block = _block;
+        h->size = size;
+        _block->used += needed;
+        _block->refs.fetchAndAdd(1);
+
+        _allocations++;
+        _bytes += size;
+        _inUse += needed;
+        _peak = std::max(_peak, _inUse);
+        return h + 1;
+    }
+
+    void* OpArena::reallocate(void* p, size_t size) {
+        if (size > MaxAllocation) {
+            _oversize++;
+            return NULL;
+        }
+        Block::Header* h = Block::header(p);
+        Block* b = h->block;
+        const size_t oldNeeded = Block::footprint(h->size);
+        const size_t needed = Block::footprint(size);
+        const bool newest = b == _block &&
+                            reinterpret_cast<char*>(h) + oldNeeded == b->data() + b->used;
+        if (newest && b->size - (b->used - oldNeeded) >= needed) {
+            b->used = b->used - oldNeeded + needed;
+            _inUse += static_cast<long long>(needed) - static_cast<long long>(oldNeeded);
+            _peak = std::max(_peak, _inUse);
+            if (size > h->size) {
+                _bytes += size - h->size;
+            }
+            h->size = size;
+            return p;
+        }
+
+        void* q = allocate(size);
+        if (q == NULL) {
+            return NULL;
+        }
+        memcpy(q, p, std::min(h->size, size));
+        release(p);
+        return q;
+    }
+
+    size_t OpArena::allocationSize(const void* p) {
+        return Block::header(p)->size;
+    }
+
+    void OpArena::release(void* p) {
+        Block::Header* h = Block::header(p);
+        Block* b = h->block;
+        OpArena* arena = current();
+        if (arena != NULL && arena->_block == b) {
+            // only this thread allocates from its current block, so it may rewind it
+            const size_t needed = Block::footprint(h->size);
+            if (reinterpret_cast<char*>(h) + needed == b->data() + b->used) {
+                b->used -= needed;
+                arena->_inUse -= needed;
+            }
+        }
+        if (b->refs.subtractAndFetch(1) == 0) {
+            free(b);
+        }
+    }
+
+    bool OpArena::newBlock(size_t needed) {
+        const size_t size = std::max(_nextBlockSize, needed);
+        void* mem = malloc(sizeof(Block) + size);
+        if (mem == NULL) {
+            return false;
+        }
+        retire();
+        _block = new (mem) Block(size);
+        _blocks++;
+        _nextBlockSize = std::min(_nextBlockSize * 2, static_cast<size_t>(MaxBlockSize));
+        return true;
+    }
+
+    void OpArena::retire() {
+        if (_block != NULL) {
+            if (_block->refs.subtractAndFetch(1) == 0) {
+                free(_block);
+            }
+            _block = NULL;
+        }
+    }
+
+    void OpArena::reset() {
+        if (_allocations > 0 || _oversize > 0) {
+            totalOperations.fetchAndAdd(1);
+            totalAllocations.fetchAndAdd(_allocations);
+            totalBytes.fetchAndAdd(_bytes);
+            totalBlocks.fetchAndAdd(_blocks);
+            totalOversize.fetchAndAdd(_oversize);
+            for (long long seen = highWater.load(); seen < _peak; ) {
+                const long long was = highWater.compareAndSwap(seen, _peak);
+                if (was == seen) {
+                    break;
+                }
+                seen = was;
+            }
+        }
+        _allocations = _bytes = _inUse = _peak = _blocks = _oversize = 0;
+
+        // Keep a first-size block that nothing points into any more, so the next operation
+        // doesn't need a malloc at all.  Anything bigger goes back, as does a block that
+        // still has live allocations; those free it when they go.
+        if (_block != NULL) {
+            if (_block->size <= static_cast<size_t>(BlockSize) && _block->refs.load() == 1) {
+                _block->used = 0;
+            }
+            else {
+                retire();
+            }
+        }
+        _nextBlockSize = BlockSize;
+    }
+
+    void OpArena::appendStats(BSONObjBuilder& b) {
+        b.append("operations", totalOperations.load());
+        b.append("allocations", totalAllocations.load());
+        b.append("bytesAllocated", totalBytes.load());
+        b.append("blocksAllocated", totalBlocks.load());
+        b.append("oversizeAllocations", totalOversize.load());
+        b.append("highWaterBytes", highWater.load());
+    }
+
+    OpArena::Scope::Scope() : _arena(opArenas.getMake()) {
+        if (_arena->_active) {
+            _arena = NULL;
+        }
+        else {
+            _arena->_active = true;
+        }
+    }
+
+    OpArena::Scope::~Scope() {
+        if (_arena != NULL) {
+            _arena->_active = false;
+            _arena->reset();
+        }
+    }
+
+    void* TrivialAllocator::arenaRealloc(void* p, size_t sz) {
+        if (p == NULL) {
+            return Malloc(sz);
+        }
+        if (_arena == OpArena::current()) {
+            void* q = _arena->reallocate(p, sz);
+            if (q != NULL) {
+                return q;
+            }
+        }
+        // too big for the arena, or the operation is over: move to the heap for good
+        void* q = malloc(sz);
+        if (q != NULL) {
+            memcpy(q, p, std::min(OpArena::allocationSize(p), sz));
+            OpArena::release(p);
+            _arena = NULL;
+        }
+        return q;
+    }
+
+} // namespace mongo
@@ -0,0 +1,105 @@
+/**
+ * Copyright (C) 2013 Tokutek Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <boost/noncopyable.hpp>
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /**
+     * A per-thread bump allocator for the temporary buffers of a single operation.
+     *
+     * Building a BSONObj costs a malloc, a realloc or two as it grows, and a free, which with
+     * hundreds of connection threads all building temporaries is a lot of traffic through the
+     * global allocator.  While an OpArena::Scope is open, BufBuilders and BSONObjBuilders that
+     * are given OpArena::current() take their buffers from the thread's arena instead: an
+     * allocation is a pointer bump, growing the newest buffer happens in place, and freeing it
+     * rewinds the arena.  The first block is kept for the thread's next operation.
+     *
+     * Every allocation holds a reference on its block, so a buffer that outlives the operation,
+     * or that is freed by another thread, is still safe; it only keeps its block from being
+     * reused until it is freed.  Allocations larger than MaxAllocation come from malloc.
+     */
+    class OpArena : boost::noncopyable {
+    public:
+        enum {
+            BlockSize = 32 * 1024,
+            MaxBlockSize = 1024 * 1024,
+            MaxAllocation = 128 * 1024
+        };
+
+        OpArena();
+        ~OpArena();
+
+        /** @return this thread's arena if an operation is in progress on it, otherwise NULL */
+        static OpArena* current();
+
+        /** @return size bytes, or NULL if size is more than MaxAllocation */
+        void* allocate(size_t size);
+
+        /**
+         * Grow or shrink an allocation from this arena, in place if it is the newest one.
+         * @return NULL, leaving p alone, if size is more than MaxAllocation
+         */
+        void* reallocate(void* p, size_t size);
+
+        /** @return the size p was allocated or last reallocated with */
+        static size_t allocationSize(const void* p);
+
+        /** Free an allocation from any arena, from any thread. */
+        static void release(void* p);
+
+        /** Totals and high water marks over all operations so far, for serverStatus. */
+        static void appendStats(BSONObjBuilder& b);
+
+        /**
+         * Activates the thread's arena for the duration of an operation, and resets it after.
+         * Scopes opened while another one is open, as by DBDirectClient, do nothing.
+         */
+        class Scope : boost::noncopyable {
+        public:
+            Scope();
+            ~Scope();
+        private:
+            OpArena* _arena;
+        };
+
+    private:
+        struct Block;
+
+        bool newBlock(size_t needed);
+        void retire();
+        void reset();
+
+        Block* _block;
+        size_t _nextBlockSize;
+        bool _active;
+
+        // this operation's numbers, added to the totals when it ends
+        long long _allocations;
+        long long _bytes;
+        long long _inUse;
+        long long _peak;
+        long long _blocks;
+        long long _oversize;
+    };
+
+} // namespace mongo
@@ -0,0 +1,79 @@
+/**
+*    Copyright (C) 2013 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/pch.h"
+
+#include "mongo/db/capped_notifier.h"
+
+#include <map>
+
+#include "mongo/util/concurrency/mutex.h"
+
+namespace mongo {
+
+    namespace {
+        SimpleMutex notifiersMutex("cappedNotifiers");
+        std::map<string, shared_ptr<CappedNotifier> > notifiers;
+    }
+
+    shared_ptr<CappedNotifier> CappedNotifier::get(const StringData &ns) {
+        SimpleMutex::scoped_lock lk(notifiersMutex);
+        shared_ptr<CappedNotifier> &n = notifiers[ns.toString()];
+        if (!n) {
+            n.reset(new CappedNotifier());
+        }
+        return n;
+    }
+
+    shared_ptr<CappedNotifier> CappedNotifier::find(const StringData &ns) {
+        SimpleMutex::scoped_lock lk(notifiersMutex);
+        std::map<string, shared_ptr<CappedNotifier> >::const_iterator it = notifiers.find(ns.toString());
+        return it != notifiers.end() ? it->second : shared_ptr<CappedNotifier>();
+    }
+
+    void CappedNotifier::release(const StringData &ns, shared_ptr<CappedNotifier> &n) {
+        SimpleMutex::scoped_lock lk(notifiersMutex);
+        n.reset();
+        std::map<string, shared_ptr<CappedNotifier> >::iterator it = notifiers.find(ns.toString());
+        if (it != notifiers.end() && it->second.unique()) {
+            notifiers.erase(it);
+        }
+    }
+
+    void CappedNotifier::notifyAll() {
+        _version.fetchAndAdd(1);
+        // A waiter counts itself before it checks the version, and checks it under the mutex,
+        // so if it missed the increment it is either counted here or already waiting.
+        if (_waiters.load() > 0) {
+            boost::mutex::scoped_lock lk(_mutex);
+            _cond.notify_all();
+        }
+    }
+
+    bool CappedNotifier::waitForChange(unsigned long long seen, int millis) {
+        _waiters.fetchAndAdd(1);
+        bool changed = true;
+        {
+            boost::mutex::scoped_lock lk(_mutex);
+            if (_version.load() == seen) {
+                changed = _cond.timed_wait(lk, boost::posix_time::milliseconds(millis));
+            }
+        }
+        _waiters.fetchAndSubtract(1);
+        return changed;
+    }
+
+} // namespace mongo
@@ -0,0 +1,70 @@
+/**
+*    Copyright (C) 2013 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "mongo/pch.h"
+
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "mongo/base/string_data.h"
+#include "mongo/platform/atomic_word.h"
+
+namespace mongo {
+
+    /**
+     * Wakes the awaitData getMores tailing a capped collection when a transaction that
+     * inserted into it completes, instead of having them poll.  Aborts count too, since an
+     * abort can move minUnsafeKey() past inserts that committed before it.
+     *
+     * A getMore reads version() before it looks for data, and if it finds none, waits for the
+     * version to change.  An open capped collection holds its notifier, so notifying costs an
+     * atomic increment, and a lock only when someone is waiting.
+     */
+    class CappedNotifier : boost::noncopyable {
+    public:
+        CappedNotifier() : _waiters(0) { }
+
+        // @return the notifier for ns, making one if there isn't one yet.  For the collection.
+        static shared_ptr<CappedNotifier> get(const StringData &ns);
+
+        // @return the notifier for ns, or an empty pointer if ns isn't an open capped collection
+        static shared_ptr<CappedNotifier> find(const StringData &ns);
+
+        // Drops n, and forgets the notifier for ns if nothing else holds it.
+        static void release(const StringData &ns, shared_ptr<CappedNotifier> &n);
+
+        unsigned long long version() const {
+            return _version.load();
+        }
+
+        void notifyAll();
+
+        /**
+         * Waits until the version isn't seen any more, or for millis.
+         * @return false if it timed out
+         */
+        bool waitForChange(unsigned long long seen, int millis);
+
+    private:
+        AtomicUInt64 _version;
+        AtomicUInt32 _waiters;
+        boost::mutex _mutex;
+        boost::condition _cond;
+    };
+
+} // namespace mongo
@@ -514,6 +514,7 @@ namespace mongo {
         fastmodinsert = false;
         upsert = false;
         keyUpdates = 0;  // unsigned, so -1 not possible
+        commitMicros = 0;
         
         exceptionInfo.reset();
         lockNotGrantedInfo = BSONObj();
@@ -669,6 +670,12 @@ namespace mongo {
         OPDEBUG_APPEND_NUMBER( keyUpdates );
 
         b.append( "lockStats" , curop.lockStat().report() );
+        {
+            BSONObjBuilder t( b.subobjStart( "timingMicros" ) );
+            t.append( "lockWait" , curop.lockStat().getTotalTimeAcquiring() );
+            t.append( "commit" , commitMicros );
+            t.done();
+        }
 
         if ( ! exceptionInfo.empty() )
             exceptionInfo.append( b , "exception" , "exceptionCode" );
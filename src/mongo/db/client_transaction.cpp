@@ -24,6 +24,7 @@
 #include "pch.h"
 
 #include "mongo/db/client.h"
+#include "mongo/db/curop.h"
 
 namespace mongo {
 
@@ -54,7 +55,13 @@ namespace mongo {
     void Client::TransactionStack::commitTxn(int flags) {
         DEV { LOG(3) << "commit transaction(" << _txns.size() - 1 << ") " << flags << endl; }
         shared_ptr<TxnContext> txnToCommit = _txns.top();
+        const unsigned long long start = curTimeMicros64();
         txnToCommit->commit(flags);
+        // for the profiler, which shows how much of an op went to writing the log
+        CurOp *op = haveClient() ? cc().curop() : NULL;
+        if (op != NULL) {
+            op->debug().commitMicros += curTimeMicros64() - start;
+        }
         pop();
     }
 
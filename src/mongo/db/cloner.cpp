@@ -308,6 +308,21 @@ namespace mongo {
         }
     }
 
+    /* A partitioned collection gets the source's partitions, ids and all, before any documents
+       go in, so the copy's partitions hold the same keys and replayed dropPartitions find them.
+    */
+    static void copyPartitions(DBClientBase &conn, const string &from_name, const string &to_name) {
+        BSONObj info;
+        uassert( 17069, str::stream() << "could not get the partitions of " << from_name << ": " << info,
+                 conn.runCommand(nsToDatabase(from_name),
+                                 BSON("getPartitionInfo" << nsToCollectionSubstring(from_name)),
+                                 info) );
+        Client::WriteContext ctx(to_name);
+        NamespaceDetails *d = nsdetails(to_name);
+        verify(d != NULL);
+        d->clonePartitions(info);
+    }
+
     void Cloner::copyCollectionData(
         const string& ns, 
         const BSONObj& query,
@@ -365,6 +380,9 @@ namespace mongo {
                 {
                     return false;
                 }
+                if ( config["options"].Obj()["partitioned"].trueValue() ) {
+                    copyPartitions(*conn, ns, ns);
+                }
             }
         }
         copyCollectionData(ns, query, copyIndexes, true);
@@ -514,6 +532,9 @@ namespace mongo {
                 const char *toname = to_name.c_str();
                 userCreateNS(toname, options, err, opts.logForRepl);
             }
+            if ( options["partitioned"].trueValue() ) {
+                copyPartitions(*conn, from_name, to_name);
+            }
             LOG(1) << "\t\t cloning " << from_name << " -> " << to_name << endl;
             Query q;
             copy(
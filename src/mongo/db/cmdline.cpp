@@ -164,6 +164,7 @@ namespace {
         hidden.add_options()
         ("objcheck", "inspect client data for validity on receipt (DEFAULT)")
         ("noobjcheck", "do NOT inspect client data for validity on receipt")
+        ("objcheckUTF8", "also require field names and strings in client data to be valid UTF-8")
         ("traceExceptions", "log stack traces for every exception")
         ;
     }
@@ -388,6 +389,13 @@ namespace {
             }
             cmdLine.objcheck = false;
         }
+        if (params.count("objcheckUTF8")) {
+            if (!cmdLine.objcheck) {
+                out() << "--objcheckUTF8 needs --objcheck" << endl;
+                return false;
+            }
+            cmdLine.objcheckUTF8 = true;
+        }
 
         if (params.count("bind_ip")) {
             // passing in wildcard is the same as default behavior; remove and warn
@@ -89,6 +89,7 @@ namespace mongo {
 
 
         bool objcheck;         // --objcheck
+        bool objcheckUTF8;     // --objcheckUTF8, also require valid UTF-8 when objcheck is on
 
         int defaultProfile;    // --profile
         int slowMS;            // --time in ms that is "slow"
@@ -182,7 +183,7 @@ namespace mongo {
         configsvr(false), quota(false), quotaFiles(8), cpu(false),
         logFlushPeriod(100), // 0 means fsync every transaction, 100 means fsync log once every 100 ms
         expireOplogDays(0), expireOplogHours(0), // default of 0 means never purge entries from oplog
-        objcheck(true), defaultProfile(0),
+        objcheck(true), objcheckUTF8(false), defaultProfile(0),
         slowMS(100), defaultLocalThresholdMillis(15), moveParanoia( true ),
         syncdelay(60), noUnixSocket(false), doFork(0), socket("/tmp"), maxConns(DEFAULT_MAX_CONN),
         logAppend(false), logWithSyslog(false),
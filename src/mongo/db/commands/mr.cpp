@@ -36,6 +36,7 @@
 
 #include "mongo/db/commands/mr.h"
 
+#include "mongo/db/server_parameters.h"
 #include "mongo/util/scopeguard.h"
 
 namespace mongo {
@@ -44,6 +45,9 @@ namespace mongo {
 
         AtomicUInt Config::JOB_NUMBER;
 
+        // threads that run a native map, see ParallelMapper; 1 maps on the command's thread
+        MONGO_EXPORT_SERVER_PARAMETER(mrNativeMapThreads, int, 4);
+
         JSFunction::JSFunction( const std::string& type , const BSONElement& e ) {
             _type = type;
             _code = e._asCode();
@@ -264,10 +268,20 @@ namespace mongo {
                 if ( cmdObj["scope"].type() == Object )
                     scopeSetup = cmdObj["scope"].embeddedObjectUserCheck();
 
-                mapper.reset( new JSMapper( cmdObj["map"] ) );
-                reducer.reset( new JSReducer( cmdObj["reduce"] ) );
-                if ( cmdObj["finalize"].type() && cmdObj["finalize"].trueValue() )
-                    finalizer.reset( new JSFinalizer( cmdObj["finalize"] ) );
+                native = cmdObj["map"].type() == Object;
+                if ( native ) {
+                    uassert( 17045 , "a native map needs a native reduce" , cmdObj["reduce"].type() == Object );
+                    mapper.reset( new NativeMapper( cmdObj["map"] ) );
+                    reducer.reset( new NativeReducer( cmdObj["reduce"] ) );
+                    if ( cmdObj["finalize"].type() && cmdObj["finalize"].trueValue() )
+                        finalizer.reset( new NativeFinalizer( cmdObj["finalize"] ) );
+                }
+                else {
+                    mapper.reset( new JSMapper( cmdObj["map"] ) );
+                    reducer.reset( new JSReducer( cmdObj["reduce"] ) );
+                    if ( cmdObj["finalize"].type() && cmdObj["finalize"].trueValue() )
+                        finalizer.reset( new JSFinalizer( cmdObj["finalize"] ) );
+                }
 
                 if ( cmdObj["mapparams"].type() == Array ) {
                     mapParams = cmdObj["mapparams"].embeddedObjectUserCheck();
@@ -636,6 +650,16 @@ namespace mongo {
          * Initialize the mapreduce operation, creating the inc collection
          */
         void State::init() {
+            if ( _config.native ) {
+                // nothing to set up in js, and no js mode to run in
+                _config.mapper->init( this );
+                _config.reducer->init( this );
+                if ( _config.finalizer )
+                    _config.finalizer->init( this );
+                _jsMode = false;
+                return;
+            }
+
             // setup js
             const string userToken = ClientBasic::getCurrent()->getAuthorizationManager()
                                                               ->getAuthenticatedPrincipalNamesToken();
@@ -994,6 +1018,10 @@ namespace mongo {
             _add( _temp.get() , a , _size );
         }
 
+        void State::emitCombined( const BSONObj& a ) {
+            _add( _temp.get() , a , _size );
+        }
+
         void State::_add( InMemory* im, const BSONObj& a , long& size ) {
             BSONList& all = (*im)[a];
             all.push_back( a );
@@ -1121,7 +1149,7 @@ namespace mongo {
 
                 LOG(1) << "mr ns: " << config.ns << endl;
 
-                uassert( 16149 , "cannot run map reduce without the js engine", globalScriptEngine );
+                uassert( 16149 , "cannot run map reduce without the js engine", config.native || globalScriptEngine );
 
                 // Get chunk manager before we check our version, to make sure it doesn't increment
                 // in the meantime
@@ -1166,6 +1194,11 @@ namespace mongo {
                         {
                             Client::ReadContext ctx( config.ns );
 
+                            scoped_ptr<ParallelMapper> parallel;
+                            if ( config.native && mrNativeMapThreads > 1 ) {
+                                parallel.reset( new ParallelMapper( state , mrNativeMapThreads ) );
+                            }
+
                             // obtain full cursor on data to apply mr to
                             shared_ptr<Cursor> temp = getOptimizedCursor( config.ns.c_str(), config.filter, config.sort );
                             uassert( 16052, str::stream() << "could not create cursor over " << config.ns << " for query : " << config.filter << " sort : " << config.sort, temp.get() );
@@ -1196,18 +1229,29 @@ namespace mongo {
 
                                 // do map
                                 if ( config.verbose ) mt.reset();
-                                config.mapper->map( o );
+                                if ( parallel ) {
+                                    // the mapper threads' tables get checked as they come back
+                                    parallel->map( o );
+                                }
+                                else {
+                                    config.mapper->map( o );
+                                    // check if map needs to be dumped to disk
+                                    state.checkSize();
+                                }
                                 if ( config.verbose ) mapTime += mt.micros();
 
-                                // check if map needs to be dumped to disk
-                                state.checkSize();
-
                                 num++;
                                 pm.hit();
 
                                 if ( config.limit && num >= config.limit )
                                     break;
                             }
+
+                            if ( parallel ) {
+                                if ( config.verbose ) mt.reset();
+                                parallel->finish();
+                                if ( config.verbose ) mapTime += mt.micros();
+                            }
                         }
                         pm.finished();
 
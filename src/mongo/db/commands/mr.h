@@ -19,6 +19,7 @@
 #pragma once
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
 #include <string>
 #include <vector>
 
@@ -26,7 +27,9 @@
 #include "mongo/db/curop.h"
 #include "mongo/db/instance.h"
 #include "mongo/db/jsobj.h"
+#include "mongo/db/pipeline/accumulator.h"
 #include "mongo/scripting/engine.h"
+#include "mongo/util/queue.h"
 
 namespace mongo {
 
@@ -139,6 +142,70 @@ namespace mongo {
 
         };
 
+        // ------------  native implementations -----------
+
+        /**
+         * A map/reduce may give its functions as aggregation expressions instead of JavaScript,
+         * and then runs without the scripting engine:
+         *
+         *   map:      { key: <expression>, value: <expression> }   emits once per document
+         *   reduce:   { $sum|$min|$max: <expression> }              for scalar values, or
+         *             { <field>: { $sum|$min|$max: <expression> }, ... }   for object values
+         *   finalize: <expression>
+         *
+         * The reduce expressions see each value being reduced as $value, and finalize sees
+         * { _id: <key>, value: <reduced value> }.  As with JavaScript, reducing values that
+         * were themselves reduced must give the same answer as reducing the originals.
+         */
+        class NativeMapper : public Mapper {
+        public:
+            NativeMapper( const BSONElement& spec );
+            virtual void init( State * state ) { _state = state; }
+            virtual void map( const BSONObj& o );
+
+            /**
+             * @return the {"0": key, "1": value} tuple o emits.  Doesn't touch the State, so
+             *         it may run on several threads at once.
+             */
+            BSONObj tuple( const BSONObj& o ) const;
+
+        private:
+            intrusive_ptr<Expression> _key;
+            intrusive_ptr<Expression> _value;
+            State * _state;
+        };
+
+        class NativeReducer : public Reducer {
+        public:
+            NativeReducer( const BSONElement& spec );
+            virtual void init( State * state ) {}
+
+            virtual BSONObj reduce( const BSONList& tuples );
+            virtual BSONObj finalReduce( const BSONList& tuples , Finalizer * finalizer );
+
+            /**
+             * Reduces tuples to a single {"0": key, "1": value} tuple without counting it in
+             * numReduces, so that mapper threads can combine values as they go.
+             */
+            BSONObj combine( const BSONList& tuples ) const;
+
+        private:
+            Value reduceValues( const BSONList& tuples ) const;
+
+            // one per field of an object value, or a single unnamed one for a scalar value
+            vector<string> _fields;
+            vector< intrusive_ptr<Accumulator> > _accumulators;
+        };
+
+        class NativeFinalizer : public Finalizer {
+        public:
+            NativeFinalizer( const BSONElement& spec );
+            virtual void init( State * state ) {}
+            virtual BSONObj finalize( const BSONObj& tuple );
+        private:
+            intrusive_ptr<Expression> _expr;
+        };
+
         // -----------------
 
 
@@ -165,6 +232,7 @@ namespace mongo {
             // options
             bool verbose;
             bool jsMode;
+            bool native; // map, reduce and finalize are aggregation expressions, see NativeMapper
             int splitInfo;
 
             // query options
@@ -239,6 +307,13 @@ namespace mongo {
              */
             void emit( const BSONObj& a );
 
+            /**
+             * stages a tuple that already combines several emits, as handed back by the threads
+             * of a parallel native map, which count the emits with countEmits
+             */
+            void emitCombined( const BSONObj& a );
+            void countEmits( long long n ) { _numEmits += n; }
+
             /**
              * if size is big, run a reduce
              * if its still big, dump to temp collection
@@ -332,6 +407,50 @@ namespace mongo {
             ScriptingFunction _reduceAndFinalizeAndInsert;
         };
 
+        /**
+         * Runs a native map on several threads.  The command's thread reads the documents and
+         * hands them out in batches.  Each mapper thread combines what it emits by key as it
+         * goes, and hands its table back to be staged in the State when the table gets big or
+         * the input ends.  The State then reduces and spills to the sorted inc collection
+         * exactly as it does for a single-threaded map, so the output is the same.
+         */
+        class ParallelMapper : boost::noncopyable {
+        public:
+            ParallelMapper( State& state , int nThreads );
+            ~ParallelMapper();
+
+            /** Queues o to be mapped. */
+            void map( const BSONObj& o );
+
+            /** Stages the tables the mapper threads have handed back so far, and checks sizes. */
+            void drain();
+
+            /** Maps everything still queued and stages all of it.  Throws what a thread failed with. */
+            void finish();
+
+        private:
+            typedef shared_ptr<BSONList> Batch;
+            struct Table;
+            typedef shared_ptr<Table> TablePtr;
+
+            void run();
+            void handBack( TablePtr& table );
+            void stop();
+
+            State& _state;
+            const NativeMapper& _mapper;
+            const NativeReducer& _reducer;
+            const long _maxTableSize;
+
+            BlockingQueue<Batch> _batches;
+            BlockingQueue<TablePtr> _tables;
+            Batch _batch;
+            vector< shared_ptr<boost::thread> > _threads;
+
+            mongo::mutex _errorMutex;
+            string _error;
+        };
+
         BSONObj fast_emit( const BSONObj& args, void* data );
         BSONObj _bailFromJS( const BSONObj& args, void* data );
 
@@ -0,0 +1,364 @@
+// mr_native.cpp
+
+/**
+ *    Copyright (C) 2013 Tokutek Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongo/pch.h"
+
+#include "mongo/db/commands/mr.h"
+
+#include "mongo/db/pipeline/document.h"
+#include "mongo/db/pipeline/expression_context.h"
+
+namespace mongo {
+
+    namespace mr {
+
+        NativeMapper::NativeMapper( const BSONElement& spec ) : _state( NULL ) {
+            uassert( 17036 , "a native map must be { key: <expression>, value: <expression> }" ,
+                     spec.type() == Object );
+            BSONForEach( e , spec.Obj() ) {
+                if ( str::equals( e.fieldName() , "key" ) ) {
+                    _key = Expression::parseOperand( &e );
+                }
+                else if ( str::equals( e.fieldName() , "value" ) ) {
+                    _value = Expression::parseOperand( &e );
+                }
+                else {
+                    uasserted( 17037 , str::stream() << "unknown field in native map: " << e.fieldName() );
+                }
+            }
+            uassert( 17038 , "a native map needs both a key and a value" , _key && _value );
+        }
+
+        BSONObj NativeMapper::tuple( const BSONObj& o ) const {
+            const Document doc( o );
+            Value key = _key->evaluate( doc );
+            Value value = _value->evaluate( doc );
+            // as in JavaScript, emitting undefined emits null
+            if ( key.missing() ) {
+                key = Value( BSONNULL );
+            }
+            if ( value.missing() ) {
+                value = Value( BSONNULL );
+            }
+
+            BSONObjBuilder b;
+            key.addToBsonObj( &b , "0" );
+            value.addToBsonObj( &b , "1" );
+            BSONObj res = b.obj();
+            uassert( 17070 , "an emit can't be more than half max bson size" , res.objsize() < ( BSONObjMaxUserSize / 2 ) );
+            return res;
+        }
+
+        void NativeMapper::map( const BSONObj& o ) {
+            verify( _state );
+            _state->emit( tuple( o ) );
+        }
+
+        namespace {
+
+            typedef intrusive_ptr<Accumulator> (*AccumulatorFactory)( const intrusive_ptr<ExpressionContext>& );
+
+            // Only accumulators that give the same answer on their own results can reduce.
+            intrusive_ptr<Accumulator> parseAccumulator( const BSONElement& e ) {
+                AccumulatorFactory factory;
+                if ( str::equals( e.fieldName() , "$sum" ) ) {
+                    factory = AccumulatorSum::create;
+                }
+                else if ( str::equals( e.fieldName() , "$min" ) ) {
+                    factory = AccumulatorMinMax::createMin;
+                }
+                else if ( str::equals( e.fieldName() , "$max" ) ) {
+                    factory = AccumulatorMinMax::createMax;
+                }
+                else {
+                    uasserted( 17039 , str::stream() << "a native reduce can only use $sum, $min and $max, not "
+                               << e.fieldName() );
+                }
+
+                intrusive_ptr<Accumulator> acc = factory( intrusive_ptr<ExpressionContext>() );
+                verify( acc->getStateSize() > 0 );
+                BSONElement operand = e;
+                acc->addOperand( Expression::parseOperand( &operand ) );
+                return acc;
+            }
+
+            // The accumulators' states for one reduce, laid out as DocumentSourceGroup does.
+            class ReduceStates : boost::noncopyable {
+            public:
+                explicit ReduceStates( const vector< intrusive_ptr<Accumulator> >& accumulators ) :
+                    _accumulators( accumulators ) {
+                    size_t size = 0;
+                    for ( size_t i = 0; i < _accumulators.size(); i++ ) {
+                        _offsets.push_back( size );
+                        size += ( _accumulators[i]->getStateSize() + 7 ) & ~size_t( 7 );
+                    }
+                    _buf.reset( new double[ size / sizeof( double ) + 1 ] );
+                    for ( size_t i = 0; i < _accumulators.size(); i++ ) {
+                        _accumulators[i]->initState( state( i ) );
+                    }
+                }
+
+                ~ReduceStates() {
+                    for ( size_t i = 0; i < _accumulators.size(); i++ ) {
+                        _accumulators[i]->destroyState( state( i ) );
+                    }
+                }
+
+                void* state( size_t i ) {
+                    return reinterpret_cast<char*>( _buf.get() ) + _offsets[i];
+                }
+
+            private:
+                const vector< intrusive_ptr<Accumulator> >& _accumulators;
+                vector<size_t> _offsets;
+                boost::scoped_array<double> _buf;
+            };
+
+        } // namespace
+
+        NativeReducer::NativeReducer( const BSONElement& spec ) {
+            uassert( 17040 , "a native reduce must be an object" , spec.type() == Object );
+            const BSONObj obj = spec.Obj();
+            uassert( 17041 , "a native reduce can't be empty" , ! obj.isEmpty() );
+
+            if ( obj.firstElement().fieldName()[0] == '$' ) {
+                uassert( 17042 , "a native reduce of scalar values takes a single accumulator" ,
+                         obj.nFields() == 1 );
+                _fields.push_back( "" );
+                _accumulators.push_back( parseAccumulator( obj.firstElement() ) );
+                return;
+            }
+
+            BSONForEach( e , obj ) {
+                uassert( 17043 , str::stream() << "native reduce field " << e.fieldName()
+                         << " must be { <accumulator>: <expression> }" ,
+                         e.type() == Object && e.Obj().nFields() == 1 );
+                _fields.push_back( e.fieldName() );
+                _accumulators.push_back( parseAccumulator( e.Obj().firstElement() ) );
+            }
+        }
+
+        Value NativeReducer::reduceValues( const BSONList& tuples ) const {
+            uassert( 17071 ,  "need values" , tuples.size() );
+
+            ReduceStates states( _accumulators );
+            for ( BSONList::const_iterator it = tuples.begin(); it != tuples.end(); ++it ) {
+                BSONObjIterator j( *it );
+                j.next();
+                BSONObjBuilder b;
+                b.appendAs( j.next() , "value" );
+                const Document doc( b.obj() );
+                for ( size_t i = 0; i < _accumulators.size(); i++ ) {
+                    _accumulators[i]->accumulate( states.state( i ) , doc );
+                }
+            }
+
+            if ( _fields[0].empty() ) {
+                return _accumulators[0]->getStateValue( states.state( 0 ) );
+            }
+            MutableDocument out( _fields.size() );
+            for ( size_t i = 0; i < _fields.size(); i++ ) {
+                out.addField( _fields[i] , _accumulators[i]->getStateValue( states.state( i ) ) );
+            }
+            return Value( out.freeze() );
+        }
+
+        BSONObj NativeReducer::combine( const BSONList& tuples ) const {
+            if ( tuples.size() == 1 )
+                return tuples[0];
+            const Value v = reduceValues( tuples );
+            BSONObjBuilder b;
+            b.appendAs( tuples[0].firstElement() , "0" );
+            v.addToBsonObj( &b , "1" );
+            return b.obj();
+        }
+
+        BSONObj NativeReducer::reduce( const BSONList& tuples ) {
+            if ( tuples.size() > 1 )
+                ++numReduces;
+            return combine( tuples );
+        }
+
+        BSONObj NativeReducer::finalReduce( const BSONList& tuples , Finalizer * finalizer ) {
+            const BSONObj reduced = reduce( tuples );
+            BSONObjIterator it( reduced );
+            BSONObjBuilder b( reduced.objsize() + 16 );
+            b.appendAs( it.next() , "_id" );
+            b.appendAs( it.next() , "value" );
+            BSONObj res = b.obj();
+
+            if ( finalizer ) {
+                res = finalizer->finalize( res );
+            }
+            return res;
+        }
+
+        NativeFinalizer::NativeFinalizer( const BSONElement& spec ) {
+            BSONElement e = spec;
+            _expr = Expression::parseOperand( &e );
+        }
+
+        BSONObj NativeFinalizer::finalize( const BSONObj& o ) {
+            Value v = _expr->evaluate( Document( o ) );
+            if ( v.missing() ) {
+                v = Value( BSONNULL );
+            }
+            BSONObjBuilder b;
+            b.append( o.firstElement() );
+            v.addToBsonObj( &b , "value" );
+            return b.obj();
+        }
+
+        // ------------  parallel map -----------
+
+        // from key to the tuple that combines all the values emitted for it
+        typedef std::map< BSONObj , BSONObj , TupleKeyCmp > Combined;
+
+        // What a mapper thread hands back: its emits, combined by key.
+        struct ParallelMapper::Table {
+            Table() : size( 0 ) , emits( 0 ) , reduces( 0 ) {}
+            Combined tuples;
+            long size;
+            long long emits;
+            long long reduces;
+        };
+
+        static size_t batchCount( const shared_ptr<BSONList>& batch ) {
+            return 1;
+        }
+
+        ParallelMapper::ParallelMapper( State& state , int nThreads ) :
+            _state( state ),
+            _mapper( static_cast<const NativeMapper&>( *state.config().mapper ) ),
+            _reducer( static_cast<const NativeReducer&>( *state.config().reducer ) ),
+            _maxTableSize( state.config().maxInMemSize ),
+            _batches( 2 * nThreads , &batchCount ),
+            _errorMutex( "mr::ParallelMapper" ) {
+            verify( nThreads > 0 );
+            for ( int i = 0; i < nThreads; i++ ) {
+                _threads.push_back( shared_ptr<boost::thread>(
+                        new boost::thread( boost::bind( &ParallelMapper::run , this ) ) ) );
+            }
+        }
+
+        ParallelMapper::~ParallelMapper() {
+            stop();
+        }
+
+        void ParallelMapper::map( const BSONObj& o ) {
+            if ( ! _batch ) {
+                _batch.reset( new BSONList() );
+                _batch->reserve( 256 );
+            }
+            _batch->push_back( o.getOwned() );
+            if ( _batch->size() == 256 ) {
+                _batches.push( _batch );
+                _batch.reset();
+                drain();
+            }
+        }
+
+        void ParallelMapper::run() {
+            TablePtr table( new Table() );
+            bool failed = false;
+            for ( Batch batch = _batches.blockingPop(); batch; batch = _batches.blockingPop() ) {
+                if ( failed ) {
+                    // keep taking batches so the command's thread doesn't wait on us
+                    continue;
+                }
+                try {
+                    for ( BSONList::const_iterator it = batch->begin(); it != batch->end(); ++it ) {
+                        const BSONObj t = _mapper.tuple( *it );
+                        table->emits++;
+                        pair< Combined::iterator , bool > ins =
+                                table->tuples.insert( make_pair( t , t ) );
+                        if ( ins.second ) {
+                            table->size += t.objsize() + 16;
+                        }
+                        else {
+                            BSONList both;
+                            both.push_back( ins.first->second );
+                            both.push_back( t );
+                            const BSONObj combined = _reducer.combine( both );
+                            table->size += combined.objsize() - ins.first->second.objsize();
+                            ins.first->second = combined;
+                            table->reduces++;
+                        }
+                        if ( table->size > _maxTableSize ) {
+                            handBack( table );
+                        }
+                    }
+                }
+                catch ( const std::exception& e ) {
+                    scoped_lock lk( _errorMutex );
+                    _error = e.what();
+                    failed = true;
+                }
+            }
+            if ( ! failed ) {
+                handBack( table );
+            }
+        }
+
+        void ParallelMapper::handBack( TablePtr& table ) {
+            _tables.push( table );
+            table.reset( new Table() );
+        }
+
+        void ParallelMapper::drain() {
+            {
+                scoped_lock lk( _errorMutex );
+                uassert( 17044 , "native map failed: " + _error , _error.empty() );
+            }
+            TablePtr table;
+            while ( _tables.tryPop( table ) ) {
+                for ( Combined::const_iterator it = table->tuples.begin();
+                      it != table->tuples.end(); ++it ) {
+                    _state.emitCombined( it->second );
+                }
+                _state.countEmits( table->emits );
+                _state.config().reducer->numReduces += table->reduces;
+                _state.checkSize();
+            }
+        }
+
+        void ParallelMapper::stop() {
+            if ( _threads.empty() ) {
+                return;
+            }
+            for ( size_t i = 0; i < _threads.size(); i++ ) {
+                _batches.push( Batch() );
+            }
+            for ( size_t i = 0; i < _threads.size(); i++ ) {
+                _threads[i]->join();
+            }
+            _threads.clear();
+        }
+
+        void ParallelMapper::finish() {
+            if ( _batch ) {
+                _batches.push( _batch );
+                _batch.reset();
+            }
+            stop();
+            drain();
+        }
+
+    } // namespace mr
+
+} // namespace mongo
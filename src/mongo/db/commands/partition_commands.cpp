@@ -0,0 +1,182 @@
+/** @file partition_commands.cpp
+    adding, dropping and describing the partitions of a partitioned collection
+*/
+
+/**
+ *    Copyright (C) 2013 Tokutek Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pch.h"
+
+#include <string>
+#include <vector>
+
+#include "mongo/db/auth/action_set.h"
+#include "mongo/db/auth/action_type.h"
+#include "mongo/db/auth/authorization_manager.h"
+#include "mongo/db/auth/privilege.h"
+#include "mongo/db/client.h"
+#include "mongo/db/commands.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/namespace_details.h"
+#include "mongo/db/oplog_helpers.h"
+
+namespace mongo {
+
+    static NamespaceDetails *partitionedCollection(const string &dbname, const BSONObj &cmdObj,
+                                                   string &errmsg) {
+        const string coll = cmdObj.firstElement().valuestrsafe();
+        if (coll.empty()) {
+            errmsg = "no collection name specified";
+            return NULL;
+        }
+        NamespaceDetails *d = nsdetails(dbname + '.' + coll);
+        if (d == NULL) {
+            errmsg = "ns not found";
+            return NULL;
+        }
+        if (!d->isPartitioned()) {
+            errmsg = "collection is not partitioned";
+            return NULL;
+        }
+        return d;
+    }
+
+    class CmdAddPartition : public FileopsCommand {
+    public:
+        CmdAddPartition() : FileopsCommand("addPartition") { }
+        // Logged by run(), with the max it resolved, so a secondary closes off its last
+        // partition at the same key even if its documents differ.
+        virtual bool logTheOp() { return false; }
+        virtual bool slaveOk() const { return false; }
+        virtual bool adminOnly() const { return false; }
+        virtual void help( stringstream& help ) const {
+            help << "close off the last partition of a partitioned collection and start a new one\n"
+                "{ addPartition: <collection>[, newMax: <primary key>] }\n"
+                " without newMax, the last partition ends at the largest primary key in it";
+        }
+        virtual void addRequiredPrivileges(const std::string& dbname,
+                                           const BSONObj& cmdObj,
+                                           std::vector<Privilege>* out) {
+            ActionSet actions;
+            actions.addAction(ActionType::createCollection);
+            out->push_back(Privilege(parseNs(dbname, cmdObj), actions));
+        }
+        virtual bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+            NamespaceDetails *d = partitionedCollection(dbname, cmdObj, errmsg);
+            if (d == NULL) {
+                return false;
+            }
+            BSONObj newMax;
+            if (cmdObj.hasField("newMax")) {
+                newMax = cmdObj["newMax"].wrap("");
+            }
+            const BSONObj max = d->addPartition(newMax);
+            result.appendAs(max.firstElement(), "max");
+            if (!fromRepl) {
+                const string cmdns = dbname + ".$cmd";
+                BSONObjBuilder b;
+                b.append("addPartition", cmdObj.firstElement().valuestr());
+                b.appendAs(max.firstElement(), "newMax");
+                OpLogHelpers::logCommand(cmdns.c_str(), b.done(), &cc().txn());
+            }
+            return true;
+        }
+    } cmdAddPartition;
+
+    class CmdDropPartition : public FileopsCommand {
+    public:
+        CmdDropPartition() : FileopsCommand("dropPartition") { }
+        // Logged by run(), with the dropped range, so a secondary can check that its partition
+        // with that id holds the same keys before it drops it.
+        virtual bool logTheOp() { return false; }
+        virtual bool slaveOk() const { return false; }
+        virtual bool adminOnly() const { return false; }
+        virtual void help( stringstream& help ) const {
+            help << "drop a partition, and every document in it, from a partitioned collection\n"
+                "{ dropPartition: <collection>, id: <partition id> }\n"
+                " see getPartitionInfo for the ids";
+        }
+        virtual void addRequiredPrivileges(const std::string& dbname,
+                                           const BSONObj& cmdObj,
+                                           std::vector<Privilege>* out) {
+            ActionSet actions;
+            actions.addAction(ActionType::dropCollection);
+            out->push_back(Privilege(parseNs(dbname, cmdObj), actions));
+        }
+        virtual bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+            NamespaceDetails *d = partitionedCollection(dbname, cmdObj, errmsg);
+            if (d == NULL) {
+                return false;
+            }
+            if (!cmdObj["id"].isNumber()) {
+                errmsg = "need a numeric partition id";
+                return false;
+            }
+            const long long id = cmdObj["id"].numberLong();
+            BSONObj min, max;
+            d->getPartitionRange(id, min, max);
+            if (fromRepl) {
+                // Ids only line up with the primary's if this member's partitions came from
+                // it, through replication or the cloner. Dropping anything else would lose a
+                // different set of documents than the primary did.
+                uassert( 17067, str::stream() << "partition " << id << " of " << d->ns()
+                                << " holds (" << min.firstElement() << ", " << max.firstElement()
+                                << "], not the (" << cmdObj["min"] << ", " << cmdObj["max"]
+                                << "] dropped on the primary",
+                                cmdObj["min"].ok() && cmdObj["max"].ok() &&
+                                min.woCompare(cmdObj["min"].wrap("")) == 0 &&
+                                max.woCompare(cmdObj["max"].wrap("")) == 0 );
+            }
+            d->dropPartition(id);
+            if (!fromRepl) {
+                const string cmdns = dbname + ".$cmd";
+                BSONObjBuilder b;
+                b.append("dropPartition", cmdObj.firstElement().valuestr());
+                b.append("id", id);
+                b.appendAs(min.firstElement(), "min");
+                b.appendAs(max.firstElement(), "max");
+                OpLogHelpers::logCommand(cmdns.c_str(), b.done(), &cc().txn());
+            }
+            return true;
+        }
+    } cmdDropPartition;
+
+    class CmdGetPartitionInfo : public QueryCommand {
+    public:
+        CmdGetPartitionInfo() : QueryCommand("getPartitionInfo") { }
+        virtual bool adminOnly() const { return false; }
+        virtual void help( stringstream& help ) const {
+            help << "list the partitions of a partitioned collection\n"
+                "{ getPartitionInfo: <collection> }";
+        }
+        virtual void addRequiredPrivileges(const std::string& dbname,
+                                           const BSONObj& cmdObj,
+                                           std::vector<Privilege>* out) {
+            ActionSet actions;
+            actions.addAction(ActionType::find);
+            out->push_back(Privilege(parseNs(dbname, cmdObj), actions));
+        }
+        virtual bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool) {
+            NamespaceDetails *d = partitionedCollection(dbname, cmdObj, errmsg);
+            if (d == NULL) {
+                return false;
+            }
+            d->appendPartitionInfo(result);
+            return true;
+        }
+    } cmdGetPartitionInfo;
+
+} // namespace mongo
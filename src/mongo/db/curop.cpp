@@ -18,9 +18,13 @@
 #include "pch.h"
 #include "curop.h"
 #include "database.h"
+#include "mongo/db/server_parameters.h"
 
 namespace mongo {
 
+    // with profiling at level 1, also profile one in this many ops that aren't slow, 0 for none
+    MONGO_EXPORT_SERVER_PARAMETER(profileSampleRate, int, 0);
+
     // todo : move more here
 
     CurOp::CurOp( Client * client , CurOp * wrapped ) : 
@@ -48,6 +52,19 @@ namespace mongo {
         _lockStat.reset();
     }
 
+    bool CurOp::shouldDBProfile( int ms ) const {
+        if ( _dbprofile <= 0 )
+            return false;
+
+        if ( _dbprofile >= 2 || ms >= cmdLine.slowMS )
+            return true;
+
+        // op numbers are handed out in order, so this takes every Nth op without another
+        // shared counter
+        const int rate = profileSampleRate;
+        return rate > 0 && _opNum.get() % rate == 0;
+    }
+
     void CurOp::reset() {
         _reset();
         _start = 0;
@@ -84,6 +84,7 @@ namespace mongo {
         bool fastmodinsert;  // upsert of an $operation. builds a default object
         bool upsert;         // true if the update actually did an insert
         int keyUpdates;
+        long long commitMicros; // committing transactions, mostly writing the recovery log
 
         // error handling
         ExceptionInfo exceptionInfo;
@@ -183,12 +184,11 @@ namespace mongo {
         int profileLevel() const   { return _dbprofile; }
         const char * getNS() const { return _ns.c_str(); }
 
-        bool shouldDBProfile( int ms ) const {
-            if ( _dbprofile <= 0 )
-                return false;
-
-            return _dbprofile >= 2 || ms >= cmdLine.slowMS;
-        }
+        /**
+         * at level 1, ops over slowms and, with profileSampleRate set, a sample of the rest;
+         * at level 2, all ops
+         */
+        bool shouldDBProfile( int ms ) const;
 
         AtomicUInt opNum() const { return _opNum; }
 
@@ -17,6 +17,8 @@
 
 #include "mongo/pch.h"
 
+#include <boost/bind.hpp>
+
 #include "mongo/db/curop.h"
 #include "mongo/db/cursor.h"
 #include "mongo/db/namespace_details.h"
@@ -41,8 +43,15 @@ namespace mongo {
                      true, direction, numWanted ) {
     }
 
+    static shared_ptr<Cursor> makeBasicCursor( NamespaceDetails *d, int direction ) {
+        return BasicCursor::make( d, direction );
+    }
+
     shared_ptr<Cursor> BasicCursor::make( NamespaceDetails *d, int direction ) {
-        if ( d != NULL ) {
+        if ( d != NULL && d->isPartitioned() ) {
+            return shared_ptr<Cursor>( new PartitionedCursor( d, direction,
+                    boost::bind( &makeBasicCursor, _1, direction ) ) );
+        } else if ( d != NULL ) {
             return shared_ptr<Cursor>(new BasicCursor(d, direction));
         } else {
             return shared_ptr<Cursor>(new DummyCursor(direction));
@@ -53,4 +62,121 @@ namespace mongo {
         IndexScanCursor( d, d->getPKIndex(), direction ) {
     }
 
+    PartitionedCursor::PartitionedCursor( NamespaceDetails *d, int direction,
+                                          const Factory &make ) :
+        _d( d ),
+        _direction( direction ),
+        _make( make ),
+        _next( 0 ),
+        _nscannedBefore( 0 ) {
+        nextPartition();
+    }
+
+    void PartitionedCursor::nextPartition() {
+        const int n = _d->nPartitions();
+        do {
+            if ( _current ) {
+                _nscannedBefore += _current->nscanned();
+            }
+            NamespaceDetails &p = _d->partition( _direction > 0 ? _next : n - 1 - _next );
+            _next++;
+            _current = _make( &p );
+            if ( _matcher ) {
+                _current->setMatcher( _matcher );
+            }
+            if ( _keyFieldsOnly ) {
+                _current->setKeyFieldsOnly( _keyFieldsOnly );
+            }
+        } while ( !_current->ok() && _next < n );
+    }
+
+    bool PartitionedCursor::advance() {
+        _current->advance();
+        if ( !_current->ok() && _next < _d->nPartitions() ) {
+            nextPartition();
+        }
+        return ok();
+    }
+
+    void PartitionedCursor::explainDetails( BSONObjBuilder& b ) const {
+        _current->explainDetails( b );
+        b.append( "partitionsScanned", _next );
+    }
+
+    IntersectionCursor::IntersectionCursor( const shared_ptr<Cursor> &driver,
+                                            const vector<shared_ptr<Cursor> > &filters ) :
+        _driver( driver ),
+        _filterNscanned( 0 ),
+        _intersected( true ) {
+        for ( vector<shared_ptr<Cursor> >::const_iterator it = filters.begin();
+              it != filters.end(); ++it ) {
+            const bool first = it == filters.begin();
+            _filterNames += ( first ? "" : ", " ) + (*it)->toString();
+            // Once the intersection is empty, or abandoned, the rest of the filters can't
+            // change the result.
+            if ( !_intersected || ( !first && _pks.empty() ) ) {
+                continue;
+            }
+            if ( !addFilter( **it, first ) ) {
+                _intersected = false;
+                vector<BSONObj>().swap( _pks );
+            }
+        }
+        skipNonIntersecting();
+    }
+
+    bool IntersectionCursor::addFilter( Cursor &filter, bool first ) {
+        vector<BSONObj> pks;
+        for ( ; filter.ok(); filter.advance() ) {
+            if ( pks.size() >= MaxIntersectionSize ) {
+                _filterNscanned += filter.nscanned();
+                return false;
+            }
+            pks.push_back( filter.currPK().getOwned() );
+        }
+        _filterNscanned += filter.nscanned();
+
+        // A multikey filter may produce the same primary key more than once.
+        std::sort( pks.begin(), pks.end() );
+        pks.erase( std::unique( pks.begin(), pks.end() ), pks.end() );
+
+        if ( first ) {
+            _pks.swap( pks );
+        }
+        else {
+            vector<BSONObj> both;
+            std::set_intersection( _pks.begin(), _pks.end(), pks.begin(), pks.end(),
+                                   std::back_inserter( both ) );
+            _pks.swap( both );
+        }
+        return true;
+    }
+
+    void IntersectionCursor::skipNonIntersecting() {
+        if ( !_intersected ) {
+            return;
+        }
+        while ( _driver->ok() &&
+                !std::binary_search( _pks.begin(), _pks.end(), _driver->currPK() ) ) {
+            _driver->advance();
+        }
+    }
+
+    bool IntersectionCursor::advance() {
+        _driver->advance();
+        skipNonIntersecting();
+        return ok();
+    }
+
+    string IntersectionCursor::toString() const {
+        return "IntersectionCursor " + _driver->toString() + " [" + _filterNames + "]";
+    }
+
+    void IntersectionCursor::explainDetails( BSONObjBuilder& b ) const {
+        _driver->explainDetails( b );
+        b.append( "intersected", _intersected );
+        b.appendNumber( "intersectionSize", static_cast<long long>( _pks.size() ) );
+        b.appendNumber( "nscannedIntersect", _filterNscanned );
+    }
+
 } // namespace mongo
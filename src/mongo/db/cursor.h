@@ -19,6 +19,8 @@
 
 #include "mongo/pch.h"
 
+#include <boost/function.hpp>
+
 #include "mongo/db/jsobj.h"
 #include "mongo/db/matcher.h"
 #include "mongo/db/projection.h"
@@ -171,6 +173,8 @@ namespace mongo {
         public:
             static const unsigned char hasPK = 1;
             static const unsigned char hasObj = 2;
+            // the obj is in _ownedObjs, the buffer holds its index
+            static const unsigned char ownedObj = 4;
         };
 
         // store rows in a buffer that has a "preferred size". if we need to 
@@ -185,6 +189,12 @@ namespace mongo {
         size_t _current_offset;
         size_t _end_offset;
         char *_buf;
+
+        // objs at least this big get a buffer of their own instead of being copied into
+        // _buf, so that current() returns them owned and a reply can send them from there.
+        static const size_t _OBJ_SIZE_OWNED = 16 * 1024;
+        vector<BSONObj> _ownedObjs;
+        size_t _ownedBytes;
     };
 
     /**
@@ -194,16 +204,17 @@ namespace mongo {
     public:
 
         // Create a cursor over a specific start, end key range.
-        static shared_ptr<IndexCursor> make( NamespaceDetails *d, const IndexDetails &idx,
-                                             const BSONObj &startKey, const BSONObj &endKey,
-                                             bool endKeyInclusive, int direction,
-                                             int numWanted = 0);
+        // Over a partitioned collection, this is a PartitionedCursor.
+        static shared_ptr<Cursor> make( NamespaceDetails *d, const IndexDetails &idx,
+                                        const BSONObj &startKey, const BSONObj &endKey,
+                                        bool endKeyInclusive, int direction,
+                                        int numWanted = 0);
 
         // Create a cursor over a set of one or more field ranges.
-        static shared_ptr<IndexCursor> make( NamespaceDetails *d, const IndexDetails &idx,
-                                             const shared_ptr< FieldRangeVector > &bounds,
-                                             int singleIntervalLimit, int direction,
-                                             int numWanted = 0);
+        static shared_ptr<Cursor> make( NamespaceDetails *d, const IndexDetails &idx,
+                                        const shared_ptr< FieldRangeVector > &bounds,
+                                        int singleIntervalLimit, int direction,
+                                        int numWanted = 0);
 
         virtual ~IndexCursor();
 
@@ -299,9 +310,10 @@ namespace mongo {
             RowBuffer *buffer;
             int rows_fetched;
             int rows_to_fetch;
+            long long bytes_fetched;
             std::exception *ex;
             cursor_getf_extra(RowBuffer *buf, int n_to_fetch) :
-                buffer(buf), rows_fetched(0), rows_to_fetch(n_to_fetch), ex(NULL) {
+                buffer(buf), rows_fetched(0), rows_to_fetch(n_to_fetch), bytes_fetched(0), ex(NULL) {
             }
         };
         static int cursor_getf(const DBT *key, const DBT *val, void *extra);
@@ -327,6 +339,31 @@ namespace mongo {
         bool skipOutOfRangeKeysAndCheckEnd();
         void checkEnd();
 
+        /**
+         * Bounds made only of point intervals on a unique index, like an $in on _id, match at
+         * most one row per point.  Rather than seeking to each point and then stepping past it
+         * to find the next one, the cursor steps through the points and fetches them into the
+         * row buffer in order, in batches, with one exact get each.  Walking the points in key
+         * order keeps consecutive gets in the same, already cached, leaf nodes.
+         */
+        bool usePointGets() const;
+        void initializePoints();
+        /** @return false if there are no more points, else the next one in point */
+        bool nextPoint( BSONObj &point );
+        /** get the rows for the next batch of points into the RowBuffer */
+        bool fetchPoints();
+        struct point_getf_extra : public ExceptionSaver {
+            RowBuffer *buffer;
+            const storage::Key *prefix; // for secondary keys, which have the pk appended
+            const Ordering *ordering;
+            bool found;
+            long long bytes_fetched;
+            point_getf_extra(RowBuffer *buf, const storage::Key *p, const Ordering *o) :
+                buffer(buf), prefix(p), ordering(o), found(false), bytes_fetched(0) {
+            }
+        };
+        static int point_getf(const DBT *key, const DBT *val, void *extra);
+
         NamespaceDetails *const _d;
         const IndexDetails &_idx;
         const Ordering _ordering;
@@ -348,6 +385,8 @@ namespace mongo {
         shared_ptr<Projection::KeyOnly> _keyFieldsOnly;
         long long _nscanned;
         long long _nscannedObjects;
+        // key and value bytes handed to us by the dictionary, noted on the index when we're done
+        long long _bytesRead;
 
         // Prelock is true if the caller does not want a limited result set from the cursor.
         // Even if the query looks like { a: { $gte: 5 } }, the caller may want limited results for:
@@ -377,6 +416,13 @@ namespace mongo {
         // of bulk fetch so we know an appropriate amount of rows to fetch.
         RowBuffer _buffer;
         int _getf_iteration;
+
+        // When using point gets, the position in each field's intervals of the next point to
+        // get.  The points are the cross product of the fields' intervals, which can be very
+        // large, so they are made one at a time.
+        bool _pointGets;
+        vector<size_t> _pointPositions;
+        bool _pointsDone;
     };
 
     /**
@@ -414,6 +460,120 @@ namespace mongo {
         BasicCursor( NamespaceDetails *d, int direction );
     };
 
+    /**
+     * A cursor over the primary key of a partitioned collection: goes over the same range of
+     * each partition in turn, in primary key order (reversed for a reverse cursor), which is
+     * the order of the whole primary key, since partitions hold consecutive ranges of it.
+     * Each partition's cursor is only made when the one before it is exhausted.
+     */
+    class PartitionedCursor : public Cursor {
+    public:
+        // makes the cursor over one partition
+        typedef boost::function<shared_ptr<Cursor> (NamespaceDetails *)> Factory;
+
+        PartitionedCursor( NamespaceDetails *d, int direction, const Factory &make );
+
+        bool ok() { return _current->ok(); }
+        BSONObj current() { return _current->current(); }
+        bool advance();
+        BSONObj currKey() const { return _current->currKey(); }
+        BSONObj currPK() const { return _current->currPK(); }
+        BSONObj indexKeyPattern() const { return _current->indexKeyPattern(); }
+        bool supportGetMore() { return true; }
+        string toString() const { return _current->toString(); }
+        bool getsetdup(const BSONObj &pk) { return false; }
+        bool isMultiKey() const { return false; }
+        bool modifiedKeys() const { return false; }
+        BSONObj prettyIndexBounds() const { return _current->prettyIndexBounds(); }
+        long long nscanned() const { return _nscannedBefore + _current->nscanned(); }
+
+        CoveredIndexMatcher *matcher() const { return _matcher.get(); }
+        bool currentMatches( MatchDetails *details = NULL ) {
+            return _current->currentMatches( details );
+        }
+        void setMatcher( shared_ptr< CoveredIndexMatcher > matcher ) {
+            _matcher = matcher;
+            _current->setMatcher( matcher );
+        }
+        const Projection::KeyOnly *keyFieldsOnly() const { return _keyFieldsOnly.get(); }
+        void setKeyFieldsOnly( const shared_ptr<Projection::KeyOnly> &keyFieldsOnly ) {
+            _keyFieldsOnly = keyFieldsOnly;
+            _current->setKeyFieldsOnly( keyFieldsOnly );
+        }
+        void explainDetails( BSONObjBuilder& b ) const;
+
+    private:
+        // make the next partition's cursor, skipping partitions with nothing in range
+        void nextPartition();
+
+        NamespaceDetails *const _d;
+        const int _direction;
+        const Factory _make;
+        int _next; // partitions done, in cursor order
+        shared_ptr<Cursor> _current;
+        long long _nscannedBefore;
+        shared_ptr< CoveredIndexMatcher > _matcher;
+        shared_ptr<Projection::KeyOnly> _keyFieldsOnly;
+    };
+
+    /**
+     * Index intersection: iterates a driving index cursor, but only stops on entries whose
+     * primary key is also found by every one of a set of filter cursors.
+     *
+     * The filter cursors are exhausted when the IntersectionCursor is constructed and their
+     * primary keys intersected into one sorted vector, so only the documents in the
+     * intersection are ever fetched through the driving cursor.  Keys, bounds, ordering and
+     * matching are all the driving cursor's.  If a filter produces more than
+     * MaxIntersectionSize primary keys, the intersection is abandoned and the driving cursor
+     * is iterated unrestricted, which costs nothing in correctness since the matcher still
+     * checks every predicate.
+     */
+    class IntersectionCursor : public Cursor {
+    public:
+        static const size_t MaxIntersectionSize = 20000;
+
+        IntersectionCursor( const shared_ptr<Cursor> &driver,
+                            const vector<shared_ptr<Cursor> > &filters );
+
+        bool ok() { return _driver->ok(); }
+        BSONObj current() { return _driver->current(); }
+        bool advance();
+        BSONObj currKey() const { return _driver->currKey(); }
+        BSONObj currPK() const { return _driver->currPK(); }
+        BSONObj indexKeyPattern() const { return _driver->indexKeyPattern(); }
+        bool supportGetMore() { return true; }
+        string toString() const;
+        bool getsetdup(const BSONObj &pk) { return _driver->getsetdup(pk); }
+        bool isMultiKey() const { return _driver->isMultiKey(); }
+        bool modifiedKeys() const { return _driver->modifiedKeys(); }
+        BSONObj prettyIndexBounds() const { return _driver->prettyIndexBounds(); }
+        long long nscanned() const { return _driver->nscanned() + _filterNscanned; }
+
+        CoveredIndexMatcher *matcher() const { return _driver->matcher(); }
+        bool currentMatches( MatchDetails *details = NULL ) {
+            return _driver->currentMatches( details );
+        }
+        void setMatcher( shared_ptr< CoveredIndexMatcher > matcher ) {
+            _driver->setMatcher( matcher );
+        }
+        const Projection::KeyOnly *keyFieldsOnly() const { return _driver->keyFieldsOnly(); }
+        void setKeyFieldsOnly( const shared_ptr<Projection::KeyOnly> &keyFieldsOnly ) {
+            _driver->setKeyFieldsOnly( keyFieldsOnly );
+        }
+        void explainDetails( BSONObjBuilder& b ) const;
+
+    private:
+        /** @return false if the filter had too many primary keys to intersect. */
+        bool addFilter( Cursor &filter, bool first );
+        void skipNonIntersecting();
+
+        shared_ptr<Cursor> _driver;
+        string _filterNames;
+        long long _filterNscanned;
+        bool _intersected; // false if the intersection was abandoned
+        vector<BSONObj> _pks; // sorted and unique
+    };
+
     /**
      * Dummy cursor returning no results.
      * Can be used to represent a cursor over a non-existent collection.
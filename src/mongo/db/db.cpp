@@ -379,6 +379,8 @@ namespace mongo {
         else {
             startTTLBackgroundJob();
         }
+        startCappedStatsBackgroundJob();
+        startProfileWriter();
 
 #ifndef _WIN32
         CmdLine::launchOk();
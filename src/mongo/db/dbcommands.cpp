@@ -48,12 +48,16 @@
 #include "mongo/db/namespace_details.h"
 #include "mongo/db/namespacestring.h"
 #include "mongo/db/query_optimizer.h"
+#include "mongo/db/querypattern.h"
+#include "mongo/db/queryutil.h"
 #include "mongo/db/ops/count.h"
 #include "mongo/db/ops/insert.h"
 #include "mongo/db/repl/bgsync.h"
 #include "mongo/db/stats/counters.h"
+#include "mongo/db/stats/top.h"
 #include "mongo/db/storage/env.h"
 #include "mongo/db/oplog_helpers.h"
+#include "mongo/db/ttl.h"
 #include "mongo/s/d_writeback.h"
 #include "mongo/scripting/engine.h"
 #include "mongo/util/version.h"
@@ -552,6 +556,30 @@ namespace mongo {
                 bb.done();
             }
 
+            {
+                BSONObjBuilder bb( result.subobjStart( "opArena" ) );
+                OpArena::appendStats( bb );
+                bb.done();
+            }
+
+            {
+                BSONObjBuilder bb( result.subobjStart( "ttl" ) );
+                appendTTLStats( bb );
+                bb.done();
+            }
+
+            {
+                BSONObjBuilder bb( result.subobjStart( "profileWriter" ) );
+                appendProfileWriterStats( bb );
+                bb.done();
+            }
+
+            {
+                BSONObjBuilder bb( result.subobjStart( "opLatencies" ) );
+                Top::global.appendGlobalLatencies( bb );
+                bb.done();
+            }
+
             {
                 BSONObjBuilder bb( result.subobjStart( "network" ) );
                 networkCounter.append( bb );
@@ -640,6 +668,25 @@ namespace mongo {
         }
     } cmdEngineStatus;
 
+    class CmdEngineStats : public WebInformationCommand {
+    public:
+        CmdEngineStats() : WebInformationCommand("engineStats") {}
+
+        virtual void help( stringstream& help ) const {
+            help << "returns TokuMX engine counters by subsystem, as numbers, for polling\n"
+                "(cachetable, evictions, nodeReads, nodeWrites, messageBufferFlushes, checkpoint)\n"
+                "per index counters are in collStats";
+        }
+
+        virtual void addRequiredPrivileges(const std::string& dbname,
+                                           const BSONObj& cmdObj,
+                                           std::vector<Privilege>* out) {} // No auth required, like engineStatus
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+            storage::get_engine_stats(result);
+            return true;
+        }
+    } cmdEngineStats;
+
     class CmdShowPendingLockRequests : public WebInformationCommand {
     public:
         CmdShowPendingLockRequests() : WebInformationCommand("showPendingLockRequests") {}
@@ -1414,6 +1461,114 @@ namespace mongo {
         }
     } cmdCollectionStats;
 
+    class CmdPlanCache : public Command {
+    public:
+        CmdPlanCache() : Command( "planCache" ) {}
+        virtual bool logTheOp() { return false; } // the plan cache is local to each member
+        virtual bool slaveOk() const { return true; }
+        // Listing only needs a read lock, changing the cache takes the write lock, see run().
+        virtual LockType locktype() const { return NONE; }
+        virtual bool requiresSync() const { return false; }
+        virtual bool needsTxn() const { return false; }
+        virtual int txnFlags() const { return 0; }
+        virtual bool canRunInMultiStmtTxn() const { return false; }
+        virtual OpSettings getOpSettings() const { return OpSettings(); }
+        virtual void help( stringstream &help ) const {
+            help << "inspect or change the query plan cache of a collection\n"
+                    "{ planCache : \"coll\" } lists the cached plans\n"
+                    "  clear : true - drop all cached plans\n"
+                    "  set : { query : {...}, sort : {...}, index : {...} } - pin a plan for the query's pattern\n"
+                    "        (index may also be { $intersect : [ {...}, {...} ] } for an index intersection)\n"
+                    "  persist : true - save the cached plans so they are reloaded after a restart";
+        }
+        virtual void addRequiredPrivileges(const std::string& dbname,
+                                           const BSONObj& cmdObj,
+                                           std::vector<Privilege>* out) {
+            ActionSet actions;
+            actions.addAction(ActionType::planCache);
+            out->push_back(Privilege(parseNs(dbname, cmdObj), actions));
+        }
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+            const string ns = dbname + "." + cmdObj.firstElement().valuestr();
+            if ( !cmdObj["clear"].trueValue() && cmdObj["set"].eoo() &&
+                 !cmdObj["persist"].trueValue() ) {
+                Client::ReadContext ctx( ns );
+                Client::Transaction transaction( DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY );
+                NamespaceDetails *d = nsdetails( ns );
+                if ( d == NULL ) {
+                    errmsg = "ns not found";
+                    return false;
+                }
+                result.append( "ns", ns );
+                result.append( "plans", d->queryCacheEntries() );
+                transaction.commit();
+                return true;
+            }
+
+            Client::WriteContext ctx( ns );
+            Client::Transaction transaction( DB_SERIALIZABLE );
+            const bool ok = _change( ns, cmdObj, errmsg, result );
+            if ( ok ) {
+                transaction.commit();
+            }
+            return ok;
+        }
+
+    private:
+        bool _change(const string &ns, const BSONObj &cmdObj, string &errmsg, BSONObjBuilder &result) {
+            NamespaceDetails *d = nsdetails( ns );
+            if ( d == NULL ) {
+                errmsg = "ns not found";
+                return false;
+            }
+
+            if ( cmdObj["clear"].trueValue() ) {
+                d->clearQueryCache();
+            }
+
+            BSONElement set = cmdObj["set"];
+            if ( !set.eoo() ) {
+                if ( set.type() != Object ) {
+                    errmsg = "set must be an object";
+                    return false;
+                }
+                const BSONObj spec = set.Obj();
+                const BSONObj query = spec["query"].type() == Object ? spec["query"].Obj() : BSONObj();
+                const BSONObj sort = spec["sort"].type() == Object ? spec["sort"].Obj() : BSONObj();
+                if ( spec["index"].type() != Object || spec["index"].Obj().isEmpty() ) {
+                    errmsg = "set requires an index key pattern";
+                    return false;
+                }
+                const BSONObj indexKey = spec["index"].Obj().getOwned();
+                if ( !d->cachedPlanIndexesExist( indexKey ) ) {
+                    errmsg = "index not found";
+                    return false;
+                }
+
+                // A pinned plan records an nscanned so large that the optimizer never
+                // abandons it for a plan race, and allows for an out of order plan when
+                // there is a sort, so a sort the index can't provide is done in memory.
+                const CachedQueryPlan plan( indexKey,
+                                            std::numeric_limits<long long>::max() / 10,
+                                            CandidatePlanCharacter( true, !sort.isEmpty() ),
+                                            0, true );
+                const FieldRangeSet singleKey( ns.c_str(), query, true, true );
+                const FieldRangeSet multiKey( ns.c_str(), query, false, true );
+                NamespaceDetails::QueryCacheRWLock::Exclusive lk( d );
+                d->registerCachedQueryPlanForPattern( singleKey.pattern( sort ), plan );
+                d->registerCachedQueryPlanForPattern( multiKey.pattern( sort ), plan );
+            }
+
+            if ( cmdObj["persist"].trueValue() ) {
+                d->persistQueryCache();
+            }
+
+            result.append( "ns", ns );
+            result.append( "plans", d->queryCacheEntries() );
+            return true;
+        }
+    } cmdPlanCache;
+
     class DBStats : public QueryCommand {
     public:
         DBStats() : QueryCommand( "dbStats", false, "dbstats" ) {}
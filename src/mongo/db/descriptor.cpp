@@ -19,6 +19,7 @@
 #include "mongo/pch.h"
 #include "mongo/db/descriptor.h"
 #include "mongo/db/keygenerator.h"
+#include "mongo/db/storage/dbt.h"
 
 namespace mongo {
 
@@ -122,4 +123,82 @@ namespace mongo {
         }
     }
 
+    namespace {
+
+        // Each thread keeps the SimpleKeyGenerators for the descriptors it has generated keys
+        // for recently.  Generators depend only on the descriptor, so dictionaries with equal
+        // descriptors share one, and a stale entry is never wrong, just unused.
+        class SimpleKeyGeneratorCache : boost::noncopyable {
+        public:
+            const SimpleKeyGenerator &get(const Descriptor &descriptor) {
+                const DBT dbt = descriptor.dbt();
+                for (vector<Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it) {
+                    if (it->descriptor.size() == dbt.size &&
+                        memcmp(it->descriptor.data(), dbt.data, dbt.size) == 0) {
+                        return *it->generator;
+                    }
+                }
+                if (_entries.size() >= MaxEntries) {
+                    _entries.erase(_entries.begin());
+                }
+                vector<const char *> fields;
+                descriptor.fieldNames(fields);
+                Entry e;
+                e.descriptor.assign(static_cast<const char *>(dbt.data), dbt.size);
+                e.generator.reset(new SimpleKeyGenerator(fields, descriptor.sparse()));
+                _entries.push_back(e);
+                return *_entries.back().generator;
+            }
+
+        private:
+            static const size_t MaxEntries = 64;
+            struct Entry {
+                string descriptor;
+                shared_ptr<SimpleKeyGenerator> generator;
+            };
+            vector<Entry> _entries;
+        };
+
+        boost::thread_specific_ptr<SimpleKeyGeneratorCache> simpleKeyGenerators;
+
+    } // namespace
+
+    size_t Descriptor::generateKeys(const BSONObj &obj, const BSONObj &pk, DBT_ARRAY *keys) const {
+        const Header &h(*reinterpret_cast<const Header *>(_data));
+        if (!h.hashed) {
+            if (simpleKeyGenerators.get() == NULL) {
+                simpleKeyGenerators.reset(new SimpleKeyGeneratorCache());
+            }
+            const SimpleKeyGenerator &generator = simpleKeyGenerators->get(*this);
+
+            // Ordering allows at most 31 fields in a key.
+            BSONElement elts[32];
+            dassert(generator.numFields() <= 32);
+            switch (generator.getKey(obj, elts)) {
+            case SimpleKeyGenerator::NO_KEY:
+                storage::dbt_array_clear_and_resize(keys, 0);
+                return 0;
+            case SimpleKeyGenerator::SINGLE_KEY: {
+                const storage::KeyV1Owned key(elts, generator.numFields());
+                storage::Key sKey;
+                sKey.reset(key, &pk);
+                storage::dbt_array_clear_and_resize(keys, 1);
+                storage::dbt_array_push(keys, sKey.buf(), sKey.size());
+                return 1;
+            }
+            case SimpleKeyGenerator::NEEDS_EXPANSION:
+                break;
+            }
+        }
+
+        BSONObjSet keySet;
+        generateKeys(obj, keySet);
+        storage::dbt_array_clear_and_resize(keys, keySet.size());
+        for (BSONObjSet::const_iterator i = keySet.begin(); i != keySet.end(); i++) {
+            const storage::Key sKey(*i, &pk);
+            storage::dbt_array_push(keys, sKey.buf(), sKey.size());
+        }
+        return keySet.size();
+    }
+
 } // namespace mongo
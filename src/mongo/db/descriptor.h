@@ -57,11 +57,20 @@ namespace mongo {
 
         void generateKeys(const BSONObj &obj, BSONObjSet &keys) const;
 
+        // Generate the dictionary keys for obj, each followed by pk, straight into keys.
+        // @return the number of keys generated.
+        size_t generateKeys(const BSONObj &obj, const BSONObj &pk, DBT_ARRAY *keys) const;
+
         bool clustering() const {
             const Header &h(*reinterpret_cast<const Header *>(_data));
             return h.clustering;
         }
 
+        bool sparse() const {
+            const Header &h(*reinterpret_cast<const Header *>(_data));
+            return h.sparse;
+        }
+
         static size_t serializedSize(const BSONObj &keyPattern);
 
     private:
@@ -0,0 +1,102 @@
+/**
+ * Copyright (C) 2013 Tokutek Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongo/pch.h"
+
+#include "mongo/db/field_lookup_scope.h"
+
+#include "mongo/util/concurrency/threadlocal.h"
+
+namespace mongo {
+
+    // The innermost scope of each thread.  The scopes themselves live on the stack.
+    struct FieldLookupScopes {
+        FieldLookupScopes() : top(NULL) {}
+        FieldLookupScope *top;
+    };
+
+    TSP_DECLARE(FieldLookupScopes, fieldLookupScopes)
+    TSP_DEFINE(FieldLookupScopes, fieldLookupScopes)
+
+    FieldLookupScope::FieldLookupScope( const BSONObj &obj ) :
+        _obj( obj ),
+        _active( find( obj ) == NULL ),
+        _next( fieldLookupScopes.getMake()->top ),
+        _looked( false ) {
+        if ( _active ) {
+            fieldLookupScopes.get()->top = this;
+        }
+    }
+
+    FieldLookupScope::~FieldLookupScope() {
+        if ( _active ) {
+            dassert( fieldLookupScopes.get()->top == this );
+            fieldLookupScopes.get()->top = _next;
+        }
+    }
+
+    FieldLookupScope *FieldLookupScope::find( const BSONObj &obj ) {
+        const FieldLookupScopes *scopes = fieldLookupScopes.get();
+        if ( scopes == NULL ) {
+            return NULL;
+        }
+        for ( FieldLookupScope *s = scopes->top; s != NULL; s = s->_next ) {
+            if ( s->_obj.objdata() == obj.objdata() ) {
+                return s;
+            }
+        }
+        return NULL;
+    }
+
+    BSONElement FieldLookupScope::lookup( const StringData &name ) {
+        if ( _index ) {
+            return _index->getField( name );
+        }
+        if ( !_looked ) {
+            // a document looked at only once isn't worth indexing
+            _looked = true;
+            return _obj.getField( name );
+        }
+        _index.reset( new BSONElementIndex( _obj ) );
+        return _index->getField( name );
+    }
+
+    BSONElement FieldLookupScope::getField( const BSONObj &obj, const StringData &name ) {
+        FieldLookupScope *s = find( obj );
+        return s != NULL ? s->lookup( name ) : obj.getField( name );
+    }
+
+    BSONElement FieldLookupScope::getFieldDotted( const BSONObj &obj, const StringData &name ) {
+        FieldLookupScope *s = find( obj );
+        if ( s == NULL ) {
+            return obj.getFieldDotted( name );
+        }
+        // same as BSONObj::getFieldDotted(), a field named with the whole dotted path wins
+        BSONElement e = s->lookup( name );
+        if ( e.eoo() ) {
+            const size_t dot = name.find( '.' );
+            if ( dot != string::npos ) {
+                const BSONElement left = s->lookup( name.substr( 0, dot ) );
+                if ( left.type() == Object || left.type() == Array ) {
+                    return left.embeddedObject().getFieldDotted( name.substr( dot + 1 ) );
+                }
+                return BSONElement();
+            }
+        }
+        return e;
+    }
+
+} // namespace mongo
@@ -0,0 +1,68 @@
+/**
+ * Copyright (C) 2013 Tokutek Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mongo/pch.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#include "mongo/base/string_data.h"
+#include "mongo/bson/bson_element_index.h"
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    /**
+     * While a FieldLookupScope for a document is alive on this thread, top level field lookups
+     * in that document made through getField() and getFieldDotted() share one BSONElementIndex,
+     * so the matcher, the update modifiers and key generation for each index don't each walk
+     * it again.
+     *
+     * The index is only built on the second lookup, a single lookup costs what
+     * BSONObj::getField() does.  Scopes nest, a scope for a document that already has one just
+     * defers to it, and lookups in documents without a scope go straight to BSONObj.  The
+     * document must stay in place for the life of the scope.
+     */
+    class FieldLookupScope : boost::noncopyable {
+    public:
+        explicit FieldLookupScope( const BSONObj &obj );
+        ~FieldLookupScope();
+
+        /** @return true if a scope on this thread covers obj */
+        static bool covers( const BSONObj &obj ) {
+            return find( obj ) != NULL;
+        }
+
+        /** Same as obj.getField( name ). */
+        static BSONElement getField( const BSONObj &obj, const StringData &name );
+
+        /** Same as obj.getFieldDotted( name ). */
+        static BSONElement getFieldDotted( const BSONObj &obj, const StringData &name );
+
+    private:
+        static FieldLookupScope *find( const BSONObj &obj );
+        BSONElement lookup( const StringData &name );
+
+        const BSONObj _obj;
+        // false if an outer scope already covers _obj
+        const bool _active;
+        FieldLookupScope *const _next;
+        bool _looked;
+        boost::scoped_ptr<BSONElementIndex> _index;
+    };
+
+} // namespace mongo
@@ -440,6 +440,10 @@ namespace mongo {
                                       ? 0.0
                                       : ((double)_stats.bt_dsize/_stats.bt_nkeys)));
         b.appendNumber("storageSize", (long long) _stats.bt_fsize / scale);
+        // logical size over file size, so fragmentation counts against it too
+        b.appendNumber("compressionRatio", (_stats.bt_fsize == 0
+                                            ? 0.0
+                                            : ((double)_stats.bt_dsize/_stats.bt_fsize)));
         b.append("pageSize", _pageSize / scale);
         b.append("readPageSize", _readPageSize / scale);
         // fill compression
@@ -477,6 +481,8 @@ namespace mongo {
         b.appendNumber("nscannedObjects", _accessStats.nscannedObjects.load());
         b.appendNumber("inserts", _accessStats.inserts.load());
         b.appendNumber("deletes", _accessStats.deletes.load());
+        b.appendNumber("bytesRead", _accessStats.bytesRead.load());
+        b.appendNumber("bytesWritten", _accessStats.bytesWritten.load());
         return b.obj();
         // TODO: (Zardosht) Need to figure out how to display these dates
         /*
@@ -224,6 +224,10 @@ namespace mongo {
             CacheLineWord deletes;
             // Not sure how to capture updates just yet
             //CacheLineWord updates;
+            // keys and values read by cursors, and sent to the dictionary by inserts and
+            // updates (updates only count for the primary key)
+            CacheLineWord bytesRead;
+            CacheLineWord bytesWritten;
         };
 
         const AccessStats &getAccessStats() const {
@@ -242,6 +246,12 @@ namespace mongo {
         void noteDelete() const {
             _accessStats.deletes.fetchAndAdd(1);
         }
+        void noteBytesRead(const long long bytes) const {
+            _accessStats.bytesRead.fetchAndAdd(bytes);
+        }
+        void noteBytesWritten(const long long bytes) const {
+            _accessStats.bytesWritten.fetchAndAdd(bytes);
+        }
 
         class Cursor : public storage::Cursor {
         public:
@@ -333,6 +343,12 @@ namespace mongo {
         uint64_t getDeleleCount() const {
             return _accessStats.deletes.load();
         }
+        uint64_t getBytesRead() const {
+            return _accessStats.bytesRead.load();
+        }
+        uint64_t getBytesWritten() const {
+            return _accessStats.bytesWritten.load();
+        }
     private:
         string _name;
         DB_BTREE_STAT64 _stats;
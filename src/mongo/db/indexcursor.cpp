@@ -18,6 +18,8 @@
 */
 
 #include "mongo/pch.h"
+#include <boost/bind.hpp>
+
 #include "mongo/db/curop.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/queryutil.h"
@@ -30,7 +32,8 @@ namespace mongo {
         _size(_BUF_SIZE_PREFERRED),
         _current_offset(0),
         _end_offset(0),
-        _buf(new char[_size]) {
+        _buf(new char[_size]),
+        _ownedBytes(0) {
     }
 
     RowBuffer::~RowBuffer() {
@@ -44,7 +47,7 @@ namespace mongo {
     bool RowBuffer::isGorged() const {
         const int threshold = 100;
         const bool almost_full = _end_offset + threshold > _size;
-        const bool too_big = _size > _BUF_SIZE_PREFERRED;
+        const bool too_big = _size + _ownedBytes > _BUF_SIZE_PREFERRED;
         return almost_full || too_big;
     }
 
@@ -55,16 +58,23 @@ namespace mongo {
 
         const char *buf = _buf + _current_offset;
         const char headerBits = *buf++;
-        dassert(headerBits >= 1 && headerBits <= 3);
+        dassert(headerBits >= 1 && headerBits <= 7);
 
         storage::Key sk(buf, headerBits & HeaderBits::hasPK);
         sKey.set(buf, sk.size());
-        obj = headerBits & HeaderBits::hasObj ? BSONObj(buf + sKey.size()) : BSONObj();
+        if (headerBits & HeaderBits::ownedObj) {
+            uint32_t i;
+            memcpy(&i, buf + sKey.size(), sizeof(i));
+            obj = _ownedObjs[i];
+        } else {
+            obj = headerBits & HeaderBits::hasObj ? BSONObj(buf + sKey.size()) : BSONObj();
+        }
 
         dassert(_current_offset
                 + 1
                 + sk.size()
-                + (headerBits & HeaderBits::hasObj ? obj.objsize() : 0)
+                + (headerBits & HeaderBits::ownedObj ? sizeof(uint32_t) :
+                   headerBits & HeaderBits::hasObj ? obj.objsize() : 0)
                 <= _end_offset);
     }
 
@@ -72,7 +82,9 @@ namespace mongo {
 
         size_t key_size = sKey.size();
         size_t obj_size = obj.isEmpty() ? 0 : obj.objsize();
-        size_t size_needed = _end_offset + 1 + key_size + obj_size;
+        const bool ownObj = obj_size >= _OBJ_SIZE_OWNED;
+        const size_t obj_bytes = ownObj ? sizeof(uint32_t) : obj_size;
+        size_t size_needed = _end_offset + 1 + key_size + obj_bytes;
 
         // if we need more than we have, realloc.
         if (size_needed > _size) {
@@ -86,8 +98,10 @@ namespace mongo {
         // Determine what to put in the header byte.
         const bool hasPK = !sKey.pk().isEmpty();
         const bool hasObj = obj_size > 0;
-        const unsigned char headerBits = (hasPK ? HeaderBits::hasPK : 0) | (hasObj ? HeaderBits::hasObj : 0);
-        dassert(headerBits >= 1 && headerBits <= 3);
+        const unsigned char headerBits = (hasPK ? HeaderBits::hasPK : 0) |
+                                         (hasObj ? HeaderBits::hasObj : 0) |
+                                         (ownObj ? HeaderBits::ownedObj : 0);
+        dassert(headerBits >= 1 && headerBits <= 7);
         memcpy(_buf + _end_offset, &headerBits, 1);
         _end_offset += 1;
 
@@ -96,7 +110,13 @@ namespace mongo {
         // the header bit says whether a pk/obj exists.
         memcpy(_buf + _end_offset, sKey.buf(), key_size);
         _end_offset += key_size;
-        if (obj_size > 0) {
+        if (ownObj) {
+            const uint32_t i = _ownedObjs.size();
+            _ownedObjs.push_back(obj.getOwned());
+            _ownedBytes += obj_size;
+            memcpy(_buf + _end_offset, &i, sizeof(i));
+            _end_offset += sizeof(i);
+        } else if (obj_size > 0) {
             memcpy(_buf + _end_offset, obj.objdata(), obj_size);
             _end_offset += obj_size;
         }
@@ -115,13 +135,15 @@ namespace mongo {
 
         // the buffer has more, seek passed the current one.
         const char headerBits = *(_buf + _current_offset);
-        dassert(headerBits >= 1 && headerBits <= 3);
+        dassert(headerBits >= 1 && headerBits <= 7);
         _current_offset += 1;
 
         storage::Key sKey(_buf + _current_offset, headerBits & HeaderBits::hasPK);
         _current_offset += sKey.size();
 
-        if (headerBits & HeaderBits::hasObj) {
+        if (headerBits & HeaderBits::ownedObj) {
+            _current_offset += sizeof(uint32_t);
+        } else if (headerBits & HeaderBits::hasObj) {
             BSONObj obj(_buf + _current_offset);
             _current_offset += obj.objsize();
         }
@@ -145,27 +167,58 @@ namespace mongo {
             }
             _current_offset = 0;
             _end_offset = 0;
+            _ownedObjs.clear();
+            _ownedBytes = 0;
         }
     }
 
     /* ---------------------------------------------------------------------- */
 
-    shared_ptr<IndexCursor> IndexCursor::make( NamespaceDetails *d, const IndexDetails &idx,
-                                               const BSONObj &startKey, const BSONObj &endKey,
-                                               bool endKeyInclusive, int direction,
-                                               int numWanted ) {
-        return shared_ptr<IndexCursor>( new IndexCursor( d, idx, startKey, endKey,
-                                                         endKeyInclusive, direction,
-                                                         numWanted ) );
-    }
-
-    shared_ptr<IndexCursor> IndexCursor::make( NamespaceDetails *d, const IndexDetails &idx,
-                                               const shared_ptr< FieldRangeVector > &bounds,
-                                               int singleIntervalLimit, int direction,
-                                               int numWanted ) {
-        return shared_ptr<IndexCursor>( new IndexCursor( d, idx, bounds,
-                                                         singleIntervalLimit, direction,
-                                                         numWanted ) );
+    // The same range over a partition's primary key, for a PartitionedCursor.
+    static shared_ptr<Cursor> makePartitionKeyRangeCursor( const BSONObj &startKey,
+                                                           const BSONObj &endKey,
+                                                           bool endKeyInclusive, int direction,
+                                                           int numWanted, NamespaceDetails *p ) {
+        return IndexCursor::make( p, p->getPKIndex(), startKey, endKey, endKeyInclusive,
+                                  direction, numWanted );
+    }
+
+    static shared_ptr<Cursor> makePartitionBoundsCursor( const shared_ptr< FieldRangeVector > &bounds,
+                                                         int singleIntervalLimit, int direction,
+                                                         int numWanted, NamespaceDetails *p ) {
+        return IndexCursor::make( p, p->getPKIndex(), bounds, singleIntervalLimit,
+                                  direction, numWanted );
+    }
+
+    shared_ptr<Cursor> IndexCursor::make( NamespaceDetails *d, const IndexDetails &idx,
+                                          const BSONObj &startKey, const BSONObj &endKey,
+                                          bool endKeyInclusive, int direction,
+                                          int numWanted ) {
+        if ( d->isPartitioned() ) {
+            verify( d->isPKIndex( idx ) );
+            return shared_ptr<Cursor>( new PartitionedCursor( d, direction,
+                    boost::bind( &makePartitionKeyRangeCursor, startKey.getOwned(),
+                                 endKey.getOwned(), endKeyInclusive, direction, numWanted,
+                                 _1 ) ) );
+        }
+        return shared_ptr<Cursor>( new IndexCursor( d, idx, startKey, endKey,
+                                                    endKeyInclusive, direction,
+                                                    numWanted ) );
+    }
+
+    shared_ptr<Cursor> IndexCursor::make( NamespaceDetails *d, const IndexDetails &idx,
+                                          const shared_ptr< FieldRangeVector > &bounds,
+                                          int singleIntervalLimit, int direction,
+                                          int numWanted ) {
+        if ( d->isPartitioned() ) {
+            verify( d->isPKIndex( idx ) );
+            return shared_ptr<Cursor>( new PartitionedCursor( d, direction,
+                    boost::bind( &makePartitionBoundsCursor, bounds, singleIntervalLimit,
+                                 direction, numWanted, _1 ) ) );
+        }
+        return shared_ptr<Cursor>( new IndexCursor( d, idx, bounds,
+                                                    singleIntervalLimit, direction,
+                                                    numWanted ) );
     }
 
     IndexCursor::IndexCursor( NamespaceDetails *d, const IndexDetails &idx,
@@ -183,11 +236,14 @@ namespace mongo {
         _boundsMustMatch(true),
         _nscanned(0),
         _nscannedObjects(0),
+        _bytesRead(0),
         _prelock(!cc().opSettings().getJustOne() && numWanted == 0),
         _cursor(_idx, cursor_flags()),
         _tailable(false),
         _ok(false),
-        _getf_iteration(0)
+        _getf_iteration(0),
+        _pointGets(false),
+        _pointsDone(true)
     {
         verify( _d != NULL );
         TOKULOG(3) << toString() << ": constructor: bounds " << prettyIndexBounds() << endl;
@@ -209,11 +265,14 @@ namespace mongo {
         _boundsMustMatch(true),
         _nscanned(0),
         _nscannedObjects(0),
+        _bytesRead(0),
         _prelock(!cc().opSettings().getJustOne() && numWanted == 0),
         _cursor(_idx, cursor_flags()),
         _tailable(false),
         _ok(false),
-        _getf_iteration(0)
+        _getf_iteration(0),
+        _pointGets(false),
+        _pointsDone(true)
     {
         verify( _d != NULL );
         _boundsIterator.reset( new FieldRangeVectorIterator( *_bounds , singleIntervalLimit ) );
@@ -227,6 +286,9 @@ namespace mongo {
     IndexCursor::~IndexCursor() {
         // Book-keeping for index access patterns.
         _idx.noteQuery(_nscanned, _nscannedObjects);
+        if (_bytesRead > 0) {
+            _idx.noteBytesRead(_bytesRead);
+        }
     }
 
     int IndexCursor::cursor_getf(const DBT *key, const DBT *val, void *extra) {
@@ -237,6 +299,7 @@ namespace mongo {
                 storage::Key sKey(key);
                 buffer->append(sKey, val->size > 0 ?
                         BSONObj(static_cast<const char *>(val->data)) : BSONObj());
+                info->bytes_fetched += key->size + val->size;
 
                 // request more bulk fetching if we are allowed to fetch more rows
                 // and the row buffer is not too full.
@@ -264,6 +327,7 @@ namespace mongo {
         // Tailable cursors _must_ use endKey/endKeyInclusive so the bounds we
         // may or may not have gotten via the constructor is no longer valid.
         _bounds.reset();
+        _pointGets = false;
         checkCurrentAgainstBounds();
     }
 
@@ -404,7 +468,13 @@ namespace mongo {
             prelock();
         }
 
-        if ( _bounds != NULL ) {
+        if ( usePointGets() ) {
+            initializePoints();
+            _ok = fetchPoints();
+            if ( ok() ) {
+                getCurrentFromBuffer();
+            }
+        } else if ( _bounds != NULL ) {
             const int r = skipToNextKey( _startKey );
             if ( r == -1 ) {
                 // The bounds iterator suggests _bounds->startKey() is within
@@ -512,6 +582,7 @@ namespace mongo {
         }
 
         _getf_iteration++;
+        _bytesRead += extra.bytes_fetched;
         _ok = extra.rows_fetched > 0 ? true : false;
         if ( ok() ) {
             getCurrentFromBuffer();
@@ -523,7 +594,12 @@ namespace mongo {
     // Check the current key with respect to our key bounds, whether
     // it be provided by independent field ranges or by start/end keys.
     bool IndexCursor::checkCurrentAgainstBounds() {
-        if ( _bounds == NULL ) {
+        if ( _pointGets ) {
+            // Point gets only find keys that are in bounds.
+            if ( ok() ) {
+                ++_nscanned;
+            }
+        } else if ( _bounds == NULL ) {
             checkEnd();
             if ( ok() ) {
                 ++_nscanned;
@@ -707,6 +783,7 @@ again:      while ( !allInclusive && ok() ) {
         }
 
         _getf_iteration++;
+        _bytesRead += extra.bytes_fetched;
         return extra.rows_fetched > 0 ? true : false;
     }
 
@@ -720,7 +797,7 @@ again:      while ( !allInclusive && ok() ) {
         // if there is not data remaining in the bulk fetch buffer,
         // do a fractal tree call to get more rows
         if ( !ok() ) {
-            _ok = fetchMoreRows();
+            _ok = _pointGets ? fetchPoints() : fetchMoreRows();
         }
         // at this point, if there are rows to be gotten,
         // it is residing in the bulk fetch buffer.
@@ -733,6 +810,120 @@ again:      while ( !allInclusive && ok() ) {
         }
     }
 
+    bool IndexCursor::usePointGets() const {
+        return _bounds != NULL && _bounds->containsOnlyPointIntervals() &&
+               (_d->isPKIndex(_idx) || _idx.unique());
+    }
+
+    void IndexCursor::initializePoints() {
+        const vector<FieldRange> &ranges = _bounds->ranges();
+        _pointPositions.assign( ranges.size(), 0 );
+        _pointsDone = false;
+        for ( vector<FieldRange>::const_iterator r = ranges.begin(); r != ranges.end(); ++r ) {
+            if ( r->intervals().empty() ) {
+                _pointsDone = true;
+            }
+        }
+        _pointGets = true;
+        TOKULOG(3) << toString() << ": using point gets for " << _bounds->size() << " keys" << endl;
+    }
+
+    bool IndexCursor::nextPoint( BSONObj &point ) {
+        if ( _pointsDone ) {
+            return false;
+        }
+        const vector<FieldRange> &ranges = _bounds->ranges();
+        BSONObjBuilder b;
+        for ( size_t i = 0; i < ranges.size(); i++ ) {
+            b.appendAs( ranges[i].intervals()[_pointPositions[i]]._lower._bound, "" );
+        }
+        point = b.obj();
+
+        // The cross product of each field's points, which are already in cursor order, so the
+        // last field's position moves fastest.
+        for ( size_t i = ranges.size(); i-- > 0; ) {
+            if ( ++_pointPositions[i] < ranges[i].intervals().size() ) {
+                return true;
+            }
+            _pointPositions[i] = 0;
+        }
+        _pointsDone = true;
+        return true;
+    }
+
+    int IndexCursor::point_getf(const DBT *key, const DBT *val, void *extra) {
+        struct point_getf_extra *info = static_cast<struct point_getf_extra *>(extra);
+        try {
+            if (key != NULL) {
+                storage::Key sKey(key);
+                const storage::Key *prefix = info->prefix;
+                if (prefix != NULL) {
+                    // set_range landed on the first key at or after the point; it is the
+                    // point's only if the key part, without the pk, compares equal. The
+                    // bytes may still differ, e.g. NumberInt(5) and 5.0 are encoded apart.
+                    const storage::KeyV1 k(static_cast<const char *>(key->data));
+                    const storage::KeyV1 p(static_cast<const char *>(prefix->buf()));
+                    if (k.woCompare(p, *info->ordering) != 0) {
+                        return 0;
+                    }
+                }
+                info->buffer->append(sKey, val->size > 0 ?
+                        BSONObj(static_cast<const char *>(val->data)) : BSONObj());
+                info->found = true;
+                info->bytes_fetched += key->size + val->size;
+            }
+            return 0;
+        } catch (const std::exception &ex) {
+            info->saveException(ex);
+        }
+        return -1;
+    }
+
+    bool IndexCursor::fetchPoints() {
+        // We're going to get more rows, so get rid of what's there.
+        _buffer.empty();
+
+        const bool isSecondary = !_d->isPKIndex(_idx);
+        const int rows_to_fetch = getf_fetch_count();
+        int rows_fetched = 0;
+        DBC *cursor = _cursor.dbc();
+        BSONObj point;
+        while ( rows_fetched < rows_to_fetch && !_buffer.isGorged() && nextPoint( point ) ) {
+            const storage::Key prefix( point, NULL );
+            int r;
+            if ( isSecondary ) {
+                // Secondary keys have the pk appended, so find the first key
+                // with the point's prefix, which is the only one.
+                const storage::Key sKey( point, forward() ? &minKey : &maxKey );
+                DBT key_dbt = sKey.dbt();
+                struct point_getf_extra extra(&_buffer, &prefix, &_ordering);
+                r = forward() ?
+                    cursor->c_getf_set_range(cursor, getf_flags(), &key_dbt, point_getf, &extra) :
+                    cursor->c_getf_set_range_reverse(cursor, getf_flags(), &key_dbt, point_getf, &extra);
+                if ( r == -1 ) {
+                    extra.throwException();
+                }
+                rows_fetched += extra.found ? 1 : 0;
+                _bytesRead += extra.bytes_fetched;
+            } else {
+                DBT key_dbt = prefix.dbt();
+                struct point_getf_extra extra(&_buffer, NULL, &_ordering);
+                r = cursor->c_getf_set(cursor, getf_flags(), &key_dbt, point_getf, &extra);
+                if ( r == -1 ) {
+                    extra.throwException();
+                }
+                rows_fetched += extra.found ? 1 : 0;
+                _bytesRead += extra.bytes_fetched;
+            }
+            if ( r != 0 && r != DB_NOTFOUND ) {
+                storage::handle_ydb_error(r);
+            }
+        }
+
+        _getf_iteration++;
+        return rows_fetched > 0;
+    }
+
     bool IndexCursor::advance() {
         killCurrentOp.checkForInterrupt();
         if ( ok() ) {
@@ -92,6 +92,9 @@ namespace mongo {
                        name << " key:" << keyPattern.toString(),
                        _d->nIndexes() < NIndexesMax);
 
+        uassert(17047, "a partitioned collection has no indexes but its primary key",
+                       !_isSecondaryIndex || !_d->isPartitioned());
+
         // The first index we create should be the pk index, when we first create the collection.
         if (!_isSecondaryIndex) {
             massert(16923, "first index should be pk index", keyPattern == _d->_pk);
@@ -33,6 +33,7 @@
 
 #include "mongo/db/auth/action_type.h"
 #include "mongo/db/auth/authorization_manager.h"
+#include "mongo/db/capped_notifier.h"
 #include "mongo/db/databaseholder.h"
 #include "mongo/db/introspect.h"
 #include "mongo/db/repl.h"
@@ -328,6 +329,8 @@ namespace mongo {
 
     // Returns false when request includes 'end'
     void assembleResponse( Message &m, DbResponse &dbresponse, const HostAndPort& remote ) {
+        // temporary builders for this request draw from the thread's arena
+        OpArena::Scope arenaScope;
 
         // before we lock...
         int op = m.operation();
@@ -471,7 +474,11 @@ namespace mongo {
 
         if ( currentOp.shouldDBProfile( debug.executionTime ) ) {
             // performance profiling is on
-            if ( Lock::isReadLocked() ) {
+            if ( profileAsync ) {
+                // the profile writer takes the locks, later
+                enqueueProfile( c, op, currentOp );
+            }
+            else if ( Lock::isReadLocked() ) {
                 LOG(1) << "note: not profiling because recursive read lock" << endl;
             }
             else if ( lockedForWriting() ) {
@@ -653,9 +660,13 @@ namespace mongo {
         scoped_ptr<Timer> timer;
         int pass = 0;
         bool exhaust = false;
-        QueryResult* msgdata = 0;
+        auto_ptr<Message> resp( new Message() );
+        bool haveResult = false;
         GTID last;
         bool isOplog = false;
+        bool lookedForNotifier = false;
+        shared_ptr<CappedNotifier> notifier;
+        unsigned long long notifierVersion = 0;
         while( 1 ) {
             try {
                 uassert( 16258, str::stream() << "Invalid ns [" << ns << "]", NamespaceString::isValid(ns) );
@@ -696,11 +707,16 @@ namespace mongo {
                     }
                 }
 
+                // Read before looking, so a commit after the look wakes the wait below.
+                if (notifier) {
+                    notifierVersion = notifier->version();
+                }
+
                 Client::ReadContext ctx(ns);
 
                 // call this readlocked so state can't change
                 replVerifyReadsOk();
-                msgdata = processGetMore(ns, ntoreturn, cursorid, curop, pass, exhaust);
+                haveResult = processGetMore(ns, ntoreturn, cursorid, curop, pass, exhaust, *resp);
             }
             catch ( AssertionException& e ) {
                 ex.reset( new AssertionException( e.getInfo().msg, e.getCode() ) );
@@ -709,7 +725,7 @@ namespace mongo {
             }
             
             pass++;
-            if (msgdata == 0) {
+            if (!haveResult) {
                 // this should only happen with QueryOption_AwaitData
                 exhaust = false;
                 massert(13073, "shutting down", !inShutdown() );
@@ -717,14 +733,24 @@ namespace mongo {
                     if ( ! timer ) {
                         timer.reset( new Timer() );
                     }
-                    else {
-                        if ( timer->seconds() >= 4 ) {
-                            // after about 4 seconds, return. pass stops at 1000 normally.
-                            // we want to return occasionally so slave can checkpoint.
-                            pass = 10000;
-                        }
+                    // after about 4 seconds, return. pass stops at 1000 normally.
+                    // we want to return occasionally so slave can checkpoint.
+                    const int remaining = 4000 - timer->millis();
+                    if ( remaining <= 0 ) {
+                        pass = 10000;
+                    }
+                    else if ( !lookedForNotifier ) {
+                        // Look again right away, now that a commit in between is noticed.
+                        notifier = CappedNotifier::find(ns);
+                        lookedForNotifier = true;
                     }
-                    if (debug) {
+                    else if ( notifier ) {
+                        // Wake for the next insert into the collection to complete, checking
+                        // for shutdown every so often.
+                        notifier->waitForChange(notifierVersion, std::min(remaining, 1000));
+                    }
+                    else if (debug) {
+                        // not capped (the master/slave oplog), so poll
                         sleepmillis(20);
                     }
                     else {
@@ -774,15 +800,14 @@ namespace mongo {
                 return ok;
             }
 
-            msgdata = emptyMoreResult(cursorid);
+            resp->reset();
+            resp->setData(emptyMoreResult(cursorid), true);
         }
 
-        Message *resp = new Message();
-        resp->setData(msgdata, true);
         curop.debug().responseLength = resp->header()->dataLen();
-        curop.debug().nreturned = msgdata->nReturned;
+        curop.debug().nreturned = reinterpret_cast<QueryResult *>(resp->header())->nReturned;
 
-        dbresponse.response = resp;
+        dbresponse.response = resp.release();
         dbresponse.responseTo = m.header()->id;
         
         if( exhaust ) {
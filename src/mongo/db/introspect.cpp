@@ -19,9 +19,12 @@
 
 #include "mongo/pch.h"
 
+#include <deque>
+
 #include "mongo/bson/util/builder.h"
 #include "mongo/db/auth/authorization_manager.h"
 #include "mongo/db/auth/principal_set.h"
+#include "mongo/db/commands/fsync.h"
 #include "mongo/db/curop.h"
 #include "mongo/db/database.h"
 #include "mongo/db/databaseholder.h"
@@ -29,6 +32,8 @@
 #include "mongo/db/curop.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/ops/insert.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/util/background.h"
 #include "mongo/util/goodies.h"
 
 namespace {
@@ -37,15 +42,19 @@ namespace {
 
 namespace mongo {
 
+    MONGO_EXPORT_SERVER_PARAMETER(profileAsync, bool, false);
+    // entries waiting for the profile writer, past which new ones are dropped
+    MONGO_EXPORT_SERVER_PARAMETER(profileBufferSize, int, 10000);
+
 namespace {
-    void _appendUserInfo(const Client& c, BSONObjBuilder& builder, AuthorizationManager* authManager) {
+    void _appendUserInfo(const StringData& ns, BSONObjBuilder& builder, AuthorizationManager* authManager) {
         PrincipalSet::NameIterator nameIter = authManager->getAuthenticatedPrincipalNames();
 
         PrincipalName bestUser;
         if (nameIter.more())
             bestUser = *nameIter;
 
-        StringData opdb( nsToDatabaseSubstring( c.ns() ) );
+        StringData opdb( nsToDatabaseSubstring( ns ) );
 
         BSONArrayBuilder allUsers(builder.subarrayStart("allUsers"));
         for ( ; nameIter.more(); nameIter.next()) {
@@ -65,10 +74,7 @@ namespace {
     }
 } // namespace
 
-    static void _profile(const Client& c, CurOp& currentOp, BufBuilder& profileBufBuilder) {
-        Database *db = c.database();
-        DEV verify( db );
-
+    static BSONObj _buildProfileEntry(const Client& c, CurOp& currentOp, BufBuilder& profileBufBuilder) {
         // build object
         BSONObjBuilder b(profileBufBuilder);
 
@@ -79,7 +85,7 @@ namespace {
         b.append("client", c.clientAddress());
 
         AuthorizationManager* authManager = c.getAuthorizationManager();
-        _appendUserInfo(c, b, authManager);
+        _appendUserInfo(currentOp.getNS(), b, authManager);
 
         BSONObj p = b.done();
 
@@ -92,7 +98,7 @@ namespace {
             BSONObjBuilder b(profileBufBuilder);
             b.appendDate("ts", jsTime());
             b.append("client", c.clientAddress() );
-            _appendUserInfo(c, b, authManager);
+            _appendUserInfo(currentOp.getNS(), b, authManager);
 
             b.append("err", "profile line too large (max is 100KB)");
 
@@ -103,6 +109,14 @@ namespace {
 
             p = b.done();
         }
+        return p;
+    }
+
+    static void _profile(const Client& c, CurOp& currentOp, BufBuilder& profileBufBuilder) {
+        Database *db = c.database();
+        DEV verify( db );
+
+        BSONObj p = _buildProfileEntry(c, currentOp, profileBufBuilder);
 
         // get or create the profiling collection
         NamespaceDetails *details = getOrCreateProfileCollection(db);
@@ -128,6 +142,163 @@ namespace {
         }
     }
 
+namespace {
+
+    AtomicInt64 profileQueued;
+    AtomicInt64 profileWritten;
+    AtomicInt64 profileDropped;
+    AtomicInt64 profileBatches;
+
+    /**
+     * Profile entries on their way to system.profile.  Operations only hold the lock to move
+     * an already built entry in, so they never wait on the writer's database locks or inserts.
+     */
+    class ProfileBuffer {
+    public:
+        struct Entry {
+            string profileNs;
+            BSONObj obj;
+        };
+
+        ProfileBuffer() : _mutex("ProfileBuffer") { }
+
+        // @return false if the buffer was full
+        bool push(const string& profileNs, const BSONObj& obj) {
+            SimpleMutex::scoped_lock lk(_mutex);
+            if (_entries.size() >= static_cast<size_t>(std::max(profileBufferSize, 1))) {
+                return false;
+            }
+            _entries.push_back(Entry());
+            _entries.back().profileNs = profileNs;
+            _entries.back().obj = obj;
+            return true;
+        }
+
+        void takeAll(std::deque<Entry>& out) {
+            SimpleMutex::scoped_lock lk(_mutex);
+            out.swap(_entries);
+        }
+
+    private:
+        SimpleMutex _mutex;
+        std::deque<Entry> _entries;
+    } profileBuffer;
+
+    /**
+     * Drains the profile buffer into each database's system.profile, one transaction per
+     * database per round.
+     */
+    class ProfileWriter : public BackgroundJob {
+    public:
+        virtual string name() const { return "ProfileWriter"; }
+
+        virtual void run() {
+            Client::initThread(name().c_str());
+            while (!inShutdown()) {
+                sleepmillis(RoundMillis);
+                if (lockedForWriting()) {
+                    // fsync+lock, leave it buffered (or dropped) until unlock
+                    continue;
+                }
+
+                std::deque<ProfileBuffer::Entry> entries;
+                profileBuffer.takeAll(entries);
+                while (!entries.empty()) {
+                    // everything for the first entry's database goes in one batch
+                    const string profileNs = entries.front().profileNs;
+                    vector<BSONObj> batch;
+                    std::deque<ProfileBuffer::Entry> rest;
+                    for (std::deque<ProfileBuffer::Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                        if (it->profileNs == profileNs) {
+                            batch.push_back(it->obj);
+                        }
+                        else {
+                            rest.push_back(*it);
+                        }
+                    }
+                    entries.swap(rest);
+                    writeBatch(profileNs, batch);
+                }
+            }
+            cc().shutdown();
+        }
+
+    private:
+        static const int RoundMillis = 100;
+
+        static void writeBatch(const string& profileNs, const vector<BSONObj>& batch) {
+            try {
+                try {
+                    Lock::DBRead lk(profileNs);
+                    lockedWriteBatch(profileNs, batch);
+                } catch (RetryWithWriteLock &e) {
+                    Lock::DBWrite lk(profileNs);
+                    lockedWriteBatch(profileNs, batch);
+                }
+            }
+            catch (const DBException& e) {
+                profileDropped.fetchAndAdd(batch.size());
+                LOG(1) << "profile writer could not write " << batch.size() << " entries to "
+                       << profileNs << ": " << e.toString() << endl;
+            }
+        }
+
+        static void lockedWriteBatch(const string& profileNs, const vector<BSONObj>& batch) {
+            if (!dbHolder().__isLoaded(nsToDatabase(profileNs), dbpath)) {
+                // dropped since
+                profileDropped.fetchAndAdd(batch.size());
+                return;
+            }
+            Client::Context ctx(profileNs, dbpath);
+            Client::Transaction txn(DB_SERIALIZABLE);
+            NamespaceDetails *details = getOrCreateProfileCollection(ctx.db());
+            if (details == NULL) {
+                profileDropped.fetchAndAdd(batch.size());
+                return;
+            }
+            for (vector<BSONObj>::const_iterator it = batch.begin(); it != batch.end(); ++it) {
+                BSONObj obj = *it;
+                insertOneObject(details, obj);
+            }
+            txn.commit();
+            profileWritten.fetchAndAdd(batch.size());
+            profileBatches.fetchAndAdd(1);
+        }
+    };
+
+} // namespace
+
+    void enqueueProfile(const Client& c, int op, CurOp& currentOp) {
+        try {
+            BufBuilder profileBufBuilder(1024);
+            BSONObj p = _buildProfileEntry(c, currentOp, profileBufBuilder).getOwned();
+            if (profileBuffer.push(getSisterNS(nsToDatabase(currentOp.getNS()), "system.profile"), p)) {
+                profileQueued.fetchAndAdd(1);
+            }
+            else {
+                profileDropped.fetchAndAdd(1);
+            }
+        }
+        catch (const AssertionException& assertionEx) {
+            warning() << "Caught Assertion while trying to profile " << opToString(op)
+                      << " against " << currentOp.getNS()
+                      << ": " << assertionEx.toString() << endl;
+        }
+    }
+
+    void startProfileWriter() {
+        ProfileWriter* writer = new ProfileWriter();
+        writer->go();
+    }
+
+    void appendProfileWriterStats(BSONObjBuilder& b) {
+        b.append("async", profileAsync);
+        b.append("queued", profileQueued.load());
+        b.append("written", profileWritten.load());
+        b.append("dropped", profileDropped.load());
+        b.append("batches", profileBatches.load());
+    }
+
     NamespaceDetails* getOrCreateProfileCollection(Database *db, bool force) {
         fassert(16372, db);
         const char* profileName = db->profileName().c_str();
@@ -34,6 +34,20 @@ namespace mongo {
 
     void profile(const Client& c, int op, CurOp& currentOp);
 
+    // Whether profile entries go through an in-memory buffer to a background writer, instead
+    // of being inserted by the operation they describe.
+    extern bool profileAsync;
+
+    /**
+     * Build the current op's profile entry and queue it for the profile writer.  Takes no
+     * database lock, and drops the entry if the writer is too far behind.
+     */
+    void enqueueProfile(const Client& c, int op, CurOp& currentOp);
+
+    void startProfileWriter();
+
+    void appendProfileWriterStats(BSONObjBuilder& b);
+
     /**
      * Get (or create) the profile collection
      *
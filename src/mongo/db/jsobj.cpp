@@ -64,16 +64,26 @@ namespace mongo {
     MaxKeyLabeler MAXKEY;
 
     // need to move to bson/, but has dependency on base64 so move that to bson/util/ first.
-    inline string BSONElement::jsonString( JsonStringFormat format, bool includeFieldNames, int pretty ) const {
+    string BSONElement::jsonString( JsonStringFormat format, bool includeFieldNames, int pretty ) const {
+        StringBuilder s;
+        jsonString( s, format, includeFieldNames, pretty );
+        return s.str();
+    }
+
+    void BSONElement::jsonString( StringBuilder& s, JsonStringFormat format, bool includeFieldNames, int pretty ) const {
         int sign;
 
-        stringstream s;
-        if ( includeFieldNames )
-            s << '"' << escape( fieldName() ) << "\" : ";
+        if ( includeFieldNames ) {
+            s << '"';
+            escape( s, fieldName() );
+            s << "\" : ";
+        }
         switch ( type() ) {
         case mongo::String:
         case Symbol:
-            s << '"' << escape( string(valuestr(), valuestrsize()-1) ) << '"';
+            s << '"';
+            escape( s, StringData( valuestr(), valuestrsize()-1 ) );
+            s << '"';
             break;
         case NumberLong:
             s << _numberLong();
@@ -82,8 +92,11 @@ namespace mongo {
         case NumberDouble:
             if ( number() >= -numeric_limits< double >::max() &&
                     number() <= numeric_limits< double >::max() ) {
-                s.precision( 16 );
-                s << number();
+                // same as a stringstream with precision 16
+                char buf[ 32 ];
+                const int z = snprintf( buf, sizeof( buf ), "%.16g", number() );
+                verify( z > 0 && z < (int) sizeof( buf ) );
+                s.write( buf, z );
             }
             else if ( mongo::isNaN(number()) ) {
                 s << "NaN";
@@ -113,7 +126,7 @@ namespace mongo {
             }
             break;
         case Object:
-            s << embeddedObject().jsonString( format, pretty );
+            embeddedObject().jsonString( s, format, pretty );
             break;
         case mongo::Array: {
             if ( embeddedObject().isEmpty() ) {
@@ -136,7 +149,7 @@ namespace mongo {
                         s << "undefined";
                     }
                     else {
-                        s << e.jsonString( format, false, pretty?pretty+1:0 );
+                        e.jsonString( s, format, false, pretty?pretty+1:0 );
                         e = i.next();
                     }
                     count++;
@@ -157,7 +170,7 @@ namespace mongo {
             s << '"' << valuestr() << "\", ";
             if ( format != TenGen )
                 s << "\"$id\" : ";
-            s << '"' << *x << "\" ";
+            s << '"' << x->str() << "\" ";
             if ( format == TenGen )
                 s << ')';
             else
@@ -171,7 +184,7 @@ namespace mongo {
             else {
                 s << "{ \"$oid\" : ";
             }
-            s << '"' << __oid() << '"';
+            s << '"' << __oid().str() << '"';
             if ( format == TenGen ) {
                 s << " )";
             }
@@ -184,12 +197,10 @@ namespace mongo {
             BinDataType type = BinDataType( *(char *)( (int *)( value() ) + 1 ) );
             s << "{ \"$binary\" : \"";
             char *start = ( char * )( value() ) + sizeof( int ) + 1;
-            base64::encode( s , start , len );
-            s << "\", \"$type\" : \"" << hex;
-            s.width( 2 );
-            s.fill( '0' );
-            s << type << dec;
-            s << "\" }";
+            s << base64::encode( start , len );
+            char typeHex[ 16 ];
+            snprintf( typeHex, sizeof( typeHex ), "%02x", static_cast<int>( type ) );
+            s << "\", \"$type\" : \"" << typeHex << "\" }";
             break;
         }
         case mongo::Date:
@@ -204,7 +215,7 @@ namespace mongo {
                     s << '"' << date().toString() << '"';
             }
             else
-                s << date();
+                s << date().millis;
             if ( format == Strict )
                 s << " }";
             else
@@ -212,11 +223,14 @@ namespace mongo {
             break;
         case RegEx:
             if ( format == Strict ) {
-                s << "{ \"$regex\" : \"" << escape( regex() );
+                s << "{ \"$regex\" : \"";
+                escape( s, regex() );
                 s << "\", \"$options\" : \"" << regexFlags() << "\" }";
             }
             else {
-                s << "/" << escape( regex() , true ) << "/";
+                s << "/";
+                escape( s, regex() , true );
+                s << "/";
                 // FIXME Worry about alpha order?
                 for ( const char *f = regexFlags(); *f; ++f ) {
                     switch ( *f ) {
@@ -235,7 +249,9 @@ namespace mongo {
             BSONObj scope = codeWScopeObject();
             if ( ! scope.isEmpty() ) {
                 s << "{ \"$code\" : " << _asCode() << " , "
-                  << " \"$scope\" : " << scope.jsonString() << " }";
+                  << " \"$scope\" : ";
+                scope.jsonString( s );
+                s << " }";
                 break;
             }
         }
@@ -246,10 +262,10 @@ namespace mongo {
 
         case Timestamp:
             if ( format == TenGen ) {
-                s << "Timestamp( " << ( timestampTime() / 1000 ) << ", " << timestampInc() << " )";
+                s << "Timestamp( " << ( timestampTime().millis / 1000 ) << ", " << timestampInc() << " )";
             }
             else {
-                s << "{ \"$timestamp\" : { \"t\" : " << ( timestampTime() / 1000 ) << ", \"i\" : " << timestampInc() << " } }";
+                s << "{ \"$timestamp\" : { \"t\" : " << ( timestampTime().millis / 1000 ) << ", \"i\" : " << timestampInc() << " } }";
             }
             break;
 
@@ -268,7 +284,6 @@ namespace mongo {
             string message = ss.str();
             massert( 10312 ,  message.c_str(), false );
         }
-        return s.str();
     }
 
     int BSONElement::getGtLtOp( int def ) const {
@@ -433,16 +448,24 @@ namespace mongo {
     }
 
     string BSONObj::jsonString( JsonStringFormat format, int pretty ) const {
+        StringBuilder s;
+        jsonString( s, format, pretty );
+        return s.str();
+    }
 
-        if ( isEmpty() ) return "{}";
+    void BSONObj::jsonString( StringBuilder& s, JsonStringFormat format, int pretty ) const {
+
+        if ( isEmpty() ) {
+            s << "{}";
+            return;
+        }
 
-        StringBuilder s;
         s << "{ ";
         BSONObjIterator i(*this);
         BSONElement e = i.next();
         if ( !e.eoo() )
             while ( 1 ) {
-                s << e.jsonString( format, true, pretty?pretty+1:0 );
+                e.jsonString( s, format, true, pretty?pretty+1:0 );
                 e = i.next();
                 if ( e.eoo() )
                     break;
@@ -457,7 +480,6 @@ namespace mongo {
                 }
             }
         s << " }";
-        return s.str();
     }
 
     bool BSONObj::valid() const {
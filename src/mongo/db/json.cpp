@@ -15,6 +15,8 @@
 
 #include "mongo/db/json.h"
 
+#include <cstring>
+
 #include "mongo/db/jsobj.h"
 #include "mongo/platform/cstdint.h"
 #include "mongo/util/base64.h"
@@ -40,8 +42,6 @@ namespace mongo {
         ID_RESERVE_SIZE = 64,
         PAT_RESERVE_SIZE = 4096,
         OPT_RESERVE_SIZE = 64,
-        FIELD_RESERVE_SIZE = 4096,
-        STRINGVAL_RESERVE_SIZE = 4096,
         BINDATA_RESERVE_SIZE = 4096,
         BINDATATYPE_RESERVE_SIZE = 4096,
         NS_RESERVE_SIZE = 64
@@ -72,6 +72,37 @@ namespace mongo {
 
     Status JParse::value(const StringData& fieldName, BSONObjBuilder& builder) {
         MONGO_JSON_DEBUG("fieldName: " << fieldName);
+        skipSpace();
+        if (_input >= _input_end) {
+            return number(fieldName, builder);
+        }
+        // Only try the alternatives that can start with the next character.  Strings and
+        // numbers, the common cases, then take no failed accept() calls at all.
+        switch (*_input) {
+        case '"':
+        case '\'':
+            return stringValue(fieldName, builder);
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            return number(fieldName, builder);
+        case '{':
+        case '[':
+        case '/':
+        case '-':
+        case 'n':
+        case 'N':
+        case 'D':
+        case 'T':
+        case 'O':
+        case 't':
+        case 'f':
+        case 'u':
+        case 'I':
+            break;
+        default:
+            return number(fieldName, builder);
+        }
+
         if (accept(LBRACE, false)) {
             Status ret = object(fieldName, builder);
             if (ret != Status::OK()) {
@@ -121,13 +152,7 @@ namespace mongo {
             }
         }
         else if (accept(DOUBLEQUOTE, false) || accept(SINGLEQUOTE, false)) {
-            std::string valueString;
-            valueString.reserve(STRINGVAL_RESERVE_SIZE);
-            Status ret = quotedString(&valueString);
-            if (ret != Status::OK()) {
-                return ret;
-            }
-            builder.append(fieldName, valueString);
+            return stringValue(fieldName, builder);
         }
         else if (accept("true")) {
             builder.append(fieldName, true);
@@ -159,6 +184,17 @@ namespace mongo {
         return Status::OK();
     }
 
+    Status JParse::stringValue(const StringData& fieldName, BSONObjBuilder& builder) {
+        // reuse one buffer for every string value instead of allocating one each time
+        _stringValue.clear();
+        Status ret = quotedString(&_stringValue);
+        if (ret != Status::OK()) {
+            return ret;
+        }
+        builder.append(fieldName, _stringValue);
+        return Status::OK();
+    }
+
     Status JParse::object(const StringData& fieldName, BSONObjBuilder& builder, bool subObject) {
         MONGO_JSON_DEBUG("fieldName: " << fieldName);
         if (!accept(LBRACE)) {
@@ -176,7 +212,6 @@ namespace mongo {
 
         // Special object
         std::string firstField;
-        firstField.reserve(FIELD_RESERVE_SIZE);
         Status ret = field(&firstField);
         if (ret != Status::OK()) {
             return ret;
@@ -263,9 +298,10 @@ namespace mongo {
             if (valueRet != Status::OK()) {
                 return valueRet;
             }
+            // one buffer for the names of all the remaining fields of this object
+            std::string fieldName;
             while (accept(COMMA)) {
-                std::string fieldName;
-                fieldName.reserve(FIELD_RESERVE_SIZE);
+                fieldName.clear();
                 Status fieldRet = field(&fieldName);
                 if (fieldRet != Status::OK()) {
                     return fieldRet;
@@ -731,6 +767,38 @@ namespace mongo {
     }
 
     Status JParse::number(const StringData& fieldName, BSONObjBuilder& builder) {
+        // Plain integers short enough not to overflow are by far the most common numbers.
+        // Anything else, including whatever strtod() would read further, takes the slow path.
+        {
+            const char* q = _input;
+            while (q < _input_end && isspace(*q)) {
+                ++q;
+            }
+            const bool negative = q < _input_end && *q == '-';
+            if (negative) {
+                ++q;
+            }
+            const char* digits = q;
+            long long n = 0;
+            while (q < _input_end && q - digits < 18 && *q >= '0' && *q <= '9') {
+                n = n * 10 + (*q++ - '0');
+            }
+            // a digit, letter or '.' after the run means an exponent, hex, a longer number...
+            if (q > digits && q < _input_end && !isalnum(*q) && *q != '.') {
+                if (negative) {
+                    n = -n;
+                }
+                if (n == static_cast<int>(n)) {
+                    builder.append(fieldName, static_cast<int>(n));
+                }
+                else {
+                    builder.append(fieldName, n);
+                }
+                _input = q;
+                return Status::OK();
+            }
+        }
+
         char* endptrll;
         char* endptrd;
         long long retll;
@@ -788,7 +856,14 @@ namespace mongo {
             if (!match(*_input, ALPHA "_$")) {
                 return parseError("First character in field must be [A-Za-z$_]");
             }
-            return chars(result, "", ALPHA DIGIT "_$");
+            // same as chars(result, "", ALPHA DIGIT "_$"), without a strchr() per character
+            const char* q = _input;
+            while (q < _input_end && isFieldChar(*q)) {
+                ++q;
+            }
+            result->append(_input, q);
+            _input = q;
+            return Status::OK();
         }
     }
 
@@ -818,6 +893,35 @@ namespace mongo {
         return Status::OK();
     }
 
+    /*
+     * Scans a word at a time while no byte in it can end a plain run of a quoted string.
+     */
+    const char* JParse::plainCharsEnd(const char* p, char quote) const {
+        const uint64_t ones = 0x0101010101010101ULL;
+        const uint64_t highs = 0x8080808080808080ULL;
+        const uint64_t quotes = ones * static_cast<unsigned char>(quote);
+        const uint64_t backslashes = ones * static_cast<unsigned char>('\\');
+        // A word with no quote, backslash or control character is copied as is.  The test can
+        // report such a byte that isn't there, which only means looking at the word bytewise.
+        while (_input_end - p >= 8) {
+            uint64_t w;
+            memcpy(&w, p, sizeof(w));
+            const uint64_t q = w ^ quotes;
+            const uint64_t b = w ^ backslashes;
+            const uint64_t special =
+                ((q - ones) & ~q) | ((b - ones) & ~b) | ((w - ones * 0x20) & ~w);
+            if (special & highs) {
+                break;
+            }
+            p += 8;
+        }
+        while (p < _input_end && *p != quote && *p != '\\' &&
+               static_cast<unsigned char>(*p) >= 0x20) {
+            ++p;
+        }
+        return p;
+    }
+
     /*
      * terminalSet are characters that signal end of string (e.g.) [ :\0]
      * allowedSet are the characters that are allowed, if this is set
@@ -829,8 +933,18 @@ namespace mongo {
             return parseError("Unexpected end of input");
         }
         const char* q = _input;
+        // For quoted strings, copy the runs between escapes in bulk, scanning a word at a time.
+        const bool quoted = allowedSet == NULL && terminalSet[0] != '\0' && terminalSet[1] == '\0';
         while (q < _input_end && !match(*q, terminalSet)) {
             MONGO_JSON_DEBUG("q: " << q);
+            if (quoted) {
+                const char* run = q;
+                q = plainCharsEnd(q, terminalSet[0]);
+                result->append(run, q);
+                if (q >= _input_end || *q == terminalSet[0]) {
+                    break;
+                }
+            }
             if (allowedSet != NULL) {
                 if (!match(*q, allowedSet)) {
                     _input = q;
@@ -941,7 +1055,6 @@ namespace mongo {
     bool JParse::acceptField(const StringData& expectedField) {
         MONGO_JSON_DEBUG("expectedField: " << expectedField);
         std::string nextField;
-        nextField.reserve(FIELD_RESERVE_SIZE);
         Status ret = field(&nextField);
         if (ret != Status::OK()) {
             return false;
@@ -269,6 +269,9 @@ namespace mongo {
              */
             Status field(std::string* result);
 
+            /** A quoted string value. */
+            Status stringValue(const StringData& fieldName, BSONObjBuilder&);
+
             /*
              * STRING :
              *     " "
@@ -314,6 +317,25 @@ namespace mongo {
              */
             Status chars(std::string* result, const char* terminalSet, const char* allowedSet=NULL);
 
+            /**
+             * @return the first character at or after p that is quote, a backslash, a control
+             * character or the end of input.
+             */
+            const char* plainCharsEnd(const char* p, char quote) const;
+
+            /** @return true if c is in [a-zA-Z0-9$_] */
+            static bool isFieldChar(char c) {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                       (c >= '0' && c <= '9') || c == '_' || c == '$';
+            }
+
+            /** Advance past whitespace. */
+            void skipSpace() {
+                while (_input < _input_end && isspace(*_input)) {
+                    ++_input;
+                }
+            }
+
             /**
              * Converts the two byte Unicode code point to its UTF8 character
              * encoding representation.  This function returns a string because
@@ -376,6 +398,9 @@ namespace mongo {
             const char* const _buf;
             const char* _input;
             const char* const _input_end;
+
+            // reused for every string value, see stringValue()
+            std::string _stringValue;
     };
 
 } // namespace mongo
@@ -18,6 +18,7 @@
 */
 
 #include "mongo/pch.h"
+#include "mongo/db/field_lookup_scope.h"
 #include "mongo/db/hasher.h"
 #include "mongo/db/keygenerator.h"
 #include "mongo/db/storage/assert_ids.h"
@@ -64,7 +65,7 @@ namespace mongo {
         vector<BSONElement> fixed( fieldNames.size() );
         _getKeys( fieldNames , fixed , obj, sparse, keys );
         if ( keys.empty() && ! sparse ) {
-            BSONObjBuilder nullKey(128);
+            BSONObjBuilder nullKey(128, OpArena::current());
             for (size_t i = 0; i < fieldNames.size(); i++) {
                 nullKey.appendNull("");
             }
@@ -166,7 +167,7 @@ namespace mongo {
             if ( sparse && numNotFound == (int) fieldNames.size() ) {
                 return;
             }            
-            BSONObjBuilder b(128);
+            BSONObjBuilder b(128, OpArena::current());
             for( vector< BSONElement >::iterator i = fixed.begin(); i != fixed.end(); ++i ) {
                 b.appendAs( *i, "" );
             }
@@ -186,4 +187,47 @@ namespace mongo {
         }
     }
 
+    SimpleKeyGenerator::SimpleKeyGenerator(const vector<const char *> &fieldNames,
+                                           const bool sparse) :
+        _paths(fieldNames.size()),
+        _sparse(sparse) {
+        for (size_t i = 0; i < fieldNames.size(); i++) {
+            splitStringDelim(fieldNames[i], &_paths[i], '.');
+        }
+    }
+
+    SimpleKeyGenerator::Result SimpleKeyGenerator::getKey(const BSONObj &obj, BSONElement *elts) const {
+        size_t numNotFound = 0;
+        for (size_t i = 0; i < _paths.size(); i++) {
+            // Same walk as BSONObj::getFieldDottedOrArray(), one path component at a time.
+            const vector<string> &path = _paths[i];
+            BSONObj cur = obj;
+            BSONElement e;
+            for (size_t j = 0; j < path.size(); j++) {
+                // The document's top level fields are shared with other indexes' generators.
+                e = j == 0 ? FieldLookupScope::getField(obj, path[j]) : cur.getField(path[j]);
+                if (e.type() == Array) {
+                    return NEEDS_EXPANSION;
+                }
+                if (j + 1 < path.size()) {
+                    if (e.type() != Object) {
+                        e = BSONElement();
+                        break;
+                    }
+                    cur = e.embeddedObject();
+                }
+            }
+            if (e.eoo()) {
+                elts[i] = nullElt;
+                numNotFound++;
+            } else {
+                elts[i] = e;
+            }
+        }
+        if (_sparse && numNotFound == _paths.size()) {
+            return NO_KEY;
+        }
+        return SINGLE_KEY;
+    }
+
 } // namespace mongo
@@ -95,4 +95,33 @@ namespace mongo {
         const bool _sparse;
     };
 
+    // Generates the single key of a standard index for documents without arrays along any
+    // of the indexed paths, which is most documents.  The field paths are split once, up
+    // front, and the key's values are returned in place, without building any BSON.
+    class SimpleKeyGenerator {
+    public:
+        SimpleKeyGenerator(const vector<const char *> &fieldNames,
+                           const bool sparse);
+
+        enum Result {
+            // elts holds the key's values
+            SINGLE_KEY,
+            // the document has no key (sparse index, none of the fields exist)
+            NO_KEY,
+            // an indexed path goes through an array, use KeyGenerator instead
+            NEEDS_EXPANSION
+        };
+
+        // @param elts an array of numFields() elements
+        Result getKey(const BSONObj &obj, BSONElement *elts) const;
+
+        size_t numFields() const {
+            return _paths.size();
+        }
+
+    private:
+        vector<vector<string> > _paths;
+        const bool _sparse;
+    };
+
 } // namespace mongo
@@ -95,6 +95,14 @@ namespace mongo {
         timeLocked[mapNo(type)].fetchAndAdd( micros );
     }
 
+    long long LockStat::getTotalTimeAcquiring() const {
+        long long total = 0;
+        for ( int i = 0; i < N; i++ ) {
+            total += timeAcquiring[i].load();
+        }
+        return total;
+    }
+
     void LockStat::reset() {
         for ( int i = 0; i < N; i++ ) {
             timeAcquiring[i].store(0);
@@ -38,6 +38,7 @@ namespace mongo {
         void report( StringBuilder& builder ) const;
 
         long long getTimeLocked( char type ) const { return timeLocked[mapNo(type)].load(); }
+        long long getTotalTimeAcquiring() const;
     private:
         static void _append( BSONObjBuilder& builder, const AtomicInt64* data );
         
@@ -23,9 +23,12 @@
 #include "mongo/db/matcher.h"
 #include "mongo/util/goodies.h"
 #include "mongo/util/startup_test.h"
+#include "mongo/util/stringutils.h"
+#include "mongo/util/text.h"
 #include "mongo/scripting/engine.h"
 #include "mongo/db/queryutil.h"
 #include "mongo/db/client.h"
+#include "mongo/db/field_lookup_scope.h"
 #include "mongo/db/namespacestring.h"
 #include "mongo/db/auth/authorization_manager.h"
 
@@ -183,15 +186,9 @@ namespace mongo {
                 }
                 _myregex->push_back( RegexMatcher() );
                 RegexMatcher &rm = _myregex->back();
-                rm._re.reset( new pcrecpp::RE( ie.regex(), flags2options( ie.regexFlags() ) ) );
+                rm.init( ie.regex(), ie.regexFlags() );
                 rm._fieldName = 0; // no need for field name
-                rm._regex = ie.regex();
-                rm._flags = ie.regexFlags();
                 rm._isNot = false;
-                bool purePrefix;
-                string prefix = simpleRegex(rm._regex, rm._flags, &purePrefix);
-                if (purePrefix)
-                    rm._prefix = prefix;
             }
             else {
                 uassert( 15882, "$elemMatch not allowed within $in",
@@ -228,6 +225,155 @@ namespace mongo {
         }
     }
 
+    /**
+     * If regex, with these flags, matches exactly the strings that contain some literal (or
+     * start with it, if anchored), set *literal, *anchored and *caseless and return true.
+     */
+    static bool literalRegex( const char *regex, const char *flags,
+                              string *literal, bool *anchored, bool *caseless ) {
+        bool multiline = false;
+        *caseless = false;
+        for ( ; flags && *flags; ++flags ) {
+            switch ( *flags ) {
+            case 'i':
+                *caseless = true;
+                break;
+            case 'm':
+                multiline = true;
+                break;
+            case 'x':
+                return false; // whitespace and comments aren't literal
+            default:
+                break;
+            }
+        }
+
+        *anchored = false;
+        if ( regex[ 0 ] == '\\' && regex[ 1 ] == 'A' ) {
+            *anchored = true;
+            regex += 2;
+        }
+        else if ( regex[ 0 ] == '^' ) {
+            if ( multiline ) {
+                return false; // ^ also matches after each newline
+            }
+            *anchored = true;
+            regex += 1;
+        }
+
+        literal->clear();
+        for ( ; *regex; ++regex ) {
+            char c = *regex;
+            if ( c == '\\' ) {
+                c = *++regex;
+                // \ followed by an alphanumeric is a class, assertion or backreference
+                if ( c == '\0' || isalnum( static_cast<unsigned char>( c ) ) ) {
+                    return false;
+                }
+            }
+            else if ( strchr( "^$.[]|()?*+{}", c ) ) {
+                return false;
+            }
+            if ( *caseless ) {
+                // pcre folds the case of non ascii characters with its unicode tables
+                if ( static_cast<unsigned char>( c ) >= 0x80 ) {
+                    return false;
+                }
+                if ( c >= 'A' && c <= 'Z' ) {
+                    c += 'a' - 'A';
+                }
+            }
+            literal->push_back( c );
+        }
+
+        // pcre never matches with a pattern that isn't valid utf8
+        return isValidUTF8( *literal );
+    }
+
+    inline unsigned char asciiLower( unsigned char c ) {
+        return ( c >= 'A' && c <= 'Z' ) ? c + ( 'a' - 'A' ) : c;
+    }
+
+    /** @return true if the first n bytes of s equal lowerLiteral, ignoring ascii case. */
+    inline bool caselessEqual( const char *s, const char *lowerLiteral, size_t n ) {
+        for ( size_t i = 0; i < n; ++i ) {
+            if ( asciiLower( s[ i ] ) != static_cast<unsigned char>( lowerLiteral[ i ] ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void RegexMatcher::init( const char *regex, const char *flags ) {
+        _regex = regex;
+        _flags = flags;
+        _re.reset( new pcrecpp::RE( regex, flags2options( flags ) ) );
+
+        bool anchored;
+        bool caseless;
+        if ( !literalRegex( regex, flags, &_literal, &anchored, &caseless ) ) {
+            // simpleRegex() also understands extended prefixes such as /^a b/x
+            bool purePrefix;
+            _literal = simpleRegex( regex, flags, &purePrefix );
+            if ( !purePrefix ) {
+                _literal.clear();
+            }
+            _kind = purePrefix ? PREFIX : PCRE;
+            return;
+        }
+        if ( anchored ) {
+            _kind = caseless ? PREFIX_CASELESS : PREFIX;
+        }
+        else {
+            _kind = caseless ? SUBSTRING_CASELESS : SUBSTRING;
+        }
+    }
+
+    bool RegexMatcher::matchesString( const char *str ) const {
+        const size_t n = _literal.size();
+        switch ( _kind ) {
+        case PREFIX:
+            return strncmp( str, _literal.c_str(), n ) == 0;
+        case PREFIX_CASELESS:
+            // strnlen keeps us from reading past the end of a short string
+            return strnlen( str, n ) == n && caselessEqual( str, _literal.c_str(), n );
+        case SUBSTRING: {
+            if ( n == 0 ) {
+                return true;
+            }
+            // memchr is vectorized by libc, so let it find candidates for the first byte.
+            const char first = _literal[ 0 ];
+            const char *p = str;
+            const char *end = str + strlen( str );
+            while ( static_cast<size_t>( end - p ) >= n ) {
+                p = static_cast<const char *>( memchr( p, first, ( end - p ) - n + 1 ) );
+                if ( p == NULL ) {
+                    return false;
+                }
+                if ( memcmp( p + 1, _literal.c_str() + 1, n - 1 ) == 0 ) {
+                    return true;
+                }
+                ++p;
+            }
+            return false;
+        }
+        case SUBSTRING_CASELESS: {
+            const size_t len = strlen( str );
+            if ( len < n ) {
+                return false;
+            }
+            for ( size_t i = 0; i <= len - n; ++i ) {
+                if ( caselessEqual( str + i, _literal.c_str(), n ) ) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        default:
+            return _re->PartialMatch( str );
+        }
+    }
+
     MatchDetails::MatchDetails() :
     _elemMatchKeyRequested() {
         resetOutput();
@@ -250,19 +396,10 @@ namespace mongo {
     void Matcher::addRegex(const char *fieldName, const char *regex, const char *flags, bool isNot) {
 
         RegexMatcher rm;
-        rm._re.reset( new pcrecpp::RE(regex, flags2options(flags)) );
+        rm.init(regex, flags);
         rm._fieldName = fieldName;
-        rm._regex = regex;
-        rm._flags = flags;
         rm._isNot = isNot;
         _regexs.push_back(rm);
-
-        if (!isNot) { //TODO something smarter
-            bool purePrefix;
-            string prefix = simpleRegex(regex, flags, &purePrefix);
-            if (purePrefix)
-                rm._prefix = prefix;
-        }
     }
 
     bool Matcher::addOp( const BSONElement &e, const BSONElement &fe, bool isNot, const char *& regex, const char *&flags ) {
@@ -569,6 +706,11 @@ namespace mongo {
         while ( i.more() ) {
             parseMatchExpressionElement( i.next(), nested );
         }
+
+        _program.reset( new MatchProgram( _basics ) );
+        if ( _program->empty() ) {
+            _program.reset();
+        }
     }
 
     Matcher::Matcher( const Matcher &docMatcher, const BSONObj &key ) :
@@ -631,10 +773,7 @@ namespace mongo {
         switch (e.type()) {
         case String:
         case Symbol:
-            if (rm._prefix.empty())
-                return rm._re->PartialMatch(e.valuestr());
-            else
-                return !strncmp(e.valuestr(), rm._prefix.c_str(), rm._prefix.size());
+            return rm.matchesString(e.valuestr());
         case RegEx:
             return !strcmp(rm._regex, e.regex()) && !strcmp(rm._flags, e.regexFlags());
         default:
@@ -927,6 +1066,195 @@ namespace mongo {
         return -1;
     }
 
+    const unsigned MatchProgram::MaxPredicates;
+    const unsigned MatchProgram::MaxTopFields;
+
+    MatchProgram::MatchProgram( const vector<ElementMatcher> &basics ) {
+        // Equalities are usually the most selective predicates, so they are compiled first.
+        for ( int pass = 0; pass < 2; ++pass ) {
+            for ( unsigned i = 0; i < basics.size() && i < MaxPredicates; ++i ) {
+                const ElementMatcher &em = basics[ i ];
+                if ( ( em._compareOp == BSONObj::Equality ) != ( pass == 0 ) ) {
+                    continue;
+                }
+                switch ( em._compareOp ) {
+                case BSONObj::Equality:
+                case BSONObj::LT:
+                case BSONObj::LTE:
+                case BSONObj::GT:
+                case BSONObj::GTE:
+                    break;
+                default:
+                    continue;
+                }
+                if ( em._isNot || em._toMatch.type() == Array ) {
+                    continue;
+                }
+
+                const char *fieldName = em._toMatch.fieldName();
+                unsigned path = 0;
+                while ( path < _paths.size() && _paths[ path ].dotted != fieldName ) {
+                    ++path;
+                }
+                if ( path == _paths.size() ) {
+                    Path newPath;
+                    newPath.dotted = fieldName;
+                    splitStringDelim( newPath.dotted, &newPath.components, '.' );
+                    if ( newPath.components.empty() ) {
+                        newPath.components.push_back( "" );
+                    }
+                    const string &top = newPath.components[ 0 ];
+                    newPath.topField = std::find( _topFields.begin(), _topFields.end(), top ) -
+                                       _topFields.begin();
+                    if ( newPath.topField == _topFields.size() ) {
+                        if ( _topFields.size() == MaxTopFields ) {
+                            continue;
+                        }
+                        _topFields.push_back( top );
+                    }
+                    _paths.push_back( newPath );
+                }
+
+                Predicate p;
+                p.basic = i;
+                p.path = path;
+                p.op = em._compareOp;
+                p.toMatch = em._toMatch;
+                p.canonicalType = em._toMatch.canonicalType();
+                p.kind = ( em._toMatch.isNumber() ? NumberKind :
+                           em._toMatch.type() == String ? StringKind : GenericKind );
+                p.matchesMissing = ( em._toMatch.type() == jstNULL ||
+                                     em._toMatch.type() == Undefined );
+                _predicates.push_back( p );
+            }
+        }
+    }
+
+    inline bool MatchProgram::evaluate( const Predicate &p, const BSONElement &e ) {
+        // Values of different canonical types never match, see valuesMatch().
+        if ( e.canonicalType() != p.canonicalType ) {
+            return false;
+        }
+
+        int c;
+        if ( p.kind == StringKind && e.type() == String ) {
+            int lsz = e.valuestrsize();
+            int rsz = p.toMatch.valuestrsize();
+            c = memcmp( e.valuestr(), p.toMatch.valuestr(), std::min( lsz, rsz ) );
+            if ( c == 0 ) {
+                c = lsz - rsz;
+            }
+        }
+        else if ( p.kind == NumberKind && e.type() == NumberInt &&
+                  p.toMatch.type() == NumberInt ) {
+            int l = e._numberInt();
+            int r = p.toMatch._numberInt();
+            c = ( l < r ) ? -1 : ( l == r ? 0 : 1 );
+        }
+        else {
+            c = compareElementValues( e, p.toMatch );
+        }
+
+        if ( p.op == BSONObj::Equality ) {
+            return c == 0;
+        }
+        if ( c < -1 ) c = -1;
+        if ( c > 1 ) c = 1;
+        return p.op & ( 1 << ( c + 1 ) );
+    }
+
+    bool MatchProgram::run( const BSONObj &obj, PredicateSet *matched ) const {
+        // Find every referenced top level field in one pass.  As with getField(), the first
+        // occurrence of a field name wins.
+        const unsigned nTop = _topFields.size();
+        const char *top[ MaxTopFields ];
+        unsigned nFound = 0;
+        for ( unsigned i = 0; i < nTop; ++i ) {
+            top[ i ] = NULL;
+        }
+        if ( nTop > 1 && FieldLookupScope::covers( obj ) ) {
+            // The document is already being looked up by field elsewhere in this operation.
+            for ( unsigned i = 0; i < nTop; ++i ) {
+                BSONElement e = FieldLookupScope::getField( obj, _topFields[ i ] );
+                if ( !e.eoo() ) {
+                    top[ i ] = e.rawdata();
+                }
+            }
+            nFound = nTop;
+        }
+        BSONObjIterator it( obj );
+        while ( it.more() && nFound < nTop ) {
+            BSONElement e = it.next();
+            const char *name = e.fieldName();
+            for ( unsigned i = 0; i < nTop; ++i ) {
+                if ( top[ i ] == NULL && strcmp( name, _topFields[ i ].c_str() ) == 0 ) {
+                    top[ i ] = e.rawdata();
+                    ++nFound;
+                    break;
+                }
+            }
+        }
+
+        // Resolve each path at most once.
+        enum { Unresolved, Missing, Found, HasArray };
+        const unsigned nPaths = _paths.size();
+        char state[ MaxPredicates ];
+        const char *resolved[ MaxPredicates ];
+        for ( unsigned i = 0; i < nPaths; ++i ) {
+            state[ i ] = Unresolved;
+        }
+
+        PredicateSet ret = 0;
+        for ( vector<Predicate>::const_iterator p = _predicates.begin();
+             p != _predicates.end(); ++p ) {
+            if ( state[ p->path ] == Unresolved ) {
+                const Path &path = _paths[ p->path ];
+                state[ p->path ] = Missing;
+                if ( top[ path.topField ] != NULL ) {
+                    BSONElement e( top[ path.topField ] );
+                    for ( unsigned c = 1; c < path.components.size(); ++c ) {
+                        if ( e.type() == Array ) {
+                            break;
+                        }
+                        // Descending into anything but an object means the path is missing.
+                        e = ( e.type() == Object ?
+                              e.embeddedObject().getField( path.components[ c ] ) :
+                              BSONElement() );
+                        if ( e.eoo() ) {
+                            break;
+                        }
+                    }
+                    if ( e.type() == Array ) {
+                        state[ p->path ] = HasArray;
+                    }
+                    else if ( !e.eoo() ) {
+                        state[ p->path ] = Found;
+                        resolved[ p->path ] = e.rawdata();
+                    }
+                }
+            }
+
+            switch ( state[ p->path ] ) {
+            case HasArray:
+                // Array elements and whole array equality are left to matchesDotted().
+                continue;
+            case Missing:
+                if ( !p->matchesMissing ) {
+                    return false;
+                }
+                break;
+            default:
+                if ( !evaluate( *p, BSONElement( resolved[ p->path ] ) ) ) {
+                    return false;
+                }
+            }
+            ret |= ( 1ULL << p->basic );
+        }
+
+        *matched = ret;
+        return true;
+    }
+
     extern int dump;
 
     /* See if an object matches the query.
@@ -943,8 +1271,17 @@ namespace mongo {
         /* assuming there is usually only one thing to match.  if more this
            could be slow sometimes. */
 
+        // run the compiled predicates first, they may reject the document cheaply
+        MatchProgram::PredicateSet matched = 0;
+        if ( _program && !_program->run( jsobj, &matched ) ) {
+            return false;
+        }
+
         // check normal non-regex cases:
         for ( unsigned i = 0; i < _basics.size(); i++ ) {
+            if ( i < MatchProgram::MaxPredicates && ( matched & ( 1ULL << i ) ) ) {
+                continue;
+            }
             const ElementMatcher& bm = _basics[i];
             const BSONElement& m = bm._toMatch;
             // -1=mismatch. 0=missing element. 1=match
@@ -35,13 +35,32 @@ namespace mongo {
 
     class RegexMatcher {
     public:
+        /**
+         * How strings are matched.  Regexes that are plain literals, optionally anchored at the
+         * start and optionally case insensitive (for ASCII literals), avoid running pcre.
+         */
+        enum Kind {
+            PCRE,
+            PREFIX,
+            PREFIX_CASELESS,
+            SUBSTRING,
+            SUBSTRING_CASELESS
+        };
+
         const char *_fieldName;
         const char *_regex;
         const char *_flags;
-        string _prefix;
+        Kind _kind;
+        string _literal; // lower case for the caseless kinds
         shared_ptr< pcrecpp::RE > _re;
         bool _isNot;
-        RegexMatcher() : _isNot() {}
+        RegexMatcher() : _kind( PCRE ), _isNot() {}
+
+        /** Set _regex and _flags, compile the regex and choose _kind. */
+        void init( const char *regex, const char *flags );
+
+        /** @return true if str, up to its first NUL, matches the regex. */
+        bool matchesString( const char *str ) const;
     };
 
     class GeoMatcher {
@@ -223,6 +242,64 @@ namespace mongo {
         string _elemMatchKey;
     };
 
+    /**
+     * A flat program compiled once per Matcher from its simple top level predicates: non negated
+     * equality and $gt/$gte/$lt/$lte comparisons on field paths.
+     *
+     * run() makes a single pass over the top level fields of a document, resolves each distinct
+     * field path once however many predicates share it, and evaluates the predicates with
+     * comparisons specialized on the type of the query value, equalities first.  Each predicate
+     * is decided exactly as Matcher::matchesDotted() would decide it, except where an array is
+     * found along the path; those predicates are left to the interpreted path.
+     */
+    class MatchProgram : boost::noncopyable {
+    public:
+        /** A set of indexes into the Matcher's basics. */
+        typedef unsigned long long PredicateSet;
+        static const unsigned MaxPredicates = 64;
+        static const unsigned MaxTopFields = 16;
+
+        explicit MatchProgram( const vector<ElementMatcher> &basics );
+
+        bool empty() const { return _predicates.empty(); }
+
+        /**
+         * @return false if obj cannot match.  Otherwise, sets *matched to the basics that are
+         * known to match obj; the rest must still be checked by the caller.
+         */
+        bool run( const BSONObj &obj, PredicateSet *matched ) const;
+
+    private:
+        enum Kind {
+            NumberKind,
+            StringKind,
+            GenericKind
+        };
+
+        struct Path {
+            string dotted;
+            vector<string> components; // components[ 0 ] is _topFields[ topField ]
+            unsigned topField;
+        };
+
+        struct Predicate {
+            unsigned basic;
+            unsigned path;
+            int op;
+            BSONElement toMatch;
+            int canonicalType;
+            Kind kind;
+            bool matchesMissing; // missing values match a null query value
+        };
+
+        /** @return true if e satisfies p, which must not be missing or an array. */
+        static bool evaluate( const Predicate &p, const BSONElement &e );
+
+        vector<string> _topFields;
+        vector<Path> _paths;
+        vector<Predicate> _predicates;
+    };
+
     /* Match BSON objects against a query pattern.
 
        e.g.
@@ -348,6 +425,9 @@ namespace mongo {
         vector<RegexMatcher> _regexs;
         vector<GeoMatcher> _geo;
 
+        // compiled form of the simple predicates in _basics, if there are any
+        scoped_ptr<MatchProgram> _program;
+
         // so we delete the mem when we're done:
         vector< shared_ptr< BSONObjBuilder > > _builders;
         list< shared_ptr< Matcher > > _andMatchers;
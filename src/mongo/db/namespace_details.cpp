@@ -18,8 +18,10 @@
 #include "mongo/pch.h"
 
 #include <algorithm>
+#include <limits>
 #include <list>
 #include <map>
+#include <set>
 #include <vector>
 #include <utility>
 
@@ -29,15 +31,19 @@
 #include "mongo/base/units.h"
 #include "mongo/db/auth/action_type.h"
 #include "mongo/db/auth/authorization_manager.h"
+#include "mongo/db/capped_notifier.h"
+#include "mongo/db/commands/fsync.h"
 #include "mongo/db/cursor.h"
 #include "mongo/db/database.h"
 #include "mongo/db/databaseholder.h"
+#include "mongo/db/field_lookup_scope.h"
 #include "mongo/db/json.h"
 #include "mongo/db/namespacestring.h"
 #include "mongo/db/namespace_details.h"
 #include "mongo/db/query_optimizer.h"
 #include "mongo/db/oplog.h"
 #include "mongo/db/relock.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/txn_context.h"
 #include "mongo/db/ops/delete.h"
 #include "mongo/db/ops/insert.h"
@@ -46,8 +52,10 @@
 #include "mongo/db/storage/env.h"
 #include "mongo/db/storage/txn.h"
 #include "mongo/db/storage/key.h"
+#include "mongo/db/storage/update_diff.h"
 #include "mongo/platform/atomic_word.h"
 #include "mongo/scripting/engine.h"
+#include "mongo/util/background.h"
 #include "mongo/db/oplog_helpers.h"
 #include "mongo/db/repl/rs_optime.h"
 #include "mongo/db/repl/rs.h"
@@ -174,6 +182,19 @@ namespace mongo {
             newObj = inheritIdField(oldObj, newObj);
             NamespaceDetails::updateObject(pk, oldObj, newObj, flags);
         }
+
+        // clustering indexes store the row, and a hot index needs to see it
+        bool fastUpdatesOkay() const {
+            if (indexBuildInProgress()) {
+                return false;
+            }
+            for (int i = 1; i < _nIndexes; i++) {
+                if (_indexes[i]->clustering()) {
+                    return false;
+                }
+            }
+            return true;
+        }
     };
 
     class OplogCollection : public IndexedCollection {
@@ -359,8 +380,158 @@ namespace mongo {
                 dropIndex(idx);
             }
         }
+
+        // every new privilege document gets validated in updateObject
+        bool fastUpdatesOkay() const {
+            return false;
+        }
     };
 
+    // The number and total size of a capped collection's documents, saved with its
+    // serialized details so that opening it doesn't mean reading every document.
+    //
+    // Every so many documents there is a mark holding the number and size of the documents
+    // before it.  The last mark is the boundary, which is never past minUnsafeKey(), so the
+    // documents before it were committed when they were counted and stay as counted until
+    // they are trimmed.  Trimming only removes the oldest documents.  So given the oldest
+    // document left, the marks count everything from the first mark at or after it up to
+    // the boundary, and only the documents before that mark and past the boundary need to
+    // be read.
+    class CappedStats {
+    public:
+        CappedStats() : _n(0), _size(0), _sinceMark(0) { }
+
+        // @return the primary key of the last mark, which after advance() is the boundary
+        long long boundary() const {
+            return _marks.back().pk;
+        }
+
+        // @return the primary key of the first mark
+        long long firstMark() const {
+            return _marks.front().pk;
+        }
+
+        // Starts over, counting from pk on.
+        void reset(long long pk) {
+            _marks.clear();
+            _marks.push_back(Mark(pk, 0, 0));
+            _n = _size = 0;
+            _sinceMark = 0;
+        }
+
+        // Counts the next document, which must be past the last one counted.
+        void note(long long pk, long long size) {
+            if (_sinceMark >= MarkInterval) {
+                _marks.push_back(Mark(pk, _n, _size));
+                _sinceMark = 0;
+            }
+            _n++;
+            _size += size;
+            _sinceMark++;
+        }
+
+        // Moves the boundary to pk, every document before which has been counted.
+        void advance(long long pk) {
+            Mark &last = _marks.back();
+            if (last.n == _n) {
+                last.pk = pk;
+            }
+            else {
+                _marks.push_back(Mark(pk, _n, _size));
+                _sinceMark = 0;
+            }
+            if (_marks.size() > 2 * MaxMarks) {
+                // Keep every other mark, but always the first and the boundary.
+                vector<Mark> thinned;
+                for (size_t i = 0; i < _marks.size() - 1; i += 2) {
+                    thinned.push_back(_marks[i]);
+                }
+                thinned.push_back(_marks.back());
+                _marks.swap(thinned);
+            }
+        }
+
+        // Forgets the marks before first, the oldest document left, except the boundary.
+        void dropBefore(long long first) {
+            size_t i = 0;
+            while (i < _marks.size() - 1 && _marks[i].pk < first) {
+                i++;
+            }
+            _marks.erase(_marks.begin(), _marks.begin() + i);
+        }
+
+        // @return what the marks count between the first of them and the boundary
+        long long markedCount() const {
+            return _marks.back().n - _marks.front().n;
+        }
+        long long markedSize() const {
+            return _marks.back().size - _marks.front().size;
+        }
+
+        BSONObj toBSON() const {
+            BSONArrayBuilder marks;
+            for (vector<Mark>::const_iterator it = _marks.begin(); it != _marks.end(); ++it) {
+                marks.append(BSON("pk" << it->pk << "n" << it->n << "size" << it->size));
+            }
+            return BSON("marks" << marks.arr());
+        }
+
+        // Loads what toBSON() saved.  A bad saved form only costs a scan, so it is dropped.
+        // @return false if there was nothing usable
+        bool load(const BSONElement &saved) {
+            _marks.clear();
+            if (!saved.isABSONObj()) {
+                return false;
+            }
+            try {
+                const vector<BSONElement> marks = saved.Obj()["marks"].Array();
+                for (vector<BSONElement>::const_iterator it = marks.begin(); it != marks.end(); ++it) {
+                    const BSONObj m = it->Obj();
+                    const Mark mark(m["pk"].numberLong(), m["n"].numberLong(), m["size"].numberLong());
+                    uassert(17046, "capped collection stats are out of order",
+                            _marks.empty() || (mark.pk > _marks.back().pk && mark.n >= _marks.back().n));
+                    _marks.push_back(mark);
+                }
+            } catch (DBException &e) {
+                warning() << "ignoring saved stats for a capped collection: " << e.what() << endl;
+                _marks.clear();
+            }
+            if (_marks.empty()) {
+                return false;
+            }
+            _n = _marks.back().n;
+            _size = _marks.back().size;
+            _sinceMark = 0;
+            return true;
+        }
+
+    private:
+        // The most documents between marks until there are too many marks, and most marks kept.
+        static const long long MarkInterval = 1000;
+        static const size_t MaxMarks = 256;
+
+        struct Mark {
+            Mark(long long p, long long count, long long sz) : pk(p), n(count), size(sz) { }
+            long long pk;
+            // the number and size of the documents counted before pk
+            long long n;
+            long long size;
+        };
+        vector<Mark> _marks;
+        long long _n;
+        long long _size;
+        long long _sinceMark;
+    };
+
+    namespace {
+        // The open capped collections, for the CappedStatsSaver.  A namespace can be here twice
+        // for a moment while it is reopened.
+        SimpleMutex cappedNamespacesMutex("cappedNamespaces");
+        multiset<string> cappedNamespaces;
+
+        MONGO_EXPORT_SERVER_PARAMETER(cappedStatsSaveSecs, int, 30);
+    }
+
     // Capped collections have natural order insert semantics but borrow (ie: copy)
     // its document modification strategy from IndexedCollections. The size
     // and count of a capped collection is maintained in memory and kept valid
@@ -373,8 +544,12 @@ namespace mongo {
     // noted so we can properly maintain the min uncommitted key.
     //
     // In the implementation, NaturalOrderCollection::_nextPK and the set of
-    // uncommitted primary keys are protected together by _mutex. Trimming
-    // work is done under the _deleteMutex.
+    // uncommitted primary keys are protected together by _mutex, which a
+    // transaction only needs for its first insert.  Trimming work is done
+    // under the _deleteMutex.
+    //
+    // The size and count are saved with the serialized details (see CappedStats)
+    // so that opening the collection only reads the documents inserted since.
     class CappedCollection : public NaturalOrderCollection {
     public:
         CappedCollection(const StringData &ns, const BSONObj &options,
@@ -385,7 +560,12 @@ namespace mongo {
             _currentObjects(0),
             _currentSize(0),
             _mutex("cappedMutex"),
-            _deleteMutex("cappedDeleteMutex") {
+            _deleteMutex("cappedDeleteMutex"),
+            _statsMutex("cappedStatsMutex"),
+            _statsBoundary(0),
+            _recounted(0) {
+
+            _stats.reset(0);
 
             // Create an _id index if "autoIndexId" is missing or it exists as true.
             if (mayIndexId) {
@@ -395,6 +575,7 @@ namespace mongo {
                     createIndex(info);
                 }
             }
+            registerNs();
         }
         CappedCollection(const BSONObj &serialized) :
             NaturalOrderCollection(serialized),
@@ -403,25 +584,54 @@ namespace mongo {
             _currentObjects(0),
             _currentSize(0),
             _mutex("cappedMutex"),
-            _deleteMutex("cappedDeleteMutex") {
-            
-            // Determine the number of objects and the total size.
-            // We'll have to look at the data, but this might not be so bad because:
-            // - you pay for it once, on initialization.
-            // - capped collections are meant to be "small" (fit in memory)
-            // - capped collectiosn are meant to be "read heavy",
-            //   so bringing it all into memory now helps warmup.
+            _deleteMutex("cappedDeleteMutex"),
+            _statsMutex("cappedStatsMutex"),
+            _statsBoundary(0),
+            _recounted(0) {
+
+            // Determine the number of objects and the total size.  The saved stats count
+            // most of the documents, and only the ones they don't cover have to be read.
+            // Without any saved stats that's all of them, and the stats are built while
+            // we're at it.
             long long n = 0;
             long long size = 0;
             Client::Transaction txn(DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY);
-            for (shared_ptr<Cursor> c( BasicCursor::make(this) ); c->ok(); n++, c->advance()) {
-                size += c->current().objsize();
+            const long long first = firstPK();
+            if (first < 0) {
+                _stats.reset(_nextPK.load());
             }
+            else if (_stats.load(serialized["cappedStats"])) {
+                _stats.dropBefore(first);
+                countRange(first, _stats.firstMark(), n, size, NULL);
+                n += _stats.markedCount();
+                size += _stats.markedSize();
+                countRange(_stats.boundary(), std::numeric_limits<long long>::max(), n, size, &_stats);
+            }
+            else {
+                _stats.reset(first);
+                countRange(first, std::numeric_limits<long long>::max(), n, size, &_stats);
+            }
+            // Keys aren't reused below the boundary, even ones whose inserts aborted.
+            if (_nextPK.load() < _stats.boundary()) {
+                _nextPK = AtomicWord<long long>(_stats.boundary());
+            }
+            _stats.advance(_nextPK.load());
+            _statsBoundary = AtomicWord<long long>(_stats.boundary());
             txn.commit();
 
             _currentObjects = AtomicWord<long long>(n);
             _currentSize = AtomicWord<long long>(size);
             verify((_currentSize.load() > 0) == (_currentObjects.load() > 0));
+            registerNs();
+        }
+
+        ~CappedCollection() {
+            CappedNotifier::release(_ns, _notifier);
+            SimpleMutex::scoped_lock lk(cappedNamespacesMutex);
+            multiset<string>::iterator it = cappedNamespaces.find(_ns);
+            if (it != cappedNamespaces.end()) {
+                cappedNamespaces.erase(it);
+            }
         }
 
         void fillSpecificStats(BSONObjBuilder *result, int scale) const {
@@ -452,6 +662,34 @@ namespace mongo {
             return b.obj();
         }
 
+        // Count what was committed since the last time, up to boundaryKey, a minUnsafeKey()
+        // read before the caller's snapshot.  Reading it after would let an insert that commits
+        // in between fall below the boundary without being in the snapshot, uncounted.
+        bool refreshSavedStats(const BSONObj &boundaryKey) {
+            const long long boundary = boundaryKey.firstElement().Long();
+            SimpleMutex::scoped_lock lk(_statsMutex);
+            const unsigned belowBoundary = _belowBoundary.load();
+            const bool recount = belowBoundary != _recounted;
+            if (!recount && boundary <= _stats.boundary()) {
+                return false;
+            }
+            // Work on a copy, so a failed scan leaves the stats as they were.
+            CappedStats stats = _stats;
+            const long long first = firstPK();
+            if (recount) {
+                stats.reset(first < 0 ? boundary : first);
+            }
+            long long n = 0;
+            long long size = 0;
+            countRange(stats.boundary(), boundary, n, size, &stats);
+            stats.advance(boundary);
+            stats.dropBefore(first < 0 ? boundary : first);
+            _stats = stats;
+            _statsBoundary = AtomicWord<long long>(boundary);
+            _recounted = belowBoundary;
+            return true;
+        }
+
         // run an insertion where the PK is specified
         // Can come from the applier thread on a slave or a cloner 
         void insertObjectIntoCappedWithPK(BSONObj& pk, BSONObj& obj, uint64_t flags) {
@@ -460,6 +698,10 @@ namespace mongo {
             if (pkVal >= _nextPK.load()) {
                 _nextPK = AtomicWord<long long>(pkVal + 1);
             }
+            if (pkVal < _statsBoundary.load()) {
+                // The primary committed this out of order, after the stats counted past it.
+                _belowBoundary.fetchAndAdd(1);
+            }
 
             // Must note the uncommitted PK before we do the actual insert,
             // since we check the capped rollback data structure to see if
@@ -543,6 +785,11 @@ namespace mongo {
             _lastDeletedPK = BSONObj();
         }
 
+        void appendSerialized(BSONObjBuilder &b) const {
+            SimpleMutex::scoped_lock lk(_statsMutex);
+            b.append("cappedStats", _stats.toBSON());
+        }
+
     private:
         // requires: _mutex is held
         void noteUncommittedPK(const BSONObj &pk) {
@@ -557,21 +804,61 @@ namespace mongo {
         }
 
         BSONObj getNextPK() {
-            SimpleMutex::scoped_lock lk(_mutex);
             BSONObjBuilder b(32);
+            if (cc().txn().cappedRollback().hasNotedInsert(_ns)) {
+                // This transaction's first key already holds tailable cursors back, and
+                // every key it gets after that is bigger, so no lock is needed.
+                b.append("", _nextPK.fetchAndAdd(1));
+                return b.obj();
+            }
+            SimpleMutex::scoped_lock lk(_mutex);
             b.append("", _nextPK.fetchAndAdd(1));
             BSONObj pk = b.obj();
             noteUncommittedPK(pk);
             return pk;
         }
 
+        void registerNs() {
+            _notifier = CappedNotifier::get(_ns);
+            SimpleMutex::scoped_lock lk(cappedNamespacesMutex);
+            cappedNamespaces.insert(_ns);
+        }
+
+        // @return the primary key of the oldest document, or -1 if there are none
+        long long firstPK() {
+            shared_ptr<Cursor> c(BasicCursor::make(this));
+            return c->ok() ? c->currPK().firstElement().Long() : -1;
+        }
+
+        // Counts the documents with primary keys in [start, end), noting them in stats if given.
+        void countRange(long long start, long long end, long long &n, long long &size,
+                        CappedStats *stats) {
+            if (start >= end) {
+                return;
+            }
+            for (shared_ptr<Cursor> c(IndexCursor::make(this, getPKIndex(), BSON("" << start),
+                                                        BSON("" << end), false, 1));
+                 c->ok(); c->advance()) {
+                const long long objsize = c->current().objsize();
+                if (stats != NULL) {
+                    stats->note(c->currPK().firstElement().Long(), objsize);
+                }
+                n++;
+                size += objsize;
+            }
+        }
+
         // Note the completion of a transaction by removing its
-        // minimum-PK-inserted (if there is one) from the set.
+        // minimum-PK-inserted (if there is one) from the set, which
+        // may let tailable cursors read further.
         void noteComplete(const BSONObj &minPK) {
             if (!minPK.isEmpty()) {
-                SimpleMutex::scoped_lock lk(_mutex);
-                const int n = _uncommittedMinPKs.erase(minPK);
-                verify(n == 1);
+                {
+                    SimpleMutex::scoped_lock lk(_mutex);
+                    const int n = _uncommittedMinPKs.erase(minPK);
+                    verify(n == 1);
+                }
+                _notifier->notifyAll();
             }
         }
 
@@ -636,6 +923,7 @@ namespace mongo {
         }
 
         void trim(int objsize, bool logop) {
+            // Waits for any other trimmer, so each insert makes room for itself.
             SimpleMutex::scoped_lock lk(_deleteMutex);
             long long n = _currentObjects.load();
             long long size = _currentSize.load();
@@ -698,6 +986,13 @@ namespace mongo {
         BSONObjSet _uncommittedMinPKs;
         SimpleMutex _mutex;
         SimpleMutex _deleteMutex;
+        CappedStats _stats;
+        mutable SimpleMutex _statsMutex;
+        AtomicWord<long long> _statsBoundary;
+        // Replicated inserts below the boundary, and how many of them the stats have recounted.
+        AtomicUInt32 _belowBoundary;
+        unsigned _recounted;
+        shared_ptr<CappedNotifier> _notifier;
     };
 
     // Profile collections are non-replicated capped collections that
@@ -819,6 +1114,9 @@ namespace mongo {
         void updateObject(const BSONObj &pk, const BSONObj &oldObj, BSONObj &newObj, uint64_t flags = 0) {
             uasserted( 16866, "Cannot update a collection under-going bulk load." );
         }
+        bool fastUpdatesOkay() const {
+            return false;
+        }
         void empty() {
             uasserted( 16868, "Cannot empty a collection under-going bulk load." );
         }
@@ -856,6 +1154,311 @@ namespace mongo {
         scoped_ptr<storage::Loader> _loader;
     };
 
+    static BSONObj replaceNSField(const BSONObj &obj, const StringData &to);
+
+    // A PartitionedCollection keeps its documents in partitions, each a primary key dictionary
+    // of its own holding a range of primary keys, so that old data can be aged out by
+    // dropping a whole partition's dictionary instead of deleting (and replicating the delete
+    // of) every document in it. Partition i holds the primary keys in (max(i - 1), max(i)],
+    // and the last one's max is MaxKey, so new, larger keys (time ordered _ids) go to it.
+    //
+    // Each partition is opened as an IndexedCollection named <ns>$p<id>, which is not in the
+    // namespace index, so inserts, lookups and cursors work on it unchanged. The collection's
+    // own primary key dictionary stays empty; it is there so the query optimizer has an index
+    // to plan with, and cursors made over it go over the partitions instead (see cursor.cpp).
+    //
+    // There are no secondary indexes yet, since each would need a dictionary per partition
+    // and cursors that merge them.
+    class PartitionedCollection : public NamespaceDetails {
+    public:
+        PartitionedCollection(const StringData &ns, const BSONObj &options) :
+            NamespaceDetails(ns, fromjson("{\"_id\":1}"), options),
+            _nextPartitionId(0) {
+            try {
+                appendPartition(true);
+            }
+            catch (...) {
+                close();
+                throw;
+            }
+        }
+        PartitionedCollection(const BSONObj &serialized) :
+            NamespaceDetails(serialized),
+            _nextPartitionId(serialized["nextPartitionId"].numberLong()) {
+            vector<BSONElement> partitions = serialized["partitions"].Array();
+            for (vector<BSONElement>::const_iterator it = partitions.begin(); it != partitions.end(); ++it) {
+                const BSONObj p = it->Obj();
+                _partitions.push_back(Partition(p["_id"].numberLong(), p["max"].Obj().copy(),
+                                                p["createTime"].date(), openPartition(p["_id"].numberLong(), false)));
+            }
+            verify(!_partitions.empty());
+        }
+
+        void close(const bool aborting = false) {
+            for (vector<Partition>::iterator it = _partitions.begin(); it != _partitions.end(); ++it) {
+                it->details->close(aborting);
+            }
+            NamespaceDetails::close(aborting);
+        }
+
+        bool isPartitioned() const {
+            return true;
+        }
+        int nPartitions() const {
+            return _partitions.size();
+        }
+        NamespaceDetails &partition(int i) const {
+            return *_partitions[i].details;
+        }
+
+        bool mayFindById() const {
+            return true;
+        }
+        bool findById(const BSONObj &query, BSONObj &result) const {
+            dassert(query["_id"].ok());
+            const BSONObj pk = query["_id"].wrap("");
+            NamespaceDetails &p = partitionFor(pk);
+            const bool found = p.findByPK(pk, result);
+            p.getPKIndex().noteQuery(found ? 1 : 0, 0);
+            return found;
+        }
+        bool findByPK(const BSONObj &pk, BSONObj &result) const {
+            return partitionFor(pk).findByPK(pk, result);
+        }
+
+        void insertObject(BSONObj &obj, uint64_t flags) {
+            obj = addIdField(obj);
+            const BSONObj pk = obj["_id"].wrap("");
+            partitionFor(pk).insertObject(obj, flags);
+        }
+        void deleteObject(const BSONObj &pk, const BSONObj &obj, uint64_t flags) {
+            partitionFor(pk).deleteObject(pk, obj, flags);
+        }
+        void updateObject(const BSONObj &pk, const BSONObj &oldObj, BSONObj &newObj, uint64_t flags) {
+            partitionFor(pk).updateObject(pk, oldObj, newObj, flags);
+        }
+
+        void optimizeAll() {
+            for (vector<Partition>::const_iterator it = _partitions.begin(); it != _partitions.end(); ++it) {
+                it->details->optimizeAll();
+            }
+        }
+        void optimizePK(const BSONObj &leftPK, const BSONObj &rightPK) {
+            for (vector<Partition>::const_iterator it = _partitions.begin(); it != _partitions.end(); ++it) {
+                it->details->optimizePK(leftPK, rightPK);
+            }
+        }
+
+        bool dropIndexes(const StringData& ns, const StringData& name, string &errmsg,
+                         BSONObjBuilder &result, bool mayDeleteIdIndex) {
+            if (name == "*" && mayDeleteIdIndex) {
+                // dropping the collection
+                for (vector<Partition>::const_iterator it = _partitions.begin(); it != _partitions.end(); ++it) {
+                    removePartition(*it);
+                }
+                _partitions.clear();
+            }
+            return NamespaceDetails::dropIndexes(ns, name, errmsg, result, mayDeleteIdIndex);
+        }
+
+        BSONObj addPartition(const BSONObj &newMax) {
+            Lock::assertWriteLocked(_ns);
+            Partition &last = _partitions.back();
+            BSONObj lastPK;
+            {
+                shared_ptr<Cursor> c = BasicCursor::make(last.details.get(), -1);
+                if (c->ok()) {
+                    lastPK = c->currPK().getOwned();
+                }
+            }
+            BSONObj max;
+            if (newMax.isEmpty()) {
+                uassert( 17055, "the last partition is empty, give a newMax to add a partition",
+                                !lastPK.isEmpty() );
+                max = lastPK;
+            }
+            else {
+                max = newMax.firstElement().wrap("");
+                uassert( 17056, str::stream() << "newMax " << newMax.firstElement()
+                                << " must be at least the last partition's largest primary key "
+                                << lastPK.firstElement(),
+                                lastPK.isEmpty() || max.woCompare(lastPK) >= 0 );
+                uassert( 17057, str::stream() << "newMax " << newMax.firstElement()
+                                << " must be more than the previous partition's max",
+                                _partitions.size() == 1 ||
+                                max.woCompare(_partitions[_partitions.size() - 2].max) > 0 );
+            }
+
+            noteChange();
+            last.max = max;
+            appendPartition(true);
+            nsindex(_ns)->update_ns(_ns, serialize(), true);
+            return max;
+        }
+
+        void dropPartition(long long id) {
+            Lock::assertWriteLocked(_ns);
+            uassert( 17058, "cannot drop the only partition of a collection", _partitions.size() > 1 );
+            vector<Partition>::iterator it = _partitions.begin() + partitionIndex(id);
+
+            noteChange();
+            removePartition(*it);
+            it = _partitions.erase(it);
+            if (it == _partitions.end()) {
+                // the one before it takes everything after it
+                _partitions.back().max = maxKey;
+            }
+            nsindex(_ns)->update_ns(_ns, serialize(), true);
+        }
+
+        void getPartitionRange(long long id, BSONObj &min, BSONObj &max) const {
+            const size_t i = partitionIndex(id);
+            min = i == 0 ? minKey : _partitions[i - 1].max;
+            max = _partitions[i].max;
+        }
+
+        void clonePartitions(const BSONObj &partitionInfo) {
+            Lock::assertWriteLocked(_ns);
+            {
+                shared_ptr<Cursor> c = BasicCursor::make(_partitions.back().details.get(), 1);
+                uassert( 17068, str::stream() << "can only copy partitions into an empty collection, "
+                                << _ns << " has documents",
+                                _partitions.size() == 1 && !c->ok() );
+            }
+
+            noteChange();
+            removePartition(_partitions.back());
+            _partitions.clear();
+            vector<BSONElement> partitions = partitionInfo["partitions"].Array();
+            for (vector<BSONElement>::const_iterator it = partitions.begin(); it != partitions.end(); ++it) {
+                const BSONObj p = it->Obj();
+                const long long id = p["_id"].numberLong();
+                _partitions.push_back(Partition(id, p["max"].wrap("").getOwned(),
+                                                p["createTime"].date(), openPartition(id, true)));
+            }
+            verify(!_partitions.empty());
+            _partitions.back().max = maxKey;
+            _nextPartitionId = partitionInfo["nextPartitionId"].numberLong();
+            nsindex(_ns)->update_ns(_ns, serialize(), true);
+        }
+
+        void appendPartitionInfo(BSONObjBuilder &b) const {
+            b.append("numPartitions", (int) _partitions.size());
+            b.append("nextPartitionId", _nextPartitionId);
+            BSONArrayBuilder a(b.subarrayStart("partitions"));
+            for (vector<Partition>::const_iterator it = _partitions.begin(); it != _partitions.end(); ++it) {
+                BSONObjBuilder pb(a.subobjStart());
+                pb.append("_id", it->id);
+                pb.appendAs(it->max.firstElement(), "max");
+                pb.appendDate("createTime", it->createTime);
+                pb.doneFast();
+            }
+            a.doneFast();
+        }
+
+        void fillSpecificStats(BSONObjBuilder *result, int scale) const {
+            BSONArrayBuilder a(result->subarrayStart("partitions"));
+            for (vector<Partition>::const_iterator it = _partitions.begin(); it != _partitions.end(); ++it) {
+                IndexStats stats(it->details->getPKIndex());
+                BSONObjBuilder pb(a.subobjStart());
+                pb.append("_id", it->id);
+                pb.appendAs(it->max.firstElement(), "max");
+                pb.appendNumber("count", (long long) stats.getCount());
+                pb.appendNumber("size", (long long) stats.getDataSize() / scale);
+                pb.appendNumber("storageSize", (long long) stats.getStorageSize() / scale);
+                pb.doneFast();
+            }
+            a.doneFast();
+        }
+
+    protected:
+        void appendSerialized(BSONObjBuilder &b) const {
+            b.append("nextPartitionId", _nextPartitionId);
+            BSONArrayBuilder a(b.subarrayStart("partitions"));
+            for (vector<Partition>::const_iterator it = _partitions.begin(); it != _partitions.end(); ++it) {
+                a.append(BSON("_id" << it->id << "max" << it->max << "createTime" << it->createTime));
+            }
+            a.doneFast();
+        }
+
+    private:
+        struct Partition {
+            Partition(long long i, const BSONObj &m, Date_t t, const shared_ptr<NamespaceDetails> &d) :
+                id(i), max(m), createTime(t), details(d) {
+            }
+            long long id;
+            BSONObj max; // { "": <largest primary key> }
+            Date_t createTime;
+            shared_ptr<NamespaceDetails> details;
+        };
+
+        string partitionNs(long long id) const {
+            return str::stream() << _ns << "$p" << id;
+        }
+
+        // Opens (or creates) the dictionary of partition id, as a collection of its own.
+        shared_ptr<NamespaceDetails> openPartition(long long id, bool create) const {
+            const string ns = partitionNs(id);
+            const BSONObj info = replaceNSField(getPKIndex().info(), ns);
+            if (create) {
+                IndexDetails::make(info, true)->close();
+            }
+            BSONArrayBuilder indexes;
+            indexes.append(info);
+            return shared_ptr<NamespaceDetails>(new IndexedCollection(serialize(ns, BSONObj(), _pk, 0, indexes.arr())));
+        }
+
+        // Starts a new last partition, which takes every primary key past the one before it.
+        void appendPartition(bool create) {
+            const long long id = _nextPartitionId++;
+            _partitions.push_back(Partition(id, maxKey, jsTime(), openPartition(id, create)));
+        }
+
+        // Drops a partition's dictionary, without a trace in system.indexes, where partitions
+        // aren't listed.
+        static void removePartition(const Partition &p) {
+            const string dname = p.details->getPKIndex().indexNamespace();
+            p.details->close();
+            storage::db_remove(dname);
+            removeNamespaceFromCatalog(dname);
+        }
+
+        // Cursors remember partitions by position, and if the transaction aborts, the
+        // partitions go back to what the nsindex says.
+        void noteChange() {
+            ClientCursor::invalidate(_ns);
+            NamespaceIndexRollback &rollback = cc().txn().nsIndexRollback();
+            rollback.noteNs(_ns);
+        }
+
+        size_t partitionIndex(long long id) const {
+            size_t i = 0;
+            while (i < _partitions.size() && _partitions[i].id != id) {
+                i++;
+            }
+            uassert( 17059, str::stream() << "no partition with id " << id, i < _partitions.size() );
+            return i;
+        }
+
+        NamespaceDetails &partitionFor(const BSONObj &pk) const {
+            // the first partition whose max is at least pk
+            size_t lo = 0, hi = _partitions.size() - 1;
+            while (lo < hi) {
+                const size_t mid = (lo + hi) / 2;
+                if (_partitions[mid].max.woCompare(pk) < 0) {
+                    lo = mid + 1;
+                }
+                else {
+                    hi = mid;
+                }
+            }
+            return *_partitions[lo].details;
+        }
+
+        long long _nextPartitionId;
+        vector<Partition> _partitions;
+    };
+
     /* ------------------------------------------------------------------------- */
 
     BSONObj NamespaceDetails::indexInfo(const BSONObj &keyPattern, bool unique, bool clustering) const {
@@ -914,7 +1517,8 @@ namespace mongo {
         _indexBuildInProgress(false),
         _nIndexes(0),
         _multiKeyIndexBits(0),
-        _qcWriteCount(0) {
+        _qcWriteCount(0),
+        _qcDocumentCount(-1) {
 
         massert( 10356 ,  str::stream() << "invalid ns: " << ns , NamespaceString::validCollectionName(ns));
 
@@ -949,6 +1553,10 @@ namespace mongo {
             // We enforce the restriction because it's easier to implement. See SERVER-6937.
             uassert( 16852, "System profile must be a capped collection.", options["capped"].trueValue() );
             return shared_ptr<NamespaceDetails>(new ProfileCollection(ns, options));
+        } else if (options["partitioned"].trueValue()) {
+            uassert( 17050, "a partitioned collection cannot be capped or natural order",
+                            !options["capped"].trueValue() && !options["natural"].trueValue() );
+            return shared_ptr<NamespaceDetails>(new PartitionedCollection(ns, options));
         } else if (options["capped"].trueValue()) {
             return shared_ptr<NamespaceDetails>(new CappedCollection(ns, options));
         } else if (options["natural"].trueValue()) {
@@ -966,7 +1574,8 @@ namespace mongo {
         _indexBuildInProgress(false),
         _nIndexes(serialized["indexes"].Array().size()),
         _multiKeyIndexBits(static_cast<uint64_t>(serialized["multiKeyIndexBits"].Long())),
-        _qcWriteCount(0) {
+        _qcWriteCount(0),
+        _qcDocumentCount(-1) {
 
         std::vector<BSONElement> index_array = serialized["indexes"].Array();
         for (std::vector<BSONElement>::iterator it = index_array.begin(); it != index_array.end(); it++) {
@@ -974,6 +1583,9 @@ namespace mongo {
             _indexes.push_back(idx);
         }
         computeIndexKeys();
+        if (serialized.hasField("queryCache")) {
+            loadQueryCache(serialized["queryCache"].Obj());
+        }
     }
     shared_ptr<NamespaceDetails> NamespaceDetails::make(const BSONObj &serialized, const bool bulkLoad) {
         const StringData ns = serialized["ns"].Stringdata();
@@ -990,6 +1602,9 @@ namespace mongo {
         } else if (isProfileCollection(ns)) {
             massert( 16870, "bug: Should not bulk load the profile collection", !bulkLoad );
             return shared_ptr<NamespaceDetails>(new ProfileCollection(serialized));
+        } else if (serialized["options"]["partitioned"].trueValue()) {
+            massert( 17060, "bug: Should not bulk load partitioned collections", !bulkLoad );
+            return shared_ptr<NamespaceDetails>(new PartitionedCollection(serialized));
         } else if (serialized["options"]["capped"].trueValue()) {
             massert( 16871, "bug: Should not bulk load capped collections", !bulkLoad );
             return shared_ptr<NamespaceDetails>(new CappedCollection(serialized));
@@ -1029,7 +1644,10 @@ namespace mongo {
             IndexDetails &idx = *_indexes[i];
             indexes_array.append(idx.info());
         }
-        return serialize(_ns, _options, _pk, _multiKeyIndexBits, indexes_array.arr());
+        BSONObjBuilder b;
+        b.appendElements(serialize(_ns, _options, _pk, _multiKeyIndexBits, indexes_array.arr()));
+        appendSerialized(b);
+        return b.obj();
     }
 
     void NamespaceDetails::computeIndexKeys() {
@@ -1050,15 +1668,57 @@ namespace mongo {
         QueryCacheRWLock::Exclusive lk(this);
         _qcCache.clear();
         _qcWriteCount = 0;
+        _qcDocumentCount = -1;
+    }
+
+    long long NamespaceDetails::approxDocumentCount() const {
+        if (isPartitioned()) {
+            long long n = 0;
+            for (int i = 0; i < nPartitions(); i++) {
+                n += partition(i).approxDocumentCount();
+            }
+            return n;
+        }
+        DB_BTREE_STAT64 st;
+        getPKIndex().getStat64(&st);
+        return st.bt_nkeys;
+    }
+
+    // Plans are chosen by how many documents each candidate scans, so they
+    // stay good until the amount of data changes by a meaningful fraction.
+    // Writes that don't change the size (most updates) don't age the cache;
+    // a cached plan that has gone bad anyway is caught by the optimizer when
+    // it scans far more than the nscanned recorded for it.
+    bool NamespaceDetails::queryCacheDrifted(long long count) const {
+        if (_qcDocumentCount < 0) {
+            return false;
+        }
+        const long long drift = count > _qcDocumentCount ? count - _qcDocumentCount : _qcDocumentCount - count;
+        return drift > std::max(static_cast<long long>(QueryCacheCheckInterval), _qcDocumentCount / 10);
     }
 
     void NamespaceDetails::notifyOfWriteOp() {
         if ( _qcCache.empty() ) {
             return;
         }
-        if ( ++_qcWriteCount >= 100 ) {
-            clearQueryCache();
+        if ( ++_qcWriteCount < QueryCacheCheckInterval ) {
+            return;
+        }
+        _qcWriteCount = 0;
+        const long long count = approxDocumentCount();
+        if ( !queryCacheDrifted(count) ) {
+            return;
+        }
+
+        QueryCacheRWLock::Exclusive lk(this);
+        for (map<QueryPattern, CachedQueryPlan>::iterator it = _qcCache.begin(); it != _qcCache.end(); ) {
+            if (it->second.pinned()) {
+                ++it;
+            } else {
+                _qcCache.erase(it++);
+            }
         }
+        _qcDocumentCount = _qcCache.empty() ? -1 : count;
     }
 
     CachedQueryPlan NamespaceDetails::cachedQueryPlanForPattern( const QueryPattern &pattern ) {
@@ -1068,9 +1728,85 @@ namespace mongo {
 
     void NamespaceDetails::registerCachedQueryPlanForPattern( const QueryPattern &pattern,
                                             const CachedQueryPlan &cachedQueryPlan ) {
+        if ( cachedQueryPlan.indexKey().isEmpty() ) {
+            _qcCache.erase( pattern );
+            return;
+        }
+        map<QueryPattern, CachedQueryPlan>::const_iterator i = _qcCache.find( pattern );
+        if ( i != _qcCache.end() && i->second.pinned() && !cachedQueryPlan.pinned() ) {
+            return;
+        }
+        if ( _qcDocumentCount < 0 ) {
+            _qcDocumentCount = approxDocumentCount();
+        }
         _qcCache[ pattern ] = cachedQueryPlan;
     }
 
+    bool NamespaceDetails::cachedPlanIndexesExist(const BSONObj &indexKey) const {
+        const BSONElement first = indexKey.firstElement();
+        if (str::equals(first.fieldName(), "$natural")) {
+            return true;
+        }
+        if (str::equals(first.fieldName(), "$intersect")) {
+            if (first.type() != Array || first.Obj().isEmpty()) {
+                return false;
+            }
+            for (BSONObjIterator it(first.Obj()); it.more(); ) {
+                const BSONElement e = it.next();
+                if (e.type() != Object || findIndexByKeyPattern(e.Obj()) < 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return findIndexByKeyPattern(indexKey) >= 0;
+    }
+
+    BSONArray NamespaceDetails::queryCacheEntries() {
+        QueryCacheRWLock::Shared lk(this);
+        BSONArrayBuilder entries;
+        for (map<QueryPattern, CachedQueryPlan>::const_iterator it = _qcCache.begin(); it != _qcCache.end(); ++it) {
+            entries.append(BSON("pattern" << it->first.toBSON() << "plan" << it->second.toBSON()));
+        }
+        return entries.arr();
+    }
+
+    void NamespaceDetails::persistQueryCache() {
+        if (!Lock::isWriteLocked(_ns)) {
+            throw RetryWithWriteLock();
+        }
+        // Queries register plans under a read lock, but we hold the write lock.
+        const BSONArray entries = queryCacheEntries();
+        BSONObjBuilder b;
+        b.appendElements(serialize());
+        if (!entries.isEmpty()) {
+            b.append("queryCache", BSON("count" << _qcDocumentCount << "plans" << entries));
+        }
+        nsindex(_ns)->update_ns(_ns, b.done(), true);
+    }
+
+    // Load the plans saved by persistQueryCache(). Plans for indexes that no
+    // longer exist are skipped, as is everything if the saved form is bad:
+    // losing the cache only costs a plan race.
+    void NamespaceDetails::loadQueryCache(const BSONObj &saved) {
+        try {
+            vector<BSONElement> plans = saved["plans"].Array();
+            for (vector<BSONElement>::const_iterator it = plans.begin(); it != plans.end(); ++it) {
+                const BSONObj entry = it->Obj();
+                const CachedQueryPlan plan = CachedQueryPlan::fromBSON(entry["plan"].Obj());
+                if (!cachedPlanIndexesExist(plan.indexKey())) {
+                    continue;
+                }
+                _qcCache[QueryPattern::fromBSON(entry["pattern"].Obj())] = plan;
+            }
+            _qcDocumentCount = _qcCache.empty() ? -1 : saved["count"].numberLong();
+        } catch (DBException &e) {
+            warning() << "ignoring saved query plans for " << _ns << ": " << e.what() << endl;
+            _qcCache.clear();
+            _qcDocumentCount = -1;
+        }
+    }
+
     int NamespaceDetails::findByPKCallback(const DBT *key, const DBT *value, void *extra) {
         struct findByPKCallbackExtra *info = reinterpret_cast<findByPKCallbackExtra *>(extra);
         try {
@@ -1130,6 +1866,9 @@ namespace mongo {
         dassert(!pk.isEmpty());
         dassert(!obj.isEmpty());
 
+        // Key generation for every index looks at the same fields of obj.
+        FieldLookupScope lookupScope(obj);
+
         if (isSystemUsersCollection(_ns)) {
             uassertStatusOK(AuthorizationManager::checkValidPrivilegeDocument(nsToDatabaseSubstring(_ns), obj));
         }
@@ -1190,13 +1929,24 @@ namespace mongo {
         // Index usage accounting. If a key was generated for this 
         // operation, then the index was used, otherwise it wasn't.
         // The PK is always used, only secondarys may have keys generated.
+        // The PK gets exactly the src key and val, the others whatever was generated for them.
         getPKIndex().noteInsert();
+        getPKIndex().noteBytesWritten(src_key.size + src_val.size);
         for (int i = 0; i < n; i++) {
             const DBT_ARRAY *array = &keyArrays[i];
             if (array->size > 0) {
                 IndexDetails &idx = *_indexes[i];
                 dassert(!isPKIndex(idx));
                 idx.noteInsert();
+                long long bytes = 0;
+                for (uint32_t j = 0; j < array->size; j++) {
+                    bytes += array->dbts[j].size;
+                }
+                const DBT_ARRAY *vals = &valArrays[i];
+                for (uint32_t j = 0; j < vals->size; j++) {
+                    bytes += vals->dbts[j].size;
+                }
+                idx.noteBytesWritten(bytes);
             }
         }
     }
@@ -1205,6 +1955,8 @@ namespace mongo {
         dassert(!pk.isEmpty());
         dassert(!obj.isEmpty());
 
+        FieldLookupScope lookupScope(obj);
+
         const int n = nIndexesBeingBuilt();
         DB *dbs[n];
         storage::DBTArrays keyArrays(n);
@@ -1269,6 +2021,9 @@ namespace mongo {
         dassert(!oldObj.isEmpty());
         dassert(!newObj.isEmpty());
 
+        FieldLookupScope oldLookupScope(oldObj);
+        FieldLookupScope newLookupScope(newObj);
+
         if (isSystemUsersCollection(_ns)) {
             uassertStatusOK(AuthorizationManager::checkValidPrivilegeDocument(nsToDatabaseSubstring(_ns), newObj));
         }
@@ -1320,19 +2075,67 @@ namespace mongo {
             }
         }
 
+        // When the update left the document's fields in place, send the primary key a diff
+        // instead of the whole new row; storage::update_callback applies it.  Not while an
+        // index is being built, since the indexer needs to see full rows.
+        const BSONObj diff = storage::updateDiffs && n == _nIndexes ?
+                             storage::computeUpdateDiff(oldObj, newObj) : BSONObj();
+
         // The pk doesn't change, so old_src_key == new_src_key.
         DB_ENV *env = storage::env;
-        const int r = env->update_multiple(env, dbs[0], cc().txn().db_txn(),
-                                           &src_key, &old_src_val,
-                                           &src_key, &new_src_val,
-                                           n, dbs, update_flags,
-                                           n * 2, keyArrays.arrays(), n, valArrays.arrays());
+        int r;
+        // Only the pk's share is counted, the secondaries' keys aren't known here.
+        long long pkBytesWritten = src_key.size;
+        if (diff.isEmpty()) {
+            pkBytesWritten += new_src_val.size;
+            r = env->update_multiple(env, dbs[0], cc().txn().db_txn(),
+                                     &src_key, &old_src_val,
+                                     &src_key, &new_src_val,
+                                     n, dbs, update_flags,
+                                     n * 2, keyArrays.arrays(), n, valArrays.arrays());
+        } else {
+            const BSONObj msg = storage::diffUpdateMessage(diff);
+            DBT extra = storage::dbt_make(msg.objdata(), msg.objsize());
+            pkBytesWritten += extra.size;
+            r = dbs[0]->update(dbs[0], cc().txn().db_txn(), &src_key, &extra, update_flags[0]);
+            if (r == 0 && n > 1) {
+                // The secondary indexes still get the full images, to generate their keys.
+                r = env->update_multiple(env, dbs[0], cc().txn().db_txn(),
+                                         &src_key, &old_src_val,
+                                         &src_key, &new_src_val,
+                                         n - 1, dbs + 1, update_flags + 1,
+                                         (n - 1) * 2, keyArrays.arrays(),
+                                         n - 1, valArrays.arrays());
+            }
+        }
         if (r == EINVAL) {
             uasserted( 16908, str::stream() << "Indexed insertion (on update) failed." <<
                               " This may be due to keys > 32kb. Check the error log." );
         } else if (r != 0) {
             storage::handle_ydb_error(r);
         }
+        getPKIndex().noteBytesWritten(pkBytesWritten);
+    }
+
+    void NamespaceDetails::updateObjectMods(const BSONObj &pk, const BSONObj &updateobj, uint64_t flags) {
+        TOKULOG(4) << "NamespaceDetails::updateObjectMods pk "
+            << pk << ", mods " << updateobj << endl;
+
+        dassert(!pk.isEmpty());
+        dassert(fastUpdatesOkay());
+
+        const BSONObj msg = storage::modsUpdateMessage(updateobj);
+        storage::Key sPK(pk, NULL);
+        DBT key = storage::dbt_make(sPK.buf(), sPK.size());
+        DBT extra = storage::dbt_make(msg.objdata(), msg.objsize());
+        DB *db = getPKIndex().db();
+        const bool prelocked = flags & NamespaceDetails::NO_LOCKTREE;
+        const int r = db->update(db, cc().txn().db_txn(), &key, &extra,
+                                 prelocked ? DB_PRELOCKED_WRITE : 0);
+        if (r != 0) {
+            storage::handle_ydb_error(r);
+        }
+        getPKIndex().noteBytesWritten(key.size + extra.size);
     }
 
     void NamespaceDetails::setIndexIsMultikey(const int idxNum) {
@@ -1492,11 +2295,15 @@ namespace mongo {
         uint64_t pkStorageSize = 0;
         uint64_t totalIndexDataSize = 0;
         uint64_t totalIndexStorageSize = 0;
+        uint64_t bytesRead = 0;
+        uint64_t bytesWritten = 0;
         BSONArrayBuilder index_info;
         for (uint32_t i = 0; i < numIndexes; i++) {
             IndexDetails &idx = *_indexes[i];
             IndexStats stats(idx);
             index_info.append(stats.obj(scale));
+            bytesRead += stats.getBytesRead();
+            bytesWritten += stats.getBytesWritten();
             if (isPKIndex(idx)) {
                 verify(collectionCount == 0);
                 collectionCount = stats.getCount();
@@ -1509,6 +2316,16 @@ namespace mongo {
             }
         }
 
+        // a partitioned collection's documents are in its partitions' primary keys
+        for (int i = 0; isPartitioned() && i < nPartitions(); i++) {
+            IndexStats stats(partition(i).getPKIndex());
+            collectionCount += stats.getCount();
+            pkDataSize += stats.getDataSize();
+            pkStorageSize += stats.getStorageSize();
+            bytesRead += stats.getBytesRead();
+            bytesWritten += stats.getBytesWritten();
+        }
+
         accStats->count = collectionCount;
         result->appendNumber("count", (long long) accStats->count);
 
@@ -1527,6 +2344,10 @@ namespace mongo {
         accStats->indexStorageSize = totalIndexStorageSize;
         result->appendNumber("totalIndexStorageSize", (long long) totalIndexStorageSize/scale);
 
+        // not scaled, like the per-index counters in indexDetails
+        result->appendNumber("bytesRead", (long long) bytesRead);
+        result->appendNumber("bytesWritten", (long long) bytesWritten);
+
         result->append("indexDetails", index_info.arr());        
 
         fillSpecificStats(result, scale);
@@ -1737,6 +2558,8 @@ namespace mongo {
                         from != cc().bulkLoadNS() );
         uassert( 16918, "Cannot rename a collection with a background index build in progress",
                         !from_details->indexBuildInProgress() );
+        uassert( 17061, "Cannot rename a partitioned collection",
+                        !from_details->isPartitioned() );
 
         // Kill open cursors before we close and rename the namespace
         ClientCursor::invalidate( from );
@@ -1836,6 +2659,8 @@ namespace mongo {
                         !options["capped"].trueValue() );
         uassert( 17000, "Cannot bulk load a natural order collection",
                         !options["natural"].trueValue() );
+        uassert( 17062, "Cannot bulk load a partitioned collection",
+                        !options["partitioned"].trueValue() );
 
         // Don't log the create. The begin/commit/abort load commands are already logged.
         string errmsg;
@@ -1903,4 +2728,84 @@ namespace mongo {
         return false;
     }
 
+    // Saves the stats of each open capped collection that has had documents committed to it
+    // since the last time, so that reopening it, even after a crash, reads little more than
+    // what was inserted since.  Counting happens under a read lock, and only the write to the
+    // nsdb needs the write lock.
+    class CappedStatsSaver : public BackgroundJob {
+    public:
+        virtual string name() const { return "CappedStatsSaver"; }
+
+        virtual void run() {
+            Client::initThread(name().c_str());
+
+            while (!inShutdown()) {
+                sleepsecs(std::max(cappedStatsSaveSecs, 1));
+
+                if (lockedForWriting()) {
+                    continue;
+                }
+
+                set<string> namespaces;
+                {
+                    SimpleMutex::scoped_lock lk(cappedNamespacesMutex);
+                    namespaces.insert(cappedNamespaces.begin(), cappedNamespaces.end());
+                }
+                for (set<string>::const_iterator it = namespaces.begin(); it != namespaces.end(); ++it) {
+                    try {
+                        save(*it);
+                    }
+                    catch (DBException &e) {
+                        LOG(1) << "couldn't save the stats of capped collection " << *it << ": "
+                               << e.what() << endl;
+                    }
+                }
+            }
+        }
+
+    private:
+        static void save(const string &ns) {
+            {
+                Lock::DBRead lk(ns);
+                if (!dbHolder().__isLoaded(ns, dbpath)) {
+                    return;
+                }
+                Client::Context ctx(ns);
+                NamespaceDetails *d;
+                {
+                    Client::Transaction txn(DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY);
+                    d = nsindex(ns)->find_ns(ns);
+                    if (d == NULL || !d->isCapped()) {
+                        return;
+                    }
+                    txn.commit();
+                }
+                // before the snapshot, see refreshSavedStats()
+                const BSONObj boundary = d->minUnsafeKey();
+                Client::Transaction txn(DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY);
+                if (!d->refreshSavedStats(boundary)) {
+                    return;
+                }
+                txn.commit();
+            }
+
+            Lock::DBWrite lk(ns);
+            if (!dbHolder().__isLoaded(ns, dbpath)) {
+                return;
+            }
+            Client::Context ctx(ns);
+            Client::Transaction txn(DB_SERIALIZABLE);
+            NamespaceDetails *d = nsindex(ns)->find_ns(ns);
+            if (d != NULL && d->isCapped()) {
+                nsindex(ns)->update_ns(ns, d->serialize(), true);
+                txn.commit();
+            }
+        }
+    };
+
+    void startCappedStatsBackgroundJob() {
+        CappedStatsSaver *saver = new CappedStatsSaver();
+        saver->go();
+    }
+
 } // namespace mongo
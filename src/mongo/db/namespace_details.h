@@ -114,17 +114,45 @@ namespace mongo {
             return _indexKeys;
         }
 
+        // Drop every cached plan, pinned or not. Used when the indexes change.
         void clearQueryCache();
 
         /* you must notify the query cache if you are doing writes,
-         * as the query plan utility may change */
+         * as the query plan utility may change.
+         * Unpinned plans are dropped once the collection's size has drifted
+         * far enough from what it was when they were cached. */
         void notifyOfWriteOp();
 
         CachedQueryPlan cachedQueryPlanForPattern( const QueryPattern &pattern );
 
+        // Registering a plan with an empty index key removes the entry, even a pinned one.
+        // Otherwise a pinned entry is only replaced by another pinned plan.
         void registerCachedQueryPlanForPattern( const QueryPattern &pattern,
                                                 const CachedQueryPlan &cachedQueryPlan );
 
+        // @return true if the indexes a cached plan's index key refers to all exist. The key is
+        // { $natural: 1 }, an index key pattern, or { $intersect: [ <key pattern>, ... ] }.
+        bool cachedPlanIndexesExist(const BSONObj &indexKey) const;
+
+        // @return the cached plans as an array of { pattern: ..., plan: ... } objects
+        BSONArray queryCacheEntries();
+
+        // Write the cached plans into this collection's entry in the system catalog,
+        // so they are loaded again the next time the collection is opened.
+        // Any later change to the catalog entry (such as an index build or drop)
+        // discards the saved plans.
+        void persistQueryCache();
+
+        // @return the primary key dictionary's estimate of the number of documents.
+        long long approxDocumentCount() const;
+
+        // @return a document count for planning queries: the one the query cache keeps, which
+        // notifyOfWriteOp() holds within its drift limit, or approxDocumentCount() if the
+        // cache is empty.
+        long long queryCacheDocumentCount() const {
+            return _qcDocumentCount >= 0 ? _qcDocumentCount : approxDocumentCount();
+        }
+
         class QueryCacheRWLock : boost::noncopyable {
         public:
             QueryCacheRWLock() : _lk("queryCache") { }
@@ -277,7 +305,7 @@ namespace mongo {
         bool findOne(const BSONObj &query, BSONObj &result, const bool requireIndex = false) const;
 
         // Find by primary key (single element bson object, no field name).
-        bool findByPK(const BSONObj &pk, BSONObj &result) const;
+        virtual bool findByPK(const BSONObj &pk, BSONObj &result) const;
 
         // return true if this namespace has an index on the _id field.
         bool hasIdIndex() const {
@@ -308,6 +336,51 @@ namespace mongo {
             return false;
         }
 
+        // optional to implement, return true if the namespace keeps its documents in partitions,
+        // each its own primary key dictionary covering a range of primary keys
+        virtual bool isPartitioned() const {
+            return false;
+        }
+
+        // For partitioned collections: the partitions, in primary key order, each as a
+        // collection of its own. Cursors over the primary key go over them in turn.
+        virtual int nPartitions() const {
+            return 1;
+        }
+        virtual NamespaceDetails &partition(int i) const {
+            msgasserted( 17051, "bug: should not call partition() on a collection that is not partitioned" );
+        }
+
+        // For partitioned collections: close off the last partition at newMax, or at the largest
+        // primary key in it if newMax is empty, and start a new last partition after it.
+        // @return the max the closed off partition got
+        virtual BSONObj addPartition(const BSONObj &newMax) {
+            uasserted( 17052, str::stream() << _ns << " is not a partitioned collection" );
+        }
+
+        // For partitioned collections: drop a partition, and every document in it, by its id.
+        virtual void dropPartition(long long id) {
+            uasserted( 17053, str::stream() << _ns << " is not a partitioned collection" );
+        }
+
+        // For partitioned collections: describe each partition, for getPartitionInfo.
+        virtual void appendPartitionInfo(BSONObjBuilder &b) const {
+            uasserted( 17054, str::stream() << _ns << " is not a partitioned collection" );
+        }
+
+        // For partitioned collections: the primary keys partition id holds, (min, max], with
+        // min as { "": MinKey } for the first partition.
+        virtual void getPartitionRange(long long id, BSONObj &min, BSONObj &max) const {
+            uasserted( 17065, str::stream() << _ns << " is not a partitioned collection" );
+        }
+
+        // For partitioned collections: replace the one, empty partition of a new collection
+        // with the partitions described by partitionInfo (getPartitionInfo's output), ids
+        // included, so a copy of a collection can replay the source's dropPartitions.
+        virtual void clonePartitions(const BSONObj &partitionInfo) {
+            uasserted( 17066, str::stream() << _ns << " is not a partitioned collection" );
+        }
+
         // optional to implement, return the minimum key a tailable cursor
         // may not read (at the time of this call) to guaruntee that all keys
         // strictly less than the minUnsafeKey is either committed or aborted.
@@ -315,6 +388,15 @@ namespace mongo {
             massert(16864, "bug: should not call minUnsafeKey for collection that is not Oplog or capped", false);
         }
 
+        // optional to implement, bring the statistics saved by serialize() up to date, counting
+        // up to boundary.  Only capped collections save any, so they can open without a scan.
+        // boundary must be a minUnsafeKey() read before the caller's snapshot transaction
+        // began, so that everything committed below it is in the snapshot.
+        // @return true if serialize() has something new to save
+        virtual bool refreshSavedStats(const BSONObj &boundary) {
+            return false;
+        }
+
         // Hack for ops/query.cpp queryIdHack.
         // Lets us know if findById is okay to do. We should find a nicer way to do this eventually.
         // Even though a capped collection may have an _id index, it may not use the findById code path.
@@ -336,6 +418,16 @@ namespace mongo {
         // update an object in the namespace by pk, replacing oldObj with newObj
         virtual void updateObject(const BSONObj &pk, const BSONObj &oldObj, BSONObj &newObj, uint64_t flags = 0);
 
+        // optional to implement, return true if updateObjectMods() may be used, which needs
+        // every index but the primary key to be unaffected by the mods and to not store rows
+        virtual bool fastUpdatesOkay() const {
+            return false;
+        }
+
+        // update an object in the namespace by pk, applying mods to it without reading it first.
+        // the caller checks that the mods don't touch any indexed field.
+        void updateObjectMods(const BSONObj &pk, const BSONObj &updateobj, uint64_t flags = 0);
+
         // remove everything from a collection
         virtual void empty();
 
@@ -441,6 +533,10 @@ namespace mongo {
         // generate an index info BSON for this namespace, with the same options
         BSONObj indexInfo(const BSONObj &keyPattern, bool unique, bool clustering) const;
 
+        // optional to implement, append state of the implementation's own to serialize()
+        virtual void appendSerialized(BSONObjBuilder &b) const {
+        }
+
         // fill the statistics for each index in the NamespaceDetails,
         // indexStats is an array of length nIndexes
         void fillIndexStats(std::vector<IndexStats> &indexStats) const;
@@ -469,7 +565,11 @@ namespace mongo {
         void computeIndexKeys();
 
         /* query cache (for query optimizer) */
+        static const int QueryCacheCheckInterval = 100;
+        bool queryCacheDrifted(long long count) const;
+        void loadQueryCache(const BSONObj &saved);
         int _qcWriteCount;
+        long long _qcDocumentCount; // approximate count when the cache was populated, or -1
         map<QueryPattern, CachedQueryPlan> _qcCache;
 
         struct findByPKCallbackExtra {
@@ -595,6 +695,9 @@ namespace mongo {
         SimpleRWLock _openRWLock;
     };
 
+    // Periodically saves the statistics of open capped collections (see refreshSavedStats()).
+    void startCappedStatsBackgroundJob();
+
     // Gets the namespace objects for this client threads' current database.
     NamespaceIndex *nsindex(const StringData& ns);
     NamespaceDetails *nsdetails(const StringData& ns);
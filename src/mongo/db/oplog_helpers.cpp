@@ -25,6 +25,7 @@
 #include "mongo/db/ops/delete.h"
 #include "mongo/db/ops/insert.h"
 #include "mongo/db/repl/rs.h"
+#include "mongo/db/storage/update_diff.h"
 
 
 #define KEY_STR_OP_NAME "op"
@@ -35,6 +36,9 @@
 #define KEY_STR_PK "pk"
 #define KEY_STR_COMMENT "o"
 #define KEY_STR_MIGRATE "fromMigrate"
+#define KEY_STR_DIFF "d"
+#define KEY_STR_ROLLBACK_DIFF "rd"
+#define KEY_STR_MODS "o"
 
 namespace mongo {
 namespace OpLogHelpers{
@@ -116,12 +120,36 @@ namespace OpLogHelpers{
         ) 
     {
         bool logForSharding = !fromMigrate && shouldLogTxnUpdateOpForSharding(OP_STR_UPDATE, ns, oldRow, newRow);
-        if (logTxnOpsForReplication() || logForSharding) {
-            BSONObjBuilder b;
+        bool logForReplication = logTxnOpsForReplication();
+        if (logForReplication || logForSharding) {
             if (isLocalNs(ns)) {
                 return;
             }
 
+            // An update that left the row's fields in place (most $inc and $set updates) goes
+            // to the replication log as a diff each way instead of both full images.  Migrations
+            // read the sharding log, which always gets the full images.
+            if (logForReplication && storage::updateDiffs) {
+                const BSONObj diff = storage::computeUpdateDiff(oldRow, newRow);
+                const BSONObj rollbackDiff = diff.isEmpty() ? BSONObj() :
+                                             storage::computeUpdateDiff(newRow, oldRow);
+                if (!rollbackDiff.isEmpty()) {
+                    BSONObjBuilder b;
+                    appendOpType(OP_STR_UPDATE_DIFF, &b);
+                    appendNsStr(ns, &b);
+                    appendMigrate(fromMigrate, &b);
+                    b.append(KEY_STR_PK, pk);
+                    b.append(KEY_STR_DIFF, diff);
+                    b.append(KEY_STR_ROLLBACK_DIFF, rollbackDiff);
+                    txn->logOpForReplication(b.obj());
+                    logForReplication = false;
+                }
+            }
+            if (!logForReplication && !logForSharding) {
+                return;
+            }
+
+            BSONObjBuilder b;
             appendOpType(OP_STR_UPDATE, &b);
             appendNsStr(ns, &b);
             appendMigrate(fromMigrate, &b);
@@ -129,7 +157,7 @@ namespace OpLogHelpers{
             b.append(KEY_STR_OLD_ROW, oldRow);
             b.append(KEY_STR_NEW_ROW, newRow);
             BSONObj logObj = b.obj();
-            if (logTxnOpsForReplication()) {
+            if (logForReplication) {
                 txn->logOpForReplication(logObj);
             }
             if (logForSharding) {
@@ -138,6 +166,25 @@ namespace OpLogHelpers{
         }
     }
 
+    // A fast update never read the row, so there are no images to log, only the mods.
+    // Sharding doesn't get these: mayUpdateFast() turns fast updates off while a chunk
+    // migration is logging ops (logTxnOpsForSharding()), and a migration that starts
+    // later clones the rows with the mods already applied, so it never needs them.
+    void logUpdateMods(const char* ns, const BSONObj& pk, const BSONObj& mods, TxnContext* txn) {
+        if (logTxnOpsForReplication()) {
+            BSONObjBuilder b;
+            if (isLocalNs(ns)) {
+                return;
+            }
+
+            appendOpType(OP_STR_UPDATE_MODS, &b);
+            appendNsStr(ns, &b);
+            b.append(KEY_STR_PK, pk);
+            b.append(KEY_STR_MODS, mods);
+            txn->logOpForReplication(b.obj());
+        }
+    }
+
     void logDelete(const char* ns, BSONObj row, bool fromMigrate, TxnContext* txn) {
         bool logForSharding = !fromMigrate && shouldLogTxnOpForSharding(OP_STR_DELETE, ns, row);
         if (logTxnOpsForReplication() || logForSharding) {
@@ -398,6 +445,74 @@ namespace OpLogHelpers{
         }        
     }
 
+    static void runUpdateDiffFromOplogWithLock(const char* ns, BSONObj op, bool isRollback) {
+        NamespaceDetails* nsd = nsdetails(ns);
+        const char *names[] = {
+            KEY_STR_PK,
+            KEY_STR_DIFF,
+            KEY_STR_ROLLBACK_DIFF
+            };
+        BSONElement fields[3];
+        op.getFields(3, names, fields);
+        BSONObj pk = fields[0].Obj();
+        // in rollback, the row has the update applied and we apply the reverse diff
+        BSONObj diff = isRollback ? fields[2].Obj() : fields[1].Obj();
+
+        BSONObj oldRow;
+        const bool found = nsd->findByPK(pk, oldRow);
+        massert(17027, str::stream() << "could not find row " << pk << " in " << ns <<
+                       " to apply update diff", found);
+        BSONObj newRow = storage::applyUpdateDiff(oldRow, diff);
+        uint64_t flags = (NamespaceDetails::NO_UNIQUE_CHECKS | NamespaceDetails::NO_LOCKTREE);
+        updateOneObject(nsd, pk, oldRow, newRow, LogOpUpdateDetails(), flags);
+    }
+    static void runUpdateDiffFromOplog(const char* ns, BSONObj op, bool isRollback) {
+        try {
+            Client::ReadContext ctx(ns);
+            runUpdateDiffFromOplogWithLock(ns, op, isRollback);
+        }
+        catch (RetryWithWriteLock &e) {
+            Client::WriteContext ctx(ns);
+            runUpdateDiffFromOplogWithLock(ns, op, isRollback);
+        }
+    }
+
+    static void runUpdateModsFromOplogWithLock(const char* ns, BSONObj op) {
+        NamespaceDetails* nsd = nsdetails(ns);
+        BSONObj pk = op[KEY_STR_PK].Obj();
+        BSONObj mods = op[KEY_STR_MODS].Obj();
+        uint64_t flags = (NamespaceDetails::NO_UNIQUE_CHECKS | NamespaceDetails::NO_LOCKTREE);
+        if (nsd->fastUpdatesOkay()) {
+            nsd->updateObjectMods(pk, mods, flags);
+            nsd->notifyOfWriteOp();
+        }
+        else {
+            // This member is building an index, so read the row and update it with both
+            // images, dropping mods that don't apply just as the message would have.
+            BSONObj oldRow;
+            BSONObj newRow;
+            if (nsd->findByPK(pk, oldRow) &&
+                storage::applyUpdateMessage(oldRow, storage::modsUpdateMessage(mods), newRow)) {
+                updateOneObject(nsd, pk, oldRow, newRow, LogOpUpdateDetails(), flags);
+            }
+        }
+    }
+    static void runUpdateModsFromOplog(const char* ns, BSONObj op) {
+        try {
+            Client::ReadContext ctx(ns);
+            runUpdateModsFromOplogWithLock(ns, op);
+        }
+        catch (RetryWithWriteLock &e) {
+            Client::WriteContext ctx(ns);
+            runUpdateModsFromOplogWithLock(ns, op);
+        }
+    }
+
+    static void rollbackUpdateModsFromOplog(const char* ns, BSONObj op) {
+        log() << "Cannot rollback fast update " << op << rsLog;
+        throw RollbackOplogException(str::stream() << "Could not rollback fast update " << op[KEY_STR_MODS] << " on ns " << ns);
+    }
+
     static void runCommandFromOplog(const char* ns, BSONObj op) {
         BufBuilder bb;
         BSONObjBuilder ob;
@@ -432,6 +547,14 @@ namespace OpLogHelpers{
             opCounters->gotUpdate();
             runUpdateFromOplog(ns, op, false);
         }
+        else if (strcmp(opType, OP_STR_UPDATE_DIFF) == 0) {
+            opCounters->gotUpdate();
+            runUpdateDiffFromOplog(ns, op, false);
+        }
+        else if (strcmp(opType, OP_STR_UPDATE_MODS) == 0) {
+            opCounters->gotUpdate();
+            runUpdateModsFromOplog(ns, op);
+        }
         else if (strcmp(opType, OP_STR_DELETE) == 0) {
             opCounters->gotDelete();
             runDeleteFromOplog(ns, op);
@@ -483,6 +606,12 @@ namespace OpLogHelpers{
         else if (strcmp(opType, OP_STR_UPDATE) == 0) {
             runUpdateFromOplog(ns, op, true);
         }
+        else if (strcmp(opType, OP_STR_UPDATE_DIFF) == 0) {
+            runUpdateDiffFromOplog(ns, op, true);
+        }
+        else if (strcmp(opType, OP_STR_UPDATE_MODS) == 0) {
+            rollbackUpdateModsFromOplog(ns, op);
+        }
         else if (strcmp(opType, OP_STR_DELETE) == 0) {
             // the rollback of a delete is to do the insert
             runInsertFromOplog(ns, op);
@@ -30,6 +30,8 @@ namespace OpLogHelpers{
     static const char OP_STR_INSERT[] = "i";
     static const char OP_STR_CAPPED_INSERT[] = "ci";
     static const char OP_STR_UPDATE[] = "u";
+    static const char OP_STR_UPDATE_DIFF[] = "ud"; // an update logged as a diff, see logUpdate
+    static const char OP_STR_UPDATE_MODS[] = "ur"; // a fast update, logged as its mods
     static const char OP_STR_DELETE[] = "d";
     static const char OP_STR_CAPPED_DELETE[] = "cd";
     static const char OP_STR_COMMENT[] = "n";
@@ -39,6 +41,7 @@ namespace OpLogHelpers{
     void logInsert(const char* ns, BSONObj row, TxnContext* txn);    
     void logInsertForCapped(const char* ns, BSONObj pk, BSONObj row, TxnContext* txn);
     void logUpdate(const char* ns, const BSONObj& pk, const BSONObj& oldRow, const BSONObj& newRow, bool fromMigrate, TxnContext* txn);
+    void logUpdateMods(const char* ns, const BSONObj& pk, const BSONObj& mods, TxnContext* txn);
     void logDelete(const char* ns, BSONObj row, bool fromMigrate, TxnContext* txn);
     void logDeleteForCapped(const char* ns, BSONObj pk, BSONObj row, TxnContext* txn);
     void logCommand(const char* ns, BSONObj row, TxnContext* txn);
@@ -35,7 +35,7 @@ namespace mongo {
         d->notifyOfWriteOp();
     }
     
-    long long _deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop) {
+    static long long deleteMatching(const char *ns, const BSONObj &pattern, long long limit, bool logop) {
         NamespaceDetails *d = nsdetails( ns );
         if ( ! d )
             return 0;
@@ -80,18 +80,22 @@ namespace mongo {
             deleteOneObject(d, pk, obj);
             nDeleted++;
 
-            if ( justOne ) {
+            if ( nDeleted == limit ) {
                 break;
             }
         }
         return nDeleted;
     }
 
+    long long _deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop) {
+        return deleteMatching(ns, pattern, justOne ? 1 : 0, logop);
+    }
+
     /* ns:      namespace, e.g. <database>.<collection>
        pattern: the "where" clause / criteria
-       justOne: stop after 1 match
+       limit:   stop after this many, or 0 for no limit
     */
-    long long deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop) {
+    long long deleteObjectsUpTo(const char *ns, BSONObj pattern, long long limit, bool logop) {
         if ( NamespaceString::isSystem(ns) ) {
             /* note a delete from system.indexes would corrupt the db
                if done here, as there are pointers into those objects in
@@ -104,8 +108,12 @@ namespace mongo {
             uasserted( 10100 ,  "cannot delete from collection with reserved $ in name" );
         }
 
-        long long nDeleted = _deleteObjects(ns, pattern, justOne, logop);
+        long long nDeleted = deleteMatching(ns, pattern, limit, logop);
 
         return nDeleted;
     }
+
+    long long deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop) {
+        return deleteObjectsUpTo(ns, pattern, justOne ? 1 : 0, logop);
+    }
 }
@@ -34,4 +34,8 @@ namespace mongo {
     // If justOne is true, deletedId is set to the id of the deleted object.
     long long deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop = false);
 
+    // Deletes at most limit matching objects (all of them if limit is 0), so a caller can
+    // delete a lot in several transactions.
+    long long deleteObjectsUpTo(const char *ns, BSONObj pattern, long long limit, bool logop);
+
 }
@@ -82,15 +82,49 @@ namespace mongo {
         return qr;
     }
 
-    QueryResult* processGetMore(const char *ns, int ntoreturn, long long cursorid , CurOp& curop, int pass, bool& exhaust ) {
+    ReplyBuilder::ReplyBuilder( int initialSize ) :
+        _b( initialSize ),
+        _refBytes( 0 ) {
+        _b.skip( sizeof( QueryResult ) );
+    }
+
+    void ReplyBuilder::appendObj( const BSONObj &obj ) {
+        const int size = obj.objsize();
+        if ( size >= MinRefSize && obj.isOwned() && _refs.size() < MaxRefs ) {
+            _refs.push_back( make_pair( _b.len(), obj ) );
+            _refBytes += size;
+        }
+        else {
+            _b.appendBuf( obj.objdata(), size );
+        }
+    }
+
+    void ReplyBuilder::handoff( Message &result ) {
+        char *buf = _b.buf();
+        const int bufLen = _b.len();
+        _b.decouple();
+
+        // result owns buf from here on, the slices after the first only point into it
+        result.appendData( buf, _refs.empty() ? bufLen : _refs[0].first );
+        for ( size_t i = 0; i < _refs.size(); ++i ) {
+            const BSONObj &obj = _refs[i].second;
+            result.appendDataRef( const_cast<char *>( obj.objdata() ), obj.objsize(),
+                                  boost::shared_ptr<void>( new BSONObj( obj ) ) );
+            const int end = i + 1 < _refs.size() ? _refs[i + 1].first : bufLen;
+            result.appendDataRef( buf + _refs[i].first, end - _refs[i].first );
+        }
+        _refs.clear();
+        _refBytes = 0;
+    }
+
+    bool processGetMore(const char *ns, int ntoreturn, long long cursorid , CurOp& curop, int pass, bool& exhaust, Message &result ) {
         exhaust = false;
         ClientCursor::Pin p(cursorid);
         ClientCursor *client_cursor = p.c();
 
         int bufSize = 512 + sizeof( QueryResult ) + MaxBytesToReturnToClientAtOnce;
 
-        BufBuilder b( bufSize );
-        b.skip(sizeof(QueryResult));
+        ReplyBuilder reply( bufSize );
         int resultFlags = ResultFlag_AwaitCapable;
         int start = 0;
         int n = 0;
@@ -150,7 +184,7 @@ namespace mongo {
                             continue;
 
                         if( n == 0 && (queryOptions & QueryOption_AwaitData) && pass < 1000 ) {
-                            return 0;
+                            return false;
                         }
 
                         break;
@@ -191,9 +225,15 @@ namespace mongo {
                         }
                         n++;
 
-                        client_cursor->fillQueryResultFromObj( b, &details );
+                        if ( client_cursor->fields || c->keyFieldsOnly() ) {
+                            client_cursor->fillQueryResultFromObj( reply.bb(), &details );
+                        }
+                        else {
+                            // may be sent without a copy, see ReplyBuilder
+                            reply.appendObj( c->current() );
+                        }
 
-                        if ( ( ntoreturn && n >= ntoreturn ) || b.len() > MaxBytesToReturnToClientAtOnce ) {
+                        if ( ( ntoreturn && n >= ntoreturn ) || reply.len() > MaxBytesToReturnToClientAtOnce ) {
                             c->advance();
                             client_cursor->incPos( n );
                             break;
@@ -213,16 +253,15 @@ namespace mongo {
             }
         }
 
-        QueryResult *qr = (QueryResult *) b.buf();
-        qr->len = b.len();
+        QueryResult *qr = reply.header();
         qr->setOperation(opReply);
         qr->_resultFlags() = resultFlags;
         qr->cursorId = cursorid;
         qr->startingFrom = start;
         qr->nReturned = n;
-        b.decouple();
+        reply.handoff( result );
 
-        return qr;
+        return true;
     }
 
     ResultDetails::ResultDetails() :
@@ -36,7 +36,44 @@ namespace mongo {
 
     extern const int32_t MaxBytesToReturnToClientAtOnce;
     
-    QueryResult* processGetMore(const char *ns, int ntoreturn, long long cursorid , CurOp& op, int pass, bool& exhaust);
+    /**
+     * Fills result with the next batch of a cursor.
+     * @return false if the cursor is awaiting data and nothing was returned yet.
+     */
+    bool processGetMore(const char *ns, int ntoreturn, long long cursorid , CurOp& op, int pass, bool& exhaust, Message &result);
+
+    /**
+     * Builds an OP_REPLY.  Owned documents large enough that copying them costs more than an
+     * extra iovec are referenced rather than copied, and are sent straight from their own
+     * buffers when the reply is handed off to a Message.
+     */
+    class ReplyBuilder : boost::noncopyable {
+    public:
+        explicit ReplyBuilder( int initialSize );
+
+        /** For results that must be built in place, e.g. projections. */
+        BufBuilder &bb() { return _b; }
+
+        void appendObj( const BSONObj &obj );
+
+        /** @return the length of the reply, including referenced documents. */
+        int len() const { return _b.len() + _refBytes; }
+
+        QueryResult *header() { return reinterpret_cast<QueryResult *>( _b.buf() ); }
+
+        /** Moves the reply into result, which must be empty. */
+        void handoff( Message &result );
+
+    private:
+        static const int MinRefSize = 16 * 1024;
+        // each reference costs up to two iovecs, stay well under IOV_MAX
+        static const size_t MaxRefs = 256;
+
+        BufBuilder _b;
+        // offset into _b where each referenced document belongs
+        vector< pair<int, BSONObj> > _refs;
+        int _refBytes;
+    };
 
     string runQuery(Message& m, QueryMessage& q, CurOp& curop, Message &result);
 
@@ -19,7 +19,9 @@
 
 #include "pch.h"
 
+#include "mongo/base/init.h"
 #include "mongo/client/dbclientinterface.h"
+#include "mongo/db/field_lookup_scope.h"
 #include "mongo/db/oplog.h"
 #include "mongo/db/queryutil.h"
 #include "mongo/db/query_optimizer.h"
@@ -29,9 +31,21 @@
 #include "mongo/db/ops/update.h"
 #include "mongo/db/ops/update_internal.h"
 #include "mongo/db/oplog_helpers.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/storage/update_diff.h"
+#include "mongo/db/txn_context.h"
 
 namespace mongo {
 
+    // Opt-in: an update by _id whose mods are all $inc and $set of unindexed fields is sent
+    // to the primary key as a message, without reading the document first.  The mods are
+    // applied whenever the document is next read or the message is flushed.  The price is
+    // that getLastError reports one document updated whether or not it existed, mods that
+    // turn out not to apply (like $inc of a string) are dropped instead of failing the
+    // update, and replica set rollback can't undo such an update.  Not used on shards,
+    // whose migrations need both images of every update.
+    MONGO_EXPORT_SERVER_PARAMETER(fastUpdates, bool, false);
+
     void updateOneObject(
         NamespaceDetails *d, 
         const BSONObj &pk, 
@@ -81,6 +95,36 @@ namespace mongo {
         updateOneObject( d, pk, obj, newObj, logDetails );
     }
 
+    static BSONObj applyUpdateMods(const BSONObj &obj, const BSONObj &updateobj) {
+        ModSet mods( updateobj );
+        auto_ptr<ModSetState> mss = mods.prepare( obj, false /* not an insertion */ );
+        BSONObj newObj = mss->createNewFromMods();
+        checkTooLarge( newObj );
+        return newObj;
+    }
+
+    MONGO_INITIALIZER(UpdateModsApplier)(InitializerContext*) {
+        storage::setUpdateModsApplier(applyUpdateMods);
+        return Status::OK();
+    }
+
+    static bool mayUpdateFast(NamespaceDetails *d, const ModSet &mods, bool upsert) {
+        return fastUpdates && !upsert &&
+               !mods.isIndexed() && !mods.hasDynamicArray() && mods.onlyIncAndSet() &&
+               !logTxnOpsForSharding() && d->fastUpdatesOkay();
+    }
+
+    static void updateFast(NamespaceDetails *d, const BSONObj &pk, const BSONObj &updateobj,
+                           bool logop) {
+        TOKULOG(3) << "updateFast sending mods " << updateobj << " to pk " << pk << endl;
+
+        d->updateObjectMods( pk, updateobj );
+        if ( logop ) {
+            OpLogHelpers::logUpdateMods( d->ns().c_str(), pk, updateobj, &cc().txn() );
+        }
+        d->notifyOfWriteOp();
+    }
+
     static void updateNoMods(NamespaceDetails *d, const BSONObj &pk, const BSONObj &obj,
                              const BSONObj &updateobj, const LogOpUpdateDetails &logDetails) {
 
@@ -145,6 +189,8 @@ namespace mongo {
            regular ones at the moment. */
         LogOpUpdateDetails logDetails(logop, fromMigrate);
         if ( isOperatorUpdate ) {
+            // the mods and the old keys of every index look at the same fields of obj
+            FieldLookupScope lookupScope( obj );
             auto_ptr<ModSetState> mss = mods->prepare( obj, false /* not an insertion */ );
 
             // mod set update, ie: $inc: 10 increments by 10.
@@ -199,6 +245,12 @@ namespace mongo {
             IndexDetails &idx = d->idx(idIdxNo);
             BSONObj pk = idx.getKeyFromQuery(patternOrig);
             TOKULOG(3) << "_updateObjects using simple _id query, pattern " << patternOrig << ", pk " << pk << endl;
+            if ( isOperatorUpdate && mayUpdateFast( d, *mods, upsert ) ) {
+                // we never learn whether the document was there
+                debug.fastmod = true;
+                updateFast( d, pk, updateobj, logop );
+                return UpdateResult( 1 , 1 , 1 , BSONObj() );
+            }
             UpdateResult result = _updateById( pk,
                                                isOperatorUpdate,
                                                mods.get(),
@@ -307,6 +359,7 @@ namespace mongo {
                         mymodset.reset( useMods );
                     }
 
+                    FieldLookupScope lookupScope( currentObj );
                     auto_ptr<ModSetState> mss = useMods->prepare( currentObj,
                                                                   false /* not an insertion */ );
                     updateUsingMods( d, currPK, currentObj, *mss, logDetails );
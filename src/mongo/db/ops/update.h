@@ -45,6 +45,9 @@ namespace mongo {
         }
     };
     
+    // server parameter, see update.cpp
+    extern bool fastUpdates;
+
     struct LogOpUpdateDetails {
         LogOpUpdateDetails(bool log = false, bool m = false) :
             logop(log), fromMigrate(m) {
@@ -19,6 +19,7 @@
 
 #include "pch.h"
 
+#include "mongo/db/field_lookup_scope.h"
 #include "mongo/db/oplog.h"
 #include "mongo/db/jsobjmanipulator.h"
 #include "mongo/util/mongoutils/str.h"
@@ -420,7 +421,7 @@ namespace mongo {
             ModState& ms = *mss->_mods[i->first];
 
             const Mod& m = i->second;
-            BSONElement e = obj.getFieldDotted(m.fieldName);
+            BSONElement e = FieldLookupScope::getFieldDotted(obj, m.fieldName);
 
             ms.m = &m;
             ms.old = e;
@@ -829,7 +830,7 @@ namespace mongo {
     }
 
     BSONObj ModSetState::createNewFromMods() {
-        BSONObjBuilder b( (int)(_obj.objsize() * 1.1) );
+        BSONObjBuilder b( (int)(_obj.objsize() * 1.1), OpArena::current() );
         createNewObjFromMods( "" , b , _obj );
         return _newFromMods = b.obj();
     }
@@ -339,6 +339,18 @@ namespace mongo {
 
         int isIndexed() const { return _isIndexed; }
 
+        /**
+         * @return true if every mod is a $inc or a $set, which need nothing from the document
+         * before they are applied to it
+         */
+        bool onlyIncAndSet() const {
+            for ( ModHolder::const_iterator i = _mods.begin(); i != _mods.end(); ++i ) {
+                if ( i->second.op != Mod::INC && i->second.op != Mod::SET )
+                    return false;
+            }
+            return true;
+        }
+
         unsigned size() const { return _mods.size(); }
 
         bool haveModForField( const char* fieldName ) const {
@@ -55,6 +55,31 @@ namespace mongo {
         verify(false); // these can't appear in arrays
     }
 
+    size_t Accumulator::getStateSize() const {
+        return 0;
+    }
+
+    /*
+      The remaining state methods are only called for accumulators that
+      report a non-zero getStateSize(), which must override all of them.
+    */
+    void Accumulator::initState(void *pState) const {
+        verify(false);
+    }
+
+    void Accumulator::destroyState(void *pState) const {
+        verify(false);
+    }
+
+    void Accumulator::accumulate(void *pState, const Document& pDocument) const {
+        verify(false);
+    }
+
+    Value Accumulator::getStateValue(const void *pState) const {
+        verify(false);
+        return Value();
+    }
+
     void agg_framework_reservedErrors() {
         uassert(16030, "reserved error", false);
         uassert(16031, "reserved error", false);
@@ -44,6 +44,39 @@ namespace mongo {
          */
         virtual Value getValue() const = 0;
 
+        /*
+          Accumulators whose per-group state is a small fixed-size struct
+          can have that state kept outside the Accumulator.  A single
+          instance then acts as a prototype that DocumentSourceGroup runs
+          over the state slots it lays out inline in its group table,
+          instead of allocating a new Accumulator for every group.
+
+          @returns the size of the state in bytes, or 0 if this
+            accumulator must be instantiated per group ($push, $addToSet)
+         */
+        virtual size_t getStateSize() const;
+
+        /*
+          Construct a fresh state in the (suitably aligned) memory at pState.
+         */
+        virtual void initState(void *pState) const;
+
+        /*
+          Destroy a state previously constructed by initState().
+         */
+        virtual void destroyState(void *pState) const;
+
+        /*
+          Evaluate the operand against pDocument and fold it into pState.
+          This is what evaluate() does for the accumulator's own state.
+         */
+        virtual void accumulate(void *pState, const Document& pDocument) const;
+
+        /*
+          Get the accumulated value held in pState.
+         */
+        virtual Value getStateValue(const void *pState) const;
+
     protected:
         Accumulator();
 
@@ -97,12 +130,25 @@ namespace mongo {
         public Accumulator {
     public:
         // virtuals from Expression
+        virtual Value evaluate(const Document& pDocument) const;
         virtual Value getValue() const;
 
+        // virtuals from Accumulator
+        virtual size_t getStateSize() const;
+        virtual void initState(void *pState) const;
+        virtual void destroyState(void *pState) const;
+        virtual Value getStateValue(const void *pState) const;
+
     protected:
         AccumulatorSingleValue();
 
-        mutable Value pValue; /* current min/max */
+        struct State {
+            State() : value(), haveValue(false) {}
+            Value value; /* current first/last/min/max */
+            bool haveValue; /* used by $first to remember a missing value */
+        };
+
+        mutable State state;
     };
 
 
@@ -110,9 +156,11 @@ namespace mongo {
         public AccumulatorSingleValue {
     public:
         // virtuals from Expression
-        virtual Value evaluate(const Document& pDocument) const;
         virtual const char *getOpName() const;
 
+        // virtuals from Accumulator
+        virtual void accumulate(void *pState, const Document& pDocument) const;
+
         /*
           Create the accumulator.
 
@@ -122,7 +170,6 @@ namespace mongo {
             const intrusive_ptr<ExpressionContext> &pCtx);
 
     private:
-        mutable bool _haveFirst;
         AccumulatorFirst();
     };
 
@@ -131,9 +178,11 @@ namespace mongo {
         public AccumulatorSingleValue {
     public:
         // virtuals from Expression
-        virtual Value evaluate(const Document& pDocument) const;
         virtual const char *getOpName() const;
 
+        // virtuals from Accumulator
+        virtual void accumulate(void *pState, const Document& pDocument) const;
+
         /*
           Create the accumulator.
 
@@ -154,6 +203,11 @@ namespace mongo {
         virtual Value evaluate(const Document& pDocument) const;
         virtual Value getValue() const;
         virtual const char *getOpName() const;
+        virtual size_t getStateSize() const;
+        virtual void initState(void *pState) const;
+        virtual void destroyState(void *pState) const;
+        virtual void accumulate(void *pState, const Document& pDocument) const;
+        virtual Value getStateValue(const void *pState) const;
 
         /*
           Create a summing accumulator.
@@ -167,11 +221,16 @@ namespace mongo {
     protected: /* reused by AccumulatorAvg */
         AccumulatorSum();
 
-        mutable BSONType totalType;
-        mutable long long longTotal;
-        mutable double doubleTotal;
-        // count is only used by AccumulatorAvg, but lives here to avoid counting non-numeric values
-        mutable long long count;
+        struct State {
+            State() : totalType(NumberInt), longTotal(0), doubleTotal(0), count(0) {}
+            BSONType totalType;
+            long long longTotal;
+            double doubleTotal;
+            // count is only used by AccumulatorAvg, but lives here to avoid counting non-numeric values
+            long long count;
+        };
+
+        mutable State state;
     };
 
 
@@ -179,9 +238,11 @@ namespace mongo {
         public AccumulatorSingleValue {
     public:
         // virtuals from Expression
-        virtual Value evaluate(const Document& pDocument) const;
         virtual const char *getOpName() const;
 
+        // virtuals from Accumulator
+        virtual void accumulate(void *pState, const Document& pDocument) const;
+
         /*
           Create either the max or min accumulator.
 
@@ -229,9 +290,9 @@ namespace mongo {
         typedef AccumulatorSum Super;
     public:
         // virtuals from Accumulator
-        virtual Value evaluate(const Document& pDocument) const;
-        virtual Value getValue() const;
         virtual const char *getOpName() const;
+        virtual void accumulate(void *pState, const Document& pDocument) const;
+        virtual Value getStateValue(const void *pState) const;
 
         /*
           Create an averaging accumulator.
@@ -27,11 +27,13 @@ namespace mongo {
     const char AccumulatorAvg::subTotalName[] = "subTotal";
     const char AccumulatorAvg::countName[] = "count";
 
-    Value AccumulatorAvg::evaluate(const Document& pDocument) const {
+    void AccumulatorAvg::accumulate(void *pState, const Document& pDocument) const {
         if (!pCtx->getDoingMerge()) {
-            Super::evaluate(pDocument);
+            Super::accumulate(pState, pDocument);
         }
         else {
+            State *s = static_cast<State *>(pState);
+
             /*
               If we're in the router, we expect an object that contains
               both a subtotal and a count.  This is what getValue() produced
@@ -42,14 +44,12 @@ namespace mongo {
 
             Value subTotal = shardOut[subTotalName];
             verify(!subTotal.missing());
-            doubleTotal += subTotal.getDouble();
+            s->doubleTotal += subTotal.getDouble();
                 
             Value subCount = shardOut[countName];
             verify(!subCount.missing());
-            count += subCount.getLong();
+            s->count += subCount.getLong();
         }
-
-        return Value();
     }
 
     intrusive_ptr<Accumulator> AccumulatorAvg::create(
@@ -58,18 +58,19 @@ namespace mongo {
         return pA;
     }
 
-    Value AccumulatorAvg::getValue() const {
+    Value AccumulatorAvg::getStateValue(const void *pState) const {
+        const State *s = static_cast<const State *>(pState);
         if (!pCtx->getInShard()) {
             double avg = 0;
-            if (count)
-                avg = doubleTotal / static_cast<double>(count);
+            if (s->count)
+                avg = s->doubleTotal / static_cast<double>(s->count);
 
             return Value::createDouble(avg);
         }
 
         MutableDocument out;
-        out.addField(subTotalName, Value::createDouble(doubleTotal));
-        out.addField(countName, Value::createLong(count));
+        out.addField(subTotalName, Value::createDouble(s->doubleTotal));
+        out.addField(countName, Value::createLong(s->count));
 
         return Value::createDocument(out.freeze());
     }
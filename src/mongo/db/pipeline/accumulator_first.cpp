@@ -22,22 +22,20 @@
 
 namespace mongo {
 
-    Value AccumulatorFirst::evaluate(const Document& pDocument) const {
+    void AccumulatorFirst::accumulate(void *pState, const Document& pDocument) const {
         verify(vpOperand.size() == 1);
+        State *s = static_cast<State *>(pState);
 
         /* only remember the first value seen */
-        if (!_haveFirst) {
-            // can't use pValue.missing() since we want the first value even if missing
-            _haveFirst = true;
-            pValue = vpOperand[0]->evaluate(pDocument);
+        if (!s->haveValue) {
+            // can't use value.missing() since we want the first value even if missing
+            s->haveValue = true;
+            s->value = vpOperand[0]->evaluate(pDocument);
         }
-
-        return pValue;
     }
 
     AccumulatorFirst::AccumulatorFirst()
         : AccumulatorSingleValue()
-        , _haveFirst(false)
     {}
 
     intrusive_ptr<Accumulator> AccumulatorFirst::create(
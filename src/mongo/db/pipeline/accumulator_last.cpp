@@ -22,13 +22,11 @@
 
 namespace mongo {
 
-    Value AccumulatorLast::evaluate(const Document& pDocument) const {
+    void AccumulatorLast::accumulate(void *pState, const Document& pDocument) const {
         verify(vpOperand.size() == 1);
 
         /* always remember the last value seen */
-        pValue = vpOperand[0]->evaluate(pDocument);
-
-        return pValue;
+        static_cast<State *>(pState)->value = vpOperand[0]->evaluate(pDocument);
     }
 
     AccumulatorLast::AccumulatorLast():
@@ -22,19 +22,19 @@
 
 namespace mongo {
 
-    Value AccumulatorMinMax::evaluate(const Document& pDocument) const {
+    void AccumulatorMinMax::accumulate(void *pState, const Document& pDocument) const {
         verify(vpOperand.size() == 1);
         Value prhs(vpOperand[0]->evaluate(pDocument));
 
         // nullish values should have no impact on result
         if (!prhs.nullish()) {
+            Value &current = static_cast<State *>(pState)->value;
+
             /* compare with the current value; swap if appropriate */
-            int cmp = Value::compare(pValue, prhs) * sense;
-            if (cmp > 0 || pValue.missing()) // missing is lower than all other values
-                pValue = prhs;
+            int cmp = Value::compare(current, prhs) * sense;
+            if (cmp > 0 || current.missing()) // missing is lower than all other values
+                current = prhs;
         }
-
-        return Value();
     }
 
     AccumulatorMinMax::AccumulatorMinMax(int theSense):
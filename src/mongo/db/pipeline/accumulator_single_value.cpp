@@ -22,12 +22,33 @@
 
 namespace mongo {
 
+    Value AccumulatorSingleValue::evaluate(const Document& pDocument) const {
+        accumulate(&state, pDocument);
+        return state.value;
+    }
+
     Value AccumulatorSingleValue::getValue() const {
-        return pValue;
+        return getStateValue(&state);
+    }
+
+    size_t AccumulatorSingleValue::getStateSize() const {
+        return sizeof(State);
+    }
+
+    void AccumulatorSingleValue::initState(void *pState) const {
+        new (pState) State();
+    }
+
+    void AccumulatorSingleValue::destroyState(void *pState) const {
+        static_cast<State *>(pState)->~State();
+    }
+
+    Value AccumulatorSingleValue::getStateValue(const void *pState) const {
+        return static_cast<const State *>(pState)->value;
     }
 
     AccumulatorSingleValue::AccumulatorSingleValue():
-        pValue(Value()) {
+        state() {
     }
 
 }
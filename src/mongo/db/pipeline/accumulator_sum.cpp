@@ -23,33 +23,50 @@
 namespace mongo {
 
     Value AccumulatorSum::evaluate(const Document& pDocument) const {
+        accumulate(&state, pDocument);
+        return Value();
+    }
+
+    void AccumulatorSum::accumulate(void *pState, const Document& pDocument) const {
         verify(vpOperand.size() == 1);
         Value rhs = vpOperand[0]->evaluate(pDocument);
 
         // do nothing with non numeric types
         if (!rhs.numeric())
-            return Value();
+            return;
+
+        State *s = static_cast<State *>(pState);
 
         // upgrade to the widest type required to hold the result
-        totalType = Value::getWidestNumeric(totalType, rhs.getType());
+        s->totalType = Value::getWidestNumeric(s->totalType, rhs.getType());
 
-        if (totalType == NumberInt || totalType == NumberLong) {
+        if (s->totalType == NumberInt || s->totalType == NumberLong) {
             long long v = rhs.coerceToLong();
-            longTotal += v;
-            doubleTotal += v;
+            s->longTotal += v;
+            s->doubleTotal += v;
         }
-        else if (totalType == NumberDouble) {
+        else if (s->totalType == NumberDouble) {
             double v = rhs.coerceToDouble();
-            doubleTotal += v;
+            s->doubleTotal += v;
         }
         else {
             // non numerics should have returned above so we should never get here
             verify(false);
         }
 
-        count++;
+        s->count++;
+    }
 
-        return Value();
+    size_t AccumulatorSum::getStateSize() const {
+        return sizeof(State);
+    }
+
+    void AccumulatorSum::initState(void *pState) const {
+        new (pState) State();
+    }
+
+    void AccumulatorSum::destroyState(void *pState) const {
+        static_cast<State *>(pState)->~State();
     }
 
     intrusive_ptr<Accumulator> AccumulatorSum::create(
@@ -59,14 +76,19 @@ namespace mongo {
     }
 
     Value AccumulatorSum::getValue() const {
-        if (totalType == NumberLong) {
-            return Value::createLong(longTotal);
+        return getStateValue(&state);
+    }
+
+    Value AccumulatorSum::getStateValue(const void *pState) const {
+        const State *s = static_cast<const State *>(pState);
+        if (s->totalType == NumberLong) {
+            return Value::createLong(s->longTotal);
         }
-        else if (totalType == NumberDouble) {
-            return Value::createDouble(doubleTotal);
+        else if (s->totalType == NumberDouble) {
+            return Value::createDouble(s->doubleTotal);
         }
-        else if (totalType == NumberInt) {
-            return Value::createIntOrLong(longTotal);
+        else if (s->totalType == NumberInt) {
+            return Value::createIntOrLong(s->longTotal);
         }
         else {
             massert(16000, "$sum resulted in a non-numeric type", false);
@@ -75,10 +97,7 @@ namespace mongo {
 
     AccumulatorSum::AccumulatorSum():
         Accumulator(),
-        totalType(NumberInt),
-        longTotal(0),
-        doubleTotal(0),
-        count(0) {
+        state() {
     }
 
     const char *AccumulatorSum::getOpName() const {
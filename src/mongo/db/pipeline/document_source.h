@@ -41,6 +41,7 @@ namespace mongo {
     class ExpressionFieldPath;
     class ExpressionObject;
     class DocumentSourceLimit;
+    class GroupTable;
     class Matcher;
 
     class DocumentSource :
@@ -681,9 +682,17 @@ namespace mongo {
 
         intrusive_ptr<Expression> pIdExpression;
 
-        typedef boost::unordered_map<Value,
-            vector<intrusive_ptr<Accumulator> >, Value::Hash> GroupsType;
-        GroupsType groups;
+        /*
+          Groups are kept in a GroupTable, whose records hold the state of
+          every accumulator for the group at the offsets in vStateOffset.
+          Accumulators that support inline state ($sum, $avg, $min, $max,
+          $first, $last) are run by the shared prototypes in vpPrototype
+          over those slots.  For the others, the slot holds an
+          intrusive_ptr to an Accumulator made for that group.
+        */
+        scoped_ptr<GroupTable> pGroups;
+        vector<intrusive_ptr<Accumulator> > vpPrototype;
+        vector<size_t> vStateOffset;
 
         /*
           The field names for the result documents and the accumulator
@@ -703,9 +712,12 @@ namespace mongo {
         vector<intrusive_ptr<Expression> > vpExpression;
 
 
-        Document makeDocument(const GroupsType::iterator &rIter);
+        void initGroupState(char *pState);
+        void destroyGroups();
+
+        Document makeDocument(size_t group);
 
-        GroupsType::iterator groupsIterator;
+        size_t groupsIterator;
     };
 
 
@@ -24,12 +24,14 @@
 #include "db/pipeline/document.h"
 #include "db/pipeline/expression.h"
 #include "db/pipeline/expression_context.h"
+#include "db/pipeline/group_table.h"
 #include "db/pipeline/value.h"
 
 namespace mongo {
     const char DocumentSourceGroup::groupName[] = "$group";
 
     DocumentSourceGroup::~DocumentSourceGroup() {
+        destroyGroups();
     }
 
     const char *DocumentSourceGroup::getSourceName() const {
@@ -40,7 +42,7 @@ namespace mongo {
         if (!populated)
             populate();
 
-        return (groupsIterator == groups.end());
+        return (groupsIterator == pGroups->size());
     }
 
     bool DocumentSourceGroup::advance() {
@@ -49,10 +51,10 @@ namespace mongo {
         if (!populated)
             populate();
 
-        verify(groupsIterator != groups.end());
+        verify(groupsIterator != pGroups->size());
 
         ++groupsIterator;
-        if (groupsIterator == groups.end()) {
+        if (groupsIterator == pGroups->size()) {
             dispose();
             return false;
         }
@@ -68,12 +70,34 @@ namespace mongo {
     }
 
     void DocumentSourceGroup::dispose() {
-        GroupsType().swap(groups);
-        groupsIterator = groups.end();
+        destroyGroups();
+        groupsIterator = 0;
 
         pSource->dispose();
     }
 
+    void DocumentSourceGroup::destroyGroups() {
+        if (!pGroups)
+            return;
+
+        const size_t numAccumulators = vpPrototype.size();
+        const size_t numGroups = pGroups->size();
+        for (size_t g = 0; g < numGroups; ++g) {
+            char *pState = pGroups->getState(g);
+            for (size_t i = 0; i < numAccumulators; ++i) {
+                void *pSlot = pState + vStateOffset[i];
+                if (vpPrototype[i]->getStateSize() > 0) {
+                    vpPrototype[i]->destroyState(pSlot);
+                }
+                else {
+                    static_cast<intrusive_ptr<Accumulator> *>(pSlot)->~intrusive_ptr();
+                }
+            }
+        }
+
+        pGroups->clear();
+    }
+
     void DocumentSourceGroup::sourceToBson(
         BSONObjBuilder *pBuilder, bool explain) const {
         BSONObjBuilder insides;
@@ -119,10 +143,13 @@ namespace mongo {
         SplittableDocumentSource(pExpCtx),
         populated(false),
         pIdExpression(),
-        groups(),
+        pGroups(),
+        vpPrototype(),
+        vStateOffset(),
         vFieldName(),
         vpAccumulatorFactory(),
-        vpExpression() {
+        vpExpression(),
+        groupsIterator(0) {
     }
 
     void DocumentSourceGroup::addAccumulator(
@@ -287,10 +314,47 @@ namespace mongo {
         return pGroup;
     }
 
+    void DocumentSourceGroup::initGroupState(char *pState) {
+        const size_t numAccumulators = vpPrototype.size();
+        for (size_t i = 0; i < numAccumulators; i++) {
+            void *pSlot = pState + vStateOffset[i];
+            if (vpPrototype[i]->getStateSize() > 0) {
+                vpPrototype[i]->initState(pSlot);
+            }
+            else {
+                intrusive_ptr<Accumulator> accum = (*vpAccumulatorFactory[i])(pExpCtx);
+                accum->addOperand(vpExpression[i]);
+                new (pSlot) intrusive_ptr<Accumulator>(accum);
+            }
+        }
+    }
+
     void DocumentSourceGroup::populate() {
         const size_t numAccumulators = vpAccumulatorFactory.size();
         dassert(numAccumulators == vpExpression.size());
 
+        /*
+          Make one prototype of each accumulator and lay out the group
+          records: inline state where the accumulator supports it, an
+          Accumulator pointer where it doesn't.
+        */
+        vpPrototype.clear();
+        vStateOffset.clear();
+        size_t stateSize = 0;
+        for (size_t i = 0; i < numAccumulators; i++) {
+            intrusive_ptr<Accumulator> proto = (*vpAccumulatorFactory[i])(pExpCtx);
+            proto->addOperand(vpExpression[i]);
+
+            size_t size = proto->getStateSize();
+            if (size == 0)
+                size = sizeof(intrusive_ptr<Accumulator>);
+
+            vpPrototype.push_back(proto);
+            vStateOffset.push_back(stateSize);
+            stateSize += (size + 7) & ~static_cast<size_t>(7);
+        }
+        pGroups.reset(new GroupTable(stateSize));
+
         for (bool hasNext = !pSource->eof(); hasNext; hasNext = pSource->advance()) {
             Document input  = pSource->getCurrent();
 
@@ -302,47 +366,49 @@ namespace mongo {
                 id = Value(BSONNULL);
 
             /*
-              Look for the _id value in the map; if it's not there, add a
-              new entry with a blank accumulator.
+              Look for the _id value in the table; if it's not there, add a
+              new entry with blank accumulator state.
             */
-            vector<intrusive_ptr<Accumulator> >& group = groups[id];
+            bool created;
+            char *pState = pGroups->findOrInsert(id, &created);
 
             if (numAccumulators == 0)
                 continue; // we are basically building a set
 
-            if (group.empty()) {
-                /* add the accumulators */
-                group.reserve(numAccumulators);
-                for (size_t i = 0; i < numAccumulators; i++) {
-                    intrusive_ptr<Accumulator> accum = (*vpAccumulatorFactory[i])(pExpCtx);
-                    accum->addOperand(vpExpression[i]);
-                    group.push_back(accum);
-                }
-            }
+            if (created)
+                initGroupState(pState);
 
             /* tickle all the accumulators for the group we found */
-            dassert(numAccumulators == group.size());
-            for (size_t i = 0; i < numAccumulators; i++)
-                group[i]->evaluate(input);
+            for (size_t i = 0; i < numAccumulators; i++) {
+                void *pSlot = pState + vStateOffset[i];
+                if (vpPrototype[i]->getStateSize() > 0) {
+                    vpPrototype[i]->accumulate(pSlot, input);
+                }
+                else {
+                    (*static_cast<intrusive_ptr<Accumulator> *>(pSlot))->evaluate(input);
+                }
+            }
         }
 
         /* start the group iterator */
-        groupsIterator = groups.begin();
+        groupsIterator = 0;
         populated = true;
     }
 
-    Document DocumentSourceGroup::makeDocument(
-        const GroupsType::iterator &rIter) {
-        vector<intrusive_ptr<Accumulator> > *pGroup = &rIter->second;
+    Document DocumentSourceGroup::makeDocument(size_t group) {
+        char *pState = pGroups->getState(group);
         const size_t n = vFieldName.size();
         MutableDocument out (1 + n);
 
         /* add the _id field */
-        out.addField("_id", rIter->first);
+        out.addField("_id", pGroups->getId(group));
 
         /* add the rest of the fields */
         for(size_t i = 0; i < n; ++i) {
-            Value pValue((*pGroup)[i]->getValue());
+            const void *pSlot = pState + vStateOffset[i];
+            Value pValue(vpPrototype[i]->getStateSize() > 0
+                         ? vpPrototype[i]->getStateValue(pSlot)
+                         : (*static_cast<const intrusive_ptr<Accumulator> *>(pSlot))->getValue());
             if (pValue.missing()) {
                 // we return null in this case so return objects are predictable
                 out.addField(vFieldName[i], Value(BSONNULL));
@@ -0,0 +1,130 @@
+/**
+ * Copyright (C) 2013 Tokutek Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pch.h"
+
+#include "db/pipeline/group_table.h"
+
+namespace mongo {
+
+    const size_t GroupTable::initialCapacity;
+    const size_t GroupTable::blockSize;
+
+    /* keep every record (and so every state) 8-byte aligned */
+    static size_t alignRecordSize(size_t size) {
+        return (size + 7) & ~static_cast<size_t>(7);
+    }
+
+    GroupTable::GroupTable(size_t stateSize):
+        stateOffset(sizeof(Value)),
+        recordSize(alignRecordSize(sizeof(Value) + stateSize)),
+        recordsPerBlock(std::max(static_cast<size_t>(1), blockSize / recordSize)),
+        slots(),
+        records(),
+        blocks(),
+        nextInBlock(0) {
+    }
+
+    GroupTable::~GroupTable() {
+        clear();
+    }
+
+    char *GroupTable::allocateRecord() {
+        if (blocks.empty() || nextInBlock == recordsPerBlock) {
+            char *pBlock = static_cast<char *>(malloc(recordsPerBlock * recordSize));
+            massert(17020, "out of memory allocating $group arena", pBlock != NULL);
+            blocks.push_back(pBlock);
+            nextInBlock = 0;
+        }
+        return blocks.back() + recordSize * nextInBlock++;
+    }
+
+    void GroupTable::grow() {
+        const size_t newCapacity = slots.empty() ? initialCapacity : slots.size() * 2;
+        const size_t mask = newCapacity - 1;
+
+        vector<Slot> newSlots(newCapacity);
+        for (size_t i = 0; i < newCapacity; ++i) {
+            newSlots[i].pRecord = NULL;
+        }
+
+        /* the hashes are saved, so rehashing never touches the records */
+        for (vector<Slot>::const_iterator it = slots.begin(); it != slots.end(); ++it) {
+            if (it->pRecord == NULL)
+                continue;
+            size_t pos = it->hash & mask;
+            while (newSlots[pos].pRecord != NULL)
+                pos = (pos + 1) & mask;
+            newSlots[pos] = *it;
+        }
+
+        slots.swap(newSlots);
+    }
+
+    char *GroupTable::findOrInsert(const Value &id, bool *pCreated) {
+        /* keep the load factor at or below one half */
+        if ((records.size() + 1) * 2 > slots.size())
+            grow();
+
+        const size_t hash = Value::Hash()(id);
+        const size_t mask = slots.size() - 1;
+
+        size_t pos = hash & mask;
+        for (;;) {
+            Slot &slot = slots[pos];
+            if (slot.pRecord == NULL)
+                break;
+            if (slot.hash == hash &&
+                Value::compare(*reinterpret_cast<const Value *>(slot.pRecord), id) == 0) {
+                *pCreated = false;
+                return slot.pRecord + stateOffset;
+            }
+            pos = (pos + 1) & mask;
+        }
+
+        char *pRecord = allocateRecord();
+        new (pRecord) Value(id);
+        records.push_back(pRecord);
+
+        slots[pos].hash = hash;
+        slots[pos].pRecord = pRecord;
+
+        *pCreated = true;
+        return pRecord + stateOffset;
+    }
+
+    void GroupTable::clear() {
+        for (vector<char *>::const_iterator it = records.begin(); it != records.end(); ++it) {
+            reinterpret_cast<Value *>(*it)->~Value();
+        }
+        for (vector<char *>::const_iterator it = blocks.begin(); it != blocks.end(); ++it) {
+            free(*it);
+        }
+
+        vector<Slot>().swap(slots);
+        vector<char *>().swap(records);
+        vector<char *>().swap(blocks);
+        nextInBlock = 0;
+    }
+
+    size_t GroupTable::getApproximateSize() const {
+        return sizeof(*this)
+            + slots.capacity() * sizeof(Slot)
+            + records.capacity() * sizeof(char *)
+            + blocks.size() * recordsPerBlock * recordSize;
+    }
+
+}
@@ -0,0 +1,101 @@
+/**
+ * Copyright (C) 2013 Tokutek Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mongo/pch.h"
+
+#include "db/pipeline/value.h"
+
+namespace mongo {
+
+    /*
+      An open-addressing hash table from group _id Values to fixed-size
+      group records, used by DocumentSourceGroup.
+
+      Every record holds the group's _id followed by stateSize bytes of
+      accumulator state.  Records are carved out of large arena blocks,
+      so creating a group costs no individual heap allocation, and they
+      never move once allocated, so state pointers stay valid while the
+      table grows.  The table itself only holds (hash, record) pairs and
+      is probed linearly.
+
+      The table constructs and destroys the _id Values, but the state
+      bytes are opaque: the caller initializes them after a record is
+      created and must destroy them before clear() or destruction.
+     */
+    class GroupTable : boost::noncopyable {
+    public:
+        /*
+          @param stateSize the number of bytes of state in each record
+         */
+        explicit GroupTable(size_t stateSize);
+        ~GroupTable();
+
+        /*
+          Find the record for a group, creating it if it doesn't exist.
+
+          @param id the group key
+          @param pCreated set to true if the record was just created, in
+            which case its state is uninitialized
+          @returns the state bytes of the record
+         */
+        char *findOrInsert(const Value &id, bool *pCreated);
+
+        /* number of groups, in insertion order for the accessors below */
+        size_t size() const { return records.size(); }
+        const Value &getId(size_t i) const;
+        char *getState(size_t i) const;
+
+        /*
+          Release all records.  Any state must already have been destroyed.
+         */
+        void clear();
+
+        /* approximate memory used by the table and its arena, in bytes */
+        size_t getApproximateSize() const;
+
+    private:
+        struct Slot {
+            size_t hash;
+            char *pRecord; /* NULL for an empty slot */
+        };
+
+        static const size_t initialCapacity = 16;
+        static const size_t blockSize = 64 * 1024;
+
+        char *allocateRecord();
+        void grow();
+
+        const size_t stateOffset;
+        const size_t recordSize;
+        const size_t recordsPerBlock;
+
+        vector<Slot> slots; /* capacity is always a power of two */
+        vector<char *> records;
+        vector<char *> blocks;
+        size_t nextInBlock;
+    };
+
+    inline const Value &GroupTable::getId(size_t i) const {
+        return *reinterpret_cast<const Value *>(records[i]);
+    }
+
+    inline char *GroupTable::getState(size_t i) const {
+        return records[i] + stateOffset;
+    }
+
+}
@@ -233,18 +233,18 @@ namespace mongo {
 
             switch(e.type()) {
             case Array: {
-                BSONObjBuilder subb;
+                BSONObjBuilder subb(512, OpArena::current());
                 appendArray(subb , e.embeddedObject(), true);
-                b.appendArray(b.numStr(i++), subb.obj());
+                b.appendArray(b.numStr(i++), subb.done());
                 break;
             }
             case Object: {
-                BSONObjBuilder subb;
+                BSONObjBuilder subb(512, OpArena::current());
                 BSONObjIterator jt(e.embeddedObject());
                 while (jt.more()) {
                     append(subb , jt.next());
                 }
-                b.append(b.numStr(i++), subb.obj());
+                b.append(b.numStr(i++), subb.done());
                 break;
             }
             default:
@@ -271,15 +271,15 @@ namespace mongo {
                     b.append(e);
             }
             else if (e.type() == Object) {
-                BSONObjBuilder subb;
+                BSONObjBuilder subb(512, OpArena::current());
                 BSONObjIterator it(e.embeddedObject());
                 while (it.more()) {
                     subfm.append(subb, it.next(), details, arrayOpType);
                 }
-                b.append(e.fieldName(), subb.obj());
+                b.append(e.fieldName(), subb.done());
             }
             else { //Array
-                BSONObjBuilder matchedBuilder;
+                BSONObjBuilder matchedBuilder(512, OpArena::current());
                 if ( details && arrayOpType == ARRAY_OP_POSITIONAL ) {
                     // $ positional operator specified
 
@@ -300,7 +300,7 @@ namespace mongo {
                     // append exact array; no subarray matcher specified
                     subfm.appendArray( matchedBuilder, e.embeddedObject() );
                 }
-                b.appendArray( e.fieldName(), matchedBuilder.obj() );
+                b.appendArray( e.fieldName(), matchedBuilder.done() );
             }
         }
     }
@@ -27,12 +27,19 @@
 #include "mongo/db/parsed_query.h"
 #include "mongo/db/query_plan_selection_policy.h"
 #include "mongo/db/queryutil.h"
+#include "mongo/db/server_parameters.h"
 
 //#define DEBUGQO(x) cout << x << endl;
 #define DEBUGQO(x)
 
 namespace mongo {
 
+    // Whether the optimizer may race index intersection plans alongside single index plans.
+    MONGO_EXPORT_SERVER_PARAMETER( queryIntersectionPlans, bool, true );
+    // Below this many documents a single index scan is cheap enough that racing an intersection
+    // plan only adds work.
+    MONGO_EXPORT_SERVER_PARAMETER( queryIntersectionMinDocuments, int, 1000 );
+
     // returns an IndexDetails* for a hint, 0 if hint is $natural.
     // hint must not be eoo()
     IndexDetails* parseHint( const BSONElement& hint, NamespaceDetails* d ) {
@@ -401,8 +408,8 @@ namespace mongo {
             // Record an optimal plan in the query cache immediately, with a small nscanned value
             // that will be ignored.
             optimalPlan->registerSelf
-                    ( 0, CandidatePlanCharacter( !optimalPlan->scanAndOrderRequired(),
-                                                 optimalPlan->scanAndOrderRequired() ) );
+                    ( 0, 0, CandidatePlanCharacter( !optimalPlan->scanAndOrderRequired(),
+                                                    optimalPlan->scanAndOrderRequired() ) );
             return;
         }
         
@@ -416,9 +423,98 @@ namespace mongo {
             ++i ) {
             _qps.addCandidatePlan( *i );
         }        
+
+        shared_ptr<QueryPlan> intersectionPlan = newIntersectionPlan( d, plans );
+        if ( intersectionPlan ) {
+            _qps.addCandidatePlan( intersectionPlan );
+        }
         
         _qps.addCandidatePlan( newPlan( d, -1 ) );
     }
+
+    /** @return the number of leading fields of an index bounded by a single value. */
+    static int equalityPrefixLength( const FieldRangeVector& frv ) {
+        int n = 0;
+        for( vector<FieldRange>::const_iterator i = frv.ranges().begin();
+             i != frv.ranges().end() && i->equality(); ++i ) {
+            ++n;
+        }
+        return n;
+    }
+
+    shared_ptr<QueryPlan> QueryPlanGenerator::newIntersectionPlan
+            ( NamespaceDetails* d, const vector<shared_ptr<QueryPlan> >& plans ) const {
+        if ( !queryIntersectionPlans || plans.size() < 2 ) {
+            return shared_ptr<QueryPlan>();
+        }
+
+        // Only an index whose leading field is constrained can narrow the result cheaply.
+        vector<shared_ptr<QueryPlan> > candidates;
+        for( vector<shared_ptr<QueryPlan> >::const_iterator i = plans.begin(); i != plans.end();
+             ++i ) {
+            const shared_ptr<FieldRangeVector>& frv = (*i)->frv();
+            if ( frv && !frv->ranges().empty() && !frv->ranges()[ 0 ].universal() ) {
+                candidates.push_back( *i );
+            }
+        }
+        if ( candidates.size() < 2 ||
+             d->queryCacheDocumentCount() < queryIntersectionMinDocuments ) {
+            return shared_ptr<QueryPlan>();
+        }
+
+        // Drive with a plan that provides the requested order, if any, and otherwise with the
+        // one whose bounds are most likely to be selective.
+        shared_ptr<QueryPlan> driver;
+        for( vector<shared_ptr<QueryPlan> >::const_iterator i = candidates.begin();
+             i != candidates.end(); ++i ) {
+            if ( !driver ||
+                 ( driver->scanAndOrderRequired() && !(*i)->scanAndOrderRequired() ) ||
+                 ( driver->scanAndOrderRequired() == (*i)->scanAndOrderRequired() &&
+                   equalityPrefixLength( *(*i)->frv() ) > equalityPrefixLength( *driver->frv() ) ) ) {
+                driver = *i;
+            }
+        }
+
+        // Filter with indexes on other leading fields.  Two indexes with the same leading field
+        // would mostly find the same documents.
+        shared_ptr<QueryPlan> ret = newPlan( d, driver->idxNo() );
+        set<string> leadingFields;
+        leadingFields.insert( driver->indexKey().firstElementFieldName() );
+        for( vector<shared_ptr<QueryPlan> >::const_iterator i = candidates.begin();
+             i != candidates.end() && (int)ret->intersectedPlans().size() < MaxIntersectedPlans;
+             ++i ) {
+            if ( leadingFields.insert( (*i)->indexKey().firstElementFieldName() ).second ) {
+                ret->intersectWith( *i );
+            }
+        }
+        if ( ret->intersectedPlans().empty() ) {
+            return shared_ptr<QueryPlan>();
+        }
+        return ret;
+    }
+
+    shared_ptr<QueryPlan> QueryPlanGenerator::intersectionPlanForKey
+            ( NamespaceDetails* d, const BSONObj& planKey ) const {
+        vector<BSONElement> keys = planKey.firstElement().Array();
+        shared_ptr<QueryPlan> ret;
+        for( vector<BSONElement>::const_iterator i = keys.begin(); i != keys.end(); ++i ) {
+            const int idxNo = d->findIndexByKeyPattern( i->Obj() );
+            if ( idxNo < 0 ) {
+                return shared_ptr<QueryPlan>();
+            }
+            shared_ptr<QueryPlan> p = newPlan( d, idxNo );
+            if ( p->utility() != QueryPlan::Helpful || !p->special().empty() ) {
+                return shared_ptr<QueryPlan>();
+            }
+            if ( !ret ) {
+                ret = p;
+            }
+            else {
+                ret->intersectWith( p );
+            }
+        }
+        return ret;
+    }
     
     bool QueryPlanGenerator::addShortCircuitPlan( NamespaceDetails* d ) {
         return
@@ -518,6 +614,14 @@ namespace mongo {
         if ( str::equals( bestIndex.firstElementFieldName(), "$natural" ) ) {
             p = newPlan( d, -1 );
         }
+        else if ( str::equals( bestIndex.firstElementFieldName(), "$intersect" ) ) {
+            // The recorded indexes still exist (the cache is cleared when indexes change), but
+            // with different constraints an intersection may no longer be possible.
+            p = intersectionPlanForKey( d, bestIndex );
+            if ( !p ) {
+                return false;
+            }
+        }
         
         NamespaceDetails::IndexIterator i = d->ii();
         while( i.more() ) {
@@ -705,7 +809,7 @@ namespace mongo {
     void QueryPlanSet::addCandidatePlan( const QueryPlanPtr& plan ) {
         // If _plans is nonempty, the new plan may be supplementing a recorded plan at the first
         // position of _plans.  It must not duplicate the first plan.
-        if ( nPlans() > 0 && plan->indexKey() == firstPlan()->indexKey() ) {
+        if ( nPlans() > 0 && plan->planKey() == firstPlan()->planKey() ) {
             return;
         }
         pushPlan( plan );
@@ -935,6 +1039,7 @@ namespace mongo {
         if ( runner.complete() ) {
             if ( _plans.mayRecordPlan() && runner.mayRecordPlan() ) {
                 runner.queryPlan().registerSelf( runner.nscanned(),
+                                                 runner.nmatches(),
                                                  _plans.characterizeCandidatePlans() );
             }
             _done = true;
@@ -142,6 +142,9 @@ namespace mongo {
          */
         long long nscanned() const;
 
+        /** @return the number of distinct matches this runner has counted. */
+        int nmatches() const { return _matchCounter.count(); }
+
         BSONObj currPK() const { return _c ? _c->currPK() : BSONObj(); }
         BSONObj currKey() const { return _c ? _c->currKey() : BSONObj(); }
         BSONObj current() const { return _c ? _c->current() : BSONObj(); }
@@ -306,6 +309,20 @@ namespace mongo {
 
         bool addCachedPlan( NamespaceDetails* d );
 
+        /** The most indexes an intersection plan filters its own index scan with. */
+        static const int MaxIntersectedPlans = 2;
+
+        /**
+         * @return a plan intersecting some of the candidate 'plans', or an empty pointer if no
+         * intersection looks worth trying.
+         */
+        shared_ptr<QueryPlan> newIntersectionPlan( NamespaceDetails* d,
+                                                   const vector<shared_ptr<QueryPlan> >& plans ) const;
+
+        /** @return the intersection plan recorded in the plan cache as 'planKey', if possible. */
+        shared_ptr<QueryPlan> intersectionPlanForKey( NamespaceDetails* d,
+                                                      const BSONObj& planKey ) const;
+
         shared_ptr<QueryPlan> newPlan( NamespaceDetails* d,
                                        int idxNo,
                                        const BSONObj& min = BSONObj(),
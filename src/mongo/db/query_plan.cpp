@@ -279,11 +279,21 @@ doneCheckOrder:
                                                           _direction >= 0 ? 1 : -1 ) );
         }
 
-        return shared_ptr<Cursor>( IndexCursor::make( _d,
-                                                      *_index,
-                                                      _frv,
-                                                      independentRangesSingleIntervalLimit(),
-                                                      _direction >= 0 ? 1 : -1 ) );
+        shared_ptr<Cursor> c( IndexCursor::make( _d,
+                                                 *_index,
+                                                 _frv,
+                                                 independentRangesSingleIntervalLimit(),
+                                                 _direction >= 0 ? 1 : -1 ) );
+        if ( _intersected.empty() ) {
+            return c;
+        }
+
+        vector<shared_ptr<Cursor> > filters;
+        for( vector<shared_ptr<QueryPlan> >::const_iterator i = _intersected.begin();
+             i != _intersected.end(); ++i ) {
+            filters.push_back( (*i)->newCursor() );
+        }
+        return shared_ptr<Cursor>( new IntersectionCursor( c, filters ) );
     }
 
     shared_ptr<Cursor> QueryPlan::newReverseCursor() const {
@@ -303,11 +313,37 @@ doneCheckOrder:
         return _index->keyPattern();
     }
 
+    BSONObj QueryPlan::planKey() const {
+        if ( _intersected.empty() ) {
+            return indexKey();
+        }
+        BSONArrayBuilder keys;
+        keys.append( indexKey() );
+        for( vector<shared_ptr<QueryPlan> >::const_iterator i = _intersected.begin();
+             i != _intersected.end(); ++i ) {
+            keys.append( (*i)->indexKey() );
+        }
+        return BSON( "$intersect" << keys.arr() );
+    }
+
+    void QueryPlan::intersectWith( const shared_ptr<QueryPlan>& other ) {
+        verify( indexed() && _special.empty() && !_startOrEndSpec );
+        verify( other->indexed() && other->special().empty() && other->nsd() == _d );
+        verify( other->idxNo() != _idxNo );
+        _intersected.push_back( other );
+        // Other predicates are only known to hold for the documents in the intersection.
+        _matcherNecessary = true;
+        if ( _utility == Optimal ) {
+            _utility = Helpful;
+        }
+    }
+
     const char* QueryPlan::ns() const {
         return _frs.ns();
     }
 
     void QueryPlan::registerSelf( long long nScanned,
+                                  long long nReturned,
                                   CandidatePlanCharacter candidatePlans ) const {
         // Impossible query constraints can be detected before scanning and historically could not
         // generate a QueryPattern.
@@ -319,7 +355,7 @@ doneCheckOrder:
         if (d != NULL) {
             NamespaceDetails::QueryCacheRWLock::Exclusive lk(d);
             QueryPattern queryPattern = _frs.pattern( _order );
-            CachedQueryPlan queryPlanToCache( indexKey(), nScanned, candidatePlans );
+            CachedQueryPlan queryPlanToCache( planKey(), nScanned, candidatePlans, nReturned );
             d->registerCachedQueryPlanForPattern( queryPattern, queryPlanToCache );
         }
     }
@@ -458,7 +494,7 @@ doneCheckOrder:
 
     string QueryPlan::toString() const {
         return BSON(
-                    "index" << indexKey() <<
+                    "index" << planKey() <<
                     "frv" << ( _frv ? _frv->toString() : "" ) <<
                     "order" << _order
                     ).jsonString();
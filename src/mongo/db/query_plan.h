@@ -95,13 +95,35 @@ namespace mongo {
         /** @return a new reverse cursor if this is an unindexed plan. */
         shared_ptr<Cursor> newReverseCursor() const;
 
-        /** Register this plan as a winner for its QueryPattern, with specified 'nscanned'. */
-        void registerSelf( long long nScanned, CandidatePlanCharacter candidatePlans ) const;
+        /**
+         * Register this plan as a winner for its QueryPattern, with the 'nscanned' and
+         * 'nreturned' it was observed to have.
+         */
+        void registerSelf( long long nScanned, long long nReturned,
+                           CandidatePlanCharacter candidatePlans ) const;
+
+        /**
+         * Make this an index intersection plan: in addition to its own index scan, only documents
+         * whose primary keys are found by the index scan of 'other' will be fetched.  'other' must
+         * be an indexed, non special plan over a different index of the same collection.  The
+         * results are the same as without the intersection, so matching, ordering and $or clause
+         * handling continue to be based on this plan's own index.
+         */
+        void intersectWith( const shared_ptr<QueryPlan>& other );
+
+        /** @return the plans this plan is intersected with, if any. */
+        const vector<shared_ptr<QueryPlan> >& intersectedPlans() const { return _intersected; }
 
         int direction() const { return _direction; }
 
         BSONObj indexKey() const;
 
+        /**
+         * @return the key identifying this plan in the query plan cache: indexKey(), or for an
+         * intersection plan { $intersect : [ <indexKey()>, <intersected index keys>... ] }.
+         */
+        BSONObj planKey() const;
+
         bool indexed() const { return _index != 0; }
 
         const IndexDetails* index() const { return _index; }
@@ -175,6 +197,7 @@ namespace mongo {
         bool _startOrEndSpec;
         shared_ptr<Projection::KeyOnly> _keyFieldsOnly;
         mutable shared_ptr<CoveredIndexMatcher> _matcher; // Lazy initialization.
+        vector<shared_ptr<QueryPlan> > _intersected;
     };
 
     std::ostream &operator<< ( std::ostream& out, const QueryPlan::Utility& utility );
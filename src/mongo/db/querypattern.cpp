@@ -17,6 +17,7 @@
 
 #include "querypattern.h"
 #include "mongo/db/queryutil.h"
+#include "mongo/util/mongoutils/str.h"
 
 namespace mongo {
 
@@ -86,6 +87,44 @@ namespace mongo {
         }
         return BSON( "query" << b.done() << "sort" << _sort ).toString();
     }
+
+    static bool typeFromString( const StringData &s, QueryPattern::Type *t ) {
+        for( int i = QueryPattern::Empty; i <= QueryPattern::ConstraintPresent; ++i ) {
+            QueryPattern::Type candidate = static_cast<QueryPattern::Type>( i );
+            if ( s == typeToString( candidate ) ) {
+                *t = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    BSONObj QueryPattern::toBSON() const {
+        BSONObjBuilder b;
+        for( map<string,Type>::const_iterator i = _fieldTypes.begin(); i != _fieldTypes.end(); ++i ) {
+            b << i->first << typeToString( i->second );
+        }
+        return BSON( "query" << b.done() << "sort" << _sort );
+    }
+
+    QueryPattern QueryPattern::fromBSON( const BSONObj &obj ) {
+        BSONElement query = obj[ "query" ];
+        BSONElement sort = obj[ "sort" ];
+        uassert( 17021, "query pattern must have 'query' and 'sort' objects",
+                 query.type() == Object && sort.type() == Object );
+        QueryPattern ret;
+        BSONObjIterator i( query.embeddedObject() );
+        while( i.more() ) {
+            BSONElement e = i.next();
+            Type t;
+            uassert( 17022, mongoutils::str::stream() << "bad query pattern type for field " << e.fieldName(),
+                     e.type() == String && typeFromString( e.valuestr(), &t ) );
+            ret._fieldTypes[ e.fieldName() ] = t;
+        }
+        // The saved sort was already normalized.
+        ret._sort = sort.embeddedObject().getOwned();
+        return ret;
+    }
     
     void QueryPattern::setSort( const BSONObj sort ) {
         _sort = normalizeSort( sort );
@@ -107,11 +146,35 @@ namespace mongo {
     }
     
     CachedQueryPlan::CachedQueryPlan( const BSONObj &indexKey, long long nScanned,
-                                     CandidatePlanCharacter planCharacter ) :
+                                     CandidatePlanCharacter planCharacter, long long nReturned,
+                                     bool pinned ) :
     _indexKey( indexKey ),
     _nScanned( nScanned ),
+    _nReturned( nReturned ),
+    _pinned( pinned ),
     _planCharacter( planCharacter ) {
     }
 
+    BSONObj CachedQueryPlan::toBSON() const {
+        return BSON( "index" << _indexKey <<
+                     "nscanned" << _nScanned <<
+                     "nreturned" << _nReturned <<
+                     "inOrder" << _planCharacter.mayRunInOrderPlan() <<
+                     "outOfOrder" << _planCharacter.mayRunOutOfOrderPlan() <<
+                     "pinned" << _pinned );
+    }
+
+    CachedQueryPlan CachedQueryPlan::fromBSON( const BSONObj &obj ) {
+        BSONElement index = obj[ "index" ];
+        uassert( 17023, "cached query plan must have an 'index' key pattern",
+                 index.type() == Object && !index.embeddedObject().isEmpty() );
+        return CachedQueryPlan( index.embeddedObject().getOwned(),
+                                obj[ "nscanned" ].numberLong(),
+                                CandidatePlanCharacter( obj[ "inOrder" ].trueValue(),
+                                                        obj[ "outOfOrder" ].trueValue() ),
+                                obj[ "nreturned" ].numberLong(),
+                                obj[ "pinned" ].trueValue() );
+    }
+
     
 } // namespace mongo
@@ -49,7 +49,12 @@ namespace mongo {
         bool operator!=( const QueryPattern &other ) const;
         /** for development / debugging */
         string toString() const;
+        /** @return a BSON description of the pattern, which fromBSON() can read back. */
+        BSONObj toBSON() const;
+        /** Rebuild a pattern saved by toBSON().  uasserts if obj is malformed. */
+        static QueryPattern fromBSON( const BSONObj &obj );
     private:
+        QueryPattern() {}
         void setSort( const BSONObj sort );
         static BSONObj normalizeSort( const BSONObj &spec );
         map<string,Type> _fieldTypes;
@@ -76,20 +81,35 @@ namespace mongo {
         bool _mayRunOutOfOrderPlan;
     };
 
-    /** Information about a query plan that ran successfully for a QueryPattern. */
+    /**
+     * Information about a query plan that ran successfully for a QueryPattern, along with the
+     * nscanned / nreturned counts observed when it won.  A pinned plan was set explicitly with
+     * the planCache command and is not replaced by the optimizer.
+     */
     class CachedQueryPlan {
     public:
         CachedQueryPlan() :
-        _nScanned() {
+        _nScanned(),
+        _nReturned(),
+        _pinned() {
         }
         CachedQueryPlan( const BSONObj &indexKey, long long nScanned,
-                        CandidatePlanCharacter planCharacter );
+                        CandidatePlanCharacter planCharacter, long long nReturned = 0,
+                        bool pinned = false );
         BSONObj indexKey() const { return _indexKey; }
         long long nScanned() const { return _nScanned; }
+        long long nReturned() const { return _nReturned; }
+        bool pinned() const { return _pinned; }
         CandidatePlanCharacter planCharacter() const { return _planCharacter; }
+        /** @return a BSON description of the plan, which fromBSON() can read back. */
+        BSONObj toBSON() const;
+        /** Rebuild a plan saved by toBSON().  uasserts if obj is malformed. */
+        static CachedQueryPlan fromBSON( const BSONObj &obj );
     private:
         BSONObj _indexKey;
         long long _nScanned;
+        long long _nReturned;
+        bool _pinned;
         CandidatePlanCharacter _planCharacter;
     };
 
@@ -63,6 +63,8 @@ namespace mongo {
         CollectionData& coll = _usage[ns];
         _record( coll , op , lockType , micros , command );
         _record( _global , op , lockType , micros , command );
+        _recordLatency( _latency[ns] , op , micros , command );
+        _recordLatency( _globalLatency , op , micros , command );
     }
 
     void Top::_record( CollectionData& c , int op , int lockType , long long micros , bool command ) {
@@ -107,10 +109,40 @@ namespace mongo {
 
     }
 
+    void Top::_recordLatency( LatencyData& l , int op , long long micros , bool command ) {
+        const uint64_t m = micros > 0 ? micros : 0;
+        l.total.insert( m );
+
+        // unknown and unexpected ops were already logged by _record
+        switch ( op ) {
+        case dbUpdate:
+            l.update.insert( m );
+            break;
+        case dbInsert:
+            l.insert.insert( m );
+            break;
+        case dbQuery:
+            if ( command )
+                l.commands.insert( m );
+            else
+                l.queries.insert( m );
+            break;
+        case dbGetMore:
+            l.getmore.insert( m );
+            break;
+        case dbDelete:
+            l.remove.insert( m );
+            break;
+        default:
+            break;
+        }
+    }
+
     void Top::collectionDropped( const StringData& ns ) {
         //cout << "collectionDropped: " << ns << endl;
         SimpleMutex::scoped_lock lk(_lock);
         _usage.erase(ns);
+        _latency.erase(ns);
         _lastDropped = ns.toString();
     }
 
@@ -121,10 +153,23 @@ namespace mongo {
 
     void Top::append( BSONObjBuilder& b ) {
         SimpleMutex::scoped_lock lk( _lock );
-        _appendToUsageMap( b , _usage );
+        _appendToUsageMap( b , _usage , _latency );
+    }
+
+    void Top::appendGlobalLatencies( BSONObjBuilder& b ) const {
+        SimpleMutex::scoped_lock lk( _lock );
+        b.append( "note" , "all times in microseconds" );
+        const LatencyData& l = _globalLatency;
+        _appendLatencyEntry( b , "total" , l.total );
+        _appendLatencyEntry( b , "queries" , l.queries );
+        _appendLatencyEntry( b , "getmore" , l.getmore );
+        _appendLatencyEntry( b , "insert" , l.insert );
+        _appendLatencyEntry( b , "update" , l.update );
+        _appendLatencyEntry( b , "remove" , l.remove );
+        _appendLatencyEntry( b , "commands" , l.commands );
     }
 
-    void Top::_appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ) const {
+    void Top::_appendToUsageMap( BSONObjBuilder& b , const UsageMap& map , const LatencyMap& latencies ) const {
         // pull all the names into a vector so we can sort them for the user
         
         vector<string> names;
@@ -138,30 +183,53 @@ namespace mongo {
             BSONObjBuilder bb( b.subobjStart( names[i] ) );
 
             const CollectionData& coll = map.find(names[i])->second;
+            // recorded and dropped along with the usage, so it's always there
+            const LatencyData& l = latencies.find(names[i])->second;
 
-            _appendStatsEntry( b , "total" , coll.total );
+            _appendStatsEntry( b , "total" , coll.total , &l.total );
 
             _appendStatsEntry( b , "readLock" , coll.readLock );
             _appendStatsEntry( b , "writeLock" , coll.writeLock );
 
-            _appendStatsEntry( b , "queries" , coll.queries );
-            _appendStatsEntry( b , "getmore" , coll.getmore );
-            _appendStatsEntry( b , "insert" , coll.insert );
-            _appendStatsEntry( b , "update" , coll.update );
-            _appendStatsEntry( b , "remove" , coll.remove );
-            _appendStatsEntry( b , "commands" , coll.commands );
+            _appendStatsEntry( b , "queries" , coll.queries , &l.queries );
+            _appendStatsEntry( b , "getmore" , coll.getmore , &l.getmore );
+            _appendStatsEntry( b , "insert" , coll.insert , &l.insert );
+            _appendStatsEntry( b , "update" , coll.update , &l.update );
+            _appendStatsEntry( b , "remove" , coll.remove , &l.remove );
+            _appendStatsEntry( b , "commands" , coll.commands , &l.commands );
 
             bb.done();
         }
     }
 
-    void Top::_appendStatsEntry( BSONObjBuilder& b , const char * statsName , const UsageData& map ) const {
+    void Top::_appendStatsEntry( BSONObjBuilder& b , const char * statsName , const UsageData& map ,
+                                 const LatencyHistogram* latency ) const {
         BSONObjBuilder bb( b.subobjStart( statsName ) );
         bb.appendNumber( "time" , map.time );
         bb.appendNumber( "count" , map.count );
+        if ( latency && latency->getCount() > 0 ) {
+            BSONObjBuilder lb( bb.subobjStart( "latency" ) );
+            _appendPercentiles( lb , *latency );
+            lb.done();
+        }
         bb.done();
     }
 
+    void Top::_appendLatencyEntry( BSONObjBuilder& b , const char * statsName , const LatencyHistogram& h ) const {
+        BSONObjBuilder bb( b.subobjStart( statsName ) );
+        bb.appendNumber( "count" , static_cast<long long>( h.getCount() ) );
+        _appendPercentiles( bb , h );
+        bb.done();
+    }
+
+    void Top::_appendPercentiles( BSONObjBuilder& b , const LatencyHistogram& h ) const {
+        // each is the top of the histogram bucket the percentile falls in
+        b.appendNumber( "p50" , static_cast<long long>( h.getPercentile( 0.5 ) ) );
+        b.appendNumber( "p95" , static_cast<long long>( h.getPercentile( 0.95 ) ) );
+        b.appendNumber( "p99" , static_cast<long long>( h.getPercentile( 0.99 ) ) );
+        b.appendNumber( "p999" , static_cast<long long>( h.getPercentile( 0.999 ) ) );
+    }
+
     class TopCmd : public WebInformationCommand {
     public:
         TopCmd() : WebInformationCommand("top") {}
@@ -19,6 +19,7 @@
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include "mongo/util/histogram.h"
 #include "mongo/util/string_map.h"
 
 namespace mongo {
@@ -65,9 +66,28 @@ namespace mongo {
 
         typedef StringMap<CollectionData> UsageMap;
 
+        /**
+         * latency distributions by operation type, kept apart from CollectionData so that
+         * snapshots, which copy every CollectionData, don't copy these too
+         */
+        struct LatencyData {
+            LatencyHistogram total;
+
+            LatencyHistogram queries;
+            LatencyHistogram getmore;
+            LatencyHistogram insert;
+            LatencyHistogram update;
+            LatencyHistogram remove;
+            LatencyHistogram commands;
+        };
+
+        typedef StringMap<LatencyData> LatencyMap;
+
     public:
         void record( const StringData& ns , int op , int lockType , long long micros , bool command );
         void append( BSONObjBuilder& b );
+        /** latency percentiles of each operation type, over all collections */
+        void appendGlobalLatencies( BSONObjBuilder& b ) const;
         void cloneMap(UsageMap& out) const;
         CollectionData getGlobalData() const { return _global; }
         void collectionDropped( const StringData& ns );
@@ -76,13 +96,19 @@ namespace mongo {
         static Top global;
 
     private:
-        void _appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ) const;
-        void _appendStatsEntry( BSONObjBuilder& b , const char * statsName , const UsageData& map ) const;
+        void _appendToUsageMap( BSONObjBuilder& b , const UsageMap& map , const LatencyMap& latencies ) const;
+        void _appendStatsEntry( BSONObjBuilder& b , const char * statsName , const UsageData& map ,
+                                const LatencyHistogram* latency = NULL ) const;
+        void _appendLatencyEntry( BSONObjBuilder& b , const char * statsName , const LatencyHistogram& h ) const;
+        void _appendPercentiles( BSONObjBuilder& b , const LatencyHistogram& h ) const;
         void _record( CollectionData& c , int op , int lockType , long long micros , bool command );
+        void _recordLatency( LatencyData& l , int op , long long micros , bool command );
 
         mutable SimpleMutex _lock;
         CollectionData _global;
         UsageMap _usage;
+        LatencyData _globalLatency;
+        LatencyMap _latency;
         string _lastDropped;
     };
 
@@ -40,6 +40,7 @@
 #include "mongo/db/storage/dbt.h"
 #include "mongo/db/storage/exception.h"
 #include "mongo/db/storage/key.h"
+#include "mongo/db/storage/update_diff.h"
 #include "mongo/util/assert_util.h"
 #include "mongo/util/log.h"
 
@@ -93,16 +94,10 @@ namespace mongo {
                 verify(dest_db != src_db);
 
                 // Generate keys for a secondary index.
-                BSONObjSet keys;
-                descriptor.generateKeys(obj, keys);
-                dbt_array_clear_and_resize(dest_keys, keys.size());
-                for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); i++) {
-                    const Key sKey(*i, &pk);
-                    dbt_array_push(dest_keys, sKey.buf(), sKey.size());
-                }
+                const size_t nKeys = descriptor.generateKeys(obj, pk, dest_keys);
                 // Set the multiKey bool if it's provided and we generated multiple keys.
                 // See NamespaceDetails::Indexer::Indexer()
-                if (dest_db->app_private != NULL && keys.size() > 1) {
+                if (dest_db->app_private != NULL && nKeys > 1) {
                     bool *multiKey = reinterpret_cast<bool *>(dest_db->app_private);
                     if (!*multiKey) {
                         *multiKey = true;
@@ -150,6 +145,35 @@ namespace mongo {
             return 0; 
         }
 
+        // Applies the update messages NamespaceDetails sends the primary key instead of a whole
+        // new row: diffs from updateObject() and mods from updateObjectMods().  This may run in
+        // any thread, whenever the ydb applies the message.  Not calling set_val leaves the row
+        // as it was.
+        static int update_callback(DB *db, const DBT *key, const DBT *old_val, const DBT *extra,
+                                   void (*set_val)(const DBT *new_val, void *set_extra),
+                                   void *set_extra) {
+            try {
+                if (old_val == NULL) {
+                    // the row is gone, nothing to update
+                    return 0;
+                }
+                const BSONObj oldObj(reinterpret_cast<const char *>(old_val->data));
+                const BSONObj msg(reinterpret_cast<const char *>(extra->data));
+                BSONObj newObj;
+                if (applyUpdateMessage(oldObj, msg, newObj)) {
+                    const DBT new_val = dbt_make(newObj.objdata(), newObj.objsize());
+                    set_val(&new_val, set_extra);
+                }
+            } catch (const DBException &ex) {
+                verify(ex.getCode() > 0);
+                return ex.getCode();
+            } catch (const std::exception &ex) {
+                problem() << "Unhandled std::exception in storage::update_callback()" << endl;
+                verify(false);
+            }
+            return 0;
+        }
+
         static uint64_t calculate_cachesize(void) {
             uint64_t physmem, maxdata;
             physmem = toku_os_get_phys_memory_size();
@@ -238,6 +262,11 @@ namespace mongo {
                 handle_ydb_error_fatal(r);
             }
 
+            r = env->set_update(env, update_callback);
+            if (r != 0) {
+                handle_ydb_error_fatal(r);
+            }
+
             r = env->set_lock_timeout_callback(env, lock_not_granted_callback);
             if (r != 0) {
                 handle_ydb_error_fatal(r);
@@ -416,6 +445,107 @@ namespace mongo {
             }
         }
 
+        // Engine status rows are picked out by the prefix of their key name.  Rows this version
+        // of the engine doesn't have just don't show up.
+        static const struct {
+            const char *prefix;
+            const char *section;
+        } engine_stats_sections[] = {
+            { "CT_", "cachetable" },
+            { "FT_PARTIAL_EVICTIONS_", "evictions" },
+            { "FT_FULL_EVICTIONS_", "evictions" },
+            { "FT_NUM_BASEMENTS_", "nodeReads" },
+            { "FT_NUM_MSG_BUFFER_", "nodeReads" },
+            { "FT_NUM_PIVOTS_", "nodeReads" },
+            { "FT_BYTES_", "nodeReads" },
+            { "FT_NANOTIME_", "nodeReads" },
+            { "FT_DISK_FLUSH_", "nodeWrites" },
+            { "FT_FLUSHER_", "messageBufferFlushes" },
+            { "CP_", "checkpoint" },
+        };
+        static const size_t num_engine_stats_sections =
+                sizeof(engine_stats_sections) / sizeof(engine_stats_sections[0]);
+
+        void get_engine_stats(BSONObjBuilder &stats) {
+            uint64_t num_rows;
+            uint64_t max_rows;
+            uint64_t panic;
+            size_t panic_string_len = 128;
+            char panic_string[panic_string_len];
+            fs_redzone_state redzone_state;
+
+            int r = storage::env->get_engine_status_num_rows(storage::env, &max_rows);
+            if (r != 0) {
+                handle_ydb_error(r);
+            }
+            TOKU_ENGINE_STATUS_ROW_S mystat[max_rows];
+            r = env->get_engine_status(env, mystat, max_rows, &num_rows, &redzone_state, &panic, panic_string, panic_string_len, TOKU_ENGINE_STATUS);
+            if (r != 0) {
+                handle_ydb_error(r);
+            }
+
+            map<string, shared_ptr<BSONObjBuilder> > sections;
+            long long checkpoint_begin = -1, checkpoint_end = -1;
+            for (uint64_t i = 0; i < num_rows; i++) {
+                TOKU_ENGINE_STATUS_ROW row = &mystat[i];
+                const char *section = NULL;
+                for (size_t j = 0; j < num_engine_stats_sections; j++) {
+                    if (str::startsWith(row->keyname, engine_stats_sections[j].prefix)) {
+                        section = engine_stats_sections[j].section;
+                        break;
+                    }
+                }
+                if (section == NULL) {
+                    continue;
+                }
+
+                long long v;
+                switch (row->type) {
+                case FS_STATE:
+                case UINT64:
+                case UNIXTIME:
+                    v = row->value.num;
+                    break;
+                case TOKUTIME:
+                    // micros, so it stays an integer
+                    v = (long long) (tokutime_to_seconds(row->value.num) * 1000000);
+                    break;
+                case PARCOUNT:
+                    v = read_partitioned_counter(row->value.parcount);
+                    break;
+                default:
+                    continue;
+                }
+                if (str::equals(row->keyname, "CP_TIME_LAST_CHECKPOINT_BEGIN")) {
+                    checkpoint_begin = v;
+                }
+                else if (str::equals(row->keyname, "CP_TIME_LAST_CHECKPOINT_END")) {
+                    checkpoint_end = v;
+                }
+
+                shared_ptr<BSONObjBuilder> &b = sections[section];
+                if (!b) {
+                    b.reset(new BSONObjBuilder());
+                }
+                b->appendNumber(row->keyname, v);
+            }
+
+            map<string, shared_ptr<BSONObjBuilder> >::iterator cp = sections.find("checkpoint");
+            if (cp != sections.end() && checkpoint_begin > 0 && checkpoint_end >= checkpoint_begin) {
+                cp->second->appendNumber("lastDurationSecs", checkpoint_end - checkpoint_begin);
+            }
+
+            // in the table's order, so samples line up
+            for (size_t j = 0; j < num_engine_stats_sections; j++) {
+                map<string, shared_ptr<BSONObjBuilder> >::iterator it =
+                        sections.find(engine_stats_sections[j].section);
+                if (it != sections.end()) {
+                    stats.append(it->first, it->second->obj());
+                    sections.erase(it);
+                }
+            }
+        }
+
         static BSONObj pretty_key(const DBT *key, DB *db) {
             BSONObjBuilder b;
             const Key sKey(key);
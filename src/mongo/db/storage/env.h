@@ -36,6 +36,10 @@ namespace mongo {
         void db_rename(const string &old_name, const string &new_name);
 
         void get_status(BSONObjBuilder &status);
+        // The engine status counters for the cachetable, node reads and writes, evictions,
+        // message buffer flushes and checkpoints, grouped by subsystem, all as numbers so that
+        // two samples can be subtracted.
+        void get_engine_stats(BSONObjBuilder &stats);
         void get_pending_lock_request_status(BSONObjBuilder &status);
         void get_live_transaction_status(BSONObjBuilder &status);
         void log_flush();
@@ -92,112 +92,128 @@ namespace mongo {
         // fromBSON to KeyV1 format
         KeyV1Owned::KeyV1Owned(const BSONObj& obj) {
             BSONObj::iterator i(obj);
-            unsigned char bits = 0;
             while( 1 ) { 
                 BSONElement e = i.next();
-                if( i.more() )
-                    bits |= cHASMORE;
-                switch( e.type() ) { 
-                case MinKey:
-                    b.appendUChar(cminkey|bits);
-                    break;
-                case jstNULL:
-                    b.appendUChar(cnull|bits);
-                    break;
-                case MaxKey:
-                    b.appendUChar(cmaxkey|bits);
-                    break;
-                case Bool:
-                    b.appendUChar( (e.boolean()?ctrue:cfalse) | bits );
-                    break;
-                case jstOID:
-                    b.appendUChar(coid|bits);
-                    b.appendBuf(&e.__oid(), sizeof(OID));
+                if( !appendElement(e, i.more() ? cHASMORE : 0) ) {
+                    traditional(obj);
+                    return;
+                }
+                if( !i.more() )
                     break;
-                case BinData:
-                    {
-                        int t = e.binDataType();
-                        // 0-7 and 0x80 to 0x87 are supported by KeyV1
-                        if( (t & 0x78) == 0 && t != ByteArrayDeprecated ) {
-                            int len;
-                            const char * d = e.binData(len);
-                            if( len <= BinDataLenMax ) {
-                                int code = BinDataLengthToCode[len];
-                                if( code >= 0 ) {
-                                    if( t >= 128 )
-                                        t = (t-128) | 0x08;
-                                    dassert( (code&t) == 0 );
-                                    b.appendUChar( cbindata|bits );
-                                    b.appendUChar( code | t );
-                                    b.appendBuf(d, len);
-                                    break;
-                                }
+            }
+            _keyData = (const unsigned char *) b.buf();
+            dassert( b.len() == dataSize() ); // check datasize method is correct
+            dassert( (*_keyData & cNOTUSED) == 0 );
+        }
+
+        KeyV1Owned::KeyV1Owned(const BSONElement *elts, const size_t n) {
+            dassert( n > 0 );
+            for( size_t i = 0; i < n; i++ ) {
+                if( !appendElement(elts[i], i + 1 < n ? cHASMORE : 0) ) {
+                    BSONObjBuilder bob(b.len() + 64);
+                    for( size_t j = 0; j < n; j++ ) {
+                        bob.appendAs(elts[j], "");
+                    }
+                    traditional(bob.done());
+                    return;
+                }
+            }
+            _keyData = (const unsigned char *) b.buf();
+            dassert( b.len() == dataSize() ); // check datasize method is correct
+            dassert( (*_keyData & cNOTUSED) == 0 );
+        }
+
+        bool KeyV1Owned::appendElement(const BSONElement &e, const unsigned char bits) {
+            switch( e.type() ) { 
+            case MinKey:
+                b.appendUChar(cminkey|bits);
+                break;
+            case jstNULL:
+                b.appendUChar(cnull|bits);
+                break;
+            case MaxKey:
+                b.appendUChar(cmaxkey|bits);
+                break;
+            case Bool:
+                b.appendUChar( (e.boolean()?ctrue:cfalse) | bits );
+                break;
+            case jstOID:
+                b.appendUChar(coid|bits);
+                b.appendBuf(&e.__oid(), sizeof(OID));
+                break;
+            case BinData:
+                {
+                    int t = e.binDataType();
+                    // 0-7 and 0x80 to 0x87 are supported by KeyV1
+                    if( (t & 0x78) == 0 && t != ByteArrayDeprecated ) {
+                        int len;
+                        const char * d = e.binData(len);
+                        if( len <= BinDataLenMax ) {
+                            int code = BinDataLengthToCode[len];
+                            if( code >= 0 ) {
+                                if( t >= 128 )
+                                    t = (t-128) | 0x08;
+                                dassert( (code&t) == 0 );
+                                b.appendUChar( cbindata|bits );
+                                b.appendUChar( code | t );
+                                b.appendBuf(d, len);
+                                break;
                             }
                         }
-                        traditional(obj);
-                        return;
                     }
-                case Date:
-                    b.appendUChar(cdate|bits);
-                    b.appendStruct(e.date());
-                    break;
-                case String:
-                    {
-                        b.appendUChar(cstring|bits);
-                        // note we do not store the terminating null, to save space.
-                        unsigned x = (unsigned) e.valuestrsize() - 1;
-                        if( x > 255 ) { 
-                            traditional(obj);
-                            return;
-                        }
-                        b.appendUChar(x);
-                        b.appendBuf(e.valuestr(), x);
-                        break;
+                    return false;
+                }
+            case Date:
+                b.appendUChar(cdate|bits);
+                b.appendStruct(e.date());
+                break;
+            case String:
+                {
+                    // note we do not store the terminating null, to save space.
+                    unsigned x = (unsigned) e.valuestrsize() - 1;
+                    if( x > 255 ) { 
+                        return false;
                     }
-                case NumberInt:
-                    b.appendUChar(cint|bits);
-                    b.appendNum((double) e._numberInt());
+                    b.appendUChar(cstring|bits);
+                    b.appendUChar(x);
+                    b.appendBuf(e.valuestr(), x);
                     break;
-                case NumberLong:
-                    {
-                        long long n = e._numberLong();
-                        long long m = 2LL << 52;
-                        DEV {
-                            long long d = m-1;
-                            verify( ((long long) ((double) -d)) == -d );
-                        }
-                        if( n >= m || n <= -m ) {
-                            // can't represent exactly as a double
-                            traditional(obj);
-                            return;
-                        }
-                        b.appendUChar(clong|bits);
-                        b.appendNum((double) n);
-                        break;
+                }
+            case NumberInt:
+                b.appendUChar(cint|bits);
+                b.appendNum((double) e._numberInt());
+                break;
+            case NumberLong:
+                {
+                    long long n = e._numberLong();
+                    long long m = 2LL << 52;
+                    DEV {
+                        long long d = m-1;
+                        verify( ((long long) ((double) -d)) == -d );
                     }
-                case NumberDouble:
-                    {
-                        double d = e._numberDouble();
-                        if( isNaN(d) ) {
-                            traditional(obj);
-                            return;
-                        }
-                        b.appendUChar(cdouble|bits);
-                        b.appendNum(d);
-                        break;
+                    if( n >= m || n <= -m ) {
+                        // can't represent exactly as a double
+                        return false;
                     }
-                default:
-                    // if other types involved, store as traditional BSON
-                    traditional(obj);
-                    return;
+                    b.appendUChar(clong|bits);
+                    b.appendNum((double) n);
+                    break;
                 }
-                if( !i.more() )
+            case NumberDouble:
+                {
+                    double d = e._numberDouble();
+                    if( isNaN(d) ) {
+                        return false;
+                    }
+                    b.appendUChar(cdouble|bits);
+                    b.appendNum(d);
                     break;
-                bits = 0;
+                }
+            default:
+                // if other types involved, store as traditional BSON
+                return false;
             }
-            _keyData = (const unsigned char *) b.buf();
-            dassert( b.len() == dataSize() ); // check datasize method is correct
-            dassert( (*_keyData & cNOTUSED) == 0 );
+            return true;
         }
 
         BSONObj KeyV1::toBson(BufBuilder &bb) const { 
@@ -272,6 +288,40 @@ namespace mongo {
             return b.done();
         }
 
+        static unsigned sizes[] = {
+            0,
+            1, //cminkey=1,
+            1, //cnull=2,
+            0,
+            9, //cdouble=4,
+            0,
+            0, //cstring=6,
+            0,
+            13, //coid=8,
+            0,
+            1, //cfalse=10,
+            1, //ctrue=11,
+            9, //cdate=12,
+            0,
+            1, //cmaxkey=14,
+            0
+        };
+
+        inline unsigned sizeOfElement(const unsigned char *p) { 
+            unsigned type = *p & cCANONTYPEMASK;
+            unsigned sz = sizes[type];
+            if( sz == 0 ) {
+                if( type == cstring ) { 
+                    sz = ((unsigned) p[1]) + 2;
+                }
+                else {
+                    verify( type == cbindata );
+                    sz = binDataCodeToLength(p[1]) + 2;
+                }
+            }
+            return sz;
+        }
+
         static int compare(const unsigned char *&l, const unsigned char *&r) { 
             int lt = (*l & cCANONTYPEMASK);
             int rt = (*r & cCANONTYPEMASK);
@@ -366,7 +416,27 @@ namespace mongo {
             return L.woCompare(R, order, /*considerfieldname*/false);
         }
 
+        size_t commonPrefixLength(const char *left, const char *right, const size_t len) {
+            // Compare a word at a time, the compiler is free to widen this loop further.
+            size_t i = 0;
+            for ( ; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+                uint64_t l, r;
+                memcpy(&l, left + i, sizeof(l));
+                memcpy(&r, right + i, sizeof(r));
+                if (l != r) {
+                    break;
+                }
+            }
+            for ( ; i < len && left[i] == right[i]; i++) {
+            }
+            return i;
+        }
+
         int KeyV1::woCompare(const KeyV1& right, const Ordering &order) const {
+            return woCompare(right, order, 0);
+        }
+
+        int KeyV1::woCompare(const KeyV1& right, const Ordering &order, const size_t equalPrefix) const {
             const unsigned char *l = _keyData;
             const unsigned char *r = right._keyData;
 
@@ -374,6 +444,19 @@ namespace mongo {
                 return compareHybrid(right, order);
 
             unsigned mask = 1;
+
+            // Elements that end inside the identical prefix are equal, and since their
+            // type bytes are identical too, so are their sizes.  Skip them without decoding.
+            while( 1 ) {
+                const unsigned sz = sizeOfElement(l);
+                if( (size_t) (l - _keyData) + sz > equalPrefix )
+                    break;
+                if( (*l & cHASMORE) == 0 )
+                    return 0;
+                l += sz; r += sz;
+                mask <<= 1;
+            }
+
             while( 1 ) { 
                 char lval = *l; 
                 char rval = *r;
@@ -400,40 +483,6 @@ namespace mongo {
             return 0;
         }
 
-        static unsigned sizes[] = {
-            0,
-            1, //cminkey=1,
-            1, //cnull=2,
-            0,
-            9, //cdouble=4,
-            0,
-            0, //cstring=6,
-            0,
-            13, //coid=8,
-            0,
-            1, //cfalse=10,
-            1, //ctrue=11,
-            9, //cdate=12,
-            0,
-            1, //cmaxkey=14,
-            0
-        };
-
-        inline unsigned sizeOfElement(const unsigned char *p) { 
-            unsigned type = *p & cCANONTYPEMASK;
-            unsigned sz = sizes[type];
-            if( sz == 0 ) {
-                if( type == cstring ) { 
-                    sz = ((unsigned) p[1]) + 2;
-                }
-                else {
-                    verify( type == cbindata );
-                    sz = binDataCodeToLength(p[1]) + 2;
-                }
-            }
-            return sz;
-        }
-
         int KeyV1::dataSize() const { 
             const unsigned char *p = _keyData;
             if( !isCompactFormat() ) {
@@ -39,6 +39,9 @@ namespace mongo {
 
     namespace storage {
 
+        /** @return the number of leading bytes that are identical in left and right, up to len */
+        size_t commonPrefixLength(const char *left, const char *right, size_t len);
+
         /** Key class for precomputing a small format index key that is denser than a traditional BSONObj. */
         class KeyV1Owned;
 
@@ -64,9 +67,11 @@ namespace mongo {
             explicit KeyV1(const char *keyData) : _keyData((unsigned char *) keyData) { }
 
             int woCompare(const KeyV1& r, const Ordering &o) const;
+            /** @param equalPrefix a number of leading bytes known to be identical in both keys */
+            int woCompare(const KeyV1& r, const Ordering &o, size_t equalPrefix) const;
             bool woEqual(const KeyV1& r) const;
             BSONObj toBson() const {
-                BufBuilder bb;
+                BufBuilder bb(512, OpArena::current());
                 return toBson(bb).getOwned();
             }
             BSONObj toBson(BufBuilder &bb) const;
@@ -103,12 +108,16 @@ namespace mongo {
             */
             KeyV1Owned(const BSONObj& obj);
 
+            /** @elts the n values of a key, as if they were the elements of a BSON object */
+            KeyV1Owned(const BSONElement *elts, size_t n);
+
             /** makes a copy (memcpy's the whole thing) */
             KeyV1Owned(const KeyV1& rhs);
 
         private:
             StackBufBuilder b;
             void traditional(const BSONObj& obj); // store as traditional bson not as compact format
+            bool appendElement(const BSONElement& e, unsigned char bits); // false if not representable
         };
 
         // Dictionary key format:
@@ -150,9 +159,17 @@ namespace mongo {
                 dassert((int) key1.size() >= k1.dataSize());
                 dassert((int) key2.size() >= k2.dataSize());
 
+                // Identical bytes are equal keys, and whatever leading bytes are identical
+                // don't need to be decoded to be compared.
+                const size_t equalPrefix = commonPrefixLength(key1.buf(), key2.buf(),
+                                                              std::min(key1.size(), key2.size()));
+                if (equalPrefix == (size_t) key1.size() && key1.size() == key2.size()) {
+                    return 0;
+                }
+
                 // Compare by the first key in KeyV1 format.
                 {
-                    const int c = k1.woCompare(k2, ordering);
+                    const int c = k1.woCompare(k2, ordering, equalPrefix);
                     if (c < 0) {
                         return -1;
                     } else if (c > 0) {
@@ -223,7 +240,7 @@ namespace mongo {
             }
 
             BSONObj key() const {
-                BufBuilder bb;
+                BufBuilder bb(512, OpArena::current());
                 return key(bb).getOwned();
             }
 
@@ -0,0 +1,154 @@
+/**
+*    Copyright (C) 2013 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/pch.h"
+
+#include "mongo/db/storage/update_diff.h"
+
+#include "mongo/bson/util/op_arena.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    namespace storage {
+
+        // Off by default: members that don't know the "ud" oplog entry can't apply it.
+        MONGO_EXPORT_SERVER_PARAMETER(updateDiffs, bool, false);
+
+        static bool sameElement(const BSONElement &a, const BSONElement &b) {
+            return a.size() == b.size() && memcmp(a.rawdata(), b.rawdata(), a.size()) == 0;
+        }
+
+        // Appends the diff of two objects to b.  Returns false, having appended nothing useful,
+        // if the objects don't have the same field names in the same order.
+        static bool appendDiff(const BSONObj &oldObj, const BSONObj &newObj, BSONObjBuilder &b) {
+            BSONObjIterator o(oldObj);
+            BSONObjIterator n(newObj);
+            for (int pos = 0; o.more() && n.more(); pos++) {
+                const BSONElement oe = o.next();
+                const BSONElement ne = n.next();
+                if (oe.fieldNameSize() != ne.fieldNameSize() ||
+                    memcmp(oe.fieldName(), ne.fieldName(), oe.fieldNameSize()) != 0) {
+                    return false;
+                }
+                if (sameElement(oe, ne)) {
+                    continue;
+                }
+
+                BSONObjBuilder change(b.subobjStart(BSONObjBuilder::numStr(pos)));
+                if (oe.type() == Object && ne.type() == Object) {
+                    // a change deep inside a big embedded object shouldn't copy all of it
+                    BSONObjBuilder nested(64, OpArena::current());
+                    if (appendDiff(oe.embeddedObject(), ne.embeddedObject(), nested)) {
+                        change.append("d", nested.done());
+                        change.doneFast();
+                        continue;
+                    }
+                }
+                change.appendAs(ne, "s");
+                change.doneFast();
+            }
+            return !o.more() && !n.more();
+        }
+
+        BSONObj computeUpdateDiff(const BSONObj &oldObj, const BSONObj &newObj) {
+            BSONObjBuilder b(128, OpArena::current());
+            if (!appendDiff(oldObj, newObj, b)) {
+                return BSONObj();
+            }
+            BSONObj diff = b.obj();
+            // Not worth an update message, nor a second format in the oplog, unless it saves
+            // most of the document.
+            if (diff.objsize() * 2 > newObj.objsize()) {
+                return BSONObj();
+            }
+            return diff;
+        }
+
+        static void appendApplied(const BSONObj &obj, const BSONObj &diff, BSONObjBuilder &b) {
+            BSONObjIterator d(diff);
+            BSONElement de = d.next();
+            int pos = 0;
+            for (BSONObjIterator i(obj); i.more(); pos++) {
+                const BSONElement e = i.next();
+                if (de.eoo() || de.fieldName() != BSONObjBuilder::numStr(pos)) {
+                    b.append(e);
+                    continue;
+                }
+
+                const BSONElement change = de.embeddedObjectUserCheck().firstElement();
+                if (mongoutils::str::equals(change.fieldName(), "s")) {
+                    b.appendAs(change, e.fieldName());
+                }
+                else {
+                    massert(17025, "update diff does not fit the document",
+                            mongoutils::str::equals(change.fieldName(), "d") && e.type() == Object);
+                    BSONObjBuilder sub(b.subobjStart(e.fieldName()));
+                    appendApplied(e.embeddedObject(), change.embeddedObjectUserCheck(), sub);
+                    sub.doneFast();
+                }
+                de = d.next();
+            }
+            massert(17026, "update diff changes fields the document doesn't have", de.eoo());
+        }
+
+        BSONObj applyUpdateDiff(const BSONObj &obj, const BSONObj &diff) {
+            BSONObjBuilder b(obj.objsize() + diff.objsize());
+            appendApplied(obj, diff, b);
+            return b.obj();
+        }
+
+        static BSONObj (*_applyUpdateMods)(const BSONObj &obj, const BSONObj &mods) = NULL;
+
+        void setUpdateModsApplier(BSONObj (*f)(const BSONObj &obj, const BSONObj &mods)) {
+            _applyUpdateMods = f;
+        }
+
+        BSONObj diffUpdateMessage(const BSONObj &diff) {
+            BSONObjBuilder b(diff.objsize() + 8, OpArena::current());
+            b.append("d", diff);
+            return b.obj();
+        }
+
+        BSONObj modsUpdateMessage(const BSONObj &mods) {
+            BSONObjBuilder b(mods.objsize() + 8, OpArena::current());
+            b.append("m", mods);
+            return b.obj();
+        }
+
+        bool applyUpdateMessage(const BSONObj &obj, const BSONObj &msg, BSONObj &newObj) {
+            const BSONElement e = msg.firstElement();
+            if (mongoutils::str::equals(e.fieldName(), "d")) {
+                newObj = applyUpdateDiff(obj, e.Obj());
+                return true;
+            }
+
+            massert(17028, mongoutils::str::stream() << "unknown update message " << msg,
+                    mongoutils::str::equals(e.fieldName(), "m") && _applyUpdateMods != NULL);
+            try {
+                newObj = _applyUpdateMods(obj, e.Obj());
+                return true;
+            } catch (const DBException &ex) {
+                LOG(1) << "fast update " << e.Obj() << " does not apply to " << obj
+                       << ", leaving it alone: " << ex.what() << endl;
+                return false;
+            }
+        }
+
+    } // namespace storage
+
+} // namespace mongo
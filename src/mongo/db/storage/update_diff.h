@@ -0,0 +1,71 @@
+/**
+*    Copyright (C) 2013 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "mongo/pch.h"
+
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    namespace storage {
+
+        // Whether updates may be written to the primary key and to the oplog as diffs.  Opt-in:
+        // only turn it on once every member of the replica set, and every other reader of the
+        // oplog, runs a version that can apply "ud" entries.
+        extern bool updateDiffs;
+
+        /**
+         * Describes the values an update changed, for an update that kept every field of the
+         * document in place (the common $inc / $set of existing fields).  Each element is named
+         * for the position of the field it changes and is either { s: <new value> } or, for an
+         * embedded object whose own fields stayed in place, { d: <diff of that object> }.
+         *
+         * @return the diff, or an empty object if the update added, removed or reordered top
+         *         level fields, or if the diff would not be much smaller than newObj.
+         */
+        BSONObj computeUpdateDiff(const BSONObj &oldObj, const BSONObj &newObj);
+
+        /**
+         * @return obj with diff applied, which is exactly the newObj the diff was computed for
+         *         when obj is the oldObj.  Throws if diff does not fit obj.
+         */
+        BSONObj applyUpdateDiff(const BSONObj &obj, const BSONObj &diff);
+
+        /**
+         * The extra of an update message sent to a primary key with DB->update is either
+         * { d: <diff> }, for an update whose images were both known, or { m: <mods> }, for a
+         * fast update that was sent without reading the row.
+         */
+        BSONObj diffUpdateMessage(const BSONObj &diff);
+        BSONObj modsUpdateMessage(const BSONObj &mods);
+
+        /**
+         * Applies an update message to the row it was sent to, for the ydb's update callback.
+         * @return false, leaving newObj alone, if the row should keep its value because the
+         *         message's mods don't apply to it.  Mods can't be refused at update time,
+         *         since nothing read the row then.
+         */
+        bool applyUpdateMessage(const BSONObj &obj, const BSONObj &msg, BSONObj &newObj);
+
+        // Applying mods needs the update code, which isn't part of coredb, so the server
+        // provides it.  See ops/update.cpp.
+        void setUpdateModsApplier(BSONObj (*f)(const BSONObj &obj, const BSONObj &mods));
+
+    } // namespace storage
+
+} // namespace mongo
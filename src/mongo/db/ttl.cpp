@@ -19,84 +19,322 @@
 
 #include "pch.h"
 
+#include <boost/thread/thread.hpp>
+
 #include "mongo/db/commands/fsync.h"
 #include "mongo/db/ttl.h"
 #include "mongo/db/databaseholder.h"
 #include "mongo/db/instance.h"
 #include "mongo/db/ops/delete.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/util/background.h"
 #include "mongo/db/replutil.h"
 
 namespace mongo {
-    
+
+    // how often to look for new ttl indexes, and to revisit ones that were caught up
+    MONGO_EXPORT_SERVER_PARAMETER(ttlMonitorSleepSecs, int, 60);
+    // documents deleted per transaction
+    MONGO_EXPORT_SERVER_PARAMETER(ttlDeleteBatchSize, int, 1000);
+    // across all ttl indexes, 0 for no limit
+    MONGO_EXPORT_SERVER_PARAMETER(ttlDeletesPerSecond, int, 0);
+    // collections expired at the same time
+    MONGO_EXPORT_SERVER_PARAMETER(ttlMonitorThreads, int, 2);
+
+    namespace {
+
+        // One pass over an index stops after this long, so that a big expiry wave on one
+        // collection doesn't starve the others sharing its thread.
+        const long long PassMillis = 5000;
+
+        AtomicInt64 ttlPasses;
+        AtomicInt64 ttlBatches;
+        AtomicInt64 ttlDeleted;
+        AtomicInt64 ttlRateLimitedMillis;
+
+        // expired documents each index had left after its last pass, counted up to
+        // BacklogBatches batches' worth
+        const int BacklogBatches = 10;
+        SimpleMutex ttlBacklogMutex("ttlBacklog");
+        map<string, long long> ttlBacklog;
+
+        // Spreads ttlDeletesPerSecond over all the threads deleting.
+        class TTLRateLimiter {
+        public:
+            TTLRateLimiter() : _mutex("TTLRateLimiter"), _nextMicros(0) { }
+
+            // @return how long to wait, having deleted n, before deleting more
+            long long reserve(long long n) {
+                const long long rate = ttlDeletesPerSecond;
+                if (rate <= 0) {
+                    return 0;
+                }
+                SimpleMutex::scoped_lock lk(_mutex);
+                const unsigned long long now = curTimeMicros64();
+                _nextMicros = std::max(_nextMicros, now);
+                const unsigned long long wait = _nextMicros - now;
+                _nextMicros += n * 1000000 / rate;
+                return wait / 1000;
+            }
+
+        private:
+            SimpleMutex _mutex;
+            unsigned long long _nextMicros;
+        } ttlRateLimiter;
+
+        struct TTLIndex {
+            string dbName;
+            string ns;
+            string field;
+            long long expireAfterSeconds;
+
+            string id() const { return ns + "." + field; }
+        };
+
+    } // namespace
+
     class TTLMonitor : public BackgroundJob {
     public:
-        TTLMonitor(){}
+        TTLMonitor() : _nextLook(0) { }
         virtual ~TTLMonitor(){}
 
         virtual string name() const { return "TTLMonitor"; }
         
         static string secondsExpireField;
         
-        void doTTLForDB( const string& dbName ) {
+        void findTTLIndexes( const string& dbName, vector<TTLIndex>& found ) {
             Client::GodScope god;
 
-            vector<BSONObj> indexes;
-            {
-                auto_ptr<DBClientCursor> cursor =
-                                db.query( getSisterNS(dbName, "system.indexes") ,
-                                          BSON( secondsExpireField << BSON( "$exists" << true ) ) ,
-                                          0 , /* default nToReturn */
-                                          0 , /* default nToSkip */
-                                          0 , /* default fieldsToReturn */
-                                          QueryOption_SlaveOk ); /* perform on secondaries too */
-                if ( cursor.get() ) {
-                    while ( cursor->more() ) {
-                        indexes.push_back( cursor->next().getOwned() );
-                    }
-                }
+            auto_ptr<DBClientCursor> cursor =
+                            db.query( getSisterNS(dbName, "system.indexes") ,
+                                      BSON( secondsExpireField << BSON( "$exists" << true ) ) ,
+                                      0 , /* default nToReturn */
+                                      0 , /* default nToSkip */
+                                      0 , /* default fieldsToReturn */
+                                      QueryOption_SlaveOk ); /* perform on secondaries too */
+            if ( !cursor.get() ) {
+                return;
             }
-            
-            for ( unsigned i=0; i<indexes.size(); i++ ) {
-                BSONObj idx = indexes[i];
+            while ( cursor->more() ) {
+                BSONObj idx = cursor->next();
                 BSONObj key = idx["key"].Obj();
                 if ( key.nFields() != 1 ) {
                     error() << "key for ttl index can only have 1 field" << endl;
                     continue;
                 }
+                TTLIndex t;
+                t.dbName = dbName;
+                t.ns = idx["ns"].String();
+                t.field = key.firstElement().fieldName();
+                t.expireAfterSeconds = idx[secondsExpireField].numberLong();
+                found.push_back( t );
+            }
+        }
 
-                BSONObj query;
-                {
-                    BSONObjBuilder b;
-                    b.appendDate( "$lt" , curTimeMillis64() - ( 1000 * idx[secondsExpireField].numberLong() ) );
-                    query = BSON( key.firstElement().fieldName() << b.obj() );
-                }
-                
-                LOG(1) << "TTL: " << key << " \t " << query << endl;
-                
+        /**
+         * Deletes what has expired in one index, a batch per transaction, for up to PassMillis.
+         * @return true if it stopped with expired documents left
+         */
+        static bool doTTLForIndex( DBClientBase& conn, const TTLIndex& idx ) {
+            Client::GodScope god;
+
+            BSONObj query;
+            {
+                BSONObjBuilder b;
+                b.appendDate( "$lt" , curTimeMillis64() - ( 1000 * idx.expireAfterSeconds ) );
+                query = BSON( idx.field << b.obj() );
+            }
+
+            LOG(1) << "TTL: " << idx.ns << " \t " << query << endl;
+
+            const long long batchSize = std::max( ttlDeleteBatchSize , 1 );
+            long long total = 0;
+            bool behind = false;
+            Timer t;
+            while ( !inShutdown() ) {
                 long long n = 0;
                 {
-                    string ns = idx["ns"].String();
                     OpSettings settings;
                     settings.setQueryCursorMode(WRITE_LOCK_CURSOR);
                     cc().setOpSettings(settings);
 
-                    Client::ReadContext ctx(ns);
+                    Client::ReadContext ctx(idx.ns);
                     Client::Transaction transaction(DB_SERIALIZABLE);
-                    NamespaceDetails* nsd = nsdetails(ns.c_str());
+                    NamespaceDetails* nsd = nsdetails(idx.ns.c_str());
                     if (!nsd) {
                         // collection was dropped
-                        continue;
+                        behind = false;
+                        break;
                     }
                     // only do deletes if on master
-                    if (!isMasterNs(dbName.c_str())) {
-                        continue;
+                    if (!isMasterNs(idx.dbName.c_str())) {
+                        behind = false;
+                        break;
                     }
-                    n = deleteObjects(ns.c_str(), query, false, true);
+                    n = deleteObjectsUpTo(idx.ns.c_str(), query, batchSize, true);
                     transaction.commit();
                 }
+                total += n;
+                ttlBatches.fetchAndAdd(1);
+                ttlDeleted.fetchAndAdd(n);
+                if ( n < batchSize ) {
+                    behind = false;
+                    break;
+                }
 
-                LOG(1) << "\tTTL deleted: " << n << endl;
+                behind = true;
+                const long long wait = ttlRateLimiter.reserve( n );
+                if ( wait > 0 ) {
+                    ttlRateLimitedMillis.fetchAndAdd( wait );
+                    sleepmillis( wait );
+                }
+                if ( t.millis() >= PassMillis ) {
+                    break;
+                }
+            }
+            ttlPasses.fetchAndAdd(1);
+
+            long long backlog = 0;
+            if ( behind ) {
+                backlog = conn.count( idx.ns , query , QueryOption_SlaveOk ,
+                                      BacklogBatches * batchSize );
+            }
+            {
+                SimpleMutex::scoped_lock lk(ttlBacklogMutex);
+                ttlBacklog[idx.id()] = backlog;
+            }
+
+            LOG(1) << "\tTTL deleted: " << total << ( behind ? ", more to go" : "" ) << endl;
+            return behind;
+        }
+
+        /**
+         * Expires the indexes of some collections, taking a collection at a time from the
+         * shared list, on its own thread.  Indexes on one collection stay on one thread, so
+         * they don't fight over the same documents.
+         */
+        class Worker {
+        public:
+            Worker( const vector< vector<TTLIndex> >& collections , vector< vector<char> >& behind ,
+                    AtomicUInt32& next ) :
+                _collections( collections ) , _behind( behind ) , _next( next ) { }
+
+            void operator()() {
+                Client::initThread( "TTLMonitorWorker" );
+                DBDirectClient conn;
+                for ( unsigned i = _next.fetchAndAdd(1); i < _collections.size() && !inShutdown();
+                      i = _next.fetchAndAdd(1) ) {
+                    const vector<TTLIndex>& indexes = _collections[i];
+                    for ( unsigned j = 0; j < indexes.size(); j++ ) {
+                        try {
+                            _behind[i][j] = doTTLForIndex( conn , indexes[j] );
+                        }
+                        catch ( DBException& e ) {
+                            error() << "error processing ttl for " << indexes[j].ns << " "
+                                    << e << endl;
+                        }
+                    }
+                }
+                cc().shutdown();
+            }
+
+        private:
+            const vector< vector<TTLIndex> >& _collections;
+            vector< vector<char> >& _behind;
+            AtomicUInt32& _next;
+        };
+
+        // Rereads the ttl indexes of every database, every ttlMonitorSleepSecs.
+        void lookForIndexes() {
+            if ( curTimeMillis64() < _nextLook ) {
+                return;
+            }
+            _nextLook = curTimeMillis64() + 1000LL * std::max( ttlMonitorSleepSecs , 1 );
+
+            set<string> dbs;
+            {
+                Lock::DBRead lk( "local" );
+                dbHolder().getAllShortNames( dbs );
+            }
+
+            vector<TTLIndex> indexes;
+            for ( set<string>::const_iterator i=dbs.begin(); i!=dbs.end(); ++i ) {
+                string db = *i;
+                try {
+                    findTTLIndexes( db , indexes );
+                }
+                catch ( DBException& e ) {
+                    error() << "error processing ttl for db: " << db << " " << e << endl;
+                }
+            }
+            _indexes.swap( indexes );
+
+            // forget the schedules of dropped indexes
+            set<string> ids;
+            for ( unsigned i = 0; i < _indexes.size(); i++ ) {
+                ids.insert( _indexes[i].id() );
+            }
+            for ( map<string, unsigned long long>::iterator it = _due.begin(); it != _due.end(); ) {
+                if ( ids.count( it->first ) ) {
+                    ++it;
+                }
+                else {
+                    _due.erase( it++ );
+                }
+            }
+            SimpleMutex::scoped_lock lk(ttlBacklogMutex);
+            for ( map<string, long long>::iterator it = ttlBacklog.begin(); it != ttlBacklog.end(); ) {
+                if ( ids.count( it->first ) ) {
+                    ++it;
+                }
+                else {
+                    ttlBacklog.erase( it++ );
+                }
+            }
+        }
+
+        // Expires every index that is due, and schedules each one's next pass: right away if
+        // it fell behind, otherwise after ttlMonitorSleepSecs.
+        void expireDueIndexes() {
+            const unsigned long long now = curTimeMillis64();
+            vector< vector<TTLIndex> > collections;
+            {
+                map<string, unsigned> byNs;
+                for ( unsigned i = 0; i < _indexes.size(); i++ ) {
+                    const TTLIndex& idx = _indexes[i];
+                    if ( _due[idx.id()] > now ) {
+                        continue;
+                    }
+                    map<string, unsigned>::const_iterator it = byNs.find( idx.ns );
+                    if ( it == byNs.end() ) {
+                        it = byNs.insert( make_pair( idx.ns , collections.size() ) ).first;
+                        collections.push_back( vector<TTLIndex>() );
+                    }
+                    collections[it->second].push_back( idx );
+                }
+            }
+            if ( collections.empty() ) {
+                return;
+            }
+
+            vector< vector<char> > behind( collections.size() );
+            for ( unsigned i = 0; i < collections.size(); i++ ) {
+                behind[i].resize( collections[i].size() , 0 );
+            }
+            AtomicUInt32 next;
+            const int nThreads = std::min( std::max( ttlMonitorThreads , 1 ) ,
+                                           static_cast<int>( collections.size() ) );
+            boost::thread_group threads;
+            for ( int i = 0; i < nThreads; i++ ) {
+                threads.create_thread( Worker( collections , behind , next ) );
+            }
+            threads.join_all();
+
+            const unsigned long long later = curTimeMillis64() + 1000LL * std::max( ttlMonitorSleepSecs , 1 );
+            for ( unsigned i = 0; i < collections.size(); i++ ) {
+                for ( unsigned j = 0; j < collections[i].size(); j++ ) {
+                    _due[collections[i][j].id()] = behind[i][j] ? 0 : later;
+                }
             }
         }
 
@@ -104,14 +342,14 @@ namespace mongo {
             Client::initThread( name().c_str() );
 
             while ( ! inShutdown() ) {
-                sleepsecs( 60 );
+                sleepsecs( 1 );
 
-                LOG(3) << "TTLMonitor thread awake" << endl;
+                LOG(5) << "TTLMonitor thread awake" << endl;
                 
                 if ( lockedForWriting() ) {
                     // note: this is not perfect as you can go into fsync+lock between 
                     // this and actually doing the delete later
-                    LOG(3) << " locked for writing" << endl;
+                    LOG(5) << " locked for writing" << endl;
                     continue;
                 }
 
@@ -119,26 +357,18 @@ namespace mongo {
                 if ( theReplSet && !theReplSet->state().readable() )
                     continue;
 
-                set<string> dbs;
-                {
-                    Lock::DBRead lk( "local" );
-                    dbHolder().getAllShortNames( dbs );
-                }
-                
-                for ( set<string>::const_iterator i=dbs.begin(); i!=dbs.end(); ++i ) {
-                    string db = *i;
-                    try {
-                        doTTLForDB( db );
-                    }
-                    catch ( DBException& e ) {
-                        error() << "error processing ttl for db: " << db << " " << e << endl;
-                    }
-                }
-
+                lookForIndexes();
+                expireDueIndexes();
             }
         }
 
         DBDirectClient db;
+
+    private:
+        unsigned long long _nextLook;
+        vector<TTLIndex> _indexes;
+        // by TTLIndex::id(), when each index's next pass is due
+        map<string, unsigned long long> _due;
     };
 
     void startTTLBackgroundJob() {
@@ -146,5 +376,23 @@ namespace mongo {
         ttl->go();
     }    
     
+    void appendTTLStats(BSONObjBuilder& b) {
+        b.append("passes", ttlPasses.load());
+        b.append("batches", ttlBatches.load());
+        b.append("deletedDocuments", ttlDeleted.load());
+        b.append("rateLimitedMillis", ttlRateLimitedMillis.load());
+        long long backlog = 0;
+        int indexesBehind = 0;
+        {
+            SimpleMutex::scoped_lock lk(ttlBacklogMutex);
+            for ( map<string, long long>::const_iterator it = ttlBacklog.begin(); it != ttlBacklog.end(); ++it ) {
+                backlog += it->second;
+                indexesBehind += it->second > 0;
+            }
+        }
+        b.append("indexesBehind", indexesBehind);
+        b.append("expiredBacklog", backlog);
+    }
+
     string TTLMonitor::secondsExpireField = "expireAfterSeconds";
 }
@@ -19,5 +19,11 @@
 #pragma once
 
 namespace mongo {
+
+    class BSONObjBuilder;
+
     void startTTLBackgroundJob();
+
+    // For serverStatus: what the TTL monitor has deleted, and roughly how much it is behind.
+    void appendTTLStats(BSONObjBuilder& b);
 }
@@ -37,6 +37,7 @@ namespace mongo {
                                     void (*writeObj)(BSONObj &),
                                     void (*writeObjToRef)(BSONObj &));
     void disableLogTxnOpsForSharding(void);
+    bool logTxnOpsForSharding();
     bool shouldLogTxnOpForSharding(const char *opstr, const char *ns, const BSONObj &obj);
     bool shouldLogTxnUpdateOpForSharding(const char *opstr, const char *ns, const BSONObj &oldObj, const BSONObj &newObj);
     void setLogTxnToOplog(void (*)(GTID gtid, uint64_t timestamp, uint64_t hash, BSONArray& opInfo));
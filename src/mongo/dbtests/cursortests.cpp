@@ -74,8 +74,8 @@ namespace CursorTests {
                 Client::Transaction transaction(DB_SERIALIZABLE);
                 Client::WriteContext tc(ns);
                 {
-                    shared_ptr<IndexCursor> _c( IndexCursor::make( nsdetails( ns ), nsdetails( ns )->idx(1), frv, 0, 1 ) );
-                    IndexCursor &c = *_c.get();
+                    shared_ptr<Cursor> _c( IndexCursor::make( nsdetails( ns ), nsdetails( ns )->idx(1), frv, 0, 1 ) );
+                    Cursor &c = *_c.get();
                     ASSERT_EQUALS( "IndexCursor a_1 multi", c.toString() );
                     double expected[] = { 1, 2, 4, 5, 6 };
                     for( int i = 0; i < 5; ++i ) {
@@ -106,8 +106,8 @@ namespace CursorTests {
                 Client::Transaction transaction(DB_SERIALIZABLE);
                 Client::WriteContext tc(ns);
                 {
-                    shared_ptr<IndexCursor> _c( IndexCursor::make(nsdetails( ns ), nsdetails( ns )->idx(1), frv, 0, 1 ) );
-                    IndexCursor &c = *_c.get();
+                    shared_ptr<Cursor> _c( IndexCursor::make(nsdetails( ns ), nsdetails( ns )->idx(1), frv, 0, 1 ) );
+                    Cursor &c = *_c.get();
                     ASSERT_EQUALS( "IndexCursor a_1 multi", c.toString() );
                     double expected[] = { 0, 1, 2, 109 };
                     for( int i = 0; i < 4; ++i ) {
@@ -136,8 +136,8 @@ namespace CursorTests {
                 Client::Transaction transaction(DB_SERIALIZABLE);
                 Client::WriteContext ctx( ns );
                 {
-                    shared_ptr<IndexCursor> _c( IndexCursor::make( nsdetails( ns ), nsdetails( ns )->idx(1), frv, 0, -1 ) );
-                    IndexCursor& c = *_c.get();
+                    shared_ptr<Cursor> _c( IndexCursor::make( nsdetails( ns ), nsdetails( ns )->idx(1), frv, 0, -1 ) );
+                    Cursor& c = *_c.get();
                     ASSERT_EQUALS( "IndexCursor a_1 reverse multi", c.toString() );
                     double expected[] = { 6, 5, 4, 2, 1 };
                     for( int i = 0; i < 5; ++i ) {
@@ -159,6 +159,8 @@ namespace CursorTests {
             DBDirectClient _c;
             virtual BSONObj idx() const = 0;
             virtual int direction() const { return 1; }
+            virtual bool unique() const { return false; }
+            virtual bool clustering() const { return false; }
             void insert( const BSONObj &o ) {
                 _objs.push_back( o );
                 _c.insert( ns(), o );
@@ -167,7 +169,7 @@ namespace CursorTests {
                 {
                     BSONObj keypat = idx();
                     //cout << keypat.toString() << endl;
-                    _c.ensureIndex( ns(), idx() );
+                    _c.ensureIndex( ns(), idx(), unique(), clustering() );
                 }
 
                 Client::Transaction transaction(DB_SERIALIZABLE);
@@ -178,7 +180,7 @@ namespace CursorTests {
                     NamespaceDetails *d = nsdetails(ns());
                     int i = d->findIndexByKeyPattern(idx());
                     verify(i >= 0);
-                    shared_ptr<IndexCursor> c( IndexCursor::make( d, d->idx( i ), frv, 0, direction() ) );
+                    shared_ptr<Cursor> c( IndexCursor::make( d, d->idx( i ), frv, 0, direction() ) );
                     Matcher m( spec );
                     int count = 0;
                     while( c->ok() ) {
@@ -278,6 +280,67 @@ namespace CursorTests {
             virtual BSONObj idx() const { return BSON( "a" << 1 << "b" << 1 ); }
         };
 
+        class PointGetsId : public Base2 {
+        public:
+            void run() {
+                for ( int i = 0; i < 100; i++ ) {
+                    insert( BSON( "_id" << i * 2 << "a" << i ) );
+                }
+                // every other point is missing
+                BSONArrayBuilder in;
+                for ( int i = 0; i < 300; i += 3 ) {
+                    in.append( i );
+                }
+                check( BSON( "_id" << BSON( "$in" << in.arr() ) ) );
+            }
+            virtual BSONObj idx() const { return BSON( "_id" << 1 ); }
+        };
+
+        class PointGetsIdReverse : public PointGetsId {
+            virtual int direction() const { return -1; }
+        };
+
+        class PointGetsUniqueCompound : public Base2 {
+        public:
+            void run() {
+                for ( int a = 0; a < 10; a++ ) {
+                    for ( int b = 0; b < 10; b += 2 ) {
+                        insert( BSON( "a" << a << "b" << b ) );
+                    }
+                }
+                check( BSON( "a" << BSON( "$in" << BSON_ARRAY( 1 << 3 << 5 << 12 ) ) <<
+                             "b" << BSON( "$in" << BSON_ARRAY( 2 << 3 << 4 << 8 ) ) ) );
+            }
+            virtual BSONObj idx() const { return BSON( "a" << 1 << "b" << -1 ); }
+            virtual bool unique() const { return true; }
+        };
+
+        class PointGetsUniqueCompoundReverse : public PointGetsUniqueCompound {
+            virtual int direction() const { return -1; }
+        };
+
+        /** Points of another numeric type still find the stored key, whose bytes differ. */
+        class PointGetsOtherNumericTypes : public Base2 {
+        public:
+            void run() {
+                for ( int i = 0; i < 10; i++ ) {
+                    insert( BSON( "a" << i ) );
+                }
+                check( BSON( "a" << BSON( "$in" << BSON_ARRAY( 2.0 << 5.0 << 12.0 ) ) ) );
+                check( BSON( "a" << BSON( "$in" << BSON_ARRAY( 3LL << 7LL << 12LL ) ) ) );
+            }
+            virtual BSONObj idx() const { return BSON( "a" << 1 ); }
+            virtual bool unique() const { return true; }
+        };
+
+        class PointGetsOtherNumericTypesReverse : public PointGetsOtherNumericTypes {
+            virtual int direction() const { return -1; }
+        };
+
+        class PointGetsOtherNumericTypesClustering : public PointGetsOtherNumericTypes {
+            virtual bool clustering() const { return true; }
+        };
+
         /**
          * IndexCursor::advance() may skip to new index positions multiple times.  A cutoff (tested
          * here) has been implemented to avoid excessive iteration in such cases.  See SERVER-3448.
@@ -304,7 +367,7 @@ namespace CursorTests {
                 Client::Transaction transaction(DB_SERIALIZABLE);
                 Client::WriteContext ctx( ns() );
                 {
-                    shared_ptr<IndexCursor> c( IndexCursor::make( nsdetails( ns() ),
+                    shared_ptr<Cursor> c( IndexCursor::make( nsdetails( ns() ),
                                                                   nsdetails( ns() )->idx(1),
                                                                   frv,
                                                                   0, 1 ) );
@@ -657,6 +720,13 @@ namespace CursorTests {
             add<IndexCursor::EqIn>();
             add<IndexCursor::RangeEq>();
             add<IndexCursor::RangeIn>();
+            add<IndexCursor::PointGetsId>();
+            add<IndexCursor::PointGetsIdReverse>();
+            add<IndexCursor::PointGetsUniqueCompound>();
+            add<IndexCursor::PointGetsUniqueCompoundReverse>();
+            add<IndexCursor::PointGetsOtherNumericTypes>();
+            add<IndexCursor::PointGetsOtherNumericTypesReverse>();
+            add<IndexCursor::PointGetsOtherNumericTypesClustering>();
             add<IndexCursor::AbortImplicitScan>();
             add<IndexCursor::DontMatchOutOfIndexBoundsDocuments>();
             add<IndexCursor::MatcherRequiredTwoConstraintsSameField>();
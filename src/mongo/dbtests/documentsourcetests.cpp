@@ -807,6 +807,38 @@ namespace DocumentSourceTests {
             virtual string expectedResultSetString() { return "[{_id:0, first:null}]"; }
         };
 
+        /**
+         * Enough groups to grow the group table several times and fill more than one arena
+         * block, mixing accumulators kept inline with one ($push) that is not.
+         */
+        class ManyGroupsMixedAccumulators : public CheckResultsBase {
+            static const int nGroups = 1000;
+            void populateData() {
+                for( int i = 0; i < 2 * nGroups; ++i ) {
+                    client.insert( ns, BSON( "_id" << i << "g" << i % nGroups << "a" << i ) );
+                }
+            }
+            virtual BSONObj groupSpec() {
+                return fromjson( "{_id:'$g',sum:{$sum:'$a'},avg:{$avg:'$a'},min:{$min:'$a'},"
+                                 "max:{$max:'$a'},first:{$first:'$a'},last:{$last:'$a'},"
+                                 "list:{$push:'$a'}}" );
+            }
+            virtual BSONObj expectedResultSet() {
+                BSONArrayBuilder expected;
+                for( int g = 0; g < nGroups; ++g ) {
+                    expected << BSON( "_id" << g
+                                      << "sum" << 2 * g + nGroups
+                                      << "avg" << g + nGroups / 2.0
+                                      << "min" << g
+                                      << "max" << g + nGroups
+                                      << "first" << g
+                                      << "last" << g + nGroups
+                                      << "list" << BSON_ARRAY( g << g + nGroups ) );
+                }
+                return expected.arr();
+            }
+        };
+
         /** Simulate merging sharded results in the router. */ 
         class RouterMerger : public CheckResultsBase {
         public:
@@ -1789,6 +1821,7 @@ namespace DocumentSourceTests {
             add<DocumentSourceGroup::GroupNullUndefinedIds>();
             add<DocumentSourceGroup::ComplexId>();
             add<DocumentSourceGroup::UndefinedAccumulatorValue>();
+            add<DocumentSourceGroup::ManyGroupsMixedAccumulators>();
             add<DocumentSourceGroup::RouterMerger>();
             add<DocumentSourceGroup::Dependencies>();
             add<DocumentSourceGroup::StringConstantIdAndAccumulatorExpressions>();
@@ -24,6 +24,7 @@
 namespace mongo {
 
     using mongo::Histogram;
+    using mongo::LatencyHistogram;
 
     class BoundariesInit {
     public:
@@ -79,6 +80,46 @@ namespace mongo {
         }
     };
 
+    class LatencyBoundaries {
+    public:
+        void run() {
+            ASSERT_EQUALS( LatencyHistogram::findBucket( 0 ), 0u );
+            ASSERT_EQUALS( LatencyHistogram::findBucket( 1 ), 1u );
+            ASSERT_EQUALS( LatencyHistogram::findBucket( 2 ), 2u );
+            ASSERT_EQUALS( LatencyHistogram::findBucket( 3 ), 3u );
+            ASSERT_EQUALS( LatencyHistogram::findBucket( 5 ), 4u );
+            ASSERT_EQUALS( LatencyHistogram::findBucket( 6 ), 5u );
+            ASSERT_EQUALS( LatencyHistogram::findBucket( 1000 ), 19u );
+            ASSERT_EQUALS( LatencyHistogram::findBucket( 1ULL << 40 ), 63u );
+
+            // each bucket's boundary is in it, and the next latency is in the next one
+            for ( uint32_t i = 0; i < LatencyHistogram::NumBuckets - 1; i++ ) {
+                const uint64_t boundary = LatencyHistogram::getBoundary( i );
+                ASSERT_EQUALS( LatencyHistogram::findBucket( boundary ), i );
+                ASSERT_EQUALS( LatencyHistogram::findBucket( boundary + 1 ), i + 1 );
+            }
+        }
+    };
+
+    class LatencyPercentiles {
+    public:
+        void run() {
+            LatencyHistogram h;
+            ASSERT_EQUALS( h.getPercentile( 0.5 ), 0u );
+
+            for ( int i = 0; i < 990; i++ ) {
+                h.insert( 100 );
+            }
+            for ( int i = 0; i < 10; i++ ) {
+                h.insert( 100000 );
+            }
+            ASSERT_EQUALS( h.getCount(), 1000u );
+            ASSERT_EQUALS( h.getPercentile( 0.5 ), 127u );
+            ASSERT_EQUALS( h.getPercentile( 0.99 ), 127u );
+            ASSERT_EQUALS( h.getPercentile( 0.999 ), 131071u );
+        }
+    };
+
     class HistogramSuite : public Suite {
     public:
         HistogramSuite() : Suite( "histogram" ) {}
@@ -87,6 +128,8 @@ namespace mongo {
             add< BoundariesInit >();
             add< BoundariesExponential >();
             add< BoundariesFind >();
+            add< LatencyBoundaries >();
+            add< LatencyPercentiles >();
             // TODO: complete the test suite
         }
     } histogramSuite;
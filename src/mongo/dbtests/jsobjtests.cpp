@@ -20,10 +20,12 @@
 
 #include "mongo/pch.h"
 #include "mongo/bson/util/builder.h"
+#include "mongo/db/field_lookup_scope.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/jsobjmanipulator.h"
 #include "mongo/db/json.h"
 #include "mongo/db/repl.h"
+#include "mongo/db/storage/key.h"
 #include "mongo/db/cursor.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/platform/float_utils.h"
@@ -947,6 +949,151 @@ namespace JsobjTests {
 
     } // namespace BSONObjTests
 
+    namespace KeyTests {
+
+        /** Dictionary key comparisons agree with BSON comparisons, whatever prefix they share. */
+        class CompareMatchesBSON {
+        public:
+            void run() {
+                vector<BSONObj> keys;
+                keys.push_back( BSON( "" << 1 << "" << "abc" ) );
+                keys.push_back( BSON( "" << 1 << "" << "abd" ) );
+                keys.push_back( BSON( "" << 1 << "" << "ab" ) );
+                keys.push_back( BSON( "" << 1.0 << "" << "abc" ) );
+                keys.push_back( BSON( "" << 1LL << "" << "abc" ) );
+                keys.push_back( BSON( "" << 2 << "" << "abc" ) );
+                keys.push_back( BSON( "" << -0.0 << "" << "abc" ) );
+                keys.push_back( BSON( "" << 0.0 << "" << "abc" ) );
+                keys.push_back( BSON( "" << 1 << "" << 1 ) );
+                keys.push_back( BSON( "" << 1 << "" << BSONObj() ) ); // not compact
+                keys.push_back( fromjson( "{'':1,'':null}" ) );
+
+                vector<BSONObj> pks;
+                pks.push_back( BSON( "" << 1 ) );
+                pks.push_back( BSON( "" << 2 ) );
+
+                const BSONObj patterns[] = { BSON( "a" << 1 << "b" << 1 ),
+                                             BSON( "a" << 1 << "b" << -1 ),
+                                             BSON( "a" << -1 << "b" << 1 ) };
+                for ( int p = 0; p < 3; ++p ) {
+                    const Ordering ordering = Ordering::make( patterns[ p ] );
+                    for ( vector<BSONObj>::const_iterator i = keys.begin(); i != keys.end(); ++i ) {
+                        for ( vector<BSONObj>::const_iterator j = keys.begin(); j != keys.end(); ++j ) {
+                            const int expected = sign( i->woCompare( *j, ordering, false ) );
+                            ASSERT_EQUALS( expected, compare( *i, NULL, *j, NULL, ordering ) );
+                            for ( int k = 0; k < 2; ++k ) {
+                                const int expectedWithPK =
+                                        expected != 0 ? expected : sign( pks[ 0 ].woCompare( pks[ k ] ) );
+                                ASSERT_EQUALS( expectedWithPK,
+                                               compare( *i, &pks[ 0 ], *j, &pks[ k ], ordering ) );
+                            }
+                        }
+                    }
+                }
+            }
+        private:
+            static int sign( int x ) { return x < 0 ? -1 : x > 0 ? 1 : 0; }
+            static int compare( const BSONObj &l, const BSONObj *lpk,
+                                const BSONObj &r, const BSONObj *rpk,
+                                const Ordering &ordering ) {
+                const storage::Key lkey( l, lpk );
+                const storage::Key rkey( r, rpk );
+                return sign( storage::Key::woCompare( lkey, rkey, ordering ) );
+            }
+        };
+
+    } // namespace KeyTests
+
+    namespace FieldLookupScopeTests {
+
+        /** Lookups through a scope agree with BSONObj, inside and outside the scope. */
+        class MatchesBSONObj {
+        public:
+            void run() {
+                BSONObjBuilder b;
+                for ( int i = 0; i < 50; i++ ) {
+                    b.append( "f" + BSONObjBuilder::numStr( i ), i );
+                }
+                b.append( "sub", BSON( "x" << 1 << "y" << BSON( "z" << 2 ) ) );
+                b.append( "a.b", "dotted" );
+                b.append( "a", BSON( "b" << "nested" ) );
+                BSONObj obj = b.obj();
+                BSONObj other = BSON( "f1" << "other" );
+
+                const char *names[] = { "f0", "f49", "f25", "missing", "sub.x", "sub.y.z",
+                                        "sub.nope", "f1.x", "a.b" };
+                const size_t n = sizeof( names ) / sizeof( names[0] );
+                for ( int scoped = 0; scoped < 2; scoped++ ) {
+                    scoped_ptr<FieldLookupScope> scope( scoped ? new FieldLookupScope( obj ) : NULL );
+                    ASSERT_EQUALS( scoped == 1, FieldLookupScope::covers( obj ) );
+                    ASSERT( !FieldLookupScope::covers( other ) );
+                    // nested scopes for the same document defer to the outer one
+                    FieldLookupScope inner( obj );
+                    for ( size_t i = 0; i < n; i++ ) {
+                        ASSERT_EQUALS( obj.getField( names[i] ).rawdata(),
+                                       FieldLookupScope::getField( obj, names[i] ).rawdata() );
+                        ASSERT_EQUALS( obj.getFieldDotted( names[i] ).rawdata(),
+                                       FieldLookupScope::getFieldDotted( obj, names[i] ).rawdata() );
+                    }
+                    ASSERT_EQUALS( string( "other" ),
+                                   FieldLookupScope::getField( other, "f1" ).String() );
+                }
+                ASSERT( !FieldLookupScope::covers( obj ) );
+            }
+        };
+
+    } // namespace FieldLookupScopeTests
+
+    namespace OpArenaTests {
+
+        BSONObj build( OpArena *arena, int nFields ) {
+            BSONObjBuilder b( 64, arena );
+            for ( int i = 0; i < nFields; i++ ) {
+                b.append( "f" + BSONObjBuilder::numStr( i ), "some string value" );
+            }
+            return b.obj();
+        }
+
+        /** Objects built in the arena match heap ones, and stay valid after the operation. */
+        class BuildInArena {
+        public:
+            void run() {
+                ASSERT( OpArena::current() == NULL );
+                BSONObj small, big;
+                {
+                    OpArena::Scope scope;
+                    ASSERT( OpArena::current() != NULL );
+                    {
+                        // a nested scope leaves the outer operation's arena alone
+                        OpArena::Scope nested;
+                    }
+                    ASSERT( OpArena::current() != NULL );
+
+                    BufBuilder bb( 16, OpArena::current() );
+                    ASSERT( bb.inOpArena() );
+                    ASSERT_THROWS( bb.decouple(), MsgAssertionException );
+
+                    small = build( OpArena::current(), 10 );
+                    // outgrows MaxAllocation, so it moves to the heap on the way
+                    big = build( OpArena::current(), 10000 );
+                    ASSERT_EQUALS( build( NULL, 10 ), small );
+                    ASSERT_EQUALS( build( NULL, 10000 ), big );
+
+                    BSONObj copy = small;
+                    for ( int i = 0; i < 1000; i++ ) {
+                        build( OpArena::current(), 10 );
+                    }
+                    ASSERT_EQUALS( copy, small );
+                }
+                ASSERT( OpArena::current() == NULL );
+                ASSERT_EQUALS( build( NULL, 10 ), small );
+                ASSERT_EQUALS( build( NULL, 10000 ), big );
+                ASSERT_EQUALS( build( NULL, 3 ), build( OpArena::current(), 3 ) );
+            }
+        };
+
+    } // namespace OpArenaTests
+
     namespace OIDTests {
 
         class init1 {
@@ -1923,6 +2070,9 @@ namespace JsobjTests {
             add< BSONObjTests::Validation::NoSize >( Object );
             add< BSONObjTests::Validation::NoSize >( Array );
             add< BSONObjTests::Validation::NoSize >( BinData );
+            add< KeyTests::CompareMatchesBSON >();
+            add< FieldLookupScopeTests::MatchesBSONObj >();
+            add< OpArenaTests::BuildInArena >();
             add< OIDTests::init1 >();
             add< OIDTests::initParse1 >();
             add< OIDTests::append >();
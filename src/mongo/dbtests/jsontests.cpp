@@ -1459,6 +1459,74 @@ namespace JsonTests {
 
     } // namespace FromJsonTests
 
+    namespace RoundTripTests {
+
+        /** Escapes and control characters anywhere in strings longer than a word. */
+        class EscapesAtEveryOffset {
+        public:
+            void run() {
+                const char specials[] = { '"', '\\', '/', '\n', '\t', '\x01', '\xc3' };
+                for ( int len = 0; len < 40; len++ ) {
+                    for ( int pos = 0; pos < len; pos++ ) {
+                        for ( size_t k = 0; k < sizeof( specials ); k++ ) {
+                            string str( len, 'a' );
+                            str[pos] = specials[k];
+                            BSONObj obj = BSON( "s" << str );
+                            ASSERT_EQUALS( obj, fromjson( obj.jsonString() ) );
+                        }
+                    }
+                }
+            }
+        };
+
+        /** Integers around the int and 18 digit boundaries of the integer fast path. */
+        class IntegerBoundaries {
+        public:
+            void run() {
+                const long long values[] = {
+                    0, -1, 2147483647LL, 2147483648LL, -2147483648LL, -2147483649LL,
+                    999999999999999999LL, 1000000000000000000LL, -999999999999999999LL,
+                    numeric_limits<long long>::max(), numeric_limits<long long>::min() + 1 };
+                for ( size_t i = 0; i < sizeof( values ) / sizeof( values[0] ); i++ ) {
+                    BSONObjBuilder b;
+                    if ( values[i] == static_cast<int>( values[i] ) )
+                        b.append( "n", static_cast<int>( values[i] ) );
+                    else
+                        b.append( "n", values[i] );
+                    BSONObj obj = b.obj();
+                    BSONObj parsed = fromjson( obj.jsonString() );
+                    ASSERT_EQUALS( obj, parsed );
+                    ASSERT_EQUALS( obj["n"].type(), parsed["n"].type() );
+                }
+                ASSERT_EQUALS( NumberDouble, fromjson( "{ n : 12e3 }" )["n"].type() );
+                ASSERT_EQUALS( NumberDouble, fromjson( "{ n : 12.5 }" )["n"].type() );
+                ASSERT_EQUALS( NumberDouble,
+                               fromjson( "{ n : 123456789012345678901234 }" )["n"].type() );
+            }
+        };
+
+        /** A corpus of typical documents survives serializing and parsing back. */
+        class TypicalDocuments {
+        public:
+            void run() {
+                for ( int i = 0; i < 100; i++ ) {
+                    BSONObjBuilder b;
+                    b.append( "_id", i );
+                    b.append( "name", "user name number " + BSONObjBuilder::numStr( i ) );
+                    b.append( "count", i * 7919LL * 104729LL );
+                    b.append( "ratio", i * 0.25 );
+                    b.appendBool( "active", i % 2 );
+                    b.append( "note", "line one\nline \"two\" \xc3\xa9t\xc3\xa9" );
+                    b.append( "address", BSON( "street" << "1 Main St" << "zip" << 10000 + i ) );
+                    b.append( "tags", BSON_ARRAY( "a" << "bb" << "ccc" << i ) );
+                    BSONObj doc = b.obj();
+                    ASSERT_EQUALS( doc, fromjson( doc.jsonString() ) );
+                }
+            }
+        };
+
+    } // namespace RoundTripTests
+
     class All : public Suite {
     public:
         All() : Suite( "json" ) {
@@ -1590,6 +1658,9 @@ namespace JsonTests {
             add< FromJsonTests::EmbeddedDatesFormat3 >();
             add< FromJsonTests::NullString >();
             add< FromJsonTests::NullFieldUnquoted >();
+            add< RoundTripTests::EscapesAtEveryOffset >();
+            add< RoundTripTests::IntegerBoundaries >();
+            add< RoundTripTests::TypicalDocuments >();
         }
     } myall;
 
@@ -117,6 +117,83 @@ namespace MatcherTests {
         }
     };
 
+    /** Simple predicates decided by the compiled MatchProgram. */
+    class CompiledPredicates {
+    public:
+        void run() {
+            // Ranges sharing a field, mixed numeric types.
+            Matcher range( fromjson( "{ a:{ $gt:1, $lte:5 }, b:'x' }" ) );
+            ASSERT( range.matches( fromjson( "{ a:5.0, b:'x' }" ) ) );
+            ASSERT( range.matches( BSON( "b" << "x" << "a" << 2LL ) ) );
+            ASSERT( !range.matches( fromjson( "{ a:1, b:'x' }" ) ) );
+            ASSERT( !range.matches( fromjson( "{ a:3, b:'xy' }" ) ) );
+            ASSERT( !range.matches( fromjson( "{ a:'3', b:'x' }" ) ) );
+            ASSERT( !range.matches( fromjson( "{ b:'x' }" ) ) );
+            // The first of duplicate field names is matched, as with getField().
+            ASSERT( range.matches( fromjson( "{ a:3, b:'x', a:10 }" ) ) );
+            ASSERT( !range.matches( fromjson( "{ a:10, b:'x', a:3 }" ) ) );
+
+            // Dotted paths, through objects and arrays.
+            Matcher dotted( fromjson( "{ 'a.b':4, 'a.c':{ $lt:'n' } }" ) );
+            ASSERT( dotted.matches( fromjson( "{ a:{ b:4, c:'m' } }" ) ) );
+            ASSERT( !dotted.matches( fromjson( "{ a:{ b:5, c:'m' } }" ) ) );
+            ASSERT( !dotted.matches( fromjson( "{ a:4 }" ) ) );
+            ASSERT( dotted.matches( fromjson( "{ a:[ { b:4 }, { c:'m' } ] }" ) ) );
+            ASSERT( dotted.matches( fromjson( "{ a:{ b:[ 3, 4 ], c:'m' } }" ) ) );
+            ASSERT( !dotted.matches( fromjson( "{ a:[ { b:3 }, { c:'m' } ] }" ) ) );
+
+            // Null matches missing values, but not along a path into an array.
+            Matcher null( fromjson( "{ 'a.b':null, c:{ $gte:null } }" ) );
+            ASSERT( null.matches( BSONObj() ) );
+            ASSERT( null.matches( fromjson( "{ a:1 }" ) ) );
+            ASSERT( !null.matches( fromjson( "{ a:{ b:1 } }" ) ) );
+            ASSERT( !null.matches( fromjson( "{ c:1 }" ) ) );
+            ASSERT( null.matches( fromjson( "{ a:[ { b:null } ] }" ) ) );
+
+            // Whole array and embedded object equality.
+            Matcher object( fromjson( "{ a:{ x:1 }, b:[ 1, 2 ] }" ) );
+            ASSERT( object.matches( fromjson( "{ a:{ x:1 }, b:[ 1, 2 ] }" ) ) );
+            ASSERT( object.matches( fromjson( "{ a:[ { x:1 } ], b:[ [ 1, 2 ] ] }" ) ) );
+            ASSERT( !object.matches( fromjson( "{ a:{ x:1, y:1 }, b:[ 1, 2 ] }" ) ) );
+        }
+    };
+
+    /** Literal regexes are matched without pcre, with the same results. */
+    class RegexFastPaths {
+    public:
+        void run() {
+            check( "abc", "", RegexMatcher::SUBSTRING, "xxabcx", true );
+            check( "abc", "", RegexMatcher::SUBSTRING, "xxabx", false );
+            check( "a\\.c", "", RegexMatcher::SUBSTRING, "a.c", true );
+            check( "a\\.c", "", RegexMatcher::SUBSTRING, "abc", false );
+            check( "^abc", "", RegexMatcher::PREFIX, "abcd", true );
+            check( "\\Aabc", "m", RegexMatcher::PREFIX, "xabc", false );
+            check( "^a b", "x", RegexMatcher::PREFIX, "abc", true );
+            check( "ERROR", "i", RegexMatcher::SUBSTRING_CASELESS, "an Error occurred", true );
+            check( "ERROR", "i", RegexMatcher::SUBSTRING_CASELESS, "an Err", false );
+            check( "^GET /", "i", RegexMatcher::PREFIX_CASELESS, "get /index.html", true );
+            check( "^GET /", "i", RegexMatcher::PREFIX_CASELESS, "ge", false );
+            check( "a.c", "", RegexMatcher::PCRE, "abc", true );
+            check( "^abc", "m", RegexMatcher::PCRE, "x\nabc", true );
+            check( "\\d+", "", RegexMatcher::PCRE, "a1", true );
+            check( "\xc3\xa9", "i", RegexMatcher::PCRE, "\xc3\x89", true );
+
+            Matcher m( fromjson( "{ a:/warn/i, b:{ $in:[ /^x/, 5 ] } }" ) );
+            ASSERT( m.matches( fromjson( "{ a:'a WARNING', b:'xyz' }" ) ) );
+            ASSERT( !m.matches( fromjson( "{ a:'a WARNING', b:'yz' }" ) ) );
+            ASSERT( !m.matches( fromjson( "{ a:'a warm', b:5 }" ) ) );
+        }
+    private:
+        static void check( const char *regex, const char *flags, RegexMatcher::Kind kind,
+                           const char *str, bool expected ) {
+            RegexMatcher rm;
+            rm.init( regex, flags );
+            ASSERT_EQUALS( kind, rm._kind );
+            ASSERT_EQUALS( expected, rm.matchesString( str ) );
+            ASSERT_EQUALS( expected, rm._re->PartialMatch( str ) );
+        }
+    };
+
     class MixedNumericEmbedded {
     public:
         void run() {
@@ -412,6 +489,8 @@ namespace MatcherTests {
             add<MixedNumericEqual>();
             add<MixedNumericGt>();
             add<MixedNumericIN>();
+            add<CompiledPredicates>();
+            add<RegexFastPaths>();
             add<Size>();
             add<MixedNumericEmbedded>();
             add<ElemMatchKey>();
@@ -19,7 +19,11 @@
  */
 
 #include "mongo/pch.h"
+
+#include <boost/thread/thread.hpp>
+
 #include "mongo/db/dbhelpers.h"
+#include "mongo/db/descriptor.h"
 #include "mongo/db/json.h"
 #include "mongo/db/queryutil.h"
 
@@ -939,6 +943,43 @@ namespace NamespaceTests {
             BSONObj key() const { return BSON( "1" << 1 ); }
         };
         
+        /** Dictionary keys generated for the ydb match the keys generated as BSON. */
+        class DictionaryKeys {
+        public:
+            void run() {
+                const char *docs[] = { "{a:1,b:'x'}", "{a:{b:2}}", "{b:1}", "{a:[1,2],b:3}",
+                                       "{a:[{b:1},{b:2}]}", "{a:{b:[1,2]}}", "{a:null}",
+                                       "{a:{c:1}}", "{a:'a string',b:{c:[]}}", "{a:[]}", "{}" };
+                const char *patterns[] = { "{a:1}", "{'a.b':1}", "{a:1,b:-1}", "{b:1,'a.b':1}" };
+                for ( size_t p = 0; p < sizeof( patterns ) / sizeof( patterns[ 0 ] ); ++p ) {
+                    for ( int sparse = 0; sparse < 2; ++sparse ) {
+                        Descriptor descriptor( fromjson( patterns[ p ] ), false, 0, sparse );
+                        for ( size_t d = 0; d < sizeof( docs ) / sizeof( docs[ 0 ] ); ++d ) {
+                            check( descriptor, fromjson( docs[ d ] ) );
+                        }
+                    }
+                }
+            }
+        private:
+            void check( const Descriptor &descriptor, const BSONObj &obj ) {
+                const BSONObj pk = BSON( "" << 7 );
+                BSONObjSet keys;
+                descriptor.generateKeys( obj, keys );
+
+                storage::DBTArrays arrays( 1 );
+                const size_t n = descriptor.generateKeys( obj, pk, &arrays[ 0 ] );
+                ASSERT_EQUALS( keys.size(), n );
+                ASSERT_EQUALS( n, arrays[ 0 ].size );
+                size_t i = 0;
+                for ( BSONObjSet::const_iterator it = keys.begin(); it != keys.end(); ++it, ++i ) {
+                    const storage::Key sKey( *it, &pk );
+                    const DBT &dbt = arrays[ 0 ].dbts[ i ];
+                    ASSERT_EQUALS( (size_t) sKey.size(), (size_t) dbt.size );
+                    ASSERT( memcmp( sKey.buf(), dbt.data, dbt.size ) == 0 );
+                }
+            }
+        };
+
     } // namespace IndexDetailsTests
 
     namespace NamespaceDetailsTests {
@@ -1073,7 +1114,183 @@ namespace NamespaceTests {
                 assertCachedIndexKey( BSONObj() );
             }
         };                                                                                         
+
+        /** Cached plans and their statistics survive a round trip through BSON. */
+        class QueryCacheEntries : public CachedPlanBase {
+        public:
+            void run() {
+                nsd()->registerCachedQueryPlanForPattern
+                        ( _pattern,
+                         CachedQueryPlan( BSON( "a" << 1 ), 7, CandidatePlanCharacter( true, false ),
+                                          3 ) );
+                BSONArray entries = nsd()->queryCacheEntries();
+                ASSERT_EQUALS( 1, entries.nFields() );
+                BSONObj entry = entries.firstElement().Obj();
+
+                ASSERT( _pattern == QueryPattern::fromBSON( entry[ "pattern" ].Obj() ) );
+                CachedQueryPlan plan = CachedQueryPlan::fromBSON( entry[ "plan" ].Obj() );
+                ASSERT_EQUALS( BSON( "a" << 1 ), plan.indexKey() );
+                ASSERT_EQUALS( 7, plan.nScanned() );
+                ASSERT_EQUALS( 3, plan.nReturned() );
+                ASSERT( plan.planCharacter().mayRunInOrderPlan() );
+                ASSERT( !plan.planCharacter().mayRunOutOfOrderPlan() );
+                ASSERT( !plan.pinned() );
+            }
+        };
+
+        /** A pinned plan is not replaced by the optimizer, but can still be removed. */
+        class PinnedPlan : public CachedPlanBase {
+        public:
+            void run() {
+                nsd()->registerCachedQueryPlanForPattern
+                        ( _pattern,
+                         CachedQueryPlan( BSON( "b" << 1 ), 1, CandidatePlanCharacter( true, false ),
+                                          0, true ) );
+                registerIndexKey( BSON( "a" << 1 ) );
+                assertCachedIndexKey( BSON( "b" << 1 ) );
+
+                registerIndexKey( BSONObj() );
+                assertCachedIndexKey( BSONObj() );
+            }
+        };
+
+        /** Writes that don't change the collection's size leave the query cache alone. */
+        class WritesWithoutDrift : public CachedPlanBase {
+        public:
+            void run() {
+                registerIndexKey( BSON( "a" << 1 ) );
+                for( int i = 0; i < 1000; ++i ) {
+                    nsd()->notifyOfWriteOp();
+                }
+                assertCachedIndexKey( BSON( "a" << 1 ) );
+            }
+        };
         
+        class CappedStatsBase {
+        public:
+            CappedStatsBase( const string &coll ) : _coll( coll ), _ns( "unittests." + coll ) {
+                _client.dropCollection( _ns );
+            }
+            ~CappedStatsBase() {
+                _client.dropCollection( _ns );
+            }
+        protected:
+            void create() {
+                BSONObj info;
+                ASSERT( _client.runCommand( "unittests",
+                                            BSON( "create" << _coll <<
+                                                  "capped" << true << "size" << 1024 * 1024 <<
+                                                  "max" << 2500 ),
+                                            info ) );
+            }
+            void insert( int start, int n ) {
+                for ( int i = start; i < start + n; ++i ) {
+                    _client.insert( _ns, BSON( "_id" << i << "s" << string( i % 50, 'x' ) ) );
+                }
+            }
+            BSONObj boundary() {
+                Client::ReadContext ctx( _ns );
+                return nsdetails( _ns )->minUnsafeKey();
+            }
+            void save() {
+                const BSONObj b = boundary();
+                Client::WriteContext ctx( _ns );
+                Client::Transaction txn( DB_SERIALIZABLE );
+                NamespaceDetails *d = nsdetails( _ns );
+                ASSERT( d->refreshSavedStats( b ) );
+                nsindex( _ns )->update_ns( _ns, d->serialize(), true );
+                txn.commit();
+            }
+            void reopen() {
+                long long n = 0;
+                long long size = 0;
+                for ( auto_ptr<DBClientCursor> c = _client.query( _ns, BSONObj() ); c->more(); ) {
+                    n++;
+                    size += c->next().objsize();
+                }
+                ASSERT_EQUALS( 2500, n );
+
+                Client::WriteContext ctx( _ns );
+                Client::Transaction txn( DB_SERIALIZABLE );
+                ASSERT( nsindex( _ns )->close_ns( _ns ) );
+                BSONObjBuilder stats;
+                nsdetails( _ns )->fillSpecificStats( &stats, 1 );
+                BSONObj o = stats.obj();
+                ASSERT_EQUALS( n, o[ "cappedCount" ].numberLong() );
+                ASSERT_EQUALS( size, o[ "cappedSizeCurrent" ].numberLong() );
+                txn.commit();
+            }
+            const string _coll;
+            const string _ns;
+            DBDirectClient _client;
+        };
+
+        /**
+         * A capped collection reopens with the same count and size from its saved stats, both
+         * for documents trimmed since they were saved and for ones inserted since.
+         */
+        class CappedStatsReopen : public CappedStatsBase {
+        public:
+            CappedStatsReopen() : CappedStatsBase( "NamespaceDetailsTests_CappedStatsReopen" ) {
+            }
+            void run() {
+                create();
+                insert( 0, 3000 );
+                save();
+                // trims the oldest of the saved documents, and adds some past them
+                insert( 3000, 200 );
+                reopen();
+                insert( 3200, 1500 );
+                save();
+                insert( 4700, 10 );
+                reopen();
+            }
+        };
+
+        /**
+         * An insert another client commits while the saver's snapshot is open, but before it
+         * counts, is not in the snapshot.  It must not be below the saved boundary either, or
+         * the reopened collection never counts it.
+         */
+        class CappedStatsConcurrentInsert : public CappedStatsBase {
+        public:
+            CappedStatsConcurrentInsert() :
+                CappedStatsBase( "NamespaceDetailsTests_CappedStatsConcurrentInsert" ) {
+            }
+            void run() {
+                create();
+                insert( 0, 3000 );
+                const BSONObj b = boundary();
+                {
+                    Client::Transaction txn( DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY );
+                    boost::thread inserter( boost::bind( &CappedStatsConcurrentInsert::insertFromOtherClient,
+                                                         this, 3000 ) );
+                    inserter.join();
+                    {
+                        Client::ReadContext ctx( _ns );
+                        ASSERT( nsdetails( _ns )->refreshSavedStats( b ) );
+                    }
+                    txn.commit();
+                }
+                {
+                    Client::WriteContext ctx( _ns );
+                    Client::Transaction txn( DB_SERIALIZABLE );
+                    nsindex( _ns )->update_ns( _ns, nsdetails( _ns )->serialize(), true );
+                    txn.commit();
+                }
+                reopen();
+            }
+        private:
+            void insertFromOtherClient( int i ) {
+                Client::initThread( "capped stats inserter" );
+                {
+                    DBDirectClient client;
+                    client.insert( _ns, BSON( "_id" << i << "s" << string( i % 50, 'x' ) ) );
+                }
+                cc().shutdown();
+            }
+        };
+
     } // namespace NamespaceDetailsTests
 
     class All : public Suite {
@@ -1119,8 +1336,14 @@ namespace NamespaceTests {
             add< IndexDetailsTests::CompoundMissing >();
             add< IndexDetailsTests::Suitability >();
             add< IndexDetailsTests::NumericFieldSuitability >();
+            add< IndexDetailsTests::DictionaryKeys >();
             add< NamespaceDetailsTests::SetIndexIsMultikey >();
             add< NamespaceDetailsTests::ClearQueryCache >();
+            add< NamespaceDetailsTests::QueryCacheEntries >();
+            add< NamespaceDetailsTests::PinnedPlan >();
+            add< NamespaceDetailsTests::WritesWithoutDrift >();
+            add< NamespaceDetailsTests::CappedStatsReopen >();
+            add< NamespaceDetailsTests::CappedStatsConcurrentInsert >();
         }
     } myall;
 } // namespace NamespaceTests
@@ -36,6 +36,7 @@
 
 namespace mongo {
     extern BSONObj id_obj;
+    extern int queryIntersectionMinDocuments;
     void runQuery(Message& m, QueryMessage& q, Message &response ) {
         CurOp op( &(cc()) );
         op.ensureStarted();
@@ -1344,6 +1345,58 @@ namespace QueryOptimizerTests {
             }
         };
 
+        /** Two indexes on separately constrained fields are also tried as an intersection. */
+        class IntersectionPlan : public Base {
+        public:
+            IntersectionPlan() : _minDocuments( queryIntersectionMinDocuments ) {}
+            ~IntersectionPlan() { queryIntersectionMinDocuments = _minDocuments; }
+            void run() {
+                ensureIndex( ns(), BSON( "a" << 1 ), false, "a_1" );
+                ensureIndex( ns(), BSON( "b" << 1 ), false, "b_1" );
+                for( int i = 0; i < 140; ++i ) {
+                    client().insert( ns(), BSON( "_id" << i << "a" << i % 10 << "b" << i % 7 ) );
+                }
+                BSONObj query = BSON( "a" << 1 << "b" << 1 );
+
+                // Small collections don't get an intersection plan.
+                ASSERT_EQUALS( 3, makeQps( query )->nPlans() );
+
+                queryIntersectionMinDocuments = 0;
+                shared_ptr<QueryPlanSet> qps = makeQps( query );
+                ASSERT_EQUALS( 4, qps->nPlans() );
+                shared_ptr<QueryPlan> intersection;
+                for( QueryPlanSet::PlanVector::const_iterator i = qps->plans().begin();
+                     i != qps->plans().end(); ++i ) {
+                    if ( str::equals( (*i)->planKey().firstElementFieldName(), "$intersect" ) ) {
+                        intersection = *i;
+                    }
+                }
+                ASSERT( intersection );
+                ASSERT_EQUALS( 1U, intersection->intersectedPlans().size() );
+                ASSERT_EQUALS( QueryPlan::Helpful, intersection->utility() );
+
+                // Only documents found by both indexes are returned.
+                vector<int> ids;
+                for( shared_ptr<Cursor> c = intersection->newCursor(); c->ok(); c->advance() ) {
+                    ids.push_back( c->current()[ "_id" ].numberInt() );
+                }
+                ASSERT_EQUALS( 2U, ids.size() );
+                ASSERT_EQUALS( 1, ids[ 0 ] );
+                ASSERT_EQUALS( 71, ids[ 1 ] );
+
+                // A recorded intersection plan is rebuilt from the plan cache.
+                nsd()->registerCachedQueryPlanForPattern
+                        ( makePattern( query, BSONObj() ),
+                          CachedQueryPlan( intersection->planKey(), 2,
+                                           CandidatePlanCharacter( true, false ) ) );
+                qps = makeQps( query );
+                ASSERT( qps->usingCachedPlan() );
+                ASSERT_EQUALS( intersection->planKey(), qps->firstPlan()->planKey() );
+            }
+        private:
+            int _minDocuments;
+        };
+
         /** An unhelpful query plan will not be used if recorded in the query plan cache. */
         class AvoidUnhelpfulRecordedPlan : public Base {
         public:
@@ -1389,6 +1442,54 @@ namespace QueryOptimizerTests {
             }
         };
 
+        /** A persisted plan cache is loaded again when the collection is reopened. */
+        class PersistedPlanCache : public Base {
+        public:
+            void run() {
+                ensureIndex( ns(), BSON( "a" << 1 ), false, "a_1" );
+                ensureIndex( ns(), BSON( "b" << 1 ), false, "b_1" );
+                BSONObj query = BSON( "a" << 1 << "b" << 1 );
+                nsd()->registerCachedQueryPlanForPattern
+                        ( makePattern( query, BSONObj() ),
+                          CachedQueryPlan( BSON( "b" << 1 ), 1,
+                                           CandidatePlanCharacter( true, false ) ) );
+                nsd()->persistQueryCache();
+
+                ASSERT( nsindex( ns() )->close_ns( ns() ) );
+                ASSERT_EQUALS( BSON( "b" << 1 ),
+                               nsd()->cachedQueryPlanForPattern( makePattern( query, BSONObj() ) )
+                                       .indexKey() );
+                shared_ptr<QueryPlanSet> qps = makeQps( query );
+                ASSERT( qps->usingCachedPlan() );
+                ASSERT_EQUALS( BSON( "b" << 1 ), qps->firstPlan()->indexKey() );
+            }
+        };
+
+        /** Writes that change the collection's size by enough invalidate a cached plan. */
+        class DriftInvalidatesCachedPlan : public Base {
+        public:
+            void run() {
+                ensureIndex( ns(), BSON( "a" << 1 ), false, "a_1" );
+                BSONObj query = BSON( "a" << 1 );
+                nsd()->registerCachedQueryPlanForPattern
+                        ( makePattern( query, BSONObj() ),
+                          CachedQueryPlan( BSON( "a" << 1 ), 1,
+                                           CandidatePlanCharacter( true, false ) ) );
+                ASSERT_EQUALS( BSON( "a" << 1 ),
+                               nsd()->cachedQueryPlanForPattern( makePattern( query, BSONObj() ) )
+                                       .indexKey() );
+
+                // Each insert notes a write op, and the count is checked every
+                // QueryCacheCheckInterval of them.
+                for( int i = 0; i < 1000; ++i ) {
+                    client().insert( ns(), BSON( "_id" << i << "a" << i ) );
+                }
+                ASSERT( nsd()->cachedQueryPlanForPattern( makePattern( query, BSONObj() ) )
+                                .indexKey().isEmpty() );
+                ASSERT( !makeQps( query )->usingCachedPlan() );
+            }
+        };
+
         /** Special plans are only selected when allowed. */
         class AllowSpecial : public Base {
         public:
@@ -1690,8 +1791,11 @@ namespace QueryOptimizerTests {
             //add<QueryPlanSetTests::ExcludeSpecialPlanWhenIndexPlan>();
             //add<QueryPlanSetTests::ExcludeUnindexedPlanWhenSpecialPlan>();
             add<QueryPlanSetTests::PossiblePlans>();
+            add<QueryPlanSetTests::IntersectionPlan>();
             add<QueryPlanSetTests::AvoidUnhelpfulRecordedPlan>();
             add<QueryPlanSetTests::AvoidDisallowedRecordedPlan>();
+            add<QueryPlanSetTests::PersistedPlanCache>();
+            add<QueryPlanSetTests::DriftInvalidatesCachedPlan>();
             // TokuMX: no geo
             //add<QueryPlanSetTests::AllowSpecial>();
             add<MultiPlanScannerTests::ToString>();
@@ -196,6 +196,32 @@ namespace QueryTests {
         }
     };
 
+    /** Large documents in a getMore reply are sent from their own buffers. */
+    class GetMoreLargeDocuments : public ClientBase {
+    public:
+        ~GetMoreLargeDocuments() {
+            client().dropCollection( ns() );
+        }
+        void run() {
+            const string big( 40 * 1024, 'x' );
+            for ( int i = 0; i < 20; ++i ) {
+                // interleave small documents so the reply mixes copied and referenced data
+                insert( ns(), BSON( "_id" << i << "s" << ( i % 2 ? big : string( "small" ) ) ) );
+            }
+            auto_ptr< DBClientCursor > cursor = client().query( ns(), Query().sort( "_id" ), 0, 0,
+                                                                 0, 0, 3 );
+            for ( int i = 0; i < 20; ++i ) {
+                ASSERT( cursor->more() );
+                BSONObj o = cursor->next();
+                ASSERT_EQUALS( i, o[ "_id" ].numberInt() );
+                ASSERT_EQUALS( i % 2 ? big : string( "small" ), o[ "s" ].String() );
+            }
+            ASSERT( !cursor->more() );
+        }
+    private:
+        static const char *ns() { return "unittests.querytests.GetMoreLargeDocuments"; }
+    };
+
     class PositiveLimit : public ClientBase {
     public:
         const char* ns;
@@ -1519,6 +1545,7 @@ namespace QueryTests {
             add< FindOneRequireIndex >();
             add< BoundedKey >();
             add< GetMore >();
+            add< GetMoreLargeDocuments >();
             add< PositiveLimit >();
             add< ReturnOneOfManyAndTail >();
             add< TailNotAtEnd >();
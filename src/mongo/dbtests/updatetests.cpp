@@ -26,6 +26,7 @@
 #include "mongo/db/lasterror.h"
 #include "mongo/db/ops/update.h"
 #include "mongo/db/ops/update_internal.h"
+#include "mongo/db/storage/update_diff.h"
 
 #include "dbtests.h"
 
@@ -1350,6 +1351,144 @@ namespace UpdateTests {
         }
     };
 
+    namespace UpdateDiffTests {
+
+        BSONObj bigDoc( int n, const BSONObj &sub ) {
+            BSONObjBuilder b;
+            b.append( "_id", 1 );
+            b.append( "n", n );
+            b.append( "s", string( 1000, 'x' ) );
+            b.append( "sub", sub );
+            return b.obj();
+        }
+
+        void checkRoundTrip( const BSONObj &oldObj, const BSONObj &newObj ) {
+            BSONObj diff = storage::computeUpdateDiff( oldObj, newObj );
+            ASSERT( !diff.isEmpty() );
+            ASSERT_LESS_THAN( diff.objsize() * 10, newObj.objsize() );
+            ASSERT_EQUALS( 0, memcmp( newObj.objdata(),
+                                      storage::applyUpdateDiff( oldObj, diff ).objdata(),
+                                      newObj.objsize() ) );
+            BSONObj rollbackDiff = storage::computeUpdateDiff( newObj, oldObj );
+            ASSERT_EQUALS( 0, memcmp( oldObj.objdata(),
+                                      storage::applyUpdateDiff( newObj, rollbackDiff ).objdata(),
+                                      oldObj.objsize() ) );
+        }
+
+        class Inc {
+        public:
+            void run() {
+                BSONObj sub = BSON( "a" << 1 << "b" << "c" );
+                checkRoundTrip( bigDoc( 1, sub ), bigDoc( 2, sub ) );
+            }
+        };
+
+        class Nested {
+        public:
+            void run() {
+                BSONObj oldSub = BSON( "a" << 1 << "b" << "c" << "d" << BSON( "e" << 1.5 ) );
+                BSONObj newSub = BSON( "a" << 1 << "b" << "c" << "d" << BSON( "e" << 2.5 ) );
+                checkRoundTrip( bigDoc( 1, oldSub ), bigDoc( 1, newSub ) );
+                // a new field in an embedded object replaces just that object
+                checkRoundTrip( bigDoc( 1, oldSub ), bigDoc( 1, BSON( "a" << 1 << "z" << 2 ) ) );
+            }
+        };
+
+        class StructureChange {
+        public:
+            void run() {
+                BSONObj sub = BSON( "a" << 1 );
+                BSONObj oldObj = bigDoc( 1, sub );
+                BSONObjBuilder b;
+                b.appendElements( oldObj );
+                b.append( "added", true );
+                ASSERT( storage::computeUpdateDiff( oldObj, b.obj() ).isEmpty() );
+                ASSERT( storage::computeUpdateDiff( oldObj, oldObj.removeField( "n" ) ).isEmpty() );
+                // a diff bigger than what it saves isn't worth it
+                ASSERT( storage::computeUpdateDiff( BSON( "_id" << 1 << "x" << 1 ),
+                                                    BSON( "_id" << 1 << "x" << 2 ) ).isEmpty() );
+            }
+        };
+
+        class Mismatch {
+        public:
+            void run() {
+                BSONObj sub = BSON( "a" << 1 );
+                BSONObj diff = storage::computeUpdateDiff( bigDoc( 1, sub ), bigDoc( 2, sub ) );
+                ASSERT_THROWS( storage::applyUpdateDiff( BSON( "_id" << 1 ), diff ),
+                               MsgAssertionException );
+            }
+        };
+
+    } // namespace UpdateDiffTests
+
+    namespace FastUpdateTests {
+
+        class Base : public ClientBase {
+        public:
+            Base() : _wasOn( fastUpdates ) {
+                fastUpdates = true;
+                client().dropCollection( ns() );
+            }
+            ~Base() {
+                fastUpdates = _wasOn;
+                client().dropCollection( ns() );
+            }
+        protected:
+            const char *ns() { return "unittests.updatetests.FastUpdate"; }
+        private:
+            const bool _wasOn;
+        };
+
+        class IncAndSet : public Base {
+        public:
+            void run() {
+                insert( ns(), BSON( "_id" << 1 << "a" << 1 << "b" << "x" ) );
+                update( ns(), BSON( "_id" << 1 ), BSON( "$inc" << BSON( "a" << 2 ) ) );
+                update( ns(), BSON( "_id" << 1 ), BSON( "$set" << BSON( "b" << "y" << "c" << 5 ) ) );
+                ASSERT( !error() );
+                ASSERT_EQUALS( BSON( "_id" << 1 << "a" << 3 << "b" << "y" << "c" << 5 ),
+                               client().findOne( ns(), BSON( "_id" << 1 ) ) );
+            }
+        };
+
+        class Missing : public Base {
+        public:
+            void run() {
+                update( ns(), BSON( "_id" << 1 ), BSON( "$inc" << BSON( "a" << 1 ) ) );
+                ASSERT( !error() );
+                ASSERT( client().findOne( ns(), BSON( "_id" << 1 ) ).isEmpty() );
+            }
+        };
+
+        class DoesNotApply : public Base {
+        public:
+            void run() {
+                insert( ns(), BSON( "_id" << 1 << "a" << "string" ) );
+                update( ns(), BSON( "_id" << 1 ), BSON( "$inc" << BSON( "a" << 1 ) ) );
+                // the fast update didn't read the document, so it can't fail
+                ASSERT( !error() );
+                ASSERT_EQUALS( BSON( "_id" << 1 << "a" << "string" ),
+                               client().findOne( ns(), BSON( "_id" << 1 ) ) );
+            }
+        };
+
+        class Indexed : public Base {
+        public:
+            void run() {
+                client().ensureIndex( ns(), BSON( "a" << 1 ) );
+                insert( ns(), BSON( "_id" << 1 << "a" << 1 ) );
+                update( ns(), BSON( "_id" << 1 ), BSON( "$inc" << BSON( "a" << 1 ) ) );
+                ASSERT( !client().findOne( ns(), Query( BSON( "a" << 2 ) ).hint( BSON( "a" << 1 ) ) ).isEmpty() );
+                // an update of an indexed field still reads the document, and fails as usual
+                insert( ns(), BSON( "_id" << 2 << "a" << "string" ) );
+                update( ns(), BSON( "_id" << 2 ), BSON( "$inc" << BSON( "a" << 1 ) ) );
+                ASSERT( error() );
+            }
+        };
+
+    } // namespace FastUpdateTests
+
     class All : public Suite {
     public:
         All() : Suite( "update" ) {
@@ -1461,6 +1600,16 @@ namespace UpdateTests {
             add< basic::setswitchint >();
 
             add< IndexFieldNameTest >();
+
+            add< UpdateDiffTests::Inc >();
+            add< UpdateDiffTests::Nested >();
+            add< UpdateDiffTests::StructureChange >();
+            add< UpdateDiffTests::Mismatch >();
+
+            add< FastUpdateTests::IncAndSet >();
+            add< FastUpdateTests::Missing >();
+            add< FastUpdateTests::DoesNotApply >();
+            add< FastUpdateTests::Indexed >();
         }
     } myall;
 
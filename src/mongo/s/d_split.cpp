@@ -47,6 +47,10 @@
 
 namespace mongo {
 
+    // A key from a cursor over idx, with its field names, for messages and split points.
+    static BSONObj prettyKey( const IndexDetails &idx , const BSONObj &key ) {
+        return key.replaceFieldNames( idx.keyPattern() ).clientReadable();
+    }
 
     class CmdMedianKey : public InformationCommand {
     public:
@@ -122,7 +126,7 @@ namespace mongo {
                 max = Helpers::modifiedRangeBound( max , idx->keyPattern() , -1 );
             }
 
-            shared_ptr<IndexCursor> c( IndexCursor::make( d , *idx , min , max , false , 1 ) );
+            shared_ptr<Cursor> c( IndexCursor::make( d , *idx , min , max , false , 1 ) );
             auto_ptr<ClientCursor> cc( new ClientCursor( QueryOption_NoCursorTimeout , c , ns ) );
             if ( ! cc->ok() ) {
                 // range is empty
@@ -161,7 +165,7 @@ namespace mongo {
                         continue;
                     
                     ostringstream os;
-                    os << "found null value in key " << c->prettyKey( currKey ) << " for doc: "
+                    os << "found null value in key " << prettyKey( *idx , currKey ) << " for doc: "
                        << ( obj.hasField( "_id" ) ? obj.toString() : obj["_id"].toString() );
                     log() << "checkShardingIndex for '" << ns << "' failed: " << os.str() << endl;
                     
@@ -253,7 +257,7 @@ namespace mongo {
 
         void slowFindSplitPoint(long long targetChunkSize) {
             long long skipped = 0;
-            for (shared_ptr<IndexCursor> c(IndexCursor::make(_d, _idx, _chunkMin.key(), _chunkMax.key(), false, 1)); c->ok(); c->advance()) {
+            for (shared_ptr<Cursor> c(IndexCursor::make(_d, _idx, _chunkMin.key(), _chunkMax.key(), false, 1)); c->ok(); c->advance()) {
                 const BSONObj &currKey = c->currKey();
                 const BSONObj &currPK = c->currPK();
                 long long docsize = currKey.objsize() + currPK.objsize() + c->current().objsize();
@@ -331,7 +335,7 @@ namespace mongo {
                 // If _chunkMin doesn't actually exist (could be {x: MinKey} for example) we need to
                 // get the actual first key in the chunk so that we make sure we don't try to split
                 // on the first key.
-                shared_ptr<IndexCursor> c(IndexCursor::make(_d, _idx, _chunkMin.key(), _chunkMax.key(), false, 1, 1));
+                shared_ptr<Cursor> c(IndexCursor::make(_d, _idx, _chunkMin.key(), _chunkMax.key(), false, 1, 1));
                 massert(16794, "didn't find anything actually in our chunk, but we thought we should split it", c->ok());
                 _lastSplitKey = _chunkPattern.prettyKey(c->currKey());
             }
@@ -499,7 +503,7 @@ namespace mongo {
                 long long numChunks = 0;
 
                 {
-                    shared_ptr<IndexCursor> c(IndexCursor::make( d , *idx , min , max , false , 1 ));
+                    shared_ptr<Cursor> c(IndexCursor::make( d , *idx , min , max , false , 1 ));
                     auto_ptr<ClientCursor> cc( new ClientCursor( QueryOption_NoCursorTimeout , c , ns ) );
                     if ( ! cc->ok() ) {
                         errmsg = "can't open a cursor for splitting (desired range is possibly empty)";
@@ -510,7 +514,7 @@ namespace mongo {
                     // at the end. If a key appears more times than entries allowed on a chunk, we issue a warning and
                     // split on the following key.
                     set<BSONObj> tooFrequentKeys;
-                    splitKeys.push_back(c->prettyKey(c->currKey().getOwned()).extractFields(keyPattern));
+                    splitKeys.push_back(prettyKey(*idx, c->currKey().getOwned()).extractFields(keyPattern));
                     while (true) {
                         while (cc->ok()) {
                             const BSONObj &currObj = cc->current();
@@ -519,7 +523,7 @@ namespace mongo {
 
                             // we want ~half-full chunks
                             if (2 * currSize >= maxChunkSize) {
-                                BSONObj currKey = c->prettyKey(c->currKey()).extractFields(keyPattern);
+                                BSONObj currKey = prettyKey(*idx, c->currKey()).extractFields(keyPattern);
                                 // Do not use this split key if it is the same used in the previous split point.
                                 if (currKey.woCompare(splitKeys.back()) == 0) {
                                     tooFrequentKeys.insert(currKey.getOwned());
@@ -566,7 +570,7 @@ namespace mongo {
                     // Warn for keys that are more numerous than maxChunkSize allows.
                     for ( set<BSONObj>::const_iterator it = tooFrequentKeys.begin(); it != tooFrequentKeys.end(); ++it ) {
                         warning() << "chunk is larger than " << maxChunkSize
-                                  << " bytes because of key " << c->prettyKey( *it ) << endl;
+                                  << " bytes because of key " << prettyKey( *idx , *it ) << endl;
                     }
 
                     // Remove the sentinel at the beginning before returning
@@ -25,11 +25,14 @@
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/convenience.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "mongo/base/initializer.h"
 #include "mongo/client/dbclientcursor.h"
+#include "mongo/client/remote_transaction.h"
 #include "mongo/db/namespacestring.h"
 #include "mongo/tools/tool.h"
+#include "mongo/util/queue.h"
 
 using namespace mongo;
 
@@ -44,14 +47,109 @@ class Dump : public Tool {
     private:
         FILE* _f;
     };
+
+    typedef shared_ptr<BufBuilder> Batch;
+
+    // A range of a split collection being dumped, see writeCollectionRanges.
+    struct RangeCursor {
+        size_t i;
+        FILE* f;
+        shared_ptr<DBClientCursor> cursor;
+    };
+
+    /**
+     * Writes the ranges of a split collection to their files, each range on the thread it is
+     * assigned to, so that its batches stay in order while different ranges are written at
+     * once.  A range's file is closed after its last batch.
+     */
+    class RangeWriters : boost::noncopyable {
+        struct Item {
+            FILE* f;
+            Batch batch;  // empty with last, or to stop the thread
+            bool last;
+        };
+        typedef BlockingQueue<Item> Queue;
+
+    public:
+        explicit RangeWriters(int n) : _lock("Dump::RangeWriters") {
+            for (int i = 0; i < n; i++) {
+                _queues.push_back(shared_ptr<Queue>(new Queue(8)));
+                _threads.push_back(shared_ptr<boost::thread>(
+                        new boost::thread(boost::bind(&RangeWriters::run, this, _queues.back()))));
+            }
+        }
+
+        ~RangeWriters() {
+            join();
+        }
+
+        void write(size_t range, FILE* f, const Batch& batch, bool last) {
+            Item item = { f, batch, last };
+            _queues[range % _queues.size()]->push(item);
+        }
+
+        /** Waits for everything to be written, and throws if any of it couldn't be. */
+        void finish() {
+            join();
+            scoped_lock lk(_lock);
+            uassert(17032, _error, _error.empty());
+        }
+
+        bool failed() {
+            scoped_lock lk(_lock);
+            return !_error.empty();
+        }
+
+    private:
+        void join() {
+            for (size_t i = 0; i < _threads.size(); i++) {
+                Item stop = { NULL, Batch(), false };
+                _queues[i]->push(stop);
+            }
+            for (size_t i = 0; i < _threads.size(); i++) {
+                _threads[i]->join();
+            }
+            _threads.clear();
+        }
+
+        void run(shared_ptr<Queue> queue) {
+            set<FILE*> open;
+            for (Item item = queue->blockingPop(); item.f != NULL; item = queue->blockingPop()) {
+                open.insert(item.f);
+                if (item.batch && !failed()) {
+                    const size_t len = item.batch->len();
+                    if (fwrite(item.batch->buf(), 1, len, item.f) != len) {
+                        scoped_lock lk(_lock);
+                        _error = errnoWithPrefix("couldn't write to file");
+                    }
+                }
+                if (item.last) {
+                    fclose(item.f);
+                    open.erase(item.f);
+                }
+            }
+            // stopped early, by an error
+            for (set<FILE*>::iterator it = open.begin(); it != open.end(); ++it) {
+                fclose(*it);
+            }
+        }
+
+        vector< shared_ptr<Queue> > _queues;
+        vector< shared_ptr<boost::thread> > _threads;
+        mongo::mutex _lock;
+        string _error;
+    };
+
 public:
-    Dump() : Tool( "dump" , ALL , "" , "" , true ) {
+    Dump() : Tool( "dump" , ALL , "" , "" , true ), _splitSize(0), _numWriters(0) {
         add_options()
         ("out,o", po::value<string>()->default_value("dump"), "output directory or \"-\" for stdout")
         ("query,q", po::value<string>() , "json query" )
         ("oplog", "Use oplog for point-in-time snapshotting" )
         ("repair", "try to recover a crashed database" )
         ("forceTableScan", "force a table scan (do not use $snapshot)" )
+        ("splitSize", po::value<int>(), "dump everything from one snapshot transaction, splitting collections into _id ranges of about this many MB, each written to its own file" )
+        ("numWriters", po::value<int>()->default_value(4), "with --splitSize, number of ranges to fetch and write at once" )
         ;
     }
 
@@ -135,6 +233,110 @@ public:
         log() << "\t\t " << m.done() << " objects" << endl;
     }
 
+    // @return the _id keys splitting coll into ranges of about _splitSize MB, or nothing if it
+    //         is smaller than that, or can't be split by _id.
+    vector<BSONObj> splitKeys( const string& coll ) {
+        BSONObjBuilder cmd;
+        cmd.append( "splitVector" , coll );
+        cmd.append( "keyPattern" , BSON( "_id" << 1 ) );
+        cmd.append( "maxChunkSize" , _splitSize );
+        BSONObj res;
+        vector<BSONObj> keys;
+        if ( ! conn( true ).runCommand( "admin" , cmd.done() , res ) ) {
+            LOG(1) << "\tnot splitting " << coll << ": " << res << endl;
+            return keys;
+        }
+        BSONForEach( e , res["splitKeys"].Obj() ) {
+            keys.push_back( e.Obj().getOwned() );
+        }
+        return keys;
+    }
+
+    // Matches the range between splits[i - 1] and splits[i], open at either end.
+    BSONObj rangeQuery( const vector<BSONObj>& splits , size_t i ) {
+        BSONObjBuilder id;
+        if ( i > 0 ) {
+            id.appendAs( splits[i - 1].firstElement() , "$gte" );
+        }
+        if ( i < splits.size() ) {
+            id.appendAs( splits[i].firstElement() , "$lt" );
+        }
+        const BSONObj range = BSON( "_id" << id.obj() );
+        return _query.isEmpty() ? range : BSON( "$and" << BSON_ARRAY( _query << range ) );
+    }
+
+    /**
+     * Dumps a collection bigger than _splitSize to one file per _id range, <coll>.bson.NNNN,
+     * which mongorestore puts back together.  Everything is read over conn() inside the dump's
+     * snapshot transaction, which only that connection can use, so the ranges take turns
+     * fetching a batch each while RangeWriters writes them out in parallel.
+     */
+    void writeCollectionRanges( const string coll , const boost::filesystem::path& outdir ,
+                                const string& filename ) {
+        const vector<BSONObj> splits = splitKeys( coll );
+        if ( splits.empty() ) {
+            writeCollectionFile( coll , outdir / ( filename + ".bson" ) );
+            return;
+        }
+        const size_t nRanges = splits.size() + 1;
+        log() << "\t" << coll << " to " << nRanges << " ranges in "
+              << ( outdir / ( filename + ".bson.*" ) ).string() << endl;
+
+        ProgressMeter m( conn( true ).count( coll.c_str() , _query , QueryOption_SlaveOk ) );
+        m.setUnits("objects");
+
+        RangeWriters writers( _numWriters );
+        list<RangeCursor> active;
+        size_t next = 0;
+        try {
+            while ( next < nRanges || ! active.empty() ) {
+                while ( active.size() < size_t( _numWriters ) && next < nRanges ) {
+                    char suffix[16];
+                    snprintf( suffix , sizeof( suffix ) , ".bson.%04u" , unsigned( next ) );
+                    const boost::filesystem::path file = outdir / ( filename + suffix );
+                    RangeCursor r;
+                    r.i = next++;
+                    r.f = fopen( file.string().c_str() , "wb" );
+                    uassert( 17033 , errnoWithPrefix( ( "couldn't open file " + file.string() ).c_str() ) , r.f );
+                    active.push_back( r );
+                    Query q( rangeQuery( splits , r.i ) );
+                    active.back().cursor.reset( conn( true ).query( coll , q.hint( BSON( "_id" << 1 ) ) , 0 , 0 , 0 ,
+                                                                    QueryOption_SlaveOk | QueryOption_NoCursorTimeout ).release() );
+                    uassert( 17034 , "couldn't query " + coll , active.back().cursor.get() );
+                }
+
+                for ( list<RangeCursor>::iterator it = active.begin(); it != active.end(); ) {
+                    if ( ! it->cursor->more() ) {
+                        writers.write( it->i , it->f , Batch() , true );
+                        it = active.erase( it );
+                        continue;
+                    }
+                    Batch batch( new BufBuilder( 1024 * 1024 ) );
+                    int n = 0;
+                    while ( it->cursor->moreInCurrentBatch() ) {
+                        const BSONObj obj = it->cursor->nextSafe();
+                        batch->appendBuf( obj.objdata() , obj.objsize() );
+                        n++;
+                    }
+                    writers.write( it->i , it->f , batch , false );
+                    m.hit( n );
+                    ++it;
+                }
+                uassert( 17035 , "stopping the dump of " + coll , ! writers.failed() );
+            }
+        }
+        catch ( ... ) {
+            // the writers close the files of ranges that were still going
+            for ( list<RangeCursor>::iterator it = active.begin(); it != active.end(); ++it ) {
+                writers.write( it->i , it->f , Batch() , true );
+            }
+            throw;
+        }
+        writers.finish();
+
+        log() << "\t\t " << m.done() << " objects" << endl;
+    }
+
     void writeMetadataFile( const string coll, boost::filesystem::path outputFile, 
                             map<string, BSONObj> options, multimap<string, BSONObj> indexes ) {
         log() << "\tMetadata for " << coll << " to " << outputFile.string() << endl;
@@ -233,7 +435,12 @@ public:
         for (vector<string>::iterator it = collections.begin(); it != collections.end(); ++it) {
             string name = *it;
             const string filename = name.substr( db.size() + 1 );
-            writeCollectionFile( name , outdir / ( filename + ".bson" ) );
+            if ( _splitSize > 0 ) {
+                writeCollectionRanges( name , outdir , filename );
+            }
+            else {
+                writeCollectionFile( name , outdir / ( filename + ".bson" ) );
+            }
             writeMetadataFile( name, outdir / (filename + ".metadata.json"), collectionOptions, indexes);
         }
 
@@ -320,6 +527,23 @@ public:
 
         _usingMongos = isMongos();
 
+        // One MVCC transaction, begun before anything is listed, makes every collection in the
+        // dump, and its metadata, a view of the same moment.
+        scoped_ptr<RemoteTransaction> snapshot;
+        if ( hasParam( "splitSize" ) ) {
+            _splitSize = getParam( "splitSize" , 0 );
+            _numWriters = getParam( "numWriters" , 4 );
+            if ( _splitSize < 1 || _numWriters < 1 ) {
+                log() << "--splitSize and --numWriters must be at least 1" << endl;
+                return -1;
+            }
+            if ( _usingMongos || hasParam( "dbpath" ) ) {
+                log() << "--splitSize needs a connection to a mongod" << endl;
+                return -1;
+            }
+            snapshot.reset( new RemoteTransaction( conn( true ) , "mvcc" ) );
+        }
+
         boost::filesystem::path root( out );
         string db = _db;
 
@@ -355,6 +579,10 @@ public:
             go( db , root / db );
         }
 
+        if ( snapshot ) {
+            snapshot->commit();
+        }
+
         if (!opLogName.empty()) {
             BSONObjBuilder b;
             b.appendDate("$gt", opLogStart);
@@ -369,6 +597,8 @@ public:
 
     bool _usingMongos;
     BSONObj _query;
+    int _splitSize;  // MB, 0 to dump each collection whole
+    int _numWriters;
 };
 
 int main( int argc , char ** argv, char ** envp ) {
@@ -210,6 +210,7 @@ public:
             out << '[';
 
         long long num = 0;
+        StringBuilder json;
         while ( cursor->more() ) {
             num++;
             BSONObj obj = cursor->next();
@@ -228,10 +229,13 @@ public:
                 if (jsonArray && num != 1)
                     out << ',';
 
-                out << obj.jsonString();
+                json.reset();
+                obj.jsonString( json );
+                out.write( json.stringData().rawData(), json.stringData().size() );
 
+                // no need to flush every line, the stream is flushed when we're done
                 if (!jsonArray)
-                    out << endl;
+                    out << '\n';
             }
         }
 
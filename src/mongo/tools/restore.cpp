@@ -24,6 +24,7 @@
 #include <boost/program_options.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
 #include <fcntl.h>
 #include <fstream>
 #include <set>
@@ -35,12 +36,144 @@
 #include "mongo/db/json.h"
 #include "mongo/client/dbclientcursor.h"
 #include "mongo/client/remote_loader.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/queue.h"
 
 using namespace mongo;
 
 namespace po = boost::program_options;
 
 class Restore : public BSONTool {
+
+    // A .bson file to restore into a collection.
+    struct CollectionJob {
+        boost::filesystem::path file;
+        string ns;
+        string oldCollName; // name of the collection that was dumped from
+        // For a collection mongodump --splitSize split into _id ranges, the <coll>.bson.NNNN
+        // files that make up file, which itself doesn't exist.
+        vector<boost::filesystem::path> ranges;
+    };
+
+    // @return the length of the <coll>.bson part of a <coll>.bson.NNNN range file's name, or
+    //         0 if it isn't one.
+    static size_t rangeFilePrefix(const string &name) {
+        const size_t dot = name.rfind(".bson.");
+        if (dot == string::npos || dot + 6 == name.size() ||
+            name.find_first_not_of("0123456789", dot + 6) != string::npos) {
+            return 0;
+        }
+        return dot + 5;
+    }
+
+    // Orders range files by the number after .bson., since past 9999 ranges the numbers are
+    // wider than the %04u they are padded to, and don't sort as strings.
+    static bool rangeFileLess(const boost::filesystem::path &a, const boost::filesystem::path &b) {
+        const string an = a.leaf().string();
+        const string bn = b.leaf().string();
+        const unsigned long long ai = strtoull(an.c_str() + rangeFilePrefix(an) + 1, NULL, 10);
+        const unsigned long long bi = strtoull(bn.c_str() + rangeFilePrefix(bn) + 1, NULL, 10);
+        return ai < bi;
+    }
+
+    // Documents read from a .bson file, packed back to back, to go in one insert.
+    struct Batch : boost::noncopyable {
+        explicit Batch(int size) : buf(size) {}
+        BufBuilder buf;
+        vector<int> offsets;
+    };
+    typedef shared_ptr<Batch> BatchPtr;
+
+    static size_t batchBytes(const BatchPtr &batch) {
+        return batch ? batch->buf.len() : 0;
+    }
+
+    /**
+     * Reads a .bson file on its own thread, so that reading the next batch overlaps with
+     * inserting the last one.  Keeps a few batches of read-ahead; an empty BatchPtr marks the
+     * end of the file.
+     */
+    class FileReader : boost::noncopyable {
+    public:
+        FileReader(Restore &tool, const boost::filesystem::path &file, int batchSize) :
+            _tool(tool), _file(file), _batchSize(batchSize),
+            _queue(3 * std::max(batchSize, BSONObjMaxUserSize) + 1, &batchBytes),
+            _ended(false) {
+            _thread.reset(new boost::thread(boost::bind(&FileReader::run, this)));
+        }
+
+        ~FileReader() {
+            cancel();
+        }
+
+        BatchPtr next() {
+            BatchPtr batch = _queue.blockingPop();
+            if (!batch) {
+                _ended = true;
+            }
+            return batch;
+        }
+
+        /** Waits for the reader to finish, throwing anything it failed with. */
+        void finish() {
+            _thread->join();
+            uassert(17030, str::stream() << "error reading " << _file.string() << ": " << _error,
+                    _error.empty());
+        }
+
+        /** Stops the reader early, when the inserts have failed. */
+        void cancel() {
+            if (!_thread->joinable()) {
+                return;
+            }
+            _cancelled.store(1);
+            while (!_ended) {
+                next();
+            }
+            _thread->join();
+        }
+
+    private:
+        void run() {
+            try {
+                _tool.processFile(_file, boost::bind(&FileReader::add, this, _1));
+                if (_batch) {
+                    _queue.push(_batch);
+                }
+            }
+            catch (const DBException &e) {
+                _error = e.toString();
+            }
+            catch (const std::exception &e) {
+                _error = e.what();
+            }
+            _queue.push(BatchPtr());
+        }
+
+        void add(const BSONObj &obj) {
+            uassert(17031, "restore canceled", _cancelled.load() == 0);
+            if (_batch && _batch->buf.len() + obj.objsize() > _batchSize) {
+                _queue.push(_batch);
+                _batch.reset();
+            }
+            if (!_batch) {
+                _batch.reset(new Batch(std::max(_batchSize, obj.objsize())));
+            }
+            _batch->offsets.push_back(_batch->buf.len());
+            _batch->buf.appendBuf(obj.objdata(), obj.objsize());
+        }
+
+        Restore &_tool;
+        const boost::filesystem::path _file;
+        const int _batchSize;
+        BlockingQueue<BatchPtr> _queue;
+        BatchPtr _batch;
+        AtomicUInt32 _cancelled;
+        bool _ended; // the consumer has seen the end
+        string _error;
+        scoped_ptr<boost::thread> _thread;
+    };
+
 public:
 
     bool _drop;
@@ -48,14 +181,22 @@ public:
     bool _restoreIndexes;
     int _w;
     bool _doBulkLoad;
+    int _numParallelCollections;
+    int _batchSize;
     string _curns;
     string _curdb;
-    string _curcoll;
     set<string> _users; // For restoring users with --drop
 
+    // Collections found by drillDown, restored by doRun.  The workers take them in order.
+    vector<CollectionJob> _jobs;
+    size_t _nextJob;
+    bool _failed;
+    mongo::mutex _jobsMutex;
+
     Restore() : BSONTool( "restore" ),
         _drop(false), _restoreOptions(false), _restoreIndexes(false),
-        _w(0), _doBulkLoad(false) {
+        _w(0), _doBulkLoad(false), _numParallelCollections(1), _batchSize(0),
+        _nextJob(0), _failed(false), _jobsMutex("Restore::jobs") {
 
         add_options()
         ("drop" , "drop each collection before import. RECOMMENDED, since only non-existent collections are eligible for the bulk load optimization.")
@@ -65,6 +206,8 @@ public:
         ("noOptionsRestore" , "don't restore collection options")
         ("noIndexRestore" , "don't restore indexes")
         ("w" , po::value<int>()->default_value(1) , "minimum number of replicas per write. WARNING, setting w > 0 prevents the bulk load optimization." )
+        ("numParallelCollections" , po::value<int>()->default_value(4) , "number of collections to restore at once, each over its own connection" )
+        ("batchSize" , po::value<int>()->default_value(8) , "megabytes of documents to send in each insert" )
         ;
         add_hidden_options()
         ("dir", po::value<string>()->default_value("dump"), "directory to restore from")
@@ -100,6 +243,23 @@ public:
         if (!_doBulkLoad) {
             log() << "warning: not using bulk loader due to --w > 1" << endl;
         }
+        _numParallelCollections = getParam( "numParallelCollections" , 4 );
+        if (_numParallelCollections < 1) {
+            log() << "--numParallelCollections must be at least 1" << endl;
+            return -1;
+        }
+        if (_numParallelCollections > 1 && (hasParam( "dbpath" ) || hasFilter())) {
+            log() << "warning: restoring one collection at a time, since --dbpath and "
+                     "--filter don't allow more" << endl;
+            _numParallelCollections = 1;
+        }
+        // a batch, plus the one document that overflows it, must fit in an insert message
+        const int batchSizeMB = getParam( "batchSize" , 8 );
+        if (batchSizeMB < 1 || batchSizeMB > 16) {
+            log() << "--batchSize must be between 1 and 16" << endl;
+            return -1;
+        }
+        _batchSize = batchSizeMB * 1024 * 1024;
         if (hasParam( "keepIndexVersion" )) {
             log() << "warning: --keepIndexVersion is deprecated in TokuMX" << endl;
         }
@@ -120,10 +280,72 @@ public:
          * .bson file, or a single .bson file itself (a collection).
          */
         drillDown(root, _db != "", _coll != "", true);
+
+        // system.users needs the _users bookkeeping, so it stays on this thread and conn()
+        vector<CollectionJob> jobs;
+        jobs.swap(_jobs);
+        for (vector<CollectionJob>::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+            if (it->file.leaf() == "system.users.bson" || _numParallelCollections == 1) {
+                restoreCollection(conn(), *it);
+            }
+            else {
+                _jobs.push_back(*it);
+            }
+        }
+        if (!_jobs.empty()) {
+            const size_t nThreads = std::min(_jobs.size(), size_t(_numParallelCollections));
+            vector< shared_ptr<boost::thread> > threads;
+            for (size_t i = 0; i < nThreads; i++) {
+                threads.push_back(shared_ptr<boost::thread>(
+                        new boost::thread(boost::bind(&Restore::restoreWorker, this))));
+            }
+            for (size_t i = 0; i < threads.size(); i++) {
+                threads[i]->join();
+            }
+            if (_failed) {
+                return -1;
+            }
+        }
+
         conn().getLastError(_db == "" ? "admin" : _db);
         return EXIT_CLEAN;
     }
 
+    // Restores collections from _jobs over its own connection until they run out.
+    void restoreWorker() {
+        scoped_ptr<DBClientBase> c;
+        try {
+            c.reset(newConnection());
+        }
+        catch (const DBException &e) {
+            error() << "ERROR: couldn't open another connection: " << e.toString() << endl;
+            scoped_lock lk(_jobsMutex);
+            _failed = true;
+            return;
+        }
+        verify(c);
+
+        while (true) {
+            CollectionJob job;
+            {
+                scoped_lock lk(_jobsMutex);
+                if (_failed || _nextJob == _jobs.size()) {
+                    return;
+                }
+                job = _jobs[_nextJob++];
+            }
+            try {
+                restoreCollection(*c, job);
+            }
+            catch (const std::exception &e) {
+                error() << "ERROR: restoring " << job.ns << " failed: " << e.what() << endl;
+                scoped_lock lk(_jobsMutex);
+                _failed = true;
+                return;
+            }
+        }
+    }
+
     void drillDown( boost::filesystem::path root,
                     bool use_db,
                     bool use_coll,
@@ -151,7 +373,8 @@ public:
                 }
 
                 if (use_coll) {
-                    if (boost::filesystem::is_directory(p) || i != end) {
+                    if (boost::filesystem::is_directory(p) ||
+                        (i != end && !rangeFilePrefix(p.leaf().string()))) {
                         error() << "ERROR: root directory must be a dump of a single collection" << endl;
                         error() << "       when specifying a collection name with --collection" << endl;
                         printHelp(cout);
@@ -177,13 +400,20 @@ public:
             return;
         }
 
+        // The ranges of a split collection are restored together, as the file they came from.
+        boost::filesystem::path range;
+        if (const size_t prefix = rangeFilePrefix(root.leaf().string())) {
+            range = root;
+            root = root.branch_path() / root.leaf().string().substr(0, prefix);
+        }
+
         if ( ! ( endsWith( root.string().c_str() , ".bson" ) ||
                  endsWith( root.string().c_str() , ".bin" ) ) ) {
             error() << "don't know what to do with file [" << root.string() << "]" << endl;
             return;
         }
 
-        log() << root.string() << endl;
+        log() << ( range.empty() ? root : range ).string() << endl;
 
         if ( root.leaf() == "system.profile.bson" ) {
             log() << "\t skipping" << endl;
@@ -216,16 +446,39 @@ public:
             ns += "." + oldCollName;
         }
 
-        log() << "\tgoing into namespace [" << ns << "]" << endl;
+        if (!range.empty()) {
+            for (vector<CollectionJob>::iterator it = _jobs.begin(); it != _jobs.end(); ++it) {
+                if (it->file == root && it->ns == ns) {
+                    it->ranges.push_back(range);
+                    return;
+                }
+            }
+        }
+
+        CollectionJob job;
+        job.file = root;
+        job.ns = ns;
+        job.oldCollName = oldCollName;
+        if (!range.empty()) {
+            job.ranges.push_back(range);
+        }
+        _jobs.push_back(job);
+    }
+
+    void restoreCollection(DBClientBase &c, const CollectionJob &job) {
+        const boost::filesystem::path &root = job.file;
+        const string &ns = job.ns;
+        const bool users = root.leaf() == "system.users.bson";
+        log() << root.string() << "\tgoing into namespace [" << ns << "]" << endl;
 
         if ( _drop ) {
-            if (root.leaf() != "system.users.bson" ) {
-                log() << "\t dropping" << endl;
-                conn().dropCollection( ns );
+            if ( !users ) {
+                log() << "\t dropping " << ns << endl;
+                c.dropCollection( ns );
             } else {
                 // Create map of the users currently in the DB
                 BSONObj fields = BSON("user" << 1);
-                scoped_ptr<DBClientCursor> cursor(conn().query(ns, Query(), 0, 0, &fields));
+                scoped_ptr<DBClientCursor> cursor(c.query(ns, Query(), 0, 0, &fields));
                 while (cursor->more()) {
                     BSONObj user = cursor->next();
                     _users.insert(user["user"].String());
@@ -235,7 +488,7 @@ public:
 
         BSONObj metadataObject;
         if (_restoreOptions || _restoreIndexes) {
-            boost::filesystem::path metadataFile = (root.branch_path() / (oldCollName + ".metadata.json"));
+            boost::filesystem::path metadataFile = (root.branch_path() / (job.oldCollName + ".metadata.json"));
             if (!boost::filesystem::exists(metadataFile.string())) {
                 // This is fine because dumps from before 2.1 won't have a metadata file, just print a warning.
                 // System collections shouldn't have metadata so don't warn if that file is missing.
@@ -247,15 +500,14 @@ public:
             }
         }
 
-        _curns = ns.c_str();
-        NamespaceString nss(_curns);
-        _curdb = nss.db;
-        _curcoll = nss.coll;
+        NamespaceString nss(ns);
+        massert( 16910, "Shouldn't be inserting into system.indexes directly",
+                        nss.coll != "system.indexes" );
 
         // If drop is not used, warn if the collection exists.
         if (!_drop) {
-            scoped_ptr<DBClientCursor> cursor(conn().query(_curdb + ".system.namespaces",
-                                                            Query(BSON("name" << ns))));
+            scoped_ptr<DBClientCursor> cursor(c.query(nss.db + ".system.namespaces",
+                                                      Query(BSON("name" << ns))));
             if (cursor->more()) {
                 // collection already exists show warning
                 warning() << "Restoring to " << ns << " without dropping. Restored data "
@@ -269,9 +521,9 @@ public:
             const vector<BSONElement> indexElements = metadataObject["indexes"].Array();
             for (vector<BSONElement>::const_iterator it = indexElements.begin(); it != indexElements.end(); ++it) {
                 // Need to make sure the ns field gets updated to
-                // the proper _curdb + _curns value, if we're
+                // the proper db + collection, if we're
                 // restoring to a different database.
-                const BSONObj indexObj = renameIndexNs(it->Obj());
+                const BSONObj indexObj = renameIndexNs(it->Obj(), ns);
                 indexes.push_back(indexObj);
             }
         }
@@ -279,36 +531,87 @@ public:
                                 metadataObject["options"].Obj() : BSONObj();
 
         if (_doBulkLoad) {
-            RemoteLoader loader(conn(), _curdb, _curcoll, indexes, options);
-            processFile( root );
+            // The loader builds the indexes as the documents go in, and finishes them at commit.
+            RemoteLoader loader(c, nss.db, nss.coll, indexes, options);
+            insertFile(c, job, users);
             loader.commit();
         } else {
             // No bulk load. Create collection and indexes manually.
             if (!options.isEmpty()) {
-                createCollectionWithOptions(options);
+                createCollectionWithOptions(c, ns, options);
             }
             // Build indexes last - it's a little faster.
-            processFile( root );
+            insertFile(c, job, users);
             for (vector<BSONObj>::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                createIndex(*it);
+                createIndex(c, nss.db, *it);
             }
         }
 
-        if (_drop && root.leaf() == "system.users.bson") {
+        if (_drop && users) {
             // Delete any users that used to exist but weren't in the dump file
             for (set<string>::iterator it = _users.begin(); it != _users.end(); ++it) {
                 BSONObj userMatch = BSON("user" << *it);
-                conn().remove(ns, Query(userMatch));
+                c.remove(ns, Query(userMatch));
             }
             _users.clear();
         }
     }
 
+    void insertFile(DBClientBase &c, const CollectionJob &job, bool users) {
+        if (users) {
+            verify(job.ranges.empty());
+            // users may have to be updated one at a time, see gotObject
+            _curns = job.ns;
+            NamespaceString nss(_curns);
+            _curdb = nss.db;
+            processFile( job.file );
+            return;
+        }
+
+        vector<boost::filesystem::path> files = job.ranges;
+        if (files.empty()) {
+            files.push_back(job.file);
+        }
+        // the ranges are numbered in _id order, which is the fastest order to insert them in
+        if (!job.ranges.empty()) {
+            sort(files.begin(), files.end(), rangeFileLess);
+        }
+
+        // Reading one range ahead keeps the inserts going from one file to the next.  If an
+        // insert fails, destroying the readers stops them.
+        scoped_ptr<FileReader> reader(new FileReader(*this, files[0], _batchSize));
+        for (size_t i = 0; i < files.size(); i++) {
+            scoped_ptr<FileReader> nextReader(i + 1 < files.size() ?
+                                              new FileReader(*this, files[i + 1], _batchSize) :
+                                              NULL);
+            insertBatches(c, job.ns, *reader);
+            reader->finish();
+            reader.swap(nextReader);
+        }
+    }
+
+    void insertBatches(DBClientBase &c, const string &ns, FileReader &reader) {
+        const string db = nsToDatabase(ns);
+        vector<BSONObj> objs;
+        for (BatchPtr batch = reader.next(); batch; batch = reader.next()) {
+            objs.clear();
+            for (vector<int>::const_iterator it = batch->offsets.begin(); it != batch->offsets.end(); ++it) {
+                objs.push_back(BSONObj(batch->buf.buf() + *it));
+            }
+            // Like the single inserts this replaces, don't stop at the first error.
+            c.insert(ns, objs, InsertOption_ContinueOnError);
+
+            // wait for inserts to propagate to "w" nodes (doesn't warn if w used without replset)
+            if ( _w > 1 ) {
+                verify( !_doBulkLoad );
+                c.getLastErrorDetailed(db, false, false, _w);
+            }
+        }
+    }
+
+    // Only system.users is restored one object at a time, see insertFile.
     virtual void gotObject( const BSONObj& obj ) {
-        StringData collstr = nsToCollectionSubstring(_curns);
-        massert( 16910, "Shouldn't be inserting into system.indexes directly",
-                        collstr != "system.indexes" );
-        if (_drop && collstr == "system.users" && _users.count(obj["user"].String())) {
+        if (_drop && _users.count(obj["user"].String())) {
             // Since system collections can't be dropped, we have to manually
             // replace the contents of the system.users collection
             BSONObj userMatch = BSON("user" << obj["user"].String());
@@ -361,18 +664,19 @@ private:
         return nfields == obj2.nFields();
     }
 
-    void createCollectionWithOptions(BSONObj cmdObj) {
-        if (!cmdObj.hasField("create") || cmdObj["create"].String() != _curcoll) {
+    void createCollectionWithOptions(DBClientBase &c, const string &ns, BSONObj cmdObj) {
+        const NamespaceString nss(ns);
+        if (!cmdObj.hasField("create") || cmdObj["create"].String() != nss.coll) {
             BSONObjBuilder bo;
             if (!cmdObj.hasField("create")) {
-                bo.append("create", _curcoll);
+                bo.append("create", nss.coll);
             }
 
             BSONObjIterator i(cmdObj);
             while ( i.more() ) {
                 BSONElement e = i.next();
                 if (strcmp(e.fieldName(), "create") == 0) {
-                    bo.append("create", _curcoll);
+                    bo.append("create", nss.coll);
                 }
                 else {
                     bo.append(e);
@@ -382,14 +686,14 @@ private:
         }
 
         BSONObj fields = BSON("options" << 1);
-        scoped_ptr<DBClientCursor> cursor(conn().query(_curdb + ".system.namespaces", Query(BSON("name" << _curns)), 0, 0, &fields));
+        scoped_ptr<DBClientCursor> cursor(c.query(nss.db + ".system.namespaces", Query(BSON("name" << ns)), 0, 0, &fields));
 
         bool createColl = true;
         if (cursor->more()) {
             createColl = false;
             BSONObj obj = cursor->next();
             if (!obj.hasField("options") || !optionsSame(cmdObj, obj["options"].Obj())) {
-                    log() << "WARNING: collection " << _curns << " exists with different options than are in the metadata.json file and not using --drop. Options in the metadata file will be ignored." << endl;
+                    log() << "WARNING: collection " << ns << " exists with different options than are in the metadata.json file and not using --drop. Options in the metadata file will be ignored." << endl;
             }
         }
 
@@ -398,21 +702,20 @@ private:
         }
 
         BSONObj info;
-        if (!conn().runCommand(_curdb, cmdObj, info)) {
-            uasserted(15936, "Creating collection " + _curns + " failed. Errmsg: " + info["errmsg"].String());
+        if (!c.runCommand(nss.db, cmdObj, info)) {
+            uasserted(15936, "Creating collection " + ns + " failed. Errmsg: " + info["errmsg"].String());
         } else {
-            log() << "\tCreated collection " << _curns << " with options: " << cmdObj.jsonString() << endl;
+            log() << "\tCreated collection " << ns << " with options: " << cmdObj.jsonString() << endl;
         }
     }
 
-    BSONObj renameIndexNs(const BSONObj &orig) {
+    BSONObj renameIndexNs(const BSONObj &orig, const string &ns) {
         BSONObjBuilder bo;
         BSONObjIterator i(orig);
         while ( i.more() ) {
             BSONElement e = i.next();
             if (strcmp(e.fieldName(), "ns") == 0) {
-                string s = _curdb + "." + _curcoll;
-                bo.append("ns", s);
+                bo.append("ns", ns);
             }
             else if (strcmp(e.fieldName(), "v") != 0) { // Remove index version number
                 bo.append(e);
@@ -423,12 +726,12 @@ private:
 
     /* We must handle if the dbname or collection name is different at restore time than what was dumped.
      */
-    void createIndex(BSONObj indexObj) {
+    void createIndex(DBClientBase &c, const string &db, BSONObj indexObj) {
         LOG(0) << "\tCreating index: " << indexObj << endl;
-        conn().insert( _curdb + ".system.indexes" ,  indexObj );
+        c.insert( db + ".system.indexes" ,  indexObj );
 
         // We're stricter about errors for indexes than for regular data
-        BSONObj err = conn().getLastErrorDetailed(_curdb, false, false, _w);
+        BSONObj err = c.getLastErrorDetailed(db, false, false, _w);
 
         if (err.hasField("err") && !err["err"].isNull()) {
             if (err["err"].str() == "norepl" && _w > 1) {
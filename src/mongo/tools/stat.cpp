@@ -43,6 +43,7 @@ namespace mongo {
         Stat() : Tool( "stat" , REMOTE_SERVER , "admin" ) {
             _http = false;
             _many = false;
+            _engine = false;
 
             add_hidden_options()
             ( "sleep" , po::value<int>() , "time to sleep between calls" )
@@ -53,6 +54,7 @@ namespace mongo {
             ("http", "use http instead of raw db connection")
             ("discover" , "discover nodes and display stats for all" )
             ("all" , "all optional fields" )
+            ("engine" , "storage engine fields (runs engineStats too)" )
             ;
 
             addPositionArg( "sleep" , 1 );
@@ -82,6 +84,9 @@ namespace mongo {
             out << "   netIn    \t- network traffic in - bits\n";
             out << "   netOut   \t- network traffic out - bits\n";
             out << "   conn     \t- number of open connections\n";
+            out << "   cmiss    \t- # of cachetable misses per second (--engine)\n";
+            out << "   evict    \t- # of tree nodes evicted from the cachetable per second (--engine)\n";
+            out << "   mbflush  \t- # of message buffer flushes per second (--engine)\n";
             out << "   set      \t- replica set name\n";
             out << "   repl     \t- replication type \n";
             out << "            \t    PRI - primary (master)\n";
@@ -125,9 +130,24 @@ namespace mongo {
                 cout << "error: " << out << endl;
                 return BSONObj();
             }
+            if ( _engine )
+                return addEngineStats( conn() , out );
             return out.getOwned();
         }
 
+        /* serverStatus plus the engineStats command's output under "engineStats", or just
+         * serverStatus if the server doesn't have engineStats (e.g. mongos).
+         */
+        static BSONObj addEngineStats( DBClientBase& conn , const BSONObj& status ) {
+            BSONObj engine;
+            if ( ! conn.simpleCommand( "admin" , &engine , "engineStats" ) )
+                return status.getOwned();
+            BSONObjBuilder b;
+            b.appendElements( status );
+            b.append( "engineStats" , engine );
+            return b.obj();
+        }
+
 
         virtual void preSetup() {
             if ( hasParam( "http" ) ) {
@@ -149,6 +169,7 @@ namespace mongo {
         int run() {
             _statUtil.setSeconds( getParam( "sleep" , 1 ) );
             _statUtil.setAll( hasParam( "all" ) );
+            _engine = hasParam( "engine" );
             if ( _many )
                 return runMany();
             return runNormal();
@@ -264,7 +285,7 @@ namespace mongo {
         }
 
         struct ServerState {
-            ServerState() : lock( "Stat::ServerState" ) {}
+            ServerState() : lock( "Stat::ServerState" ) , engine( false ) {}
             string host;
             scoped_ptr<boost::thread> thr;
 
@@ -279,6 +300,7 @@ namespace mongo {
             bool mongos;
 
             BSONObj authParams;
+            bool engine;
         };
 
         static void serverThread( shared_ptr<ServerState> state , int sleepTime) {
@@ -297,11 +319,12 @@ namespace mongo {
                     try {
                         BSONObj out;
                         if ( conn.simpleCommand( "admin" , &out , "serverStatus" ) ) {
+                            BSONObj now = state->engine ? addEngineStats( conn , out ) : out.getOwned();
                             scoped_lock lk( state->lock );
                             state->error = "";
                             state->lastUpdate = time(0);
                             state->prev = state->now;
-                            state->now = out.getOwned();
+                            state->now = now;
                         }
                         else {
                             scoped_lock lk( state->lock );
@@ -350,6 +373,7 @@ namespace mongo {
 
             state.reset( new ServerState() );
             state->host = host;
+            state->engine = _engine;
             /* For each new thread, pass in a thread state object and the delta between samples */
             state->thr.reset( new boost::thread( boost::bind( serverThread,
                                                               state,
@@ -547,6 +571,7 @@ namespace mongo {
 
         StatUtil _statUtil;
         bool _http;
+        bool _engine;
         bool _many;
 
         struct Row {
@@ -170,6 +170,27 @@ namespace mongo {
 
         _append( result , "conn" , 5 , b.getFieldDotted( "connections.current" ).numberInt() );
 
+        if ( a["engineStats"].isABSONObj() && b["engineStats"].isABSONObj() ) {
+            BSONObj ax = a["engineStats"].embeddedObject();
+            BSONObj bx = b["engineStats"].embeddedObject();
+            if ( bx.getFieldDotted( "cachetable.CT_MISS" ).isNumber() )
+                _append( result , "cmiss" , 6 , (int)diff( "cachetable.CT_MISS" , ax , bx ) );
+            if ( bx["evictions"].isABSONObj() ) {
+                // node counts only, not the _BYTES rows next to them
+                double evictions = 0;
+                BSONObjIterator i( bx["evictions"].embeddedObject() );
+                while ( i.more() ) {
+                    string f = i.next().fieldName();
+                    if ( f.find( "BYTES" ) == string::npos )
+                        evictions += diff( "evictions." + f , ax , bx );
+                }
+                _append( result , "evict" , 6 , (int)evictions );
+            }
+            if ( bx.getFieldDotted( "messageBufferFlushes.FT_FLUSHER_FLUSH_TOTAL" ).isNumber() )
+                _append( result , "mbflush" , 7 ,
+                         (int)diff( "messageBufferFlushes.FT_FLUSHER_FLUSH_TOTAL" , ax , bx ) );
+        }
+
         if ( b["repl"].type() == Object ) {
 
             BSONObj x = b["repl"].embeddedObject();
@@ -31,6 +31,7 @@
 #include "mongo/db/json.h"
 #include "mongo/db/storage/env.h"
 #include "mongo/util/password.h"
+#include "mongo/util/scopeguard.h"
 #include "mongo/util/version.h"
 
 #include <boost/filesystem/operations.hpp>
@@ -415,6 +416,10 @@ namespace mongo {
             return;
         }
 
+        authenticate( _conn );
+    }
+
+    void Tool::authenticate( DBClientBase *conn ) {
         std::string userSource = _authenticationDatabase;
         if ( userSource.empty() ) {
             if ( !_db.empty() ) {
@@ -425,10 +430,31 @@ namespace mongo {
             }
         }
 
-        _conn->auth( BSON( saslCommandPrincipalSourceFieldName << userSource <<
-                           saslCommandPrincipalFieldName << _username <<
-                           saslCommandPasswordFieldName << _password  <<
-                           saslCommandMechanismFieldName << _authenticationMechanism ) );
+        conn->auth( BSON( saslCommandPrincipalSourceFieldName << userSource <<
+                          saslCommandPrincipalFieldName << _username <<
+                          saslCommandPasswordFieldName << _password  <<
+                          saslCommandMechanismFieldName << _authenticationMechanism ) );
+    }
+
+    DBClientBase *Tool::newConnection() {
+        if ( _noconnection || _host == "DIRECT" ) {
+            return NULL;
+        }
+
+        string errmsg;
+        ConnectionString cs = ConnectionString::parse( _host , errmsg );
+        DBClientBase *c = cs.connect( errmsg );
+        uassert( 17029 , str::stream() << "couldn't connect to [" << _host << "] " << errmsg , c );
+        if ( ! _username.empty() ) {
+            try {
+                authenticate( c );
+            }
+            catch ( ... ) {
+                delete c;
+                throw;
+            }
+        }
+        return c;
     }
 
     BSONTool::BSONTool( const char * name, DBAccess access , bool objcheck )
@@ -456,20 +482,28 @@ namespace mongo {
 
     long long BSONTool::processFile( const boost::filesystem::path& root ) {
         _fileName = root.string();
+        return processFile( root , boost::bind( &BSONTool::gotObject , this , _1 ) );
+    }
+
+    long long BSONTool::processFile( const boost::filesystem::path& root ,
+                                     const boost::function<void (const BSONObj&)>& handler ) {
+        const string fileName = root.string();
 
         unsigned long long fileLength = file_size( root );
 
         if ( fileLength == 0 ) {
-            out() << "file " << _fileName << " empty, skipping" << endl;
+            out() << "file " << fileName << " empty, skipping" << endl;
             return 0;
         }
 
 
-        FILE* file = fopen( _fileName.c_str() , "rb" );
+        FILE* file = fopen( fileName.c_str() , "rb" );
         if ( ! file ) {
-            log() << "error opening file: " << _fileName << " " << errnoWithDescription() << endl;
+            log() << "error opening file: " << fileName << " " << errnoWithDescription() << endl;
             return 0;
         }
+        // a handler may throw to stop the read
+        ON_BLOCK_EXIT( fclose , file );
 
 #if !defined(__sunos__) && defined(POSIX_FADV_SEQUENTIAL)
         posix_fadvise(fileno(file), 0, fileLength, POSIX_FADV_SEQUENTIAL);
@@ -517,7 +551,7 @@ namespace mongo {
             }
 
             if ( _matcher.get() == 0 || _matcher->matches( o ) ) {
-                gotObject( o );
+                handler( o );
                 processed++;
             }
 
@@ -527,8 +561,6 @@ namespace mongo {
             m.hit( o.objsize() );
         }
 
-        fclose( file );
-
         uassert( 10265 ,  "counts don't match" , m.done() == fileLength );
         (_usesstdout ? cout : cerr ) << m.hits() << " objects found" << endl;
         if ( _matcher.get() )
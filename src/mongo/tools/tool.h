@@ -20,6 +20,7 @@
 
 #include <string>
 
+#include <boost/function.hpp>
 #include <boost/program_options.hpp>
 
 #if defined(_WIN32)
@@ -104,6 +105,13 @@ namespace mongo {
 
         mongo::DBClientBase &conn( bool slaveIfPaired = false );
 
+        /**
+         * Opens and authenticates another connection to the same server as conn(), for tools
+         * that work on several things at once.  The caller owns it.
+         * @return NULL when there is no server, as with --dbpath
+         */
+        mongo::DBClientBase *newConnection();
+
         string _name;
 
         string _db;
@@ -142,6 +150,7 @@ namespace mongo {
 
     private:
         void auth();
+        void authenticate( mongo::DBClientBase *conn );
     };
 
     class BSONTool : public Tool {
@@ -158,6 +167,15 @@ namespace mongo {
 
         long long processFile( const boost::filesystem::path& file );
 
+        /**
+         * Like processFile, but hands each object to handler instead of gotObject, so several
+         * files may be read at once from different threads.  Not with --filter.
+         */
+        long long processFile( const boost::filesystem::path& file,
+                               const boost::function<void (const BSONObj&)>& handler );
+
+        bool hasFilter() const { return _matcher.get() != 0; }
+
     };
 
 }
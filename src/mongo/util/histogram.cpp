@@ -16,6 +16,8 @@
 
 #include "histogram.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <limits>
 #include <sstream>
@@ -126,4 +128,56 @@ namespace mongo {
         return low;
     }
 
+    LatencyHistogram::LatencyHistogram() : _count( 0 ) {
+        memset( _buckets, 0, sizeof(_buckets) );
+    }
+
+    void LatencyHistogram::insert( uint64_t micros ) {
+        _buckets[ findBucket( micros ) ]++;
+        _count++;
+    }
+
+    uint64_t LatencyHistogram::getPercentile( double q ) const {
+        if ( _count == 0 ) {
+            return 0;
+        }
+        // the rank of the sample we want, counting from 1
+        uint64_t rank = static_cast<uint64_t>( q * _count );
+        if ( rank < q * _count || rank == 0 ) {
+            rank++;
+        }
+        uint64_t seen = 0;
+        for ( uint32_t i = 0; i < NumBuckets; i++ ) {
+            seen += _buckets[i];
+            if ( seen >= rank ) {
+                return getBoundary( i );
+            }
+        }
+        return getBoundary( NumBuckets - 1 );
+    }
+
+    uint32_t LatencyHistogram::findBucket( uint64_t micros ) {
+        if ( micros < 2 ) {
+            return static_cast<uint32_t>( micros );
+        }
+        // e = floor(log2(micros)), then which half of [2^e, 2^(e+1)) it's in
+        uint32_t e = 0;
+        for ( uint64_t v = micros; v > 1; v >>= 1 ) {
+            e++;
+        }
+        const uint32_t bucket = 2 * e + static_cast<uint32_t>( ( micros >> ( e - 1 ) ) & 1 );
+        return std::min( bucket, static_cast<uint32_t>( NumBuckets - 1 ) );
+    }
+
+    uint64_t LatencyHistogram::getBoundary( uint32_t bucket ) {
+        if ( bucket < 2 ) {
+            return bucket;
+        }
+        const uint32_t e = bucket / 2;
+        const uint64_t halfWidth = 1ULL << ( e - 1 );
+        const uint64_t smallest = ( 1ULL << e ) + ( bucket % 2 ) * halfWidth;
+        // the last bucket has no top, its smallest will have to do
+        return bucket >= NumBuckets - 1 ? smallest : smallest + halfWidth - 1;
+    }
+
 }  // namespace mongo
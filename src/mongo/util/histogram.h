@@ -118,6 +118,42 @@ namespace mongo {
         Histogram& operator=( const Histogram& );
     };
 
+    /**
+     * A histogram of latencies in microseconds with fixed, logarithmic buckets, small enough
+     * to keep one per collection and operation type and to copy around.  Each power of two is
+     * split into two buckets, so a percentile read from it is at most ~50% above the true one.
+     *
+     * Not synchronized: callers that share one serialize access to it.
+     */
+    class LatencyHistogram {
+    public:
+        enum { NumBuckets = 64 };
+
+        LatencyHistogram();
+
+        void insert( uint64_t micros );
+
+        uint64_t getCount() const { return _count; }
+
+        /**
+         * Return the largest latency in the bucket that holds the 'q'th quantile, for
+         * 0 < q <= 1, or 0 if nothing was recorded.
+         */
+        uint64_t getPercentile( double q ) const;
+
+        /**
+         * Return the bucket 'micros' is counted in, and the largest latency counted in
+         * 'bucket' (for the last bucket, which counts everything over ~53 minutes, the
+         * smallest).
+         */
+        static uint32_t findBucket( uint64_t micros );
+        static uint64_t getBoundary( uint32_t bucket );
+
+    private:
+        uint64_t _count;
+        uint64_t _buckets[NumBuckets];
+    };
+
 }  // namespace mongo
 
 #endif  //  UTIL_HISTOGRAM_HEADER
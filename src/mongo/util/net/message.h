@@ -222,6 +222,8 @@ namespace mongo {
             r._buf = 0;
             if ( r._data.size() > 0 ) {
                 _data.swap( r._data );
+                _freeData.swap( r._freeData );
+                _keepAlive.swap( r._keepAlive );
             }
             r._freeIt = false;
             _freeIt = true;
@@ -233,12 +235,16 @@ namespace mongo {
                 if ( _buf ) {
                     free( _buf );
                 }
-                for( vector< pair< char *, int > >::const_iterator i = _data.begin(); i != _data.end(); ++i ) {
-                    free(i->first);
+                for( size_t i = 0; i < _data.size(); ++i ) {
+                    if ( _freeData[ i ] ) {
+                        free( _data[ i ].first );
+                    }
                 }
             }
             _buf = 0;
             _data.clear();
+            _freeData.clear();
+            _keepAlive.clear();
             _freeIt = false;
         }
 
@@ -257,9 +263,33 @@ namespace mongo {
             verify( _freeIt );
             if ( _buf ) {
                 _data.push_back( make_pair( (char*)_buf, _buf->len ) );
+                _freeData.push_back( true );
                 _buf = 0;
             }
             _data.push_back( make_pair( d, size ) );
+            _freeData.push_back( true );
+            header()->len += size;
+        }
+
+        // use to add a buffer the message must not free, after the first one
+        // keepAlive, if set, is held until the message is reset so that d stays valid
+        void appendDataRef(char *d, int size,
+                           const boost::shared_ptr<void> &keepAlive = boost::shared_ptr<void>()) {
+            if ( size <= 0 ) {
+                return;
+            }
+            verify( !empty() );
+            verify( _freeIt );
+            if ( _buf ) {
+                _data.push_back( make_pair( (char*)_buf, _buf->len ) );
+                _freeData.push_back( true );
+                _buf = 0;
+            }
+            _data.push_back( make_pair( d, size ) );
+            _freeData.push_back( false );
+            if ( keepAlive ) {
+                _keepAlive.push_back( keepAlive );
+            }
             header()->len += size;
         }
 
@@ -299,6 +329,9 @@ namespace mongo {
         // byte buffer(s) - the first must contain at least a full MsgData unless using _buf for storage instead
         typedef vector< pair< char*, int > > MsgVec;
         MsgVec _data;
+        // whether each of _data is ours to free, and what keeps the others valid
+        vector<bool> _freeData;
+        vector< boost::shared_ptr<void> > _keepAlive;
         bool _freeIt;
     };
 